@@ -0,0 +1,152 @@
+// connect to subscribed, BLESession's slot chain against the same walk
+// written on AsyncLink. Simulated thermometers answer with fixed round
+// trips and a primary service walk that goes on after the thermometer is
+// found. The slot chain opens the service when the walk ends and writes the
+// CCCD once the service is open; the AsyncLink flow opens the service as
+// soon as it is discovered and reads the Temperature Type alongside the CCCD
+// write. Neither uses the GATT cache, so every round walks the services.
+//
+//   asyncbench [rounds]
+
+#include "asynclink.h"
+#include "blesession.h"
+#include "latencyhistogram.h"
+#include "latencyrecorder.h"
+#include "simtransport.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+namespace {
+
+const QBluetoothUuid kService(QBluetoothUuid::HealthThermometer);
+const QBluetoothUuid kMeasurement(QBluetoothUuid::TemperatureMeasurement);
+const QBluetoothUuid kType(QBluetoothUuid::TemperatureType);
+
+SimTransport *thermometers(int devices, QObject *parent)
+{
+    SimTransport *transport = new SimTransport(parent);
+    for(int i = 0; i < devices; ++i) {
+        SimPeripheral peripheral = SimTransport::thermometer(i);
+        peripheral.connectLatencyMs = 20;
+        peripheral.discoveryLatencyMs = 10;
+        peripheral.serviceWalkMs = 60;
+        peripheral.subscribeLatencyMs = 10;
+        peripheral.valueReadLatencyMs = 10;
+        peripheral.latencyJitterMs = 5;
+        peripheral.rateHz = 0.0;
+        transport->addPeripheral(peripheral);
+    }
+    return transport;
+}
+
+void slotChain(int devices, int rounds, LatencyHistogram *latency, int *failed)
+{
+    QObject owner;
+    SimTransport *transport = thermometers(devices, &owner);
+    QList<BLESession *> sessions;
+    QHash<BLESession *, qint64> startedAt;
+    int subscribed = 0;
+    for(int i = 0; i < devices; ++i) {
+        BLESession *session = new BLESession(SimTransport::thermometer(i).info, transport, &owner);
+        session->setDiscoveryMode(BLESession::SubscribeOnly);
+        QObject::connect(session, &BLESession::stateChanged, [&, session](BLESession::State state) {
+            if(BLESession::Subscribed != state)
+                return;
+            latency->recordNanoseconds(LatencyRecorder::now() - startedAt.value(session));
+            ++subscribed;
+        });
+        sessions << session;
+    }
+
+    for(int round = 0; round < rounds; ++round) {
+        subscribed = 0;
+        for(BLESession *session : sessions) {
+            startedAt.insert(session, LatencyRecorder::now());
+            session->connectToDevice();
+        }
+        if(!settle([&]() { return subscribed == devices; }))
+            *failed += devices - subscribed;
+        for(BLESession *session : sessions)
+            session->disconnectFromDevice();
+        settle([&]() { return 0 == transport->connectedLinks(); });
+        QCoreApplication::processEvents();
+    }
+}
+
+void asyncFlow(int devices, int rounds, LatencyHistogram *latency, int *failed)
+{
+    QObject owner;
+    SimTransport *transport = thermometers(devices, &owner);
+    QList<AsyncLink *> links;
+    for(int i = 0; i < devices; ++i)
+        links << new AsyncLink(transport->createLink(SimTransport::thermometer(i).info, &owner), &owner);
+
+    int finished = 0;
+    for(int round = 0; round < rounds; ++round) {
+        finished = 0;
+        for(AsyncLink *async : links) {
+            const qint64 startedAt = LatencyRecorder::now();
+            auto done = [&, startedAt](GattOperation *op) {
+                if(op->succeeded())
+                    latency->recordNanoseconds(LatencyRecorder::now() - startedAt);
+                else
+                    ++*failed;
+                ++finished;
+            };
+            async->connectToDevice()->then([async, done](GattOperation *op) {
+                if(!op->succeeded())
+                    return done(op);
+                async->discover(kService)->then([async, done](GattOperation *op) {
+                    if(!op->succeeded())
+                        return done(op);
+                    async->open(kService, BLELink::SkipValues)->then([async, done](GattOperation *op) {
+                        if(!op->succeeded())
+                            return done(op);
+                        async->all(QList<GattOperation *>() << async->subscribe(kService, kMeasurement)
+                                                            << async->read(kService, kType))->then(done);
+                    });
+                });
+            });
+        }
+        if(!settle([&]() { return finished == devices; }))
+            *failed += devices - finished;
+        for(AsyncLink *async : links)
+            async->link()->disconnectFromDevice();
+        settle([&]() { return 0 == transport->connectedLinks(); });
+        QCoreApplication::processEvents();
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+
+    const int rounds = argc > 1 ? QByteArray(argv[1]).toInt() : 20;
+
+    out << "connect to subscribed in ms, " << rounds << " rounds; connect 20, discovery 10, walk 60,"
+           " subscribe 10, read 10, jitter 5\n";
+    for(int devices = 1; devices <= 32; devices *= 4) {
+        for(int async = 0; async < 2; ++async) {
+            LatencyHistogram latency;
+            int failed = 0;
+            if(async)
+                asyncFlow(devices, rounds, &latency, &failed);
+            else
+                slotChain(devices, rounds, &latency, &failed);
+            out << "  " << devices << (1 == devices ? " device,  " : " devices, ")
+                << (async ? "AsyncLink: " : "slot chain:") << " p50 " << latency.percentile(0.50) / 1000.0
+                << " p99 " << latency.percentile(0.99) / 1000.0 << " max " << latency.max() / 1000.0;
+            if(0 < failed)
+                out << ", " << failed << " failed";
+            out << "\n";
+            out.flush();
+        }
+    }
+    return 0;
+}
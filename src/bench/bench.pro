@@ -0,0 +1,18 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    asyncbench \
+    decodebench \
+    feedbench \
+    gattdecodebench \
+    ingestbench \
+    journalbench \
+    livebench \
+    logbench \
+    metricsbench \
+    scanbench \
+    sessionbench \
+    signalbench \
+    soakbench \
+    startupbench \
+    uploadbench
@@ -0,0 +1,28 @@
+#ifndef BENCHSUPPORT_H
+#define BENCHSUPPORT_H
+
+// helpers every bench shares, included as "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+// installed with qInstallMessageHandler so only the bench's own results reach the terminal
+inline void dropMessages(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+// run the event loop until done() or the deadline
+template<typename Done>
+bool settle(Done done, int timeoutMs = 5000)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while(!done()) {
+        if(timer.elapsed() > timeoutMs)
+            return false;
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+    }
+    return true;
+}
+
+#endif // BENCHSUPPORT_H
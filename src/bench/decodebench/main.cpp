@@ -0,0 +1,113 @@
+// ns per Temperature Measurement decode: ThermometerDecoder against the
+// QByteArray/QBitArray/QString chain MainWindow::updateTemperatureValue used
+
+#include "thermometerdecoder.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QBitArray>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace {
+
+// the original path minus the qDebug output, kept verbatim for comparison
+double legacyDecode(const QByteArray &a, QString *out)
+{
+   QBitArray f_arr = QBitArray::fromBits(a.data(),3);
+   QString t_format_str = f_arr.at(0) ? "F" : "C";
+
+   QByteArray t_arr = a.mid(1,2);
+   std::reverse(t_arr.begin(), t_arr.end());
+   double t_value = t_arr.toHex().toInt(nullptr,16)*0.1;
+   QString t_value_str = QString::number(t_value);
+
+   QByteArray y_arr = a.mid(5,2);
+   std::reverse(y_arr.begin(), y_arr.end());
+   int y_value = y_arr.toHex().toInt(nullptr,16);
+   QString y_value_str = QString::number(y_value);
+
+   int m_value = a.mid(7,1).toHex().toInt(nullptr,16);
+   QString m_value_str = (m_value < 10 ? "0" : "") + QString::number(m_value);
+
+   int d_value = a.mid(8,1).toHex().toInt(nullptr,16);
+   QString d_value_str = (d_value < 10 ? "0" : "") + QString::number(d_value);
+
+   int h_value = a.mid(9,1).toHex().toInt(nullptr,16);
+   QString h_value_str = (h_value < 10 ? "0" : "") + QString::number(h_value);
+
+   int j_value = a.mid(10,1).toHex().toInt(nullptr,16);
+   QString j_value_str = (j_value < 10 ? "0" : "") + QString::number(j_value);
+
+   int s_value = a.mid(11,1).toHex().toInt(nullptr,16);
+   QString s_value_str = (s_value < 10 ? "0" : "") + QString::number(s_value);
+
+   int t_type = a.mid(12,1).toHex().toInt(nullptr,16);
+   QString t_type_str = t_type == 1 ? "body" : "surface/room";
+
+   QStringList date_str;
+   date_str << y_value_str << m_value_str << d_value_str;
+   QStringList time_str;
+   time_str << h_value_str << j_value_str << s_value_str;
+
+   *out = t_value_str + t_format_str + t_type_str + date_str.join("-") + time_str.join(":");
+   return t_value;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const int iterations = argc > 1 ? QByteArray(argv[1]).toInt() : 1000000;
+
+    // fixtures documented in MainWindow::updateTemperatureValue
+    const QList<QByteArray> fixtures = {
+        QByteArray::fromHex("07d30300ffe50707080f220001"),
+        QByteArray::fromHex("07d80300ffe50707090b060001"),
+        QByteArray::fromHex("066b0100ffe50707090c150001")
+    };
+
+    for(const QByteArray &a : fixtures) {
+        TemperatureMeasurement m;
+        if(!ThermometerDecoder::decode(a.constData(), a.size(), &m)) {
+            out << "fixture " << a.toHex() << " failed to decode\n";
+            return 1;
+        }
+        QString legacy;
+        double lv = legacyDecode(a, &legacy);
+        out << a.toHex() << ": " << m.value << (m.isFahrenheit() ? "F" : "C")
+            << " " << m.year << "-" << int(m.month) << "-" << int(m.day)
+            << " (legacy " << lv << ")\n";
+
+        // keep the compiler from discarding either loop
+        volatile double sink = 0.0;
+
+        QElapsedTimer timer;
+        timer.start();
+        for(int i = 0; i < iterations; ++i) {
+            TemperatureMeasurement r;
+            ThermometerDecoder::decode(a.constData(), a.size(), &r);
+            sink = sink + r.value;
+        }
+        const qint64 decoderNs = timer.nsecsElapsed();
+
+        timer.restart();
+        for(int i = 0; i < iterations; ++i) {
+            QString s;
+            sink = sink + legacyDecode(a, &s);
+        }
+        const qint64 legacyNs = timer.nsecsElapsed();
+
+        out << "  decoder " << double(decoderNs) / iterations << " ns/decode, "
+            << "legacy " << double(legacyNs) / iterations << " ns/decode, "
+            << "speedup x" << (decoderNs > 0 ? double(legacyNs) / decoderNs : 0.0) << "\n";
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+// latency from the BLE notification slot to a reader in another process,
+// through IngestQueue and the shared-memory LiveFeed. Each run starts 1 or
+// 4 copies of this program as readers, either sleeping on the feed's futex
+// or spinning on read(), then paces notifications into a BLESession; every
+// reader reports the slot-to-reader latency of what it saw and how many
+// readings it lost to being lapped. A last mixed run interleaves PLX
+// Continuous readings, decoded and published on this thread as
+// SessionManager does, with the thermometer's, so the feed has two writers.
+//
+//   feedbench [window ms]       run the comparison
+//   feedbench read <name> wait|spin
+
+#include "blesession.h"
+#include "gattdecoder.h"
+#include "ingestqueue.h"
+#include "latencyhistogram.h"
+#include "latencyrecorder.h"
+#include "livefeed.h"
+#include "simtransport.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QProcess>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+// an hour of readings a second apart, so none is dropped as a replay
+QVector<QByteArray> hourOfReadings()
+{
+    QVector<QByteArray> readings;
+    for(int i = 0; i < 3600; ++i) {
+        QByteArray value = QByteArray::fromHex("07d30300ffe50707080f220001");
+        value[10] = char(i / 60);
+        value[11] = char(i % 60);
+        readings << value;
+    }
+    return readings;
+}
+
+// reader side: everything until the feed has been quiet for a second
+int read(const QString &name, bool spin)
+{
+    QTextStream out(stdout);
+    LiveFeedReader reader;
+    if(!reader.open(name)) {
+        out << "error " << reader.errorString() << "\n";
+        return 1;
+    }
+    out << "ready\n";
+    out.flush();
+
+    LatencyHistogram latency;
+    quint64 plx = 0;
+    LiveFeed::Record batch[256];
+    qint64 quietSince = LatencyRecorder::now();
+    for(;;) {
+        const int count = reader.read(batch, 256);
+        const qint64 now = LatencyRecorder::now();
+        for(int i = 0; i < count; ++i) {
+            latency.recordNanoseconds(now - batch[i].slotNs);
+            plx += 0x2A5F == batch[i].characteristic;
+        }
+        if(0 < count) {
+            quietSince = now;
+            continue;
+        }
+        if(now - quietSince > 1000000000LL)
+            break;
+        if(!spin)
+            reader.wait(100);
+    }
+    out << latency.count() << ' ' << reader.lost() << ' ' << latency.percentile(0.50) << ' '
+        << latency.percentile(0.99) << ' ' << latency.percentile(0.999) << ' ' << latency.max() << ' ' << plx << "\n";
+    return 0;
+}
+
+// one run at rate notifications a second; every plxEvery-th is a PLX reading when non-zero
+bool run(QTextStream &out, SimTransport *transport, const QString &name, qint64 windowMs,
+         int rate, int readers, bool spin, int plxEvery)
+{
+    static const QVector<QByteArray> notifications = hourOfReadings();
+    static const QByteArray plxNotification = QByteArray::fromHex("1f6100480062004900600047000000030000f300");
+    const QBluetoothDeviceInfo info = SimTransport::thermometer(0).info;
+    const GattDecoder::Entry *plxDecoder = GattDecoder::find(0x1822, 0x2A5F);
+
+    LiveFeed feed;
+    if(!feed.open(name, 65536)) {
+        out << "cannot open feed: " << feed.errorString() << "\n";
+        return false;
+    }
+    QVector<QProcess *> processes;
+    for(int i = 0; i < readers; ++i) {
+        QProcess *process = new QProcess;
+        process->start(QCoreApplication::applicationFilePath(),
+                       QStringList() << "read" << name << (spin ? "spin" : "wait"));
+        process->waitForReadyRead(5000);
+        process->readLine();
+        processes << process;
+    }
+
+    BLESession session(info, transport);
+    IngestQueue queue(4096);
+    queue.setLiveFeed(&feed);
+    session.setIngestQueue(&queue);
+    queue.start();
+
+    // paced like ingestbench, the slot cost itself is measured there
+    const qint64 interval = 1000000000LL / rate;
+    const qint64 end = LatencyRecorder::now() + windowMs * 1000000LL;
+    qint64 due = LatencyRecorder::now();
+    quint64 sent = 0;
+    while(due < end) {
+        while(LatencyRecorder::now() < due) {}
+        if(0 != plxEvery && 0 == sent % quint64(plxEvery)) {
+            // SessionManager::publishReading's steps, while the worker publishes the temperatures
+            const qint64 slotNs = LatencyRecorder::now();
+            GattReading reading;
+            plxDecoder->decode(plxNotification.constData(), plxNotification.size(), &reading);
+            feed.publish(info.address().toUInt64(), QDateTime::currentMSecsSinceEpoch(), slotNs, reading);
+            feed.commit();
+        } else {
+            session.receive(notifications.at(int(sent % quint64(notifications.size()))));
+        }
+        ++sent;
+        due = qMax(due + interval, LatencyRecorder::now());
+    }
+    queue.stop();
+
+    out << rate << "/s " << readers << (spin ? " spinning" : " sleeping")
+        << (1 == readers ? " reader" : " readers") << (0 != plxEvery ? ", mixed" : "")
+        << ", " << feed.published() << " published\n";
+    for(QProcess *process : processes) {
+        process->waitForFinished(10000);
+        const QList<QByteArray> f = process->readAll().trimmed().split(' ');
+        if(f.size() == 7)
+            out << "  read " << f[0] << " lost " << f[1] << " p50 " << f[2] << " p99 " << f[3]
+                << " p999 " << f[4] << " max " << f[5] << " plx " << f[6] << "\n";
+        else
+            out << "  reader failed\n";
+        delete process;
+    }
+    out.flush();
+    return true;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if(argc > 3 && QByteArray("read") == argv[1])
+        return read(QString::fromLocal8Bit(argv[2]), QByteArray("spin") == argv[3]);
+
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+
+    const qint64 windowMs = argc > 1 ? QByteArray(argv[1]).toLongLong() : 1000;
+    const QString name = QString("feedbench.%1").arg(QCoreApplication::applicationPid());
+    SimTransport transport;
+
+    out << "slot to reader latency in us, " << windowMs << " ms per run\n";
+    for(int rate = 1000; rate <= 100000; rate *= 10) {
+        for(int readers = 1; readers <= 4; readers *= 4) {
+            for(int spin = 0; spin < 2; ++spin) {
+                if(!run(out, &transport, name, windowMs, rate, readers, spin, 0))
+                    return 1;
+            }
+        }
+    }
+    // a PLX reading in every four, the oximeter's rate against the thermometers' at the top of the range
+    return run(out, &transport, name, windowMs, 100000, 4, false, 4) ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// ns per decode for every GattDecoder registry entry against a hand-written
+// decoder for the same characteristic: ThermometerDecoder for the Health
+// Thermometer, straight-line field by field code for PLX and Blood Pressure.
+// Both sides fill the same kind of record so only the decoding differs.
+
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <cstring>
+
+namespace {
+
+quint16 u16(const uchar *p)
+{
+    return quint16(p[0] | (p[1] << 8));
+}
+
+bool readTimestamp(const uchar *&p, const uchar *end, GattReading *r)
+{
+    if(end - p < 7)
+        return false;
+    r->year = u16(p);
+    r->month = p[2];
+    r->day = p[3];
+    r->hours = p[4];
+    r->minutes = p[5];
+    r->seconds = p[6];
+    p += 7;
+    return true;
+}
+
+bool readSFloat(const uchar *&p, const uchar *end, int slot, GattReading *r)
+{
+    if(end - p < 2)
+        return false;
+    r->status[slot] = GattLayout::decodeSFloat(p, &r->values[slot]);
+    r->present |= quint8(1u << slot);
+    p += 2;
+    return true;
+}
+
+bool readCode(const uchar *&p, const uchar *end, int slot, int bytes, GattReading *r)
+{
+    if(end - p < bytes)
+        return false;
+    quint32 value = 0;
+    for(int i = 0; i < bytes; ++i)
+        value |= quint32(p[i]) << (8 * i);
+    r->codes[slot] = value;
+    r->codesPresent |= quint8(1u << slot);
+    p += bytes;
+    return true;
+}
+
+// the way these are usually written: every field checks its own bounds
+bool handSpotCheck(const char *data, int size, GattReading *r)
+{
+    std::memset(r, 0, sizeof(GattReading));
+    r->service = 0x1822;
+    r->characteristic = 0x2A5E;
+    if(size < 1)
+        return false;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    r->flags = *p++;
+    if(!readSFloat(p, end, 0, r) || !readSFloat(p, end, 1, r))
+        return false;
+    if((r->flags & 0x01) && !readTimestamp(p, end, r))
+        return false;
+    if((r->flags & 0x02) && !readCode(p, end, 0, 2, r))
+        return false;
+    if((r->flags & 0x04) && !readCode(p, end, 1, 3, r))
+        return false;
+    if((r->flags & 0x08) && !readSFloat(p, end, 2, r))
+        return false;
+    return true;
+}
+
+bool handContinuous(const char *data, int size, GattReading *r)
+{
+    std::memset(r, 0, sizeof(GattReading));
+    r->service = 0x1822;
+    r->characteristic = 0x2A5F;
+    if(size < 1)
+        return false;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    r->flags = *p++;
+    if(!readSFloat(p, end, 0, r) || !readSFloat(p, end, 1, r))
+        return false;
+    if((r->flags & 0x01) && (!readSFloat(p, end, 2, r) || !readSFloat(p, end, 3, r)))
+        return false;
+    if((r->flags & 0x02) && (!readSFloat(p, end, 4, r) || !readSFloat(p, end, 5, r)))
+        return false;
+    if((r->flags & 0x04) && !readCode(p, end, 0, 2, r))
+        return false;
+    if((r->flags & 0x08) && !readCode(p, end, 1, 3, r))
+        return false;
+    if((r->flags & 0x10) && !readSFloat(p, end, 6, r))
+        return false;
+    return true;
+}
+
+bool handBloodPressure(const char *data, int size, GattReading *r)
+{
+    std::memset(r, 0, sizeof(GattReading));
+    r->service = 0x1810;
+    r->characteristic = 0x2A35;
+    if(size < 1)
+        return false;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    r->flags = *p++;
+    if(!readSFloat(p, end, 0, r) || !readSFloat(p, end, 1, r) || !readSFloat(p, end, 2, r))
+        return false;
+    if((r->flags & 0x02) && !readTimestamp(p, end, r))
+        return false;
+    if((r->flags & 0x04) && !readSFloat(p, end, 3, r))
+        return false;
+    if((r->flags & 0x08) && !readCode(p, end, 0, 1, r))
+        return false;
+    if((r->flags & 0x10) && !readCode(p, end, 1, 2, r))
+        return false;
+    return true;
+}
+
+// ThermometerDecoder fills TemperatureMeasurement, copy the value across so
+// the loop does the same stores as the generated decoder's caller would see
+bool handTemperature(const char *data, int size, GattReading *r)
+{
+    TemperatureMeasurement m;
+    const bool ok = ThermometerDecoder::decode(data, size, &m);
+    r->values[0] = m.value;
+    return ok;
+}
+
+struct Case {
+    quint16 service;
+    quint16 characteristic;
+    const char *fixture;
+    GattDecoder::DecodeFunction hand;
+};
+
+const Case kCases[] = {
+    {0x1809, 0x2A1C, "07d30300ffe50707080f220001", handTemperature},
+    {0x1822, 0x2A5E, "0062006000", handSpotCheck},
+    {0x1822, 0x2A5E, "0f62006000e50707080f220000000300004a00", handSpotCheck},
+    {0x1822, 0x2A5F, "0061004800", handContinuous},
+    {0x1822, 0x2A5F, "1f6100480062004900600047000000030000f300", handContinuous},
+    {0x1810, 0x2A35, "00780050006400", handBloodPressure},
+    {0x1810, 0x2A35, "1e780050006400e50707080f22004800020100", handBloodPressure},
+};
+
+qint64 timeDecoder(GattDecoder::DecodeFunction decode, const QByteArray &a, int iterations, double *sink)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < iterations; ++i) {
+        GattReading r;
+        decode(a.constData(), a.size(), &r);
+        *sink += r.values[0];
+    }
+    return timer.nsecsElapsed();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const int iterations = argc > 1 ? QByteArray(argv[1]).toInt() : 1000000;
+    volatile double keep = 0.0;
+
+    for(const Case &c : kCases) {
+        const GattDecoder::Entry *decoder = GattDecoder::find(c.service, c.characteristic);
+        const QByteArray a = QByteArray::fromHex(c.fixture);
+        GattReading generated;
+        GattReading hand;
+        if(nullptr == decoder || !decoder->decode(a.constData(), a.size(), &generated)
+           || !c.hand(a.constData(), a.size(), &hand)) {
+            out << "fixture " << c.fixture << " failed to decode\n";
+            return 1;
+        }
+        if(generated.values[0] != hand.values[0]) {
+            out << "fixture " << c.fixture << " decoded differently\n";
+            return 1;
+        }
+
+        double sink = 0.0;
+        const qint64 generatedNs = timeDecoder(decoder->decode, a, iterations, &sink);
+        const qint64 handNs = timeDecoder(c.hand, a, iterations, &sink);
+        keep = keep + sink;
+
+        out << GattDecoder::toString(*decoder, generated) << "\n"
+            << "  " << a.size() << " bytes: generated " << double(generatedNs) / iterations << " ns/decode, "
+            << "hand-written " << double(handNs) / iterations << " ns/decode, ratio x"
+            << (generatedNs > 0 ? double(handNs) / generatedNs : 0.0) << "\n";
+        out.flush();
+    }
+    return 0;
+}
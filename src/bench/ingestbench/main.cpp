@@ -0,0 +1,119 @@
+// time spent in the BLE notification slot at increasing notification rates,
+// decoding and formatting inline against handing the bytes to IngestQueue.
+// The consumer formats every reading the way ReadingWriter does, so the
+// inline path pays for it inside the slot and the queued path on the worker.
+
+#include "blesession.h"
+#include "bleinfo.h"
+#include "ingestqueue.h"
+#include "latencyhistogram.h"
+#include "latencyrecorder.h"
+#include "simtransport.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+// stands in for ReadingWriter, without the output
+void consume(const QString &address, const TemperatureMeasurement &m)
+{
+    QJsonObject json;
+    json["address"] = address;
+    json["reading"] = BLEInfo::measurementToString(m);
+    json["value"] = m.value;
+    volatile int size = QJsonDocument(json).toJson(QJsonDocument::Compact).size();
+    Q_UNUSED(size)
+}
+
+struct Result {
+    quint64 sent = 0;
+    quint64 overflows = 0;
+    double seconds = 0.0;
+};
+
+// an hour of readings a second apart, so none is dropped as a replay
+QVector<QByteArray> hourOfReadings()
+{
+    QVector<QByteArray> readings;
+    for(int i = 0; i < 3600; ++i) {
+        QByteArray value = QByteArray::fromHex("07d30300ffe50707080f220001");
+        value[10] = char(i / 60);
+        value[11] = char(i % 60);
+        readings << value;
+    }
+    return readings;
+}
+
+Result run(BLESession &session, const QVector<QByteArray> &notifications, int rate, qint64 windowMs,
+           LatencyHistogram &slot)
+{
+    Result result;
+    const qint64 interval = 1000000000LL / rate;
+    const qint64 start = LatencyRecorder::now();
+    const qint64 end = start + windowMs * 1000000LL;
+    qint64 due = start;
+    while(due < end) {
+        // pace the producer like a radio would, never faster than the rate
+        while(LatencyRecorder::now() < due) {}
+        const qint64 before = LatencyRecorder::now();
+        session.receive(notifications.at(int(result.sent % quint64(notifications.size()))));
+        slot.record(quint64(LatencyRecorder::now() - before));
+        ++result.sent;
+        due += interval;
+        // a slot slower than the interval pushes the schedule back, like a busy loop would
+        due = qMax(due, LatencyRecorder::now());
+    }
+    result.seconds = (LatencyRecorder::now() - start) / 1e9;
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+
+    const qint64 windowMs = argc > 1 ? QByteArray(argv[1]).toLongLong() : 1000;
+    const QVector<QByteArray> notifications = hourOfReadings();
+
+    SimTransport transport;
+    const QBluetoothDeviceInfo info = SimTransport::thermometer(0).info;
+
+    out << "slot latency in ns, " << windowMs << " ms per rate\n";
+    for(int rate = 1000; rate <= 1000000; rate *= 10) {
+        for(int queued = 0; queued < 2; ++queued) {
+            BLESession session(info, &transport);
+            IngestQueue queue(4096);
+            if(queued) {
+                session.setIngestQueue(&queue);
+                QObject::connect(&queue, &IngestQueue::temperatureMeasured, &queue, consume,
+                                 Qt::DirectConnection);
+                queue.start();
+            } else {
+                QObject::connect(&session, &BLESession::temperatureMeasured, consume);
+            }
+
+            LatencyHistogram slot;
+            const Result result = run(session, notifications, rate, windowMs, slot);
+            queue.stop();
+
+            out << rate << "/s " << (queued ? "queued" : "inline") << ": "
+                << qint64(result.sent / result.seconds) << "/s achieved, slot p50 " << slot.percentile(0.50)
+                << " p99 " << slot.percentile(0.99) << " p999 " << slot.percentile(0.999)
+                << " max " << slot.max();
+            if(queued)
+                out << ", overflows " << queue.overflows() << ", high water " << queue.highWaterMark()
+                    << ", queue delay p99 " << queue.queueDelay().percentile(0.99) << " us";
+            out << "\n";
+            out.flush();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Cost of feeding ReadingModel the way the live view does: readings from many
+// devices at a fixed rate, published once per frame, against publishing every
+// reading as it arrives. Reports ns per reading, model signals per reading and
+// RSS as the ring wraps, which should stay flat once it is full.
+
+#include "readingmodel.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+namespace {
+
+// resident set size in kB from /proc, 0 where unavailable
+qint64 residentSetSize()
+{
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly))
+        return 0;
+    for(QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if(line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return 0;
+}
+
+GattReading continuousReading(int i)
+{
+    GattReading r;
+    std::memset(&r, 0, sizeof(r));
+    r.service = 0x1822;
+    r.characteristic = 0x2A5F;
+    r.present = 0x03;
+    r.values[0] = 94 + i % 5;
+    r.values[1] = 60 + i % 40;
+    return r;
+}
+
+struct Run {
+    qint64 ns = 0;
+    int signals = 0;
+    QVector<qint64> rss;
+};
+
+// perFrame readings between publishes, 0 to publish every reading
+Run run(int readings, int devices, int perFrame, int capacity)
+{
+    ReadingModel model(capacity);
+    model.setFrameInterval(0 == perFrame ? 0 : 1000);
+    Run result;
+    QObject::connect(&model, &ReadingModel::rowsInserted, [&result]() { ++result.signals; });
+    QObject::connect(&model, &ReadingModel::rowsRemoved, [&result]() { ++result.signals; });
+    QObject::connect(&model, &ReadingModel::modelReset, [&result]() { ++result.signals; });
+
+    QStringList addresses;
+    for(int d = 0; d < devices; ++d)
+        addresses << QString("00:A0:50:%1:%2:%3")
+                     .arg((d >> 16) & 0xFF, 2, 16, QLatin1Char('0'))
+                     .arg((d >> 8) & 0xFF, 2, 16, QLatin1Char('0'))
+                     .arg(d & 0xFF, 2, 16, QLatin1Char('0')).toUpper();
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < readings; ++i) {
+        model.appendReading(addresses[i % devices], continuousReading(i));
+        if(0 != perFrame && 0 == (i + 1) % perFrame)
+            model.flush();
+        if(0 == (i + 1) % qMax(1, readings / 5))
+            result.rss << residentSetSize();
+    }
+    model.flush();
+    result.ns = timer.nsecsElapsed();
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const int readings = argc > 1 ? QByteArray(argv[1]).toInt() : 1000000;
+    const int devices = argc > 2 ? QByteArray(argv[2]).toInt() : 200;
+    const int capacity = argc > 3 ? QByteArray(argv[3]).toInt() : 10000;
+    // 1000 readings/s at 60 frames/s
+    const int perFrame = 1000 / 60;
+
+    out << readings << " readings from " << devices << " devices, ring of " << capacity << "\n";
+    const struct { const char *name; int perFrame; } modes[] = {
+        {"per frame", perFrame},
+        {"per reading", 0}
+    };
+    for(const auto &mode : modes) {
+        const Run r = run(readings, devices, mode.perFrame, capacity);
+        out << "  " << mode.name << ": " << double(r.ns) / readings << " ns/reading, "
+            << double(r.signals) / readings << " model signals/reading, RSS kB";
+        for(qint64 kb : r.rss)
+            out << " " << kb;
+        out << "\n";
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = logbench
+
+# debug records stay compiled in whatever the build type, trace is compiled out
+DEFINES += PINE_LOG_LEVEL=1
+
+include(../../bt_masimo/core.pri)
+
+SOURCES += \
+    main.cpp
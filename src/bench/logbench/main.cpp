@@ -0,0 +1,125 @@
+// logging cost on the thread that handles notifications. The legacy run
+// replays the qDebug lines the notification slot used to print, formatted
+// and written synchronously through a message handler; the structured runs
+// log the one record BLESession now writes per reading, with the level
+// enabled, disabled at run time and compiled out. Output goes to /dev/null
+// so the numbers are a lower bound for a terminal or a file.
+
+#include "bleinfo.h"
+#include "latencyhistogram.h"
+#include "latencyrecorder.h"
+#include "structlog.h"
+#include "thermometerdecoder.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+namespace {
+
+QFile *sink = nullptr;
+
+void writeMessages(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    sink->write(qFormatLogMessage(type, context, message).toLocal8Bit());
+    sink->write("\n");
+}
+
+enum Mode { Legacy, Enabled, RuntimeDisabled, CompiledOut };
+
+const char *modeName(Mode mode)
+{
+    switch(mode) {
+    case Legacy: return "qDebug, synchronous     ";
+    case Enabled: return "structured, enabled     ";
+    case RuntimeDisabled: return "structured, level off   ";
+    case CompiledOut: return "structured, compiled out";
+    }
+    return "";
+}
+
+void logNotification(Mode mode, quint64 address, const QByteArray &value, const TemperatureMeasurement &m)
+{
+    switch(mode) {
+    case Legacy:
+        // what updateTemperatureValue printed for every notification
+        qDebug() << "temperature value update";
+        for(int bit = 0; bit < 3; ++bit)
+            qDebug() << "flags bit" << bit << ((value.at(0) >> bit) & 1);
+        qDebug() << BLEInfo::measurementToString(m);
+        break;
+    case Enabled:
+    case RuntimeDisabled:
+        LOG_DEBUG("measurement", "address", Log::mac(address), "value", m.value,
+                  "type", ThermometerDecoder::typeName(m.type), "status", int(m.status));
+        break;
+    case CompiledOut:
+        LOG_TRACE("measurement", "address", Log::mac(address), "value", m.value,
+                  "type", ThermometerDecoder::typeName(m.type), "status", int(m.status));
+        break;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const qint64 windowMs = argc > 1 ? QByteArray(argv[1]).toLongLong() : 1000;
+    const int rate = argc > 2 ? QByteArray(argv[2]).toInt() : 20000;
+
+    QFile null("/dev/null");
+    if(!null.open(QIODevice::WriteOnly)) {
+        out << "cannot open /dev/null\n";
+        return 1;
+    }
+    sink = &null;
+
+    const QByteArray value = QByteArray::fromHex("07d30300ffe50707080f220001");
+    TemperatureMeasurement m;
+    ThermometerDecoder::decode(value.constData(), value.size(), &m);
+    const quint64 address = Q_UINT64_C(0xC026DA000000);
+    const qint64 interval = 1000000000LL / rate;
+
+    out << "logging cost per notification in ns, " << rate << " notifications/s for " << windowMs << " ms\n";
+    const Mode modes[] = {Legacy, Enabled, RuntimeDisabled, CompiledOut};
+    for(Mode mode : modes) {
+        if(Legacy == mode) {
+            qInstallMessageHandler(writeMessages);
+        } else {
+            Log::start("/dev/null");
+            Log::setLevel(RuntimeDisabled == mode ? Log::Warning : Log::Trace);
+        }
+        const quint64 droppedBefore = Log::dropped();
+        const quint64 writtenBefore = Log::written();
+
+        LatencyHistogram cost;
+        quint64 sent = 0;
+        const qint64 start = LatencyRecorder::now();
+        const qint64 end = start + windowMs * 1000000LL;
+        for(qint64 due = start; due < end; due += interval) {
+            while(LatencyRecorder::now() < due) {}
+            const qint64 before = LatencyRecorder::now();
+            logNotification(mode, address, value, m);
+            cost.record(quint64(LatencyRecorder::now() - before));
+            ++sent;
+        }
+
+        if(Legacy == mode)
+            qInstallMessageHandler(nullptr);
+        else
+            Log::stop();
+
+        out << "  " << modeName(mode) << ": p50 " << cost.percentile(0.50) << " p99 " << cost.percentile(0.99)
+            << " p999 " << cost.percentile(0.999) << " max " << cost.max() << ", mean " << cost.mean();
+        if(Legacy != mode)
+            out << ", " << Log::written() - writtenBefore << " of " << sent << " written, "
+                << Log::dropped() - droppedBefore << " dropped";
+        out << "\n";
+        out.flush();
+    }
+    return 0;
+}
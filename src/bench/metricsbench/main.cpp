@@ -0,0 +1,79 @@
+// cost of bumping a metrics counter from the threads that do. Each run has
+// 1 to 8 threads incrementing the same count as fast as they can, once
+// through a MetricsCounter and once through a single shared std::atomic,
+// which is what a counter without shards would be; then the time to render
+// the exposition for a scrape with every pipeline metric registered.
+
+#include "latencyrecorder.h"
+#include "metrics.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template<typename Add>
+double nsPerAdd(int threads, quint64 perThread, Add add)
+{
+    std::atomic<int> ready {0};
+    std::vector<std::thread> workers;
+    qint64 start = 0;
+    for(int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            ready.fetch_add(1);
+            while(ready.load() < threads) {}
+            for(quint64 i = 0; i < perThread; ++i)
+                add();
+        });
+    }
+    while(ready.load() < threads) {}
+    start = LatencyRecorder::now();
+    for(std::thread &worker : workers)
+        worker.join();
+    return double(LatencyRecorder::now() - start) / double(perThread);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const quint64 perThread = argc > 1 ? QByteArray(argv[1]).toULongLong() : 20000000;
+
+    MetricsCounter *counter = Metrics::counter("bench_adds_total", "Adds made by the benchmark");
+    std::atomic<quint64> shared {0};
+
+    out << "ns per add and thread, " << perThread << " adds per thread\n";
+    for(int threads = 1; threads <= 8; threads *= 2) {
+        const double sharded = nsPerAdd(threads, perThread, [counter]() { counter->add(); });
+        const double single = nsPerAdd(threads, perThread, [&shared]() {
+            shared.fetch_add(1, std::memory_order_relaxed);
+        });
+        out << "  " << threads << (1 == threads ? " thread:  " : " threads: ") << "sharded " << sharded
+            << ", one atomic " << single << "\n";
+        out.flush();
+    }
+    if(counter->value() + shared.load() != 2 * perThread * 15)
+        out << "counts do not add up\n";
+
+    // about as many series as a station with a dozen thermometers exposes
+    for(int i = 0; i < 12; ++i)
+        Metrics::counter("bench_connect_failures_total", "Connects that failed",
+                         Metrics::label("error", QString::number(i)))->add(quint64(i));
+    for(int i = 0; i < 40; ++i)
+        Metrics::sample(&app, Metrics::Gauge, "bench_depth", "A sampled gauge",
+                        [i]() { return double(i); }, Metrics::label("queue", QString::number(i)));
+    const int scrapes = 1000;
+    int size = 0;
+    const qint64 start = LatencyRecorder::now();
+    for(int i = 0; i < scrapes; ++i)
+        size = Metrics::exposition().size();
+    out << "exposition: " << (LatencyRecorder::now() - start) / scrapes / 1000 << " us for " << size << " bytes\n";
+    return 0;
+}
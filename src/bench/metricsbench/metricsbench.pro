@@ -0,0 +1,12 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = metricsbench
+
+include(../../bt_masimo/core.pri)
+
+SOURCES += \
+    main.cpp
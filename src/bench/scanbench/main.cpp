@@ -0,0 +1,158 @@
+// cost of handling a crowded scan: 10k synthetic advertisements from a few
+// hundred devices, a handful of them targets. The legacy path compares every
+// address as a QString and keeps the agent's linear device list; the new path
+// is ScanFilter plus the DeviceIndex the transports now share. A second run
+// pushes the same stream through SimTransport to count deviceDiscovered emits.
+
+#include "deviceindex.h"
+#include "latencyrecorder.h"
+#include "scanfilter.h"
+#include "simtransport.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+
+namespace {
+
+QList<QBluetoothDeviceInfo> syntheticAdvertisements(int count, int devices, int targets)
+{
+    QRandomGenerator random(42);
+    QList<QBluetoothDeviceInfo> population;
+    for(int i = 0; i < devices; ++i) {
+        // targets use the simulated thermometer addresses, the rest are random
+        const quint64 address = i < targets ? Q_UINT64_C(0xC026DA000000) + quint64(i)
+                                            : random.generate64() & Q_UINT64_C(0xFFFFFFFFFFFF);
+        QBluetoothDeviceInfo info(QBluetoothAddress(address), QString("device %1").arg(i), 0);
+        info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+        // one in twenty nearby devices is some other thermometer
+        if(i < targets || 0 == random.bounded(20))
+            info.setServiceUuids(QList<QBluetoothUuid>() << QBluetoothUuid(QBluetoothUuid::HealthThermometer),
+                                 QBluetoothDeviceInfo::DataIncomplete);
+        population << info;
+    }
+
+    QList<QBluetoothDeviceInfo> stream;
+    stream.reserve(count);
+    for(int i = 0; i < count; ++i) {
+        QBluetoothDeviceInfo info = population.at(random.bounded(devices));
+        info.setRssi(qint16(-30 - random.bounded(70)));
+        stream << info;
+    }
+    return stream;
+}
+
+// what MainWindow did: a string compare per advertisement, the agent's
+// linear update of its device list, and a copy of that list at the end
+int legacyScan(const QList<QBluetoothDeviceInfo> &stream, const QStringList &targets)
+{
+    QList<QBluetoothDeviceInfo> discovered;
+    int found = 0;
+    for(const QBluetoothDeviceInfo &info : stream) {
+        bool known = false;
+        for(int i = 0; i < discovered.size(); ++i) {
+            if(discovered.at(i).address() == info.address()) {
+                discovered[i] = info;
+                known = true;
+                break;
+            }
+        }
+        if(!known)
+            discovered << info;
+        for(const QString &target : targets) {
+            if(info.address().toString() == target)
+                ++found;
+        }
+    }
+    const QList<QBluetoothDeviceInfo> copy = discovered;
+    return found + copy.size();
+}
+
+int indexedScan(const QList<QBluetoothDeviceInfo> &stream, const ScanFilter &filter, DeviceIndex *index)
+{
+    int emitted = 0;
+    for(const QBluetoothDeviceInfo &info : stream) {
+        if(filter.accepts(info) && index->update(info, LatencyRecorder::now()))
+            ++emitted;
+    }
+    return emitted;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+
+    const int count = argc > 1 ? QByteArray(argv[1]).toInt() : 10000;
+    const int devices = argc > 2 ? QByteArray(argv[2]).toInt() : 500;
+    const int targets = 8;
+    const int rounds = 20;
+
+    const QList<QBluetoothDeviceInfo> stream = syntheticAdvertisements(count, devices, targets);
+    QStringList targetStrings;
+    ScanFilter filter;
+    for(int i = 0; i < targets; ++i) {
+        const QBluetoothAddress address(Q_UINT64_C(0xC026DA000000) + quint64(i));
+        targetStrings << address.toString();
+        filter.addAddress(address);
+    }
+    filter.addService(QBluetoothUuid(QBluetoothUuid::HealthThermometer));
+    filter.setMinimumRssi(-80);
+
+    out << count << " advertisements from " << devices << " devices, " << targets << " targets\n";
+
+    volatile int sink = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for(int r = 0; r < rounds; ++r)
+        sink = sink + legacyScan(stream, targetStrings);
+    const qint64 legacyNs = timer.nsecsElapsed() / rounds;
+
+    int emitted = 0;
+    timer.restart();
+    for(int r = 0; r < rounds; ++r) {
+        DeviceIndex index;
+        emitted = indexedScan(stream, filter, &index);
+    }
+    const qint64 indexedNs = timer.nsecsElapsed() / rounds;
+
+    out << "  legacy  " << legacyNs / 1000 << " us/scan, " << double(legacyNs) / count << " ns/advertisement\n"
+        << "  indexed " << indexedNs / 1000 << " us/scan, " << double(indexedNs) / count << " ns/advertisement, "
+        << emitted << " devices passed on, speedup x"
+        << (indexedNs > 0 ? double(legacyNs) / indexedNs : 0.0) << "\n";
+
+    // the same stream through a transport and the event loop
+    for(int filtered = 0; filtered < 2; ++filtered) {
+        SimTransport transport;
+        for(const QBluetoothDeviceInfo &info : stream) {
+            SimPeripheral p;
+            p.info = info;
+            transport.addPeripheral(p);
+        }
+        if(filtered)
+            transport.setScanFilter(filter);
+
+        int discovered = 0;
+        bool finished = false;
+        QObject::connect(&transport, &BLETransport::deviceDiscovered, [&discovered]() { ++discovered; });
+        QObject::connect(&transport, &BLETransport::scanFinished, [&finished]() { finished = true; });
+
+        transport.open(QBluetoothAddress());
+        timer.restart();
+        transport.startScan();
+        while(!finished)
+            app.processEvents(QEventLoop::WaitForMoreEvents);
+        const qint64 ns = timer.nsecsElapsed();
+
+        out << "  sim transport " << (filtered ? "filtered  " : "unfiltered") << " "
+            << ns / 1000 << " us, " << discovered << " deviceDiscovered emits, "
+            << transport.advertisementsFiltered() << " of " << transport.advertisementsSeen() << " dropped\n";
+    }
+    out.flush();
+    return 0;
+}
@@ -0,0 +1,53 @@
+// notifications/sec sustained through SessionManager as the device count
+// grows: every session receives queued Temperature Measurement notifications
+// through the event loop, as controller signals arrive in the application
+
+#include "sessionmanager.h"
+#include "simtransport.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const qint64 windowMs = argc > 1 ? QByteArray(argv[1]).toLongLong() : 1000;
+    const QByteArray notification = QByteArray::fromHex("07d30300ffe50707080f220001");
+
+    qInstallMessageHandler(dropMessages);
+
+    for(int devices = 1; devices <= 256; devices *= 2) {
+        SimTransport transport;
+        SessionManager manager(&transport);
+        for(int i = 0; i < devices; ++i)
+            manager.addSession(SimTransport::thermometer(i).info);
+
+        quint64 measured = 0;
+        QObject::connect(&manager, &SessionManager::temperatureMeasured,
+                         [&measured]() { ++measured; });
+
+        const QList<BLESession *> sessions = manager.sessions();
+        QElapsedTimer timer;
+        timer.start();
+        // keep one notification per device queued, the way a busy bay would
+        while(timer.elapsed() < windowMs) {
+            for(BLESession *session : sessions) {
+                QMetaObject::invokeMethod(session, [session, notification]() {
+                    session->processMeasurement(notification);
+                }, Qt::QueuedConnection);
+            }
+            app.processEvents();
+        }
+        app.processEvents();
+        const double seconds = timer.nsecsElapsed() / 1e9;
+
+        out << devices << " devices: " << qint64(measured / seconds) << " notifications/s, "
+            << qint64(measured / seconds / devices) << " per device\n";
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Samples/sec/core through SignalQuality for a population of synthetic PLX
+// Continuous streams: steady readings with noise, motion spikes and dropouts.
+// Runs the SSE2 kernels and the scalar reference over the same input on one
+// thread and checks that they assess every sample alike.
+
+#include "signalquality.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace {
+
+struct Stream {
+    std::vector<int> slots;
+    std::vector<float> spo2;
+    std::vector<float> pulse;
+};
+
+// one reading per device per round, interleaved the way notifications arrive
+Stream makeStream(SignalQuality *engine, int devices, int rounds)
+{
+    Stream s;
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    quint32 seed = 12345;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+    std::vector<int> slots;
+    for(int d = 0; d < devices; ++d)
+        slots.push_back(engine->slot(0x00A0500000000000ULL + quint64(d)));
+
+    for(int round = 0; round < rounds; ++round) {
+        for(int d = 0; d < devices; ++d) {
+            const quint32 r = next();
+            float spo2 = 95.0f + float(d % 4) + float(r % 3) * 0.5f;
+            float pulse = 60.0f + float(d % 30) + float((r >> 4) % 5) * 0.5f;
+            if(0 == (r >> 12) % 97)
+                pulse += 40.0f;                 // motion
+            if(0 == (r >> 12) % 61)
+                spo2 = pulse = missing;         // probe off
+            s.slots.push_back(slots[size_t(d)]);
+            s.spo2.push_back(spo2);
+            s.pulse.push_back(pulse);
+        }
+    }
+    return s;
+}
+
+qint64 run(SignalQuality *engine, const Stream &s, int devices, std::vector<SignalQuality::Result> *results)
+{
+    results->resize(s.slots.size());
+    QElapsedTimer timer;
+    timer.start();
+    for(size_t i = 0; i < s.slots.size(); i += size_t(devices))
+        engine->pushBatch(&s.slots[i], &s.spo2[i], &s.pulse[i], devices, &(*results)[i]);
+    return timer.nsecsElapsed();
+}
+
+bool near(float a, float b)
+{
+    return std::fabs(a - b) <= 1e-3f * qMax(1.0f, std::fabs(a));
+}
+
+bool same(const SignalQuality::Result &a, const SignalQuality::Result &b)
+{
+    return a.samples == b.samples && a.dropouts == b.dropouts
+        && a.motion == b.motion && a.dropout == b.dropout && a.stable == b.stable
+        && near(a.spo2Mean, b.spo2Mean) && near(a.pulseMean, b.pulseMean)
+        && near(a.spo2Deviation, b.spo2Deviation) && near(a.pulseDeviation, b.pulseDeviation)
+        && near(a.acceptedSpo2, b.acceptedSpo2) && near(a.acceptedPulse, b.acceptedPulse);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const int devices = argc > 1 ? QByteArray(argv[1]).toInt() : 1000;
+    const int rounds = argc > 2 ? QByteArray(argv[2]).toInt() : 1000;
+    const int window = argc > 3 ? QByteArray(argv[3]).toInt() : 32;
+
+    SignalQuality vectorised(window);
+    SignalQuality scalar(window);
+    scalar.setVectorised(false);
+    const Stream stream = makeStream(&vectorised, devices, rounds);
+    makeStream(&scalar, devices, 0);
+
+    std::vector<SignalQuality::Result> fast;
+    std::vector<SignalQuality::Result> reference;
+    const qint64 fastNs = run(&vectorised, stream, devices, &fast);
+    const qint64 referenceNs = run(&scalar, stream, devices, &reference);
+
+    int stable = 0;
+    int motion = 0;
+    int dropout = 0;
+    for(size_t i = 0; i < fast.size(); ++i) {
+        if(!same(fast[i], reference[i])) {
+            out << "sample " << i << " assessed differently by the scalar reference\n";
+            return 1;
+        }
+        stable += fast[i].stable;
+        motion += fast[i].motion;
+        dropout += fast[i].dropout;
+    }
+
+    const double samples = double(stream.slots.size());
+    out << devices << " devices x " << rounds << " readings, window " << vectorised.window() << "\n"
+        << "  stable " << stable << ", motion " << motion << ", dropout " << dropout << "\n"
+        << "  vectorised: " << (fastNs > 0 ? samples * 1e9 / fastNs : 0.0) << " samples/sec/core, "
+        << double(fastNs) / samples << " ns/sample\n"
+        << "  scalar:     " << (referenceNs > 0 ? samples * 1e9 / referenceNs : 0.0) << " samples/sec/core, "
+        << double(referenceNs) / samples << " ns/sample\n"
+        << "  speedup x" << (fastNs > 0 ? double(referenceNs) / fastNs : 0.0) << "\n";
+    return 0;
+}
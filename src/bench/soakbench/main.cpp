@@ -0,0 +1,224 @@
+// memory and handles across connect cycles on the simulated transport.
+// Thermometers on a pool of two simulated adapters drop their link shortly
+// after subscribing and reconnect; every so often an adapter powers off so
+// its links move to the other, a target is removed and added back so its
+// session is rebuilt, and every scan window hears passers-by at fresh
+// addresses. After a warm-up the resident set, open file descriptors, live
+// links and QObjects are sampled; the run fails when any of them grows.
+//
+//   soakbench [cycles] [hours]      cycles 0 runs until the hours are up
+
+#include "adapterpool.h"
+#include "sessionmanager.h"
+#include "simtransport.h"
+#include "structlog.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int kDevices = 12;
+const int kAdapters = 2;
+const qint64 kRssSlackKb = 2048;      // allocator and page noise
+
+struct Sample
+{
+    qint64 cycles = 0;
+    qint64 rssKb = -1;
+    int files = -1;
+    int links = 0;
+    int objects = 0;
+    int indexed = 0;
+};
+
+qint64 residentKb()
+{
+#ifdef Q_OS_UNIX
+    QFile statm("/proc/self/statm");
+    if(!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if(fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * ::sysconf(_SC_PAGESIZE) / 1024;
+#else
+    return -1;
+#endif
+}
+
+int openFiles()
+{
+    const QDir fds("/proc/self/fd");
+    return fds.exists() ? fds.entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).size() : -1;
+}
+
+int objects(const QObject *root)
+{
+    int count = 1;
+    for(const QObject *child : root->children())
+        count += objects(child);
+    return count;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const qint64 cycles = argc > 1 ? QByteArray(argv[1]).toLongLong() : 5000;
+    const double hours = argc > 2 ? QByteArray(argv[2]).toDouble() : 24.0;
+    // long enough for every link to have been carried by both adapters
+    const qint64 warmup = 0 < cycles ? qMax<qint64>(500, cycles / 5) : 2000;
+
+    qInstallMessageHandler(dropMessages);
+    Log::setLevel(Log::Error);
+
+    QList<SimTransport *> adapters;
+    AdapterPool pool([&adapters](QObject *parent) -> BLETransport * {
+        SimTransport *transport = new SimTransport(parent);
+        for(int i = 0; i < kDevices; ++i) {
+            SimPeripheral peripheral = SimTransport::thermometer(i);
+            peripheral.connectLatencyMs = 2;
+            peripheral.discoveryLatencyMs = 1;
+            peripheral.subscribeLatencyMs = 1;
+            peripheral.latencyJitterMs = 2;
+            peripheral.rateHz = 50.0;
+            peripheral.disconnectAfterMs = 40;
+            transport->addPeripheral(peripheral);
+        }
+        transport->setMaxLinks(7);
+        transport->setPassersBy(8);
+        adapters << transport;
+        return transport;
+    });
+    pool.setAdapters(QList<QBluetoothAddress>() << QBluetoothAddress(Q_UINT64_C(0x00005E000001))
+                                                << QBluetoothAddress(Q_UINT64_C(0x00005E000002)));
+    pool.setDeviceTtl(2000);
+
+    SessionManager manager(&pool);
+    manager.setAutoConnect(true);
+    manager.setMaxPendingConnects(4);
+    manager.setScanDutyCycle(100, 50);
+    QObject::connect(&manager, &SessionManager::sessionAdded, [](BLESession *session) {
+        session->setReconnectBackoff(5, 40);
+    });
+    for(int i = 0; i < kDevices; ++i)
+        manager.addTarget(SimTransport::thermometer(i).info.address());
+    // never seen, so the scan and its passers-by keep going
+    manager.addTarget(QBluetoothAddress(Q_UINT64_C(0xC026DAFFFFFF)));
+
+    qint64 subscriptions = 0;
+    int rebuilds = 0;
+    int flips = 0;
+    QObject::connect(&manager, &SessionManager::sessionStateChanged,
+                     [&](BLESession *session, BLESession::State state) {
+        if(BLESession::Subscribed != state)
+            return;
+        ++subscriptions;
+        if(0 == subscriptions % 50) {
+            // the whole session goes, link and all, and a new one takes its place
+            const QBluetoothDeviceInfo info = session->deviceInfo();
+            manager.removeTarget(info.address());
+            manager.addTarget(info.address());
+            manager.addSession(info);
+            manager.connectAll();
+            ++rebuilds;
+        }
+        if(0 == subscriptions % 100) {
+            SimTransport *adapter = adapters.at(flips++ % adapters.size());
+            adapter->setPowered(false);
+            QTimer::singleShot(50, adapter, [adapter]() { adapter->setPowered(true); });
+        }
+    });
+
+    if(!manager.start()) {
+        out << "cannot open the simulated adapters\n";
+        return 1;
+    }
+
+    auto sample = [&]() {
+        // sessions removed inside their own signals are still waiting for this
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+        Sample s;
+        s.cycles = subscriptions;
+        s.rssKb = residentKb();
+        s.files = openFiles();
+        s.links = BLELink::liveCount();
+        s.objects = objects(&manager) + objects(&pool);
+        s.indexed = pool.deviceIndex().size();
+        return s;
+    };
+    auto print = [&out](const char *what, const Sample &s) {
+        out << what << s.cycles << " cycles: rss " << s.rssKb << " kB, fds " << s.files << ", links " << s.links
+            << ", objects " << s.objects << ", indexed " << s.indexed << "\n";
+        out.flush();
+    };
+
+    Sample baseline;
+    Sample last;
+    bool warm = false;
+    int warmObjects = 0;
+    int ticks = 0;
+    QElapsedTimer clock;
+    clock.start();
+    QTimer progress;
+    QObject::connect(&progress, &QTimer::timeout, [&]() {
+        last = sample();
+        if(!warm) {
+            // the most the tree holds once every link has been on both adapters
+            warmObjects = qMax(warmObjects, last.objects);
+            if(subscriptions >= warmup) {
+                warm = true;
+                baseline = last;
+                print("baseline after ", baseline);
+            }
+        } else if(0 == ++ticks % 60) {
+            print("", last);
+        }
+        if((0 < cycles && subscriptions >= cycles) || clock.elapsed() > qint64(hours * 3600000.0))
+            app.quit();
+    });
+    progress.start(1000);
+    app.exec();
+    progress.stop();
+
+    last = sample();
+    print("final after ", last);
+    out << rebuilds << " sessions rebuilt, " << flips << " adapter power cycles, " << pool.moves()
+        << " link moves, " << clock.elapsed() / 1000 << " s\n";
+
+    if(!warm) {
+        out << "FAIL: never got past the warm-up, " << subscriptions << " of " << warmup << " cycles\n";
+        return 1;
+    }
+    QStringList failures;
+    if(0 <= baseline.rssKb && last.rssKb - baseline.rssKb > kRssSlackKb)
+        failures << QString("rss grew %1 kB").arg(last.rssKb - baseline.rssKb);
+    if(0 <= baseline.files && last.files > baseline.files)
+        failures << QString("%1 more open files").arg(last.files - baseline.files);
+    // a pooled link per session plus at most one on each adapter
+    if(last.links > kDevices * (1 + kAdapters))
+        failures << QString("%1 links alive for %2 devices").arg(last.links).arg(kDevices);
+    if(last.objects > warmObjects)
+        failures << QString("%1 objects, at most %2 after warm-up").arg(last.objects).arg(warmObjects);
+    if(last.indexed > kDevices + 1 + 8 * 40)
+        failures << QString("%1 devices indexed").arg(last.indexed);
+
+    for(const QString &failure : qAsConst(failures))
+        out << "FAIL: " << failure << "\n";
+    if(failures.isEmpty())
+        out << "PASS\n";
+    return failures.isEmpty() ? 0 : 1;
+}
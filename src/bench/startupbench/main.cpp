@@ -0,0 +1,187 @@
+// startup to first scan result and to the first subscribed thermometer,
+// cold (no settings file) and warm (the profile a previous run wrote), with
+// the settings read and adapters probed one after the other by start() or
+// together off the event loop by startAsync(). Probing and opening an
+// adapter sleep for what the Bluetooth daemon round trips cost on real
+// hardware; simulated thermometers advertise at a random point of a one
+// second interval. "stall" is the longest the event loop went without a
+// pass, which is how long a window shown first would freeze.
+//
+//   startupbench [rounds]
+
+#include "adapterpool.h"
+#include "latencyhistogram.h"
+#include "latencyrecorder.h"
+#include "sessionmanager.h"
+#include "simtransport.h"
+#include "structlog.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+
+const int kDevices = 4;
+const int kProbeMs = 150;           // QBluetoothLocalDevice::allDevices()
+const int kOpenMs = 80;             // QBluetoothLocalDevice, host mode, power
+const QBluetoothAddress kFirst(Q_UINT64_C(0x00005E000001));
+const QBluetoothAddress kSecond(Q_UINT64_C(0x00005E000002));
+
+class SlowAdapter : public SimTransport
+{
+public:
+    explicit SlowAdapter(QObject *parent) : SimTransport(parent) {}
+
+    bool open(const QBluetoothAddress &adapter) override
+    {
+        QThread::msleep(kOpenMs);
+        return SimTransport::open(adapter);
+    }
+};
+
+class SlowPool : public AdapterPool
+{
+public:
+    explicit SlowPool(QObject *parent = nullptr)
+        : AdapterPool([](QObject *p) -> BLETransport * {
+              SimTransport *transport = new SlowAdapter(p);
+              for(int i = 0; i < kDevices; ++i) {
+                  SimPeripheral peripheral = SimTransport::thermometer(i);
+                  peripheral.advertiseDelayMs = int(QRandomGenerator::global()->bounded(1000));
+                  peripheral.connectLatencyMs = 30;
+                  peripheral.discoveryLatencyMs = 10;
+                  peripheral.subscribeLatencyMs = 10;
+                  peripheral.rateHz = 0.0;
+                  transport->addPeripheral(peripheral);
+              }
+              return transport;
+          }, parent)
+    {
+    }
+
+    QList<QBluetoothAddress> probeAdapters() const override
+    {
+        QThread::msleep(kProbeMs);
+        return QList<QBluetoothAddress>() << kFirst << kSecond;
+    }
+};
+
+struct Result
+{
+    LatencyHistogram stall;
+    LatencyHistogram firstResult;
+    LatencyHistogram firstSubscribed;
+    LatencyHistogram allSubscribed;
+    int failed = 0;
+};
+
+void run(const QString &settingsPath, bool async, Result *result)
+{
+    SlowPool pool;
+    SessionManager manager(&pool);
+    manager.setSettingsPath(settingsPath);
+    manager.setAutoConnect(true);
+    manager.setMaxPendingConnects(kDevices);
+    manager.setDiscoveryMode(BLESession::SubscribeOnly);
+    for(int i = 0; i < kDevices; ++i)
+        manager.addTarget(SimTransport::thermometer(i).info.address());
+
+    qint64 startedAt = 0;
+    qint64 firstResultAt = 0;
+    qint64 firstSubscribedAt = 0;
+    qint64 allSubscribedAt = 0;
+    int subscribed = 0;
+    QObject::connect(&pool, &BLETransport::deviceDiscovered, [&]() {
+        if(0 == firstResultAt)
+            firstResultAt = LatencyRecorder::now();
+    });
+    QObject::connect(&manager, &SessionManager::sessionStateChanged,
+                     [&](BLESession *, BLESession::State state) {
+        if(BLESession::Subscribed != state)
+            return;
+        if(0 == subscribed++)
+            firstSubscribedAt = LatencyRecorder::now();
+        if(kDevices == subscribed)
+            allSubscribedAt = LatencyRecorder::now();
+    });
+    bool ok = true;
+    QObject::connect(&manager, &SessionManager::started, [&](bool started) { ok = started; });
+
+    // a pass of the event loop every tick, the longest gap is the stall
+    qint64 lastPass = 0;
+    qint64 stall = 0;
+    QTimer passes;
+    QObject::connect(&passes, &QTimer::timeout, [&]() {
+        const qint64 now = LatencyRecorder::now();
+        stall = qMax(stall, now - lastPass);
+        lastPass = now;
+    });
+    passes.start(0);
+
+    startedAt = lastPass = LatencyRecorder::now();
+    if(async)
+        manager.startAsync();
+    else
+        ok = manager.start();
+
+    if(!ok || !settle([&]() { return !ok || kDevices == subscribed; })) {
+        ++result->failed;
+        return;
+    }
+    // a warm start opens the second adapter after the first is scanning, count its stall too
+    settle([&]() { return 2 == pool.adapterCount(); });
+    QCoreApplication::processEvents();
+    passes.stop();
+
+    result->stall.recordNanoseconds(stall);
+    result->firstResult.recordNanoseconds(firstResultAt - startedAt);
+    result->firstSubscribed.recordNanoseconds(firstSubscribedAt - startedAt);
+    result->allSubscribed.recordNanoseconds(allSubscribedAt - startedAt);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+    Log::setLevel(Log::Error);
+
+    const int rounds = argc > 1 ? QByteArray(argv[1]).toInt() : 10;
+
+    QTemporaryDir dir;
+    const QString cold = dir.filePath("cold.ini");
+    const QString warm = dir.filePath("warm.ini");
+    StartupProfile profile;
+    profile.adapter = kSecond;
+    profile.adapterName = QStringLiteral("simulated");
+    for(int i = 0; i < kDevices; ++i)
+        profile.peripherals << SimTransport::thermometer(i).info;
+    profile.write(warm);
+
+    out << "startup in ms, p50 of " << rounds << " rounds; " << kDevices << " thermometers on 2 adapters, probe "
+        << kProbeMs << ", open " << kOpenMs << " each, advertising interval 1000\n";
+    for(int w = 0; w < 2; ++w) {
+        for(int async = 0; async < 2; ++async) {
+            Result result;
+            for(int round = 0; round < rounds; ++round)
+                run(w ? warm : cold, async, &result);
+            out << "  " << (w ? "warm" : "cold") << (async ? " startAsync:" : " start():   ")
+                << " stall " << result.stall.percentile(0.50) / 1000.0
+                << ", first scan result " << result.firstResult.percentile(0.50) / 1000.0
+                << ", first subscribed " << result.firstSubscribed.percentile(0.50) / 1000.0
+                << ", all subscribed " << result.allSubscribed.percentile(0.50) / 1000.0;
+            if(0 < result.failed)
+                out << ", " << result.failed << " failed";
+            out << "\n";
+            out.flush();
+        }
+    }
+    return 0;
+}
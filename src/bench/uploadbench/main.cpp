@@ -0,0 +1,188 @@
+// end-to-end PineUploader throughput and delivery latency against a local
+// stand-in for the Pine endpoint, then the same load through an outage to
+// show the disk queue delivering everything once the endpoint returns
+
+#include "latencyhistogram.h"
+#include "pineuploader.h"
+#include "../benchsupport.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QtEndian>
+
+namespace {
+
+// minimal HTTP/1.1 server: reads each POST, counts the readings in the
+// deflated JSON body and answers 200 after an optional delay
+class StandInServer
+{
+public:
+    explicit StandInServer(int delayMs) : m_delayMs(delayMs)
+    {
+        QObject::connect(&m_server, &QTcpServer::newConnection, [this]() {
+            while(QTcpSocket *socket = m_server.nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, [this, socket]() { read(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, [this, socket]() {
+                    m_buffers.remove(socket);
+                    socket->deleteLater();
+                });
+            }
+        });
+    }
+
+    bool listen(quint16 port = 0) { return m_server.listen(QHostAddress::LocalHost, port); }
+    quint16 port() const { return m_server.serverPort(); }
+    void shutdown()
+    {
+        m_server.close();
+        for(QTcpSocket *socket : m_buffers.keys())
+            socket->abort();
+    }
+
+    quint64 readings = 0;
+    quint64 requests = 0;
+    quint64 bytes = 0;
+
+private:
+    void read(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+        for(;;) {
+            const int headerEnd = buffer.indexOf("\r\n\r\n");
+            if(headerEnd < 0)
+                return;
+            int length = 0;
+            for(const QByteArray &line : buffer.left(headerEnd).split('\n')) {
+                if(line.toLower().startsWith("content-length:"))
+                    length = line.mid(15).trimmed().toInt();
+            }
+            if(buffer.size() < headerEnd + 4 + length)
+                return;
+            const QByteArray body = buffer.mid(headerEnd + 4, length);
+            buffer.remove(0, headerEnd + 4 + length);
+            count(body);
+
+            QTimer::singleShot(m_delayMs, socket, [socket]() {
+                socket->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+            });
+        }
+    }
+
+    void count(const QByteArray &deflated)
+    {
+        // qUncompress wants the qCompress length prefix back
+        QByteArray prefixed(4, 0);
+        qToBigEndian<quint32>(quint32(deflated.size() * 32), reinterpret_cast<uchar *>(prefixed.data()));
+        const QJsonObject payload = QJsonDocument::fromJson(qUncompress(prefixed + deflated)).object();
+        readings += quint64(payload.value("readings").toArray().size());
+        ++requests;
+        bytes += quint64(deflated.size());
+    }
+
+    QTcpServer m_server;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    int m_delayMs;
+};
+
+TemperatureMeasurement reading(int i)
+{
+    TemperatureMeasurement m = TemperatureMeasurement();
+    m.flags = TemperatureMeasurement::Fahrenheit | TemperatureMeasurement::HasTimestamp | TemperatureMeasurement::HasType;
+    m.mantissa = 970 + i % 30;
+    m.exponent = -1;
+    m.value = m.mantissa / 10.0;
+    m.type = 1;
+    m.year = 2021;
+    m.month = 7;
+    m.day = 8;
+    return m;
+}
+
+// feed rate readings/s for seconds, optionally with the endpoint down in the
+// middle third, then wait for the queue to drain
+void run(QTextStream &out, int rate, int seconds, int delayMs, bool outage)
+{
+    QTemporaryDir queue;
+    StandInServer server(delayMs);
+    server.listen();
+    const quint16 port = server.port();
+
+    PineUploader uploader;
+    uploader.setBatching(200, 250);
+    uploader.open(QUrl(QString("http://127.0.0.1:%1/readings").arg(port)), queue.path());
+
+    const int total = rate * seconds;
+    int sent = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QTimer feed;
+    feed.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&feed, &QTimer::timeout, [&]() {
+        const int due = qMin(total, int(qint64(rate) * timer.elapsed() / 1000));
+        for(; sent < due; ++sent)
+            uploader.enqueue(QString("C0:26:DA:00:00:%1").arg(sent % 64, 2, 16, QLatin1Char('0')), reading(sent));
+        if(sent >= total) {
+            feed.stop();
+            uploader.flush();
+        }
+    });
+    feed.start(1);
+
+    const qint64 downAt = seconds * 1000 / 3;
+    const qint64 upAt = seconds * 2000 / 3;
+    bool down = false;
+    bool recovered = !outage;
+    while(feed.isActive() || 0 < uploader.pendingBatches()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+        const qint64 ms = timer.elapsed();
+        if(!recovered && !down && ms >= downAt) {
+            server.shutdown();
+            down = true;
+        }
+        if(down && ms >= upAt && server.listen(port)) {
+            down = false;
+            recovered = true;
+        }
+        if(ms > seconds * 1000 + 120000)
+            break;
+    }
+    const double elapsed = timer.nsecsElapsed() / 1e9;
+
+    const LatencyHistogram &latency = uploader.deliveryLatency();
+    out << rate << " readings/s" << (outage ? ", endpoint down for the middle third" : "") << ": "
+        << server.readings << "/" << total << " delivered in " << server.requests << " requests, "
+        << qint64(server.readings / elapsed) << " readings/s end to end, "
+        << double(server.bytes) / qMax<quint64>(1, server.readings) << " bytes/reading, "
+        << "latency p50 " << latency.percentile(0.50) / 1000 << " ms p99 " << latency.percentile(0.99) / 1000
+        << " ms max " << latency.max() / 1000 << " ms, " << uploader.failures() << " failed attempts\n";
+    out.flush();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pine_masimo");
+    QTextStream out(stdout);
+    qInstallMessageHandler(dropMessages);
+
+    const int seconds = argc > 1 ? QByteArray(argv[1]).toInt() : 3;
+    const int delayMs = argc > 2 ? QByteArray(argv[2]).toInt() : 20;
+
+    out << "stand-in Pine answering after " << delayMs << " ms\n";
+    for(int rate = 100; rate <= 10000; rate *= 10)
+        run(out, rate, seconds, delayMs, false);
+    run(out, 1000, qMax(6, seconds), delayMs, true);
+    return 0;
+}
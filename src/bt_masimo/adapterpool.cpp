@@ -0,0 +1,341 @@
+#include "adapterpool.h"
+#include "structlog.h"
+
+#include <QTimer>
+#include <QtBluetooth/QBluetoothLocalDevice>
+
+PooledLink::PooledLink(const QBluetoothDeviceInfo &info, AdapterPool *pool, QObject *parent)
+    : BLELink(parent)
+    , m_info(info)
+    , m_pool(pool)
+{
+}
+
+PooledLink::~PooledLink()
+{
+    if(nullptr!=m_pool)
+        m_pool->release(this);
+}
+
+bool PooledLink::select(int adapter, BLETransport *transport)
+{
+    if(m_links.size() <= adapter)
+        m_links.resize(adapter + 1);
+    if(nullptr==m_links[adapter]) {
+        m_links[adapter] = transport->createLink(m_info, this);
+        if(nullptr==m_links[adapter])
+            return false;
+    }
+    if(m_inner==m_links[adapter])
+        return true;
+    // the one left behind stays idle until the link moves back; an attempt
+    // still under way there would hold a slot nobody sees
+    if(nullptr!=m_inner) {
+        m_inner->disconnect(this);
+        m_inner->disconnectFromDevice();
+    }
+    m_inner = m_links[adapter];
+    m_adapter = adapter;
+
+    connect(m_inner, &BLELink::connected, this, &BLELink::connected);
+    connect(m_inner, &BLELink::disconnected, this, &BLELink::disconnected);
+    connect(m_inner, &BLELink::serviceDiscovered, this, &BLELink::serviceDiscovered);
+    connect(m_inner, &BLELink::discoveryFinished, this, &BLELink::discoveryFinished);
+    connect(m_inner, &BLELink::serviceReady, this, &BLELink::serviceReady);
+    connect(m_inner, &BLELink::notificationsEnabled, this, &BLELink::notificationsEnabled);
+    connect(m_inner, &BLELink::characteristicRead, this, &BLELink::characteristicRead);
+    connect(m_inner, &BLELink::connectionUpdated, this, &BLELink::connectionUpdated);
+    connect(m_inner, &BLELink::notification, this, &BLELink::notification);
+    connect(m_inner, &BLELink::errorOccurred, this, &BLELink::errorOccurred);
+    return true;
+}
+
+void PooledLink::connectToDevice()
+{
+    if(nullptr==m_pool || !m_pool->bind(this)) {
+        // fails like a controller would, after the caller has seen the attempt start
+        QTimer::singleShot(0, this, [this]() {
+            emit errorOccurred(QLowEnergyController::InvalidBluetoothAdapterError,
+                               QStringLiteral("no powered adapter"));
+        });
+        return;
+    }
+    m_inner->connectToDevice();
+}
+
+void PooledLink::disconnectFromDevice()
+{
+    if(nullptr!=m_inner)
+        m_inner->disconnectFromDevice();
+}
+
+bool PooledLink::isConnected() const
+{
+    return nullptr!=m_inner && m_inner->isConnected();
+}
+
+void PooledLink::discoverServices()
+{
+    if(nullptr!=m_inner)
+        m_inner->discoverServices();
+}
+
+bool PooledLink::openService(const QBluetoothUuid &service, DetailDiscovery mode)
+{
+    return nullptr!=m_inner && m_inner->openService(service, mode);
+}
+
+bool PooledLink::enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+{
+    return nullptr!=m_inner && m_inner->enableNotifications(service, characteristic);
+}
+
+bool PooledLink::readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+{
+    return nullptr!=m_inner && m_inner->readCharacteristic(service, characteristic);
+}
+
+QList<GattAttribute> PooledLink::attributes(const QBluetoothUuid &service) const
+{
+    return nullptr==m_inner ? QList<GattAttribute>() : m_inner->attributes(service);
+}
+
+bool PooledLink::enableNotifications(const GattAttribute &cached)
+{
+    return nullptr!=m_inner && m_inner->enableNotifications(cached);
+}
+
+void PooledLink::requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters)
+{
+    if(nullptr!=m_inner)
+        m_inner->requestConnectionUpdate(parameters);
+}
+
+AdapterPool::AdapterPool(const Factory &factory, QObject *parent)
+    : BLETransport(parent)
+    , m_factory(factory)
+{
+}
+
+QList<QBluetoothAddress> AdapterPool::probeAdapters() const
+{
+    if(!m_addresses.isEmpty())
+        return m_addresses;
+    QList<QBluetoothAddress> addresses;
+    for(const QBluetoothHostInfo &host : QBluetoothLocalDevice::allDevices())
+        addresses << host.address();
+    return addresses;
+}
+
+void AdapterPool::setProbedAdapters(const QList<QBluetoothAddress> &adapters)
+{
+    if(m_addresses.isEmpty())
+        m_addresses = adapters;
+}
+
+bool AdapterPool::open(const QBluetoothAddress &adapter)
+{
+    QList<QBluetoothAddress> addresses = probeAdapters();
+    // no adapter listed (or the platform cannot list them), let the member pick
+    if(addresses.isEmpty())
+        addresses << QBluetoothAddress();
+    const int found = addresses.size();
+    // the one from the settings goes first, the rest once it is scanning
+    if(!adapter.isNull() && addresses.removeAll(adapter) > 0 && addAdapter(adapter)) {
+        m_deferred = addresses;
+        if(!m_deferred.isEmpty())
+            QTimer::singleShot(0, this, &AdapterPool::openDeferred);
+        addresses.clear();
+    }
+
+    for(const QBluetoothAddress &address : qAsConst(addresses)) {
+        if(0 < m_maxAdapters && m_adapters.size() >= m_maxAdapters)
+            break;
+        addAdapter(address);
+    }
+    m_powered = isPowered();
+    LOG_INFO("adapters.open", "adapters", m_adapters.size(), "found", found,
+             "deferred", m_deferred.size(), "links_per_adapter", m_linksPerAdapter);
+    return !m_adapters.isEmpty();
+}
+
+void AdapterPool::openDeferred()
+{
+    const QList<QBluetoothAddress> addresses = m_deferred;
+    m_deferred.clear();
+    for(const QBluetoothAddress &address : addresses) {
+        if(0 < m_maxAdapters && m_adapters.size() >= m_maxAdapters)
+            break;
+        addAdapter(address);
+    }
+    LOG_INFO("adapters.open_deferred", "adapters", m_adapters.size());
+    const bool any = isPowered();
+    if(any != m_powered) {
+        m_powered = any;
+        emit poweredChanged(any);
+    }
+}
+
+bool AdapterPool::addAdapter(const QBluetoothAddress &address)
+{
+    BLETransport *transport = m_factory(this);
+    if(nullptr==transport)
+        return false;
+    if(!transport->open(address)) {
+        LOG_WARNING("adapters.open_failed", "address", Log::mac(address.toUInt64()));
+        delete transport;
+        return false;
+    }
+    transport->forwardAdvertisements(this);
+    connect(transport, &BLETransport::scanFinished, this, &AdapterPool::memberScanFinished);
+    connect(transport, &BLETransport::scanError, this, &BLETransport::scanError);
+    connect(transport, &BLETransport::poweredChanged, this, &AdapterPool::memberPoweredChanged);
+
+    Adapter a;
+    a.transport = transport;
+    m_adapters << a;
+    LOG_INFO("adapters.added", "index", m_adapters.size() - 1,
+             "address", Log::mac(transport->adapterAddress().toUInt64()), "powered", transport->isPowered());
+    return true;
+}
+
+QBluetoothAddress AdapterPool::adapterAddress() const
+{
+    return m_adapters.isEmpty() ? QBluetoothAddress() : m_adapters.first().transport->adapterAddress();
+}
+
+QString AdapterPool::adapterName() const
+{
+    return m_adapters.isEmpty() ? QString() : m_adapters.first().transport->adapterName();
+}
+
+int AdapterPool::indexOf(const QObject *transport) const
+{
+    for(int i = 0; i < m_adapters.size(); ++i) {
+        if(m_adapters[i].transport == transport)
+            return i;
+    }
+    return -1;
+}
+
+int AdapterPool::pick(int start) const
+{
+    int best = -1;
+    for(int i = 0; i < m_adapters.size(); ++i) {
+        const int index = (start + i) % m_adapters.size();
+        const Adapter &a = m_adapters[index];
+        if(a.transport->isPowered() && (-1 == best || a.links < m_adapters[best].links))
+            best = index;
+    }
+    return best;
+}
+
+void AdapterPool::startScan()
+{
+    const int index = pick(m_nextScan);
+    if(-1 == index) {
+        emit scanError(QBluetoothDeviceDiscoveryAgent::PoweredOffError, QStringLiteral("no powered adapter"));
+        return;
+    }
+    if(-1 != m_scanning && index != m_scanning)
+        m_adapters[m_scanning].transport->stopScan();
+    m_scanning = index;
+    m_nextScan = (index + 1) % m_adapters.size();
+    LOG_DEBUG("adapters.scan", "index", index, "links", m_adapters[index].links);
+    m_adapters[index].transport->startScan();
+}
+
+void AdapterPool::stopScan()
+{
+    if(-1 != m_scanning)
+        m_adapters[m_scanning].transport->stopScan();
+    m_scanning = -1;
+}
+
+bool AdapterPool::isScanning() const
+{
+    return -1 != m_scanning && m_adapters[m_scanning].transport->isScanning();
+}
+
+void AdapterPool::memberScanFinished()
+{
+    if(indexOf(sender()) != m_scanning)
+        return;
+    m_scanning = -1;
+    emit scanFinished();
+}
+
+void AdapterPool::memberPoweredChanged(bool powered)
+{
+    const int index = indexOf(sender());
+    LOG_WARNING("adapters.power", "index", index, "powered", powered, "links", index < 0 ? 0 : m_adapters[index].links);
+
+    // the scan window ends with the radio; the scheduler starts the next one elsewhere
+    if(!powered && index == m_scanning) {
+        m_scanning = -1;
+        emit scanFinished();
+    }
+    // links on it see their own disconnects and move when they reconnect
+
+    const bool any = isPowered();
+    if(any != m_powered) {
+        m_powered = any;
+        emit poweredChanged(any);
+    }
+}
+
+BLELink *AdapterPool::createLink(const QBluetoothDeviceInfo &info, QObject *parent)
+{
+    // bound to an adapter on its first connect, when the load is known
+    return new PooledLink(info, this, parent);
+}
+
+bool AdapterPool::bind(PooledLink *link)
+{
+    const int current = link->m_adapter;
+    if(nullptr!=link->m_inner && link->m_inner->isConnected())
+        return true;
+
+    const int best = pick();
+    if(-1 == best)
+        return false;
+    if(nullptr!=link->m_inner && 0 <= current && m_adapters[current].transport->isPowered()
+       && m_adapters[current].links - 1 <= m_adapters[best].links)
+        return true;
+
+    if(!link->select(best, m_adapters[best].transport))
+        return false;
+
+    if(0 <= current) {
+        --m_adapters[current].links;
+        ++m_moves;
+        LOG_INFO("adapters.move", "address", Log::mac(link->m_info.address().toUInt64()),
+                 "from", current, "to", best);
+    }
+    ++m_adapters[best].links;
+    if(m_adapters[best].links > m_linksPerAdapter)
+        LOG_WARNING("adapters.saturated", "index", best, "links", m_adapters[best].links,
+                    "adapters", m_adapters.size());
+    return true;
+}
+
+void AdapterPool::release(PooledLink *link)
+{
+    if(0 <= link->m_adapter && link->m_adapter < m_adapters.size())
+        --m_adapters[link->m_adapter].links;
+    link->m_adapter = -1;
+}
+
+bool AdapterPool::isSimulated() const
+{
+    return !m_adapters.isEmpty() && m_adapters.first().transport->isSimulated();
+}
+
+bool AdapterPool::isPowered() const
+{
+    for(const Adapter &a : m_adapters) {
+        if(a.transport->isPowered())
+            return true;
+    }
+    return false;
+}
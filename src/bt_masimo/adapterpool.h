@@ -0,0 +1,142 @@
+#ifndef ADAPTERPOOL_H
+#define ADAPTERPOOL_H
+
+#include "bletransport.h"
+
+#include <QList>
+#include <QPointer>
+#include <QVector>
+
+#include <functional>
+
+class AdapterPool;
+
+/**
+ * The link a session holds when the transport is a pool: it forwards to a
+ * link on one member adapter and is moved to another between connections,
+ * so a session keeps the same BLELink whichever radio carries it. The link
+ * made on each adapter is kept for the next move back, so moving costs no
+ * controller and a link never holds more than one per adapter.
+ */
+class PooledLink : public BLELink
+{
+    Q_OBJECT
+
+public:
+    PooledLink(const QBluetoothDeviceInfo &info, AdapterPool *pool, QObject *parent = nullptr);
+    ~PooledLink();
+
+    // the pool index of the adapter carrying the link, -1 before the first connect
+    int adapter() const { return m_adapter; }
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    bool isConnected() const override;
+
+    void discoverServices() override;
+    bool openService(const QBluetoothUuid &service, DetailDiscovery mode) override;
+    bool enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    bool readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    QList<GattAttribute> attributes(const QBluetoothUuid &service) const override;
+    bool enableNotifications(const GattAttribute &cached) override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters) override;
+
+private:
+    friend class AdapterPool;
+
+    // forward to the link on the given adapter, made by its transport on first use
+    bool select(int adapter, BLETransport *transport);
+
+    QBluetoothDeviceInfo m_info;
+    QPointer<AdapterPool> m_pool;
+    QVector<BLELink *> m_links;         // by adapter index, children of this link
+    BLELink *m_inner = nullptr;
+    int m_adapter = -1;
+};
+
+/**
+ * Every local adapter behind one BLETransport. Each controller takes only a
+ * handful of concurrent LE links, so a new connection goes to the adapter
+ * carrying the fewest; a link whose adapter powered off, or that sits on an
+ * adapter two or more links busier than another, moves when it next
+ * connects. Scan windows go to the least loaded adapter too, rotating among
+ * equals, so scanning does not always compete with the same radio's links.
+ * Advertisements from every member pass through the pool's own filter and
+ * index.
+ */
+class AdapterPool : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    // makes the (unopened) transport for one adapter, e.g. a NativeTransport
+    typedef std::function<BLETransport *(QObject *parent)> Factory;
+
+    explicit AdapterPool(const Factory &factory, QObject *parent = nullptr);
+
+    // adapters to open, in order; with none set open() asks QBluetoothLocalDevice for all of them
+    void setAdapters(const QList<QBluetoothAddress> &adapters) { m_addresses = adapters; }
+    // the adapters set above, or every one QBluetoothLocalDevice lists
+    QList<QBluetoothAddress> probeAdapters() const override;
+    void setProbedAdapters(const QList<QBluetoothAddress> &adapters) override;
+    // open at most count adapters, 0 for every one found
+    void setMaxAdapters(int count) { m_maxAdapters = count; }
+    // links per controller before another adapter is preferred outright
+    void setLinksPerAdapter(int count) { m_linksPerAdapter = qMax(1, count); }
+
+    int adapterCount() const { return m_adapters.size(); }
+    BLETransport *adapter(int index) const { return m_adapters[index].transport; }
+    // links currently assigned to an adapter
+    int load(int index) const { return m_adapters[index].links; }
+    // links moved to another adapter when they reconnected
+    quint64 moves() const { return m_moves; }
+
+    // the given adapter is opened first and is the one reported below; when
+    // it is found the others are opened on the next event loop pass, so a
+    // scan on it need not wait for them
+    bool open(const QBluetoothAddress &adapter) override;
+    QBluetoothAddress adapterAddress() const override;
+    QString adapterName() const override;
+
+    void startScan() override;
+    void stopScan() override;
+    bool isScanning() const override;
+
+    BLELink *createLink(const QBluetoothDeviceInfo &info, QObject *parent) override;
+    bool isSimulated() const override;
+    bool isPowered() const override;
+
+private slots:
+    void memberScanFinished();
+    void memberPoweredChanged(bool powered);
+    void openDeferred();
+
+private:
+    friend class PooledLink;
+
+    struct Adapter {
+        BLETransport *transport = nullptr;
+        int links = 0;
+    };
+
+    bool addAdapter(const QBluetoothAddress &address);
+    // least loaded powered adapter, ties from start on; -1 when none is powered
+    int pick(int start = 0) const;
+    // make sure the link has an inner link on a usable adapter, false when there is none
+    bool bind(PooledLink *link);
+    void release(PooledLink *link);
+    int indexOf(const QObject *transport) const;
+
+    Factory m_factory;
+    QList<QBluetoothAddress> m_addresses;
+    QList<QBluetoothAddress> m_deferred;    // still to open after the preferred one
+    QVector<Adapter> m_adapters;
+    int m_maxAdapters = 0;
+    int m_linksPerAdapter = 7;
+    int m_scanning = -1;                // adapter running the current scan window
+    int m_nextScan = 0;
+    bool m_powered = false;
+    quint64 m_moves = 0;
+};
+
+#endif // ADAPTERPOOL_H
@@ -0,0 +1,262 @@
+#include "asynclink.h"
+#include "latencyrecorder.h"
+
+#include <QPointer>
+
+GattOperation::GattOperation(Kind kind, const QBluetoothUuid &target, QObject *parent)
+    : QObject(parent)
+    , m_kind(kind)
+    , m_target(target)
+    , m_startedAt(LatencyRecorder::now())
+{
+    m_timeout.setSingleShot(true);
+    connect(&m_timeout, &QTimer::timeout, this, [this]() { finish(TimedOut, QStringLiteral("timed out")); });
+}
+
+void GattOperation::arm(int timeoutMs)
+{
+    if(0 < timeoutMs)
+        m_timeout.start(timeoutMs);
+}
+
+qint64 GattOperation::elapsedNs() const
+{
+    return (isFinished() ? m_finishedAt : LatencyRecorder::now()) - m_startedAt;
+}
+
+GattOperation *GattOperation::then(const Callback &fn)
+{
+    if(isFinished())
+        fn(this);
+    else
+        m_then << fn;
+    return this;
+}
+
+void GattOperation::cancel()
+{
+    finish(Cancelled, QStringLiteral("cancelled"));
+}
+
+void GattOperation::finish(Status status, const QString &error, const QByteArray &value)
+{
+    if(isFinished())
+        return;
+    m_status = status;
+    m_error = error;
+    m_value = value;
+    m_finishedAt = LatencyRecorder::now();
+    m_timeout.stop();
+
+    // the link forgets it first, so the abort and callbacks see the queue without it
+    emit finished(this);
+    if(Succeeded != status && m_abort)
+        m_abort();
+    const QList<Callback> callbacks = m_then;
+    m_then.clear();
+    for(const Callback &fn : callbacks)
+        fn(this);
+    deleteLater();
+}
+
+AsyncLink::AsyncLink(BLELink *link, QObject *parent)
+    : QObject(parent)
+    , m_link(link)
+{
+    connect(link, &BLELink::connected, this, &AsyncLink::linkConnected);
+    connect(link, &BLELink::disconnected, this, &AsyncLink::linkDisconnected);
+    connect(link, &BLELink::serviceDiscovered, this, &AsyncLink::serviceDiscovered);
+    connect(link, &BLELink::discoveryFinished, this, &AsyncLink::discoveryFinished);
+    connect(link, &BLELink::serviceReady, this, &AsyncLink::serviceReady);
+    connect(link, &BLELink::notificationsEnabled, this, &AsyncLink::notificationsEnabled);
+    connect(link, &BLELink::characteristicRead, this, &AsyncLink::characteristicRead);
+    connect(link, &BLELink::errorOccurred, this, &AsyncLink::linkError);
+}
+
+GattOperation *AsyncLink::start(GattOperation::Kind kind, const QBluetoothUuid &target, int timeoutMs)
+{
+    GattOperation *operation = new GattOperation(kind, target, this);
+    m_pending << operation;
+    connect(operation, &GattOperation::finished, this, [this](GattOperation *op) { m_pending.removeOne(op); });
+    operation->arm(0 > timeoutMs ? m_defaultTimeoutMs : timeoutMs);
+    return operation;
+}
+
+bool AsyncLink::isPending(GattOperation::Kind kind) const
+{
+    for(const GattOperation *operation : m_pending) {
+        if(kind == operation->kind())
+            return true;
+    }
+    return false;
+}
+
+GattOperation *AsyncLink::connectToDevice(int timeoutMs)
+{
+    const bool issued = isPending(GattOperation::Connect);
+    GattOperation *operation = start(GattOperation::Connect, QBluetoothUuid(), timeoutMs);
+    // giving up on a connect has to stop the controller trying
+    operation->m_abort = [this]() {
+        if(!m_link->isConnected() && !isPending(GattOperation::Connect))
+            m_link->disconnectFromDevice();
+    };
+    if(m_link->isConnected())
+        operation->finish(GattOperation::Succeeded);
+    else if(!issued)
+        m_link->connectToDevice();
+    return operation;
+}
+
+GattOperation *AsyncLink::discover(const QBluetoothUuid &service, int timeoutMs)
+{
+    GattOperation *operation = start(GattOperation::Discover, service, timeoutMs);
+    if(m_discovered.contains(service))
+        operation->finish(GattOperation::Succeeded);
+    else if(!m_discovering) {
+        // one walk answers every discover issued while it runs
+        m_discovering = true;
+        m_link->discoverServices();
+    }
+    return operation;
+}
+
+GattOperation *AsyncLink::open(const QBluetoothUuid &service, BLELink::DetailDiscovery mode, int timeoutMs)
+{
+    GattOperation *operation = start(GattOperation::Open, service, timeoutMs);
+    if(!m_link->openService(service, mode))
+        operation->finish(GattOperation::Failed, QStringLiteral("service cannot be opened"));
+    return operation;
+}
+
+GattOperation *AsyncLink::subscribe(const QBluetoothUuid &service, const QBluetoothUuid &characteristic,
+                                    int timeoutMs)
+{
+    GattOperation *operation = start(GattOperation::Subscribe, characteristic, timeoutMs);
+    if(!m_link->enableNotifications(service, characteristic))
+        operation->finish(GattOperation::Failed, QStringLiteral("characteristic cannot notify"));
+    return operation;
+}
+
+GattOperation *AsyncLink::read(const QBluetoothUuid &service, const QBluetoothUuid &characteristic, int timeoutMs)
+{
+    GattOperation *operation = start(GattOperation::Read, characteristic, timeoutMs);
+    if(!m_link->readCharacteristic(service, characteristic))
+        operation->finish(GattOperation::Failed, QStringLiteral("characteristic cannot be read"));
+    return operation;
+}
+
+GattOperation *AsyncLink::all(const QList<GattOperation *> &operations)
+{
+    GattOperation *group = new GattOperation(GattOperation::Group, QBluetoothUuid(), this);
+    group->m_remaining = operations.size();
+    // members that finished before the group may be gone by the time it fails
+    QList<QPointer<GattOperation> > members;
+    for(GattOperation *operation : operations)
+        members << operation;
+    group->m_abort = [members]() {
+        for(const QPointer<GattOperation> &member : members) {
+            if(nullptr!=member)
+                member->cancel();
+        }
+    };
+    if(operations.isEmpty())
+        group->finish(GattOperation::Succeeded);
+    for(GattOperation *operation : operations) {
+        const QPointer<GattOperation> guard(group);
+        operation->then([guard](GattOperation *op) {
+            GattOperation *group = guard.data();
+            if(nullptr==group || group->isFinished())
+                return;
+            if(!op->succeeded())
+                group->finish(op->status(), op->errorString());
+            else if(0 == --group->m_remaining)
+                group->finish(GattOperation::Succeeded);
+        });
+    }
+    return group;
+}
+
+void AsyncLink::cancelAll()
+{
+    const QList<GattOperation *> pending = m_pending;
+    for(GattOperation *operation : pending)
+        operation->cancel();
+}
+
+int AsyncLink::complete(GattOperation::Kind kind, const QBluetoothUuid &target, bool every,
+                        GattOperation::Status status, const QString &error, const QByteArray &value)
+{
+    QList<GattOperation *> matched;
+    for(GattOperation *operation : qAsConst(m_pending)) {
+        if(kind == operation->kind() && target == operation->target()) {
+            matched << operation;
+            if(!every)
+                break;
+        }
+    }
+    // finishing runs callbacks, which may change m_pending
+    for(GattOperation *operation : qAsConst(matched))
+        operation->finish(status, error, value);
+    return matched.size();
+}
+
+void AsyncLink::failAll(const QString &error)
+{
+    const QList<GattOperation *> pending = m_pending;
+    for(GattOperation *operation : pending)
+        operation->finish(GattOperation::Failed, error);
+}
+
+void AsyncLink::linkConnected()
+{
+    complete(GattOperation::Connect, QBluetoothUuid(), true, GattOperation::Succeeded);
+}
+
+void AsyncLink::linkDisconnected()
+{
+    m_discovered.clear();
+    m_discovering = false;
+    failAll(QStringLiteral("disconnected"));
+}
+
+void AsyncLink::serviceDiscovered(const QBluetoothUuid &service)
+{
+    m_discovered << service;
+    complete(GattOperation::Discover, service, true, GattOperation::Succeeded);
+}
+
+void AsyncLink::discoveryFinished()
+{
+    m_discovering = false;
+    QList<GattOperation *> missing;
+    for(GattOperation *operation : qAsConst(m_pending)) {
+        if(GattOperation::Discover == operation->kind())
+            missing << operation;
+    }
+    for(GattOperation *operation : qAsConst(missing))
+        operation->finish(GattOperation::Failed, QStringLiteral("service not found"));
+}
+
+void AsyncLink::serviceReady(const QBluetoothUuid &service)
+{
+    complete(GattOperation::Open, service, true, GattOperation::Succeeded);
+}
+
+void AsyncLink::notificationsEnabled(const QBluetoothUuid &characteristic, bool enabled)
+{
+    // one answer per CCCD write
+    complete(GattOperation::Subscribe, characteristic, false,
+             enabled ? GattOperation::Succeeded : GattOperation::Failed,
+             enabled ? QString() : QStringLiteral("subscription refused"));
+}
+
+void AsyncLink::characteristicRead(const QBluetoothUuid &characteristic, const QByteArray &value)
+{
+    complete(GattOperation::Read, characteristic, false, GattOperation::Succeeded, QString(), value);
+}
+
+void AsyncLink::linkError(QLowEnergyController::Error error, const QString &errorString)
+{
+    Q_UNUSED(error)
+    failAll(errorString);
+}
@@ -0,0 +1,140 @@
+#ifndef ASYNCLINK_H
+#define ASYNCLINK_H
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+
+#include "bletransport.h"
+
+/**
+ * One request in flight on an AsyncLink. It finishes exactly once, on the
+ * event loop, by success, failure, timeout or cancel; then() callbacks run
+ * in order at that point, or at once when added to a finished operation.
+ * The operation deletes itself when control returns to the event loop after
+ * finishing, so keep the pointer only until then.
+ */
+class GattOperation : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind { Connect, Discover, Open, Subscribe, Read, Group };
+    Q_ENUM(Kind)
+    enum Status { Running, Succeeded, Failed, TimedOut, Cancelled };
+    Q_ENUM(Status)
+
+    typedef std::function<void(GattOperation *)> Callback;
+
+    Kind kind() const { return m_kind; }
+    // the service for Discover and Open, the characteristic for Subscribe and Read
+    const QBluetoothUuid &target() const { return m_target; }
+    Status status() const { return m_status; }
+    bool isFinished() const { return Running != m_status; }
+    bool succeeded() const { return Succeeded == m_status; }
+    QString errorString() const { return m_error; }
+    // what a Read returned
+    const QByteArray &value() const { return m_value; }
+    // issue to finish, monotonic
+    qint64 elapsedNs() const;
+
+    GattOperation *then(const Callback &fn);
+
+public slots:
+    // finishes as Cancelled; a connect under way is aborted
+    void cancel();
+
+signals:
+    void finished(GattOperation *operation);
+
+private:
+    friend class AsyncLink;
+
+    GattOperation(Kind kind, const QBluetoothUuid &target, QObject *parent);
+    void arm(int timeoutMs);
+    void finish(Status status, const QString &error = QString(), const QByteArray &value = QByteArray());
+
+    Kind m_kind;
+    QBluetoothUuid m_target;
+    Status m_status = Running;
+    QString m_error;
+    QByteArray m_value;
+    QList<Callback> m_then;
+    QTimer m_timeout;
+    qint64 m_startedAt = 0;
+    qint64 m_finishedAt = 0;
+    std::function<void()> m_abort;
+    int m_remaining = 0;                // Group: members still running
+};
+
+/**
+ * Futures over a BLELink: every step of the connect-discover-subscribe walk
+ * is a call returning a GattOperation instead of a slot reached through the
+ * one before it, so a flow is written in order with its state in closures
+ * and any number of devices can run the same flow:
+ *
+ *     async->connectToDevice()->then([=](GattOperation *op) {
+ *         if(op->succeeded())
+ *             async->discover(service)->then(...);
+ *     });
+ *
+ * Operations that do not depend on each other may be issued together; they
+ * are matched to the link's answers by kind and UUID, and all() joins them.
+ * Discover succeeds the moment its service turns up rather than when the
+ * whole primary service walk ends. A lost link or link error fails every
+ * pending operation. The link is not owned; destroying the AsyncLink drops
+ * its pending operations without finishing them.
+ */
+class AsyncLink : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AsyncLink(BLELink *link, QObject *parent = nullptr);
+
+    BLELink *link() const { return m_link; }
+    // used when a call passes a negative timeout; 0 waits forever
+    void setDefaultTimeout(int ms) { m_defaultTimeoutMs = qMax(0, ms); }
+    int pending() const { return m_pending.size(); }
+
+    GattOperation *connectToDevice(int timeoutMs = -1);
+    GattOperation *discover(const QBluetoothUuid &service, int timeoutMs = -1);
+    GattOperation *open(const QBluetoothUuid &service, BLELink::DetailDiscovery mode, int timeoutMs = -1);
+    GattOperation *subscribe(const QBluetoothUuid &service, const QBluetoothUuid &characteristic, int timeoutMs = -1);
+    GattOperation *read(const QBluetoothUuid &service, const QBluetoothUuid &characteristic, int timeoutMs = -1);
+
+    // succeeds when every operation has, fails with the first that does not
+    // and cancels the rest; an empty list succeeds
+    GattOperation *all(const QList<GattOperation *> &operations);
+
+public slots:
+    void cancelAll();
+
+private slots:
+    void linkConnected();
+    void linkDisconnected();
+    void serviceDiscovered(const QBluetoothUuid &service);
+    void discoveryFinished();
+    void serviceReady(const QBluetoothUuid &service);
+    void notificationsEnabled(const QBluetoothUuid &characteristic, bool enabled);
+    void characteristicRead(const QBluetoothUuid &characteristic, const QByteArray &value);
+    void linkError(QLowEnergyController::Error error, const QString &errorString);
+
+private:
+    GattOperation *start(GattOperation::Kind kind, const QBluetoothUuid &target, int timeoutMs);
+    // finish the oldest pending operation of the kind and target, or every one; how many were
+    int complete(GattOperation::Kind kind, const QBluetoothUuid &target, bool every, GattOperation::Status status,
+                 const QString &error = QString(), const QByteArray &value = QByteArray());
+    void failAll(const QString &error);
+    bool isPending(GattOperation::Kind kind) const;
+
+    BLELink *m_link = nullptr;
+    QList<GattOperation *> m_pending;   // in issue order
+    QList<QBluetoothUuid> m_discovered; // this connection's services so far
+    bool m_discovering = false;
+    int m_defaultTimeoutMs = 10000;
+};
+
+#endif // ASYNCLINK_H
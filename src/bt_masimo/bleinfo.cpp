@@ -0,0 +1,80 @@
+#include "bleinfo.h"
+#include "thermometerdecoder.h"
+
+QString BLEInfo::uuidToString(const QBluetoothUuid& uuid)
+{
+    bool success = false;
+    quint16 result16 = uuid.toUInt16(&success);
+    if (success)
+        return QStringLiteral("0x") + QString::number(result16, 16);
+
+    quint32 result32 = uuid.toUInt32(&success);
+    if (success)
+        return QStringLiteral("0x") + QString::number(result32, 16);
+
+    return uuid.toString().remove(QLatin1Char('{')).remove(QLatin1Char('}'));
+}
+
+QString BLEInfo::valueToString(const QByteArray& a)
+{
+    // Show raw string first and hex value below
+    QString result;
+    if (a.isEmpty()) {
+        result = QStringLiteral("<none>");
+        return result;
+    }
+
+    result = a;
+    result += QLatin1Char('\n');
+    result += a.toHex();
+
+    return result;
+}
+
+QString BLEInfo::handleToString(const QLowEnergyHandle& h)
+{
+    return QStringLiteral("0x") + QString::number(h, 16);
+}
+
+QString BLEInfo::permissionToString(const QLowEnergyCharacteristic& c)
+{
+    QString properties = "( ";
+    uint permission = c.properties();
+    if (permission & QLowEnergyCharacteristic::Read)
+        properties += QStringLiteral(" Read");
+    if (permission & QLowEnergyCharacteristic::Write)
+        properties += QStringLiteral(" Write");
+    if (permission & QLowEnergyCharacteristic::Notify)
+        properties += QStringLiteral(" Notify");
+    if (permission & QLowEnergyCharacteristic::Indicate)
+        properties += QStringLiteral(" Indicate");
+    if (permission & QLowEnergyCharacteristic::ExtendedProperty)
+        properties += QStringLiteral(" ExtendedProperty");
+    if (permission & QLowEnergyCharacteristic::Broadcasting)
+        properties += QStringLiteral(" Broadcast");
+    if (permission & QLowEnergyCharacteristic::WriteNoResponse)
+        properties += QStringLiteral(" WriteNoResp");
+    if (permission & QLowEnergyCharacteristic::WriteSigned)
+        properties += QStringLiteral(" WriteSigned");
+    properties += " )";
+    return properties;
+}
+
+QString BLEInfo::measurementToString(const TemperatureMeasurement& m)
+{
+    if(!m.isValid())
+        return QStringLiteral("<no value>");
+
+    QString result = QString::number(m.value) + (m.isFahrenheit() ? "F" : "C");
+    if(m.hasType())
+        result += QString(" (%1)").arg(ThermometerDecoder::typeName(m.type));
+    if(m.hasTimestamp())
+        result += QString(" %1-%2-%3 %4:%5:%6")
+                  .arg(m.year)
+                  .arg(m.month, 2, 10, QLatin1Char('0'))
+                  .arg(m.day, 2, 10, QLatin1Char('0'))
+                  .arg(m.hours, 2, 10, QLatin1Char('0'))
+                  .arg(m.minutes, 2, 10, QLatin1Char('0'))
+                  .arg(m.seconds, 2, 10, QLatin1Char('0'));
+    return result;
+}
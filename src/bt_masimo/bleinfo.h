@@ -0,0 +1,20 @@
+#ifndef BLEINFO_H
+#define BLEINFO_H
+
+#include <QObject>
+#include <QtBluetooth/QLowEnergyCharacteristic>
+
+struct TemperatureMeasurement;
+
+class BLEInfo : public QObject
+{
+    Q_OBJECT
+public:
+    static QString uuidToString(const QBluetoothUuid&);
+    static QString valueToString(const QByteArray&);
+    static QString handleToString(const QLowEnergyHandle&);
+    static QString permissionToString(const QLowEnergyCharacteristic&);
+    static QString measurementToString(const TemperatureMeasurement&);
+};
+
+#endif // BLEINFO_H
@@ -0,0 +1,517 @@
+#include "blesession.h"
+#include "ingestqueue.h"
+#include "metrics.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+#include <QMetaEnum>
+#include <QRandomGenerator>
+
+namespace {
+
+// shared with the ingest worker's, the registry hands both the same counter
+MetricsCounter *decodeErrors()
+{
+    static MetricsCounter *const counter = Metrics::counter("pine_decode_errors_total",
+        "Notifications that could not be decoded");
+    return counter;
+}
+
+}
+
+BLESession::BLESession(const QBluetoothDeviceInfo &info, BLETransport *transport, QObject *parent)
+    : QObject(parent)
+    , m_info(info)
+    , m_transport(transport)
+{
+    qRegisterMetaType<TemperatureMeasurement>();
+    qRegisterMetaType<GattReading>();
+    qRegisterMetaType<BLESession::State>();
+
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, &BLESession::reconnectDue);
+    m_measurementTimer.setSingleShot(true);
+    m_measurementTimer.setInterval(5000);
+    connect(&m_measurementTimer, &QTimer::timeout, this, &BLESession::measurementIdle);
+}
+
+BLESession::~BLESession()
+{
+    delete link;
+}
+
+void BLESession::setState(State state)
+{
+    if(m_state == state)
+        return;
+    m_state = state;
+    emit stateChanged(state);
+}
+
+void BLESession::setReconnectBackoff(int baseMs, int maxMs)
+{
+    m_reconnectBaseMs = qMax(1, baseMs);
+    m_reconnectMaxMs = qMax(m_reconnectBaseMs, maxMs);
+}
+
+void BLESession::endPhase(LatencyRecorder::Phase phase)
+{
+    const qint64 now = LatencyRecorder::now();
+    if(nullptr!=m_latency && 0 < m_phaseStart)
+        m_latency->record(phase, now - m_phaseStart);
+    m_phaseStart = now;
+}
+
+void BLESession::connectToDevice()
+{
+    PROFILE_SLOT("BLESession::connectToDevice");
+    // the link is created on first use so idle sessions stay cheap
+    if(nullptr==link) {
+        link = m_transport->createLink(m_info, this);
+        if(nullptr==link) {
+            LOG_WARNING("session.no_link", "address", Log::mac(m_info.address().toUInt64()));
+            return;
+        }
+
+        connect(link, &BLELink::connected,
+                this,&BLESession::discoverServices);
+
+        connect(link, &BLELink::disconnected,
+                this,&BLESession::deviceDisconnected);
+
+        connect(link, &BLELink::serviceDiscovered,
+                this, &BLESession::serviceDiscovered);
+
+        connect(link, &BLELink::errorOccurred,
+                this, &BLESession::serviceScanError);
+
+        connect(link, &BLELink::discoveryFinished,
+                this, &BLESession::serviceDiscoveryComplete);
+
+        connect(link, &BLELink::serviceReady,
+                this, &BLESession::serviceReady);
+
+        connect(link, &BLELink::notificationsEnabled,
+                this, &BLESession::confirmedSubscription);
+
+        connect(link, &BLELink::notification,
+                this, &BLESession::notificationReceived);
+
+        connect(link, &BLELink::connectionUpdated,
+                this, &BLESession::connectionUpdated);
+    }
+    if(link->isConnected() || Connecting == m_state)
+        return;
+
+    m_reconnectTimer.stop();
+    m_userDisconnect = false;
+
+    LOG_INFO("session.connect", "address", Log::mac(m_info.address().toUInt64()),
+             "attempt", m_reconnectAttempts);
+    foundThermometer = false;
+    m_awaitingFirstReading = false;
+    m_skipValues = SubscribeOnly == m_discoveryMode
+        || (CompareDiscovery == m_discoveryMode && 0 != (m_connects & 1));
+    ++m_connects;
+    static MetricsCounter *const connects = Metrics::counter("pine_connects_total", "Connection attempts started");
+    connects->add();
+    if(nullptr!=m_latency)
+        m_latency->recordSince(LatencyRecorder::ConnectQueue, m_queuedAt);
+    m_queuedAt = 0;
+    m_connectStartedAt = m_phaseStart = LatencyRecorder::now();
+    setState(Connecting);
+    link->connectToDevice();
+}
+
+void BLESession::disconnectFromDevice()
+{
+    m_userDisconnect = true;
+    m_reconnectTimer.stop();
+    if(Reconnecting == m_state)
+        setState(Disconnected);
+    if(nullptr!=link)
+        link->disconnectFromDevice();
+}
+
+void BLESession::deviceDisconnected()
+{
+    PROFILE_SLOT("BLESession::deviceDisconnected");
+    LOG_INFO("session.disconnected", "address", Log::mac(m_info.address().toUInt64()));
+    m_measurementTimer.stop();
+    m_lowLatency = false;
+    // late signal for an attempt already given up on in serviceScanError
+    if(Reconnecting == m_state)
+        return;
+
+    // a drop is losing a link that was up; the outage runs until the next
+    // subscription, across any failed attempts in between
+    if(!m_userDisconnect && (Discovering == m_state || Subscribing == m_state || Subscribed == m_state)) {
+        static MetricsCounter *const drops = Metrics::counter("pine_link_drops_total",
+            "Links lost after connecting, not asked for");
+        drops->add();
+        ++m_drops;
+        if(0 == m_droppedAt)
+            m_droppedAt = LatencyRecorder::now();
+    }
+    setState(Disconnected);
+    scheduleReconnect();
+}
+
+void BLESession::scheduleReconnect()
+{
+    if(!m_autoReconnect || m_userDisconnect || m_reconnectTimer.isActive())
+        return;
+
+    const qint64 ceiling = qMin<qint64>(m_reconnectMaxMs, qint64(m_reconnectBaseMs) << qMin(m_reconnectAttempts, 20));
+    const int delay = int(ceiling / 2) + QRandomGenerator::global()->bounded(int(ceiling / 2) + 1);
+    ++m_reconnectAttempts;
+    LOG_INFO("session.reconnect", "address", Log::mac(m_info.address().toUInt64()),
+             "delay_ms", delay, "attempt", m_reconnectAttempts);
+    setState(Reconnecting);
+    m_reconnectTimer.start(delay);
+}
+
+void BLESession::requestLowLatency(bool lowLatency)
+{
+    if(nullptr==link || m_lowLatency == lowLatency)
+        return;
+    m_lowLatency = lowLatency;
+
+    // short intervals while readings flow, long ones with slave latency to save power in between
+    QLowEnergyConnectionParameters parameters;
+    if(lowLatency) {
+        parameters.setIntervalRange(7.5, 15.0);
+        parameters.setLatency(0);
+        parameters.setSupervisionTimeout(2000);
+    } else {
+        parameters.setIntervalRange(100.0, 200.0);
+        parameters.setLatency(4);
+        parameters.setSupervisionTimeout(6000);
+    }
+    link->requestConnectionUpdate(parameters);
+}
+
+void BLESession::connectionUpdated(const QLowEnergyConnectionParameters &parameters)
+{
+    PROFILE_SLOT("BLESession::connectionUpdated");
+    LOG_DEBUG("session.connection_parameters", "address", Log::mac(m_info.address().toUInt64()),
+              "min_interval_ms", parameters.minimumInterval(), "max_interval_ms", parameters.maximumInterval(),
+              "latency", parameters.latency(), "supervision_ms", parameters.supervisionTimeout());
+}
+
+void BLESession::measurementIdle()
+{
+    PROFILE_SLOT("BLESession::measurementIdle");
+    requestLowLatency(false);
+}
+
+void BLESession::discoverServices()
+{
+    PROFILE_SLOT("BLESession::discoverServices");
+    endPhase(LatencyRecorder::Connect);
+    m_serviceOpening = false;
+    // discovery and the first readings are latency bound
+    requestLowLatency(true);
+
+    // reconnect: subscribe straight from the cached handles when the backend
+    // allows it, every declared characteristic must be in the cache
+    QList<GattAttribute> cached;
+    m_usingCache = nullptr!=m_gattCache && !m_profile.notify.isEmpty();
+    for(int i = 0; m_usingCache && i < m_profile.notify.size(); ++i) {
+        GattAttribute attribute;
+        m_usingCache = m_gattCache->lookup(m_info.address(), m_profile.notify.at(i), &attribute);
+        cached << attribute;
+    }
+    m_pendingSubscriptions.clear();
+    for(int i = 0; m_usingCache && i < cached.size(); ++i) {
+        m_usingCache = link->enableNotifications(cached.at(i));
+        if(m_usingCache)
+            m_pendingSubscriptions << cached.at(i).characteristic;
+    }
+    if(m_usingCache) {
+        LOG_DEBUG("session.subscribe_cached", "address", Log::mac(m_info.address().toUInt64()),
+                  "characteristics", m_pendingSubscriptions.size());
+        setState(Subscribing);
+        return;
+    }
+    m_pendingSubscriptions.clear();
+
+    setState(Discovering);
+    LOG_DEBUG("session.discover", "address", Log::mac(m_info.address().toUInt64()));
+    link->discoverServices();
+}
+
+void BLESession::serviceDiscovered(const QBluetoothUuid &serviceUuid)
+{
+  PROFILE_SLOT("BLESession::serviceDiscovered");
+  if(serviceUuid == m_profile.service)
+  {
+      LOG_DEBUG("session.profile_service", "address", Log::mac(m_info.address().toUInt64()));
+      foundThermometer = true;
+
+      // the cache says this is the service we want, no need to wait for the
+      // rest of the primary service walk before opening it
+      if(nullptr!=m_gattCache && m_gattCache->isFresh(m_info.address()))
+          openProfileService();
+  }
+}
+
+void BLESession::serviceDiscoveryComplete()
+{
+  PROFILE_SLOT("BLESession::serviceDiscoveryComplete");
+  if(!foundThermometer)
+  {
+      endPhase(LatencyRecorder::ServiceDiscovery);
+      LOG_WARNING("session.no_profile_service", "address", Log::mac(m_info.address().toUInt64()),
+                  "service", m_profile.service.toString());
+      return;
+  }
+
+  if(!m_serviceOpening)
+      openProfileService();
+}
+
+void BLESession::openProfileService()
+{
+  endPhase(LatencyRecorder::ServiceDiscovery);
+  m_serviceOpening = true;
+  if (!link->openService(m_profile.service, m_skipValues ? BLELink::SkipValues : BLELink::FullDetails)) {
+      LOG_WARNING("session.open_service_failed", "address", Log::mac(m_info.address().toUInt64()),
+                  "service", m_profile.service.toString());
+      return;
+  }
+  setState(Subscribing);
+}
+
+void BLESession::serviceReady(const QBluetoothUuid &serviceUuid)
+{
+    PROFILE_SLOT("BLESession::serviceReady");
+    if(serviceUuid != m_profile.service)
+        return;
+    endPhase(m_skipValues ? LatencyRecorder::ServiceDetailsSubscribeOnly : LatencyRecorder::ServiceDetails);
+    if (nullptr!=m_gattCache && m_gattCache->store(m_info.address(), link->attributes(serviceUuid)))
+    {
+        LOG_DEBUG("session.gatt_cached", "address", Log::mac(m_info.address().toUInt64()));
+    }
+
+    // every CCCD write goes out now, the confirmations are collected as they arrive
+    m_pendingSubscriptions.clear();
+    for(const QBluetoothUuid &c : m_profile.notify)
+    {
+        if (link->enableNotifications(serviceUuid, c))
+            m_pendingSubscriptions << c;
+        else
+            LOG_WARNING("session.no_characteristic", "address", Log::mac(m_info.address().toUInt64()),
+                        "characteristic", c.toString());
+    }
+}
+
+void BLESession::confirmedSubscription(const QBluetoothUuid &characteristic, bool enabled)
+{
+    PROFILE_SLOT("BLESession::confirmedSubscription");
+    if(!m_pendingSubscriptions.contains(characteristic))
+        return;
+
+    if(!enabled && m_usingCache) {
+        // the cached handles no longer match the device, rediscover
+        LOG_INFO("session.gatt_cache_stale", "address", Log::mac(m_info.address().toUInt64()));
+        m_usingCache = false;
+        m_pendingSubscriptions.clear();
+        if(nullptr!=m_gattCache)
+            m_gattCache->invalidate(m_info.address());
+        setState(Discovering);
+        link->discoverServices();
+        return;
+    }
+
+    m_pendingSubscriptions.removeAll(characteristic);
+    if(!enabled)
+        LOG_WARNING("session.subscription_refused", "address", Log::mac(m_info.address().toUInt64()),
+                    "characteristic", characteristic.toString());
+    else if(m_pendingSubscriptions.isEmpty()) {
+        endPhase(LatencyRecorder::Subscribe);
+        m_awaitingFirstReading = true;
+        m_reconnectAttempts = 0;
+        if(0 < m_droppedAt) {
+            m_lastRecoveryNs = LatencyRecorder::now() - m_droppedAt;
+            if(nullptr!=m_latency)
+                m_latency->record(LatencyRecorder::Recovery, m_lastRecoveryNs);
+            LOG_INFO("session.recovered", "address", Log::mac(m_info.address().toUInt64()),
+                     "ms", m_lastRecoveryNs / 1000000, "drops", m_drops);
+            m_droppedAt = 0;
+        }
+        m_measurementTimer.start();
+        setState(Subscribed);
+    }
+}
+
+void BLESession::notificationReceived(const QBluetoothUuid &c, const QByteArray& a)
+{
+  PROFILE_SLOT("BLESession::notificationReceived");
+  if (a.isEmpty() || !m_profile.notify.contains(c))
+  {
+      LOG_TRACE("session.ignored_notification", "address", Log::mac(m_info.address().toUInt64()),
+                "bytes", a.size());
+      return;
+  }
+  static MetricsCounter *const notifications = Metrics::counter("pine_notifications_total",
+      "GATT notifications received on subscribed characteristics");
+  notifications->add();
+  // a measurement is in progress, keep the link fast until it goes quiet
+  requestLowLatency(true);
+  m_measurementTimer.start();
+  // the thermometer keeps its hand-written decoder and the ingest path
+  if (c == QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement))
+      receive(a);
+  else
+      decodeReading(c, a);
+}
+
+void BLESession::decodeReading(const QBluetoothUuid &c, const QByteArray& a)
+{
+  noteArrival();
+  const GattDecoder::Entry *decoder = GattDecoder::find(m_profile.service, c);
+  GattReading reading;
+  if (nullptr==decoder || !decoder->decode(a.constData(), a.size(), &reading))
+  {
+      decodeErrors()->add();
+      LOG_WARNING("reading.undecodable", "address", Log::mac(m_info.address().toUInt64()),
+                  "characteristic", c.toString(), "data", QString::fromLatin1(a.toHex()));
+      return;
+  }
+  LOG_DEBUG("reading", "address", Log::mac(m_info.address().toUInt64()), "profile", decoder->name);
+  emit readingDecoded(m_info.address().toString(), reading);
+}
+
+void BLESession::receive(const QByteArray& a)
+{
+  const qint64 now = LatencyRecorder::now();
+  noteArrival();
+
+  if(nullptr!=m_ingest)
+  {
+      // a full queue counts the overflow itself, logging here would only add to the load
+      m_ingest->push(m_info.address().toUInt64(), a, now);
+      return;
+  }
+  processMeasurement(a);
+}
+
+void BLESession::noteArrival()
+{
+  ++m_notifications;
+
+  // first notification after subscribing, taken on arrival so the queued and
+  // inline paths measure the same thing
+  if(m_awaitingFirstReading)
+  {
+      m_awaitingFirstReading = false;
+      endPhase(LatencyRecorder::FirstReading);
+      if(nullptr!=m_latency)
+      {
+          m_latency->recordSince(LatencyRecorder::ConnectToFirstReading, m_connectStartedAt);
+          m_latency->recordSince(LatencyRecorder::DiscoveryToFirstReading, m_discoveredAt);
+      }
+      // a reconnect to the same advertisement is not a new discovery
+      m_discoveredAt = 0;
+  }
+}
+
+void BLESession::processMeasurement(const QByteArray& a)
+{
+
+  /**
+   * The Temperature Measurement Value field may contain special float value NaN
+(0x007FFFFF) defined in IEEE 11073-20601 [4] to report an invalid result from a
+computation step or missing data due to the hardware’s inability to provide a valid
+measurement
+   *
+   * */
+  /**
+   * flags field: 8bit
+   * temperature field: IEEE 11073 32-bit FLOAT, sint24 mantissa + sint8 exponent
+   * datetime field:
+   * year uint16
+   * month uint8
+   * day uint8
+   * hours (past midnight) uint8
+   * minutes (since start of hour) uint8
+   * seconds (since start of minute) uint8
+   * temperature type: 8bit
+   *
+   * example: 07 d3 03 00 ff e5 07 07 08 0f 22 00 01
+   * flags: 07, hex to binary = 00000111, bit 0 = 1 => Fahrenheit, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
+   * temperature: d3 03 00 ff => mantissa 0003d3 = 979, exponent ff = -1 => 97.9 F
+   * year: e5 07 => 07 e5 => 2021
+   * month: 07 => 7 => July (0 => month is not known)
+   * day: 08 => 8
+   * hours: 0f => 15
+   * minutes: 22 => 34
+   * seconds: 00 => 0
+   * type: 01 => armpit (Temperature Type characteristic 0x2A1D)
+   *
+   *
+   * example: 07d80300ffe50707090b060001
+   * flags: 07, hex to binary = 00000111, bit 0 = 1 => Fahrenheit, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
+   * temperature: d8 03 00 ff => mantissa 0003d8 = 984, exponent ff = -1 => 98.4 F
+   * year: e5 07 => 07 e5 => 2021
+   * month: 07 => 7 => July (0 => month is not known)
+   * day: 09 => 9
+   * hours: 0b => 11
+   * minutes: 06 => 6
+   * seconds: 00 => 0
+   * type: 01 => armpit (Temperature Type characteristic 0x2A1D)
+   *
+   * example: 066b0100ffe50707090c150001
+   * flags: 06, hex to binary = 00000110, bit 0 = 0 => Celsius, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
+   * temperature: 6b 01 00 ff => mantissa 00016b = 363, exponent ff = -1 => 36.3 C
+   * year: e5 07 => 07 e5 => 2021
+   * month: 07 => 7 => July (0 => month is not known)
+   * day: 09 => 9
+   * hours: 0c => 12
+   * minutes: 15 => 21
+   * seconds: 00 => 0
+   * type: 01 => armpit (Temperature Type characteristic 0x2A1D)
+   *
+   *
+   * */
+
+   TemperatureMeasurement m;
+   if(!ThermometerDecoder::decode(a.constData(), a.size(), &m))
+   {
+       decodeErrors()->add();
+       LOG_WARNING("measurement.truncated", "address", Log::mac(m_info.address().toUInt64()),
+                   "data", QString::fromLatin1(a.toHex()));
+       return;
+   }
+   if(!m.isValid())
+   {
+       LOG_DEBUG("measurement.no_value", "address", Log::mac(m_info.address().toUInt64()),
+                 "status", int(m.status));
+       return;
+   }
+
+   LOG_DEBUG("measurement", "address", Log::mac(m_info.address().toUInt64()),
+             "value", m.value, "type", ThermometerDecoder::typeName(m.type), "status", int(m.status));
+   emit temperatureMeasured(m_info.address().toString(), m);
+}
+
+void BLESession::serviceScanError(QLowEnergyController::Error error, const QString &errorString)
+{
+    PROFILE_SLOT("BLESession::serviceScanError");
+    static const QMetaEnum errors = QLowEnergyController::staticMetaObject.enumerator(
+                QLowEnergyController::staticMetaObject.indexOfEnumerator("Error"));
+    LOG_WARNING("session.error", "address", Log::mac(m_info.address().toUInt64()),
+                "error", errors.valueToKey(error), "message", errorString);
+    // a lookup under the registry lock, errors are rare enough
+    const QByteArray label = Metrics::label("error", QLatin1String(errors.valueToKey(error)));
+    if(Connecting == m_state)
+        Metrics::counter("pine_connect_failures_total", "Connection attempts that failed, by error", label)->add();
+    else
+        Metrics::counter("pine_link_errors_total", "Errors on established links, by error", label)->add();
+
+    // a failed connect attempt never reaches disconnected, release the slot here
+    if(Connecting == m_state) {
+        setState(Disconnected);
+        scheduleReconnect();
+    }
+}
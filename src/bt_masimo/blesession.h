@@ -0,0 +1,162 @@
+#ifndef BLESESSION_H
+#define BLESESSION_H
+
+#include <QObject>
+#include <QTimer>
+
+#include "bletransport.h"
+#include "gattcache.h"
+#include "gattdecoder.h"
+#include "gattprofile.h"
+#include "latencyrecorder.h"
+#include "thermometerdecoder.h"
+
+/**
+ * One connected peripheral: its transport link, profile subscription and
+ * state. Sessions are created and scheduled by
+ * SessionManager; nothing here depends on widgets or on a real adapter.
+ */
+class IngestQueue;
+
+class BLESession : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Idle,
+        Connecting,
+        Discovering,
+        Subscribing,
+        Subscribed,
+        Disconnected,
+        Reconnecting    // waiting out the backoff before the next attempt
+    };
+    Q_ENUM(State)
+
+    // how much of the profile's service is walked after connect
+    enum DiscoveryMode {
+        FullDiscovery,      // read every characteristic and descriptor value
+        SubscribeOnly,      // declarations only, then write the CCCDs
+        CompareDiscovery    // alternate the two per connect to measure the difference
+    };
+    Q_ENUM(DiscoveryMode)
+
+    BLESession(const QBluetoothDeviceInfo &info, BLETransport *transport, QObject *parent = nullptr);
+    ~BLESession();
+
+    const QBluetoothDeviceInfo &deviceInfo() const { return m_info; }
+    QBluetoothAddress address() const { return m_info.address(); }
+    State state() const { return m_state; }
+    quint64 notificationCount() const { return m_notifications; }
+    // links lost after connecting, and how long the last one took to resubscribe
+    quint32 dropCount() const { return m_drops; }
+    qint64 lastRecoveryNs() const { return m_lastRecoveryNs; }
+
+    // account for one Temperature Measurement notification and hand it to
+    // the ingest queue, or decode it here when there is none
+    void receive(const QByteArray& a);
+    // decode one Temperature Measurement notification and publish it
+    void processMeasurement(const QByteArray& a);
+
+    // phase spans go to this recorder, none are taken while it is null
+    void setLatencyRecorder(LatencyRecorder *latency) { m_latency = latency; }
+    // handles are cached here after discovery and reused on reconnect
+    void setGattCache(GattCache *cache) { m_gattCache = cache; }
+    // decoding moves to the queue's worker thread, which publishes the readings
+    void setIngestQueue(IngestQueue *queue) { m_ingest = queue; }
+    // monotonic times (LatencyRecorder::now) the advertisement was seen and the connect was queued
+    void markDiscovered(qint64 at) { m_discoveredAt = at; }
+    void markQueued(qint64 at) { m_queuedAt = at; }
+
+    // service and characteristics to subscribe to, the Health Thermometer by default
+    void setProfile(const GattProfile &profile) { m_profile = profile; }
+    const GattProfile &profile() const { return m_profile; }
+    void setDiscoveryMode(DiscoveryMode mode) { m_discoveryMode = mode; }
+    DiscoveryMode discoveryMode() const { return m_discoveryMode; }
+
+    // reconnect after drops and failed connects, waiting a random time between
+    // half and all of min(maxMs, baseMs * 2^attempt)
+    void setAutoReconnect(bool enabled) { m_autoReconnect = enabled; }
+    void setReconnectBackoff(int baseMs, int maxMs);
+    bool autoReconnect() const { return m_autoReconnect; }
+    // low-latency connection parameters are dropped this long after the last notification
+    void setMeasurementIdleTimeout(int ms) { m_measurementTimer.setInterval(ms); }
+
+public slots:
+    void connectToDevice();
+    void disconnectFromDevice();
+
+signals:
+    void stateChanged(BLESession::State state);
+    // the backoff has elapsed, SessionManager queues the connect
+    void reconnectDue();
+    void temperatureMeasured(const QString &address, const TemperatureMeasurement &m);
+    // any other characteristic of the profile that GattDecoder knows
+    void readingDecoded(const QString &address, const GattReading &reading);
+
+private slots:
+    void serviceDiscovered(const QBluetoothUuid &service);
+    void serviceDiscoveryComplete();
+    void serviceScanError(QLowEnergyController::Error error, const QString &errorString);
+    void deviceDisconnected();
+    void discoverServices();
+    void serviceReady(const QBluetoothUuid &service);
+    void confirmedSubscription(const QBluetoothUuid &characteristic, bool enabled);
+
+    void notificationReceived(const QBluetoothUuid &c, const QByteArray& a);
+    void connectionUpdated(const QLowEnergyConnectionParameters &parameters);
+    void measurementIdle();
+
+private:
+    void setState(State state);
+    // record the span since the previous phase ended and start the next one
+    void endPhase(LatencyRecorder::Phase phase);
+    void openProfileService();
+    void scheduleReconnect();
+    void requestLowLatency(bool lowLatency);
+    // count the notification and close the first-reading phase on the first one
+    void noteArrival();
+    void decodeReading(const QBluetoothUuid &c, const QByteArray& a);
+
+    QBluetoothDeviceInfo m_info;
+    BLETransport *m_transport = nullptr;
+    BLELink *link = nullptr;
+
+    LatencyRecorder *m_latency = nullptr;
+    GattCache *m_gattCache = nullptr;
+    IngestQueue *m_ingest = nullptr;
+    GattProfile m_profile = GattProfile::healthThermometer();
+    DiscoveryMode m_discoveryMode = FullDiscovery;
+    bool m_skipValues = false;
+    quint64 m_connects = 0;
+    QList<QBluetoothUuid> m_pendingSubscriptions;
+    bool m_usingCache = false;
+    bool m_serviceOpening = false;
+    qint64 m_discoveredAt = 0;
+    qint64 m_queuedAt = 0;
+    qint64 m_connectStartedAt = 0;
+    qint64 m_phaseStart = 0;
+    bool m_awaitingFirstReading = false;
+
+    QTimer m_reconnectTimer;
+    QTimer m_measurementTimer;
+    bool m_autoReconnect = false;
+    bool m_userDisconnect = false;
+    bool m_lowLatency = false;
+    int m_reconnectBaseMs = 500;
+    int m_reconnectMaxMs = 30000;
+    int m_reconnectAttempts = 0;
+    qint64 m_droppedAt = 0;
+    qint64 m_lastRecoveryNs = 0;
+    quint32 m_drops = 0;
+
+    State m_state = Idle;
+    quint64 m_notifications = 0;
+    bool foundThermometer = false;
+};
+
+Q_DECLARE_METATYPE(TemperatureMeasurement)
+Q_DECLARE_METATYPE(GattReading)
+
+#endif // BLESESSION_H
@@ -0,0 +1,56 @@
+#include "bletransport.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
+#include "slotprofiler.h"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<int> liveLinks {0};
+
+}
+
+BLELink::BLELink(QObject *parent)
+    : QObject(parent)
+{
+    liveLinks.fetch_add(1, std::memory_order_relaxed);
+}
+
+BLELink::~BLELink()
+{
+    liveLinks.fetch_sub(1, std::memory_order_relaxed);
+}
+
+int BLELink::liveCount()
+{
+    return liveLinks.load(std::memory_order_relaxed);
+}
+
+void BLETransport::advertisementReceived(const QBluetoothDeviceInfo &info)
+{
+    PROFILE_SLOT("BLETransport::advertisementReceived");
+    if(nullptr!=m_forward) {
+        m_forward->advertisementReceived(info);
+        return;
+    }
+    static MetricsCounter *const seen = Metrics::counter("pine_advertisements_total",
+        "Advertisements received from every adapter");
+    static MetricsCounter *const filtered = Metrics::counter("pine_advertisements_filtered_total",
+        "Advertisements dropped by the scan filter");
+    ++m_advertisementsSeen;
+    seen->add();
+    if(!m_scanFilter.accepts(info)) {
+        ++m_advertisementsFiltered;
+        filtered->add();
+        return;
+    }
+    const qint64 now = LatencyRecorder::now();
+    // a sweep per tenth of the lifetime keeps the cost off the common advertisement
+    if(now - m_expiredAt > m_deviceTtlNs / 10) {
+        m_deviceIndex.expire(now - m_deviceTtlNs);
+        m_expiredAt = now;
+    }
+    if(m_deviceIndex.update(info, now))
+        emit deviceDiscovered(info);
+}
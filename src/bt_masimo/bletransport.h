@@ -0,0 +1,152 @@
+#ifndef BLETRANSPORT_H
+#define BLETRANSPORT_H
+
+#include <QObject>
+#include <QtBluetooth/QBluetoothDeviceDiscoveryAgent>
+#include <QtBluetooth/QBluetoothDeviceInfo>
+#include <QtBluetooth/QLowEnergyConnectionParameters>
+#include <QtBluetooth/QLowEnergyController>
+
+#include "deviceindex.h"
+#include "scanfilter.h"
+
+// handles of one characteristic as found by service discovery
+struct GattAttribute
+{
+    QBluetoothUuid service;
+    QBluetoothUuid characteristic;
+    QLowEnergyHandle valueHandle = 0;
+    QLowEnergyHandle cccdHandle = 0;   // 0 when the characteristic has no CCCD
+};
+
+/**
+ * Connection to one peripheral, the steps BLESession walks through:
+ * connect, discover services, open a service, enable notifications.
+ * Every request answers asynchronously through the signals below.
+ */
+class BLELink : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum DetailDiscovery {
+        FullDetails,    // characteristics, descriptors and every readable value
+        SkipValues      // handles only, values are not read
+    };
+
+    explicit BLELink(QObject *parent = nullptr);
+    ~BLELink();
+
+    // links not yet destroyed, every backend; stays flat across reconnects
+    static int liveCount();
+
+    virtual void connectToDevice() = 0;
+    virtual void disconnectFromDevice() = 0;
+    virtual bool isConnected() const = 0;
+
+    virtual void discoverServices() = 0;
+    // discover the characteristics of a discovered service, answers with serviceReady
+    virtual bool openService(const QBluetoothUuid &service, DetailDiscovery mode) = 0;
+    // write the CCCD of an open service's characteristic, answers with notificationsEnabled
+    virtual bool enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) = 0;
+
+    // read a characteristic of an open service, answers with characteristicRead;
+    // false when the service is not open or the backend cannot read
+    virtual bool readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+    { Q_UNUSED(service) Q_UNUSED(characteristic) return false; }
+
+    // characteristics and handles of an open service, for the GATT cache
+    virtual QList<GattAttribute> attributes(const QBluetoothUuid &service) const = 0;
+    // write the CCCD from cached handles with no discovery at all, answers with
+    // notificationsEnabled; false when the backend cannot address attributes by handle
+    virtual bool enableNotifications(const GattAttribute &cached) { Q_UNUSED(cached) return false; }
+
+    // ask the peripheral for new connection interval/latency/timeout, answers
+    // with connectionUpdated if the peripheral accepts; ignored by backends that cannot
+    virtual void requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters) { Q_UNUSED(parameters) }
+
+signals:
+    void connected();
+    void disconnected();
+    void serviceDiscovered(const QBluetoothUuid &service);
+    void discoveryFinished();
+    void serviceReady(const QBluetoothUuid &service);
+    void notificationsEnabled(const QBluetoothUuid &characteristic, bool enabled);
+    void characteristicRead(const QBluetoothUuid &characteristic, const QByteArray &value);
+    void connectionUpdated(const QLowEnergyConnectionParameters &parameters);
+    void notification(const QBluetoothUuid &characteristic, const QByteArray &value);
+    void errorOccurred(QLowEnergyController::Error error, const QString &errorString);
+};
+
+/**
+ * Source of peripherals: scanning plus link creation. NativeTransport wraps
+ * Qt Bluetooth, SimTransport replays recorded notifications in process.
+ */
+class BLETransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BLETransport(QObject *parent = nullptr) : QObject(parent) {}
+
+    // select a local adapter, a null address picks the first one found
+    virtual bool open(const QBluetoothAddress &adapter) = 0;
+    virtual QBluetoothAddress adapterAddress() const = 0;
+    virtual QString adapterName() const = 0;
+
+    // the local adapters open() would list for itself, without touching this
+    // object's state so it can run on another thread before open(); empty
+    // when the transport does not choose among adapters
+    virtual QList<QBluetoothAddress> probeAdapters() const { return QList<QBluetoothAddress>(); }
+    // hand open() what probeAdapters() returned so it does not list them again
+    virtual void setProbedAdapters(const QList<QBluetoothAddress> &adapters) { Q_UNUSED(adapters) }
+
+    virtual void startScan() = 0;
+    virtual void stopScan() = 0;
+    virtual bool isScanning() const = 0;
+
+    // advertisements failing the filter are dropped before deviceDiscovered,
+    // which fires once per address for as long as the index remembers it
+    void setScanFilter(const ScanFilter &filter) { m_scanFilter = filter; }
+    const ScanFilter &scanFilter() const { return m_scanFilter; }
+    const DeviceIndex &deviceIndex() const { return m_deviceIndex; }
+    void clearDeviceIndex() { m_deviceIndex.clear(); }
+    // devices not heard from for this long leave the index, so passers-by with
+    // rotating private addresses do not grow it for as long as scanning runs
+    void setDeviceTtl(int ms) { m_deviceTtlNs = qint64(qMax(1, ms)) * 1000000LL; }
+    quint64 advertisementsSeen() const { return m_advertisementsSeen; }
+    quint64 advertisementsFiltered() const { return m_advertisementsFiltered; }
+
+    virtual BLELink *createLink(const QBluetoothDeviceInfo &info, QObject *parent) = 0;
+
+    // simulated peripherals and adapters are never persisted to settings
+    virtual bool isSimulated() const { return false; }
+
+    // false while the adapter is powered off or gone; its links are lost
+    virtual bool isPowered() const { return true; }
+
+    // hand every advertisement to another transport, unfiltered, instead of
+    // this one's filter and index; AdapterPool collects its members' this way
+    void forwardAdvertisements(BLETransport *to) { m_forward = to; }
+
+signals:
+    void deviceDiscovered(const QBluetoothDeviceInfo &info);
+    void poweredChanged(bool powered);
+    void scanFinished();
+    void scanError(QBluetoothDeviceDiscoveryAgent::Error error, const QString &errorString);
+
+protected:
+    // backends hand every advertisement here instead of emitting deviceDiscovered
+    void advertisementReceived(const QBluetoothDeviceInfo &info);
+
+private:
+    BLETransport *m_forward = nullptr;
+    ScanFilter m_scanFilter;
+    DeviceIndex m_deviceIndex;
+    qint64 m_deviceTtlNs = 600000000000LL;     // ten minutes
+    qint64 m_expiredAt = 0;
+    quint64 m_advertisementsSeen = 0;
+    quint64 m_advertisementsFiltered = 0;
+};
+
+#endif // BLETRANSPORT_H
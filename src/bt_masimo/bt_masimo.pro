@@ -8,12 +8,16 @@ CONFIG += c++11
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    trendchart.cpp
 
 HEADERS += \
-    mainwindow.h
+    mainwindow.h \
+    trendchart.h
 
 FORMS += \
     mainwindow.ui
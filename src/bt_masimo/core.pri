@@ -0,0 +1,73 @@
+# non-GUI sources shared by the application and the benchmark/test targets
+QT += bluetooth concurrent network
+
+INCLUDEPATH += $$PWD
+
+# shm_open lives in librt before glibc 2.34
+linux: LIBS += -lrt
+
+SOURCES += \
+    $$PWD/adapterpool.cpp \
+    $$PWD/asynclink.cpp \
+    $$PWD/bleinfo.cpp \
+    $$PWD/blesession.cpp \
+    $$PWD/bletransport.cpp \
+    $$PWD/deviceindex.cpp \
+    $$PWD/gattcache.cpp \
+    $$PWD/gattdecoder.cpp \
+    $$PWD/ingestqueue.cpp \
+    $$PWD/latencyhistogram.cpp \
+    $$PWD/latencyrecorder.cpp \
+    $$PWD/livefeed.cpp \
+    $$PWD/measurementjournal.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/nativetransport.cpp \
+    $$PWD/pineuploader.cpp \
+    $$PWD/readingmodel.cpp \
+    $$PWD/readingwriter.cpp \
+    $$PWD/replayfilter.cpp \
+    $$PWD/scanfilter.cpp \
+    $$PWD/scanscheduler.cpp \
+    $$PWD/sessionmanager.cpp \
+    $$PWD/signalquality.cpp \
+    $$PWD/simtransport.cpp \
+    $$PWD/slotprofiler.cpp \
+    $$PWD/stallwatchdog.cpp \
+    $$PWD/startupprofile.cpp \
+    $$PWD/structlog.cpp \
+    $$PWD/thermometerdecoder.cpp \
+    $$PWD/uploadqueue.cpp
+
+HEADERS += \
+    $$PWD/adapterpool.h \
+    $$PWD/asynclink.h \
+    $$PWD/bleinfo.h \
+    $$PWD/blesession.h \
+    $$PWD/bletransport.h \
+    $$PWD/deviceindex.h \
+    $$PWD/gattcache.h \
+    $$PWD/gattdecoder.h \
+    $$PWD/gattprofile.h \
+    $$PWD/ingestqueue.h \
+    $$PWD/latencyhistogram.h \
+    $$PWD/latencyrecorder.h \
+    $$PWD/livefeed.h \
+    $$PWD/measurementjournal.h \
+    $$PWD/metrics.h \
+    $$PWD/nativetransport.h \
+    $$PWD/pineuploader.h \
+    $$PWD/readingmodel.h \
+    $$PWD/readingwriter.h \
+    $$PWD/replayfilter.h \
+    $$PWD/scanfilter.h \
+    $$PWD/scanscheduler.h \
+    $$PWD/sessionmanager.h \
+    $$PWD/signalquality.h \
+    $$PWD/simtransport.h \
+    $$PWD/slotprofiler.h \
+    $$PWD/spscring.h \
+    $$PWD/stallwatchdog.h \
+    $$PWD/startupprofile.h \
+    $$PWD/structlog.h \
+    $$PWD/thermometerdecoder.h \
+    $$PWD/uploadqueue.h
@@ -0,0 +1,49 @@
+#include "deviceindex.h"
+
+bool DeviceIndex::update(const QBluetoothDeviceInfo &info, qint64 now)
+{
+    ++m_advertisements;
+    const quint64 key = info.address().toUInt64();
+    QHash<quint64, Entry>::iterator it = m_entries.find(key);
+    if(it != m_entries.end()) {
+        it->lastSeen = now;
+        ++it->advertisements;
+        if(0 != info.rssi())
+            it->rssi = info.rssi();
+        return false;
+    }
+
+    Entry entry;
+    entry.info = info;
+    entry.firstSeen = entry.lastSeen = now;
+    entry.advertisements = 1;
+    entry.rssi = info.rssi();
+    m_entries.insert(key, entry);
+    return true;
+}
+
+const DeviceIndex::Entry *DeviceIndex::find(const QBluetoothAddress &address) const
+{
+    QHash<quint64, Entry>::const_iterator it = m_entries.constFind(address.toUInt64());
+    return it == m_entries.constEnd() ? nullptr : &it.value();
+}
+
+int DeviceIndex::expire(qint64 olderThan)
+{
+    int removed = 0;
+    for(QHash<quint64, Entry>::iterator it = m_entries.begin(); it != m_entries.end();) {
+        if(it->lastSeen < olderThan) {
+            it = m_entries.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void DeviceIndex::clear()
+{
+    m_entries.clear();
+    m_advertisements = 0;
+}
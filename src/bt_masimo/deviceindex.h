@@ -0,0 +1,40 @@
+#ifndef DEVICEINDEX_H
+#define DEVICEINDEX_H
+
+#include <QHash>
+#include <QtBluetooth/QBluetoothDeviceInfo>
+
+/**
+ * Devices seen during scanning, keyed on the 48-bit address so repeated
+ * advertisements cost one integer hash lookup instead of string compares
+ * and list copies.
+ */
+class DeviceIndex
+{
+public:
+    struct Entry {
+        QBluetoothDeviceInfo info;
+        qint64 firstSeen = 0;     // LatencyRecorder::now() of the first advertisement
+        qint64 lastSeen = 0;
+        quint32 advertisements = 0;
+        qint16 rssi = 0;          // latest reading
+    };
+
+    // record an advertisement, true on the first sight of the address
+    bool update(const QBluetoothDeviceInfo &info, qint64 now);
+
+    const Entry *find(const QBluetoothAddress &address) const;
+    bool contains(const QBluetoothAddress &address) const { return m_entries.contains(address.toUInt64()); }
+    int size() const { return m_entries.size(); }
+    quint64 advertisements() const { return m_advertisements; }
+
+    // drop devices not heard from since the given time
+    int expire(qint64 olderThan);
+    void clear();
+
+private:
+    QHash<quint64, Entry> m_entries;
+    quint64 m_advertisements = 0;
+};
+
+#endif // DEVICEINDEX_H
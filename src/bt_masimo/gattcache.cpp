@@ -0,0 +1,128 @@
+#include "gattcache.h"
+#include "structlog.h"
+
+#include <QSettings>
+
+namespace {
+
+// settings group name for an address, QSettings keys cannot contain ':'
+QString groupName(quint64 address)
+{
+    return QString("%1").arg(address, 12, 16, QLatin1Char('0'));
+}
+
+bool sameHandles(const GattAttribute &a, const GattAttribute &b)
+{
+    return a.valueHandle == b.valueHandle && a.cccdHandle == b.cccdHandle;
+}
+
+}
+
+bool GattCache::isFresh(const QBluetoothAddress &address) const
+{
+    auto it = m_entries.constFind(address.toUInt64());
+    if(it == m_entries.constEnd() || it->attributes.isEmpty())
+        return false;
+    return it->updated.secsTo(QDateTime::currentDateTimeUtc()) < m_maxAgeSeconds;
+}
+
+bool GattCache::lookup(const QBluetoothAddress &address, const QBluetoothUuid &characteristic, GattAttribute *attribute) const
+{
+    if(!isFresh(address))
+        return false;
+
+    for(const GattAttribute &a : m_entries.value(address.toUInt64()).attributes) {
+        if(a.characteristic == characteristic && 0 != a.cccdHandle) {
+            *attribute = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GattCache::store(const QBluetoothAddress &address, const QList<GattAttribute> &attributes)
+{
+    if(attributes.isEmpty())
+        return false;
+
+    Entry &entry = m_entries[address.toUInt64()];
+    const QBluetoothUuid service = attributes.first().service;
+
+    QList<GattAttribute> kept;
+    QList<GattAttribute> previous;
+    for(const GattAttribute &old : qAsConst(entry.attributes))
+        (old.service == service ? previous : kept) << old;
+
+    bool changed = previous.size() != attributes.size();
+    for(const GattAttribute &a : attributes) {
+        bool match = false;
+        for(const GattAttribute &old : qAsConst(previous))
+            match |= old.characteristic == a.characteristic && sameHandles(old, a);
+        changed |= !match;
+    }
+
+    entry.attributes = kept + attributes;
+    entry.updated = QDateTime::currentDateTimeUtc();
+    return changed;
+}
+
+void GattCache::invalidate(const QBluetoothAddress &address)
+{
+    m_entries.remove(address.toUInt64());
+}
+
+void GattCache::read(QSettings &settings)
+{
+    m_entries.clear();
+    settings.beginGroup("gatt");
+    for(const QString &group : settings.childGroups()) {
+        bool ok = false;
+        const quint64 address = group.toULongLong(&ok, 16);
+        if(!ok)
+            continue;
+
+        settings.beginGroup(group);
+        Entry entry;
+        entry.updated = settings.value("updated").toDateTime();
+        int size = settings.beginReadArray("attributes");
+        for(int i = 0; i < size; ++i) {
+            settings.setArrayIndex(i);
+            GattAttribute a;
+            a.service = QBluetoothUuid(settings.value("service").toString());
+            a.characteristic = QBluetoothUuid(settings.value("characteristic").toString());
+            a.valueHandle = QLowEnergyHandle(settings.value("handle").toUInt());
+            a.cccdHandle = QLowEnergyHandle(settings.value("cccd").toUInt());
+            entry.attributes << a;
+        }
+        settings.endArray();
+        settings.endGroup();
+
+        if(entry.updated.isValid() && !entry.attributes.isEmpty())
+            m_entries.insert(address, entry);
+    }
+    settings.endGroup();
+    if(!m_entries.isEmpty())
+        LOG_INFO("gatt_cache.read", "peripherals", m_entries.size());
+}
+
+void GattCache::write(QSettings &settings) const
+{
+    settings.remove("gatt");
+    settings.beginGroup("gatt");
+    for(auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        settings.beginGroup(groupName(it.key()));
+        settings.setValue("updated", it->updated);
+        settings.beginWriteArray("attributes", it->attributes.size());
+        for(int i = 0; i < it->attributes.size(); ++i) {
+            const GattAttribute &a = it->attributes.at(i);
+            settings.setArrayIndex(i);
+            settings.setValue("service", a.service.toString());
+            settings.setValue("characteristic", a.characteristic.toString());
+            settings.setValue("handle", a.valueHandle);
+            settings.setValue("cccd", a.cccdHandle);
+        }
+        settings.endArray();
+        settings.endGroup();
+    }
+    settings.endGroup();
+}
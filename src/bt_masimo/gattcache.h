@@ -0,0 +1,44 @@
+#ifndef GATTCACHE_H
+#define GATTCACHE_H
+
+#include "bletransport.h"
+
+#include <QDateTime>
+#include <QHash>
+
+QT_FORWARD_DECLARE_CLASS(QSettings)
+
+/**
+ * Service/characteristic/descriptor handles per peripheral address, kept in
+ * the settings file next to the peripheral entries. A fresh entry lets a
+ * reconnect subscribe without walking the whole GATT database; an entry is
+ * stale once it passes the maximum age or a cached subscribe fails.
+ */
+class GattCache
+{
+public:
+    struct Entry
+    {
+        QDateTime updated;
+        QList<GattAttribute> attributes;
+    };
+
+    void setMaxAge(qint64 seconds) { m_maxAgeSeconds = seconds; }
+
+    // cached attribute for a characteristic, false when missing or stale
+    bool lookup(const QBluetoothAddress &address, const QBluetoothUuid &characteristic, GattAttribute *attribute) const;
+    bool isFresh(const QBluetoothAddress &address) const;
+
+    // replace the attributes of one service, true when the handles changed
+    bool store(const QBluetoothAddress &address, const QList<GattAttribute> &attributes);
+    void invalidate(const QBluetoothAddress &address);
+
+    void read(QSettings &settings);
+    void write(QSettings &settings) const;
+
+private:
+    QHash<quint64, Entry> m_entries;
+    qint64 m_maxAgeSeconds = 30 * 24 * 3600;
+};
+
+#endif // GATTCACHE_H
@@ -0,0 +1,150 @@
+#include "gattdecoder.h"
+
+using namespace GattLayout;
+
+namespace {
+
+// every exponent a 4 bit SFLOAT can carry
+const double kPow10[] = {
+    1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1,
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7
+};
+
+// Health Thermometer Temperature Measurement and Intermediate Temperature
+template <quint16 Characteristic>
+bool decodeTemperature(const char *data, int size, GattReading *r)
+{
+    return GattLayout::decode<0x1809, Characteristic,
+            Flags8, Float<0>, DateTime<0x02>, Unsigned<0, 1, 0x04>>(data, size, r);
+}
+
+// PLX Spot-Check Measurement
+bool decodeSpotCheck(const char *data, int size, GattReading *r)
+{
+    return GattLayout::decode<0x1822, 0x2A5E,
+            Flags8, SFloat<0>, SFloat<1>,
+            DateTime<0x01>,                 // timestamp
+            Unsigned<0, 2, 0x02>,           // measurement status
+            Unsigned<1, 3, 0x04>,           // device and sensor status
+            SFloat<2, 0x08>>(data, size, r);  // pulse amplitude index
+}
+
+// PLX Continuous Measurement
+bool decodeContinuous(const char *data, int size, GattReading *r)
+{
+    return GattLayout::decode<0x1822, 0x2A5F,
+            Flags8, SFloat<0>, SFloat<1>,
+            SFloat<2, 0x01>, SFloat<3, 0x01>,   // SpO2PR-Fast
+            SFloat<4, 0x02>, SFloat<5, 0x02>,   // SpO2PR-Slow
+            Unsigned<0, 2, 0x04>,               // measurement status
+            Unsigned<1, 3, 0x08>,               // device and sensor status
+            SFloat<6, 0x10>>(data, size, r);    // pulse amplitude index
+}
+
+// Blood Pressure Measurement and Intermediate Cuff Pressure
+template <quint16 Characteristic>
+bool decodeBloodPressure(const char *data, int size, GattReading *r)
+{
+    return GattLayout::decode<0x1810, Characteristic,
+            Flags8, SFloat<0>, SFloat<1>, SFloat<2>,
+            DateTime<0x02>,
+            SFloat<3, 0x04>,                // pulse rate
+            Unsigned<0, 1, 0x08>,           // user id
+            Unsigned<1, 2, 0x10>>(data, size, r);  // measurement status
+}
+
+const GattDecoder::Entry kEntries[] = {
+    {0x1809, 0x2A1C, "temperature", decodeTemperature<0x2A1C>,
+     {"temperature"}, {"type"}},
+    {0x1809, 0x2A1E, "intermediate_temperature", decodeTemperature<0x2A1E>,
+     {"temperature"}, {"type"}},
+    {0x1822, 0x2A5E, "plx_spot_check", decodeSpotCheck,
+     {"spo2", "pulse_rate", "pulse_amplitude"}, {"measurement_status", "sensor_status"}},
+    {0x1822, 0x2A5F, "plx_continuous", decodeContinuous,
+     {"spo2", "pulse_rate", "spo2_fast", "pulse_rate_fast", "spo2_slow", "pulse_rate_slow", "pulse_amplitude"},
+     {"measurement_status", "sensor_status"}},
+    {0x1810, 0x2A35, "blood_pressure", decodeBloodPressure<0x2A35>,
+     {"systolic", "diastolic", "mean_arterial", "pulse_rate"}, {"user", "measurement_status"}},
+    {0x1810, 0x2A36, "cuff_pressure", decodeBloodPressure<0x2A36>,
+     {"cuff", "diastolic", "mean_arterial", "pulse_rate"}, {"user", "measurement_status"}}
+};
+
+const int kEntryCount = int(sizeof(kEntries) / sizeof(kEntries[0]));
+
+}
+
+quint8 GattLayout::decodeSFloat(const uchar *p, double *value)
+{
+    const quint16 raw = quint16(p[0] | (p[1] << 8));
+    *value = 0.0;
+
+    // special values are only defined with a zero exponent
+    switch(raw) {
+    case 0x07FF: return TemperatureMeasurement::NaN;
+    case 0x0800: return TemperatureMeasurement::NRes;
+    case 0x07FE: return TemperatureMeasurement::PositiveInfinity;
+    case 0x0802: return TemperatureMeasurement::NegativeInfinity;
+    case 0x0801: return TemperatureMeasurement::Reserved;
+    default: break;
+    }
+
+    // sign extend the 12 bit mantissa and the 4 bit exponent
+    const int mantissa = (raw & 0x0800) ? int(raw & 0x0FFF) - 0x1000 : int(raw & 0x0FFF);
+    const int exponent = (raw & 0x8000) ? int(raw >> 12) - 16 : int(raw >> 12);
+    *value = mantissa * kPow10[exponent + 8];
+    return TemperatureMeasurement::Valid;
+}
+
+const GattDecoder::Entry *GattDecoder::find(quint16 service, quint16 characteristic)
+{
+    for(int i = 0; i < kEntryCount; ++i) {
+        if(kEntries[i].characteristic == characteristic && kEntries[i].service == service)
+            return &kEntries[i];
+    }
+    return nullptr;
+}
+
+const GattDecoder::Entry *GattDecoder::find(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+{
+    bool serviceOk = false;
+    bool characteristicOk = false;
+    const quint16 s = service.toUInt16(&serviceOk);
+    const quint16 c = characteristic.toUInt16(&characteristicOk);
+    if(!serviceOk || !characteristicOk)
+        return nullptr;
+    return find(s, c);
+}
+
+int GattDecoder::count()
+{
+    return kEntryCount;
+}
+
+const GattDecoder::Entry &GattDecoder::entry(int index)
+{
+    return kEntries[index];
+}
+
+QString GattDecoder::toString(const Entry &entry, const GattReading &r)
+{
+    QString result = QLatin1String(entry.name);
+    for(int i = 0; i < GattReading::kMaxValues; ++i) {
+        if(!r.has(i) || nullptr == entry.values[i])
+            continue;
+        result += QString(" %1=").arg(QLatin1String(entry.values[i]));
+        result += r.isValid(i) ? QString::number(r.values[i]) : QStringLiteral("<no value>");
+    }
+    for(int i = 0; i < GattReading::kMaxCodes; ++i) {
+        if(r.hasCode(i) && nullptr != entry.codes[i])
+            result += QString(" %1=0x%2").arg(QLatin1String(entry.codes[i])).arg(r.codes[i], 0, 16);
+    }
+    if(r.hasTimestamp())
+        result += QString(" %1-%2-%3 %4:%5:%6")
+                  .arg(r.year)
+                  .arg(r.month, 2, 10, QLatin1Char('0'))
+                  .arg(r.day, 2, 10, QLatin1Char('0'))
+                  .arg(r.hours, 2, 10, QLatin1Char('0'))
+                  .arg(r.minutes, 2, 10, QLatin1Char('0'))
+                  .arg(r.seconds, 2, 10, QLatin1Char('0'));
+    return result;
+}
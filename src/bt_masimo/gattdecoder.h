@@ -0,0 +1,232 @@
+#ifndef GATTDECODER_H
+#define GATTDECODER_H
+
+#include <QString>
+#include <QtBluetooth/QBluetoothUuid>
+
+#include <cstring>
+
+#include "thermometerdecoder.h"
+
+/**
+ * One decoded measurement of any registered profile, plain data like
+ * TemperatureMeasurement. Numeric fields land in value slots and integer
+ * fields (status words, user id, type) in code slots; what each slot means
+ * is named by the decoder's registry entry.
+ */
+struct GattReading
+{
+    static const int kMaxValues = 8;
+    static const int kMaxCodes = 3;
+
+    quint16 service;                 // 16 bit SIG UUIDs, the registry key
+    quint16 characteristic;
+    quint16 flags;
+    quint8 present;                  // bit per value slot
+    quint8 codesPresent;             // bit per code slot
+    quint8 status[kMaxValues];       // TemperatureMeasurement::Status per value slot
+    double values[kMaxValues];
+    quint32 codes[kMaxCodes];
+
+    quint16 year;                    // timestamp fields are 0 when absent
+    quint8  month;
+    quint8  day;
+    quint8  hours;
+    quint8  minutes;
+    quint8  seconds;
+
+    bool has(int slot) const { return present & (1u << slot); }
+    bool hasCode(int slot) const { return codesPresent & (1u << slot); }
+    bool isValid(int slot) const { return has(slot) && TemperatureMeasurement::Valid == status[slot]; }
+    bool hasTimestamp() const { return 0 != year; }
+};
+
+/**
+ * Profile layouts declared as a list of field types, e.g.
+ *
+ *     GattLayout::decode<0x1810, 0x2A35, Flags8, SFloat<0>, SFloat<1>, SFloat<2>, DateTime<0x02>>
+ *
+ * Fields are read in order. Mask is the flags bit that makes a field present,
+ * 0 for a mandatory one; mandatory fields come first and are bounds checked
+ * once, as a block, so decoding them takes no branches at all.
+ */
+namespace GattLayout {
+
+// IEEE 11073-20601 16-bit SFLOAT: sint12 mantissa, sint4 exponent
+quint8 decodeSFloat(const uchar *p, double *value);
+
+struct Flags8
+{
+    static const int kSize = 1;
+    static const quint16 kMask = 0;
+    static bool read(const uchar *&p, const uchar *, GattReading *r)
+    {
+        r->flags = *p++;
+        return true;
+    }
+};
+
+template <quint16 Mask>
+inline bool skip(const uchar *p, const uchar *end, int size, const GattReading *r, bool *ok)
+{
+    // folds to nothing for mandatory fields
+    if(0 == Mask)
+        return false;
+    if(0 == (r->flags & Mask)) {
+        *ok = true;
+        return true;
+    }
+    if(end - p < size) {
+        *ok = false;
+        return true;
+    }
+    return false;
+}
+
+template <int Slot, quint16 Mask = 0>
+struct SFloat
+{
+    static const int kSize = 2;
+    static const quint16 kMask = Mask;
+    static bool read(const uchar *&p, const uchar *end, GattReading *r)
+    {
+        bool ok;
+        if(skip<Mask>(p, end, kSize, r, &ok))
+            return ok;
+        r->status[Slot] = decodeSFloat(p, &r->values[Slot]);
+        r->present |= quint8(1u << Slot);
+        p += kSize;
+        return true;
+    }
+};
+
+template <int Slot, quint16 Mask = 0>
+struct Float
+{
+    static const int kSize = 4;
+    static const quint16 kMask = Mask;
+    static bool read(const uchar *&p, const uchar *end, GattReading *r)
+    {
+        bool ok;
+        if(skip<Mask>(p, end, kSize, r, &ok))
+            return ok;
+        qint32 mantissa;
+        qint8 exponent;
+        r->status[Slot] = ThermometerDecoder::decodeFloat(p, &mantissa, &exponent, &r->values[Slot]);
+        r->present |= quint8(1u << Slot);
+        p += kSize;
+        return true;
+    }
+};
+
+// little endian unsigned integer of Bytes bytes into a code slot
+template <int Slot, int Bytes, quint16 Mask = 0>
+struct Unsigned
+{
+    static const int kSize = Bytes;
+    static const quint16 kMask = Mask;
+    static bool read(const uchar *&p, const uchar *end, GattReading *r)
+    {
+        bool ok;
+        if(skip<Mask>(p, end, kSize, r, &ok))
+            return ok;
+        quint32 value = 0;
+        for(int i = 0; i < Bytes; ++i)
+            value |= quint32(p[i]) << (8 * i);
+        r->codes[Slot] = value;
+        r->codesPresent |= quint8(1u << Slot);
+        p += kSize;
+        return true;
+    }
+};
+
+// Date Time characteristic layout: year uint16, month, day, hours, minutes, seconds uint8
+template <quint16 Mask = 0>
+struct DateTime
+{
+    static const int kSize = 7;
+    static const quint16 kMask = Mask;
+    static bool read(const uchar *&p, const uchar *end, GattReading *r)
+    {
+        bool ok;
+        if(skip<Mask>(p, end, kSize, r, &ok))
+            return ok;
+        r->year = quint16(p[0] | (p[1] << 8));
+        r->month = p[2];
+        r->day = p[3];
+        r->hours = p[4];
+        r->minutes = p[5];
+        r->seconds = p[6];
+        p += kSize;
+        return true;
+    }
+};
+
+template <typename... Fields>
+struct Layout;
+
+template <>
+struct Layout<>
+{
+    static const int kMandatory = 0;
+    static bool read(const uchar *&, const uchar *, GattReading *) { return true; }
+};
+
+template <typename Field, typename... Rest>
+struct Layout<Field, Rest...>
+{
+    // bytes every notification carries whatever its flags say
+    static const int kMandatory = (0 == Field::kMask ? Field::kSize : 0) + Layout<Rest...>::kMandatory;
+
+    static bool read(const uchar *&p, const uchar *end, GattReading *r)
+    {
+        return Field::read(p, end, r) && Layout<Rest...>::read(p, end, r);
+    }
+};
+
+// returns false when the buffer is shorter than the fields its flags declare
+template <quint16 Service, quint16 Characteristic, typename... Fields>
+bool decode(const char *data, int size, GattReading *r)
+{
+    std::memset(r, 0, sizeof(GattReading));
+    r->service = Service;
+    r->characteristic = Characteristic;
+    if(nullptr == data || size < Layout<Fields...>::kMandatory)
+        return false;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    return Layout<Fields...>::read(p, p + size, r);
+}
+
+}
+
+/**
+ * Registry of the profile decoders, keyed by service and characteristic
+ * UUID. Entries are static; look one up once per subscription and call its
+ * decode function per notification.
+ */
+class GattDecoder
+{
+public:
+    typedef bool (*DecodeFunction)(const char *data, int size, GattReading *r);
+
+    struct Entry {
+        quint16 service;
+        quint16 characteristic;
+        const char *name;
+        DecodeFunction decode;
+        const char *values[GattReading::kMaxValues];    // slot names, nullptr when unused
+        const char *codes[GattReading::kMaxCodes];
+    };
+
+    // nullptr when nothing is registered for the pair
+    static const Entry *find(quint16 service, quint16 characteristic);
+    static const Entry *find(const QBluetoothUuid &service, const QBluetoothUuid &characteristic);
+    static const Entry *find(const GattReading &r) { return find(r.service, r.characteristic); }
+    static int count();
+    static const Entry &entry(int index);
+
+    // "name slot=value ..." for logs and the reading list
+    static QString toString(const Entry &entry, const GattReading &r);
+};
+
+#endif // GATTDECODER_H
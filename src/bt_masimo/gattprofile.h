@@ -0,0 +1,61 @@
+#ifndef GATTPROFILE_H
+#define GATTPROFILE_H
+
+#include <QList>
+#include <QtBluetooth/QBluetoothDeviceInfo>
+#include <QtBluetooth/QBluetoothUuid>
+
+/**
+ * What a session needs from a peripheral: one service and the
+ * characteristics to subscribe to. Discovery stops at what is declared here.
+ * Every characteristic listed has a decoder in GattDecoder.
+ */
+struct GattProfile
+{
+    QBluetoothUuid service;
+    QList<QBluetoothUuid> notify;
+
+    static GattProfile healthThermometer()
+    {
+        GattProfile profile;
+        profile.service = QBluetoothUuid(QBluetoothUuid::HealthThermometer);
+        profile.notify << QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement);
+        return profile;
+    }
+
+    // PLX, continuous readings are notified, spot checks indicated
+    static GattProfile pulseOximeter()
+    {
+        GattProfile profile;
+        profile.service = QBluetoothUuid(quint16(0x1822));
+        profile.notify << QBluetoothUuid(quint16(0x2A5F)) << QBluetoothUuid(quint16(0x2A5E));
+        return profile;
+    }
+
+    static GattProfile bloodPressure()
+    {
+        GattProfile profile;
+        profile.service = QBluetoothUuid(quint16(0x1810));
+        profile.notify << QBluetoothUuid(quint16(0x2A35));
+        return profile;
+    }
+
+    static QList<GattProfile> known()
+    {
+        return QList<GattProfile>() << healthThermometer() << pulseOximeter() << bloodPressure();
+    }
+
+    // the first known profile the device advertises, the Health Thermometer
+    // when it advertises none (targets are often named by address alone)
+    static GattProfile forDevice(const QBluetoothDeviceInfo &info)
+    {
+        const QList<QBluetoothUuid> advertised = info.serviceUuids();
+        for(const GattProfile &profile : known()) {
+            if(advertised.contains(profile.service))
+                return profile;
+        }
+        return healthThermometer();
+    }
+};
+
+#endif // GATTPROFILE_H
@@ -0,0 +1,132 @@
+#include "ingestqueue.h"
+#include "latencyrecorder.h"
+#include "livefeed.h"
+#include "measurementjournal.h"
+#include "metrics.h"
+
+#include <QtBluetooth/QBluetoothAddress>
+#include <QDateTime>
+
+#include <cstring>
+
+namespace {
+
+// the same counter as BLESession's, the registry hands both the one instance
+MetricsCounter *decodeErrors()
+{
+    static MetricsCounter *const counter = Metrics::counter("pine_decode_errors_total",
+        "Notifications that could not be decoded");
+    return counter;
+}
+
+}
+
+IngestQueue::IngestQueue(quint32 capacity, QObject *parent)
+    : QThread(parent)
+    , m_ring(capacity)
+{
+    setObjectName("ingest");
+}
+
+IngestQueue::~IngestQueue()
+{
+    stop();
+}
+
+bool IngestQueue::push(quint64 address, const QByteArray &value, qint64 receivedAt)
+{
+    RawNotification raw;
+    if(value.size() > int(sizeof(raw.data))) {
+        decodeErrors()->add();
+        m_decodeErrors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    raw.receivedAt = receivedAt;
+    raw.address = address;
+    raw.length = quint16(value.size());
+    std::memcpy(raw.data, value.constData(), size_t(value.size()));
+
+    if(!m_ring.tryPush(raw)) {
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+    const quint32 depth = m_ring.size();
+    if(depth > m_highWater.load(std::memory_order_relaxed))
+        m_highWater.store(depth, std::memory_order_relaxed);
+
+    // only a sleeping worker costs the producer a lock; the fence pairs with
+    // the one in run() so either we see the flag or the worker sees the value
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_sleeping.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(&m_wakeLock);
+        m_wake.wakeOne();
+    }
+    return true;
+}
+
+void IngestQueue::stop()
+{
+    if(!isRunning())
+        return;
+    requestInterruption();
+    {
+        QMutexLocker locker(&m_wakeLock);
+        m_wake.wakeOne();
+    }
+    wait();
+}
+
+void IngestQueue::run()
+{
+    RawNotification batch[kBatch];
+    while(!isInterruptionRequested()) {
+        const int count = m_ring.popBatch(batch, kBatch);
+        if(0 == count) {
+            QMutexLocker locker(&m_wakeLock);
+            m_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // a push may have landed between the pop and the flag
+            if(0 == m_ring.size() && !isInterruptionRequested())
+                m_wake.wait(&m_wakeLock, 100);
+            m_sleeping.store(false, std::memory_order_relaxed);
+            // idle is when the journal's time bound needs enforcing
+            if(nullptr!=m_journal)
+                m_journal->syncIfDue();
+            continue;
+        }
+
+        // one wall clock read per batch, each record is placed by its monotonic age
+        const qint64 wallMs = QDateTime::currentMSecsSinceEpoch();
+        const qint64 monotonic = LatencyRecorder::now();
+
+        for(int i = 0; i < count; ++i) {
+            const RawNotification &raw = batch[i];
+            TemperatureMeasurement m;
+            if(!ThermometerDecoder::decode(raw.data, raw.length, &m)) {
+                decodeErrors()->add();
+                m_decodeErrors.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            m_queueDelay.recordNanoseconds(LatencyRecorder::now() - raw.receivedAt);
+            const qint64 receivedMs = wallMs - (monotonic - raw.receivedAt) / 1000000;
+            // neither filtered, journaled nor published, as on the inline path
+            // where the session drops readings without a value
+            if(!m.isValid())
+                continue;
+            if(!m_replayFilter.admit(raw.address, receivedMs, &m)) {
+                m_replays.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if(nullptr!=m_journal)
+                m_journal->append(raw.address, receivedMs, m);
+            if(nullptr!=m_liveFeed)
+                m_liveFeed->publish(raw.address, receivedMs, raw.receivedAt, m);
+            emit temperatureMeasured(QBluetoothAddress(raw.address).toString(), m);
+        }
+        // one wake for the batch, readers see it before the queued signals land
+        if(nullptr!=m_liveFeed)
+            m_liveFeed->commit();
+    }
+}
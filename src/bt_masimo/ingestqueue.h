@@ -0,0 +1,88 @@
+#ifndef INGESTQUEUE_H
+#define INGESTQUEUE_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include "latencyhistogram.h"
+#include "replayfilter.h"
+#include "spscring.h"
+#include "thermometerdecoder.h"
+
+class LiveFeed;
+class MeasurementJournal;
+
+/**
+ * Hands raw notifications from the BLE slots to a worker thread. push() only
+ * copies the bytes and a timestamp into a lock-free ring; the worker drains
+ * it in batches, decodes, drops stored readings a device re-sends and emits
+ * temperatureMeasured, which reaches receivers in other threads through
+ * queued connections. A full ring drops the notification and counts it
+ * rather than stalling the event loop.
+ */
+class IngestQueue : public QThread
+{
+    Q_OBJECT
+
+public:
+    // one cache line per notification
+    struct RawNotification {
+        qint64 receivedAt;      // LatencyRecorder::now()
+        quint64 address;        // 48-bit peripheral address
+        quint16 length;
+        char data[46];
+    };
+
+    explicit IngestQueue(quint32 capacity = 4096, QObject *parent = nullptr);
+    ~IngestQueue();
+
+    // producer side, call from one thread only; false when the ring was full
+    // or the value does not fit a slot
+    bool push(quint64 address, const QByteArray &value, qint64 receivedAt);
+
+    void stop();
+
+    // every decoded reading is appended here on the worker thread before it is published
+    void setJournal(MeasurementJournal *journal) { m_journal = journal; }
+    // and published to local readers, committed once per batch
+    void setLiveFeed(LiveFeed *feed) { m_liveFeed = feed; }
+
+    quint32 capacity() const { return m_ring.capacity(); }
+    quint32 depth() const { return m_ring.size(); }
+    quint32 highWaterMark() const { return m_highWater.load(std::memory_order_relaxed); }
+    quint64 pushed() const { return m_pushed.load(std::memory_order_relaxed); }
+    quint64 overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+    quint64 decodeErrors() const { return m_decodeErrors.load(std::memory_order_relaxed); }
+    // timestamped readings seen before, dropped ahead of the journal
+    quint64 replays() const { return m_replays.load(std::memory_order_relaxed); }
+    // push to decoded, in microseconds
+    const LatencyHistogram &queueDelay() const { return m_queueDelay; }
+
+signals:
+    void temperatureMeasured(const QString &address, const TemperatureMeasurement &m);
+
+protected:
+    void run() override;
+
+private:
+    static const int kBatch = 64;
+
+    SpscRing<RawNotification> m_ring;
+    MeasurementJournal *m_journal = nullptr;
+    LiveFeed *m_liveFeed = nullptr;
+    QMutex m_wakeLock;
+    QWaitCondition m_wake;
+    std::atomic<bool> m_sleeping {false};
+    std::atomic<quint32> m_highWater {0};
+    std::atomic<quint64> m_pushed {0};
+    std::atomic<quint64> m_overflows {0};
+    std::atomic<quint64> m_decodeErrors {0};
+    std::atomic<quint64> m_replays {0};
+    ReplayFilter m_replayFilter;        // worker thread only
+    LatencyHistogram m_queueDelay;
+};
+
+#endif // INGESTQUEUE_H
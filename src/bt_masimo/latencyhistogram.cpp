@@ -0,0 +1,117 @@
+#include "latencyhistogram.h"
+
+#include <QJsonArray>
+
+#include <limits>
+
+namespace {
+
+inline int mostSignificantBit(quint64 v)
+{
+    return 63 - __builtin_clzll(v);
+}
+
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::reset()
+{
+    for(std::atomic<quint64> &bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(std::numeric_limits<quint64>::max(), std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketIndex(quint64 us)
+{
+    if(us < quint64(kSubBuckets))
+        return int(us);
+
+    int magnitude = mostSignificantBit(us);
+    if(magnitude > kMaxMagnitude)
+        return kBucketCount - 1;
+
+    const int shift = magnitude - kSubBucketBits;
+    const int sub = int((us >> shift) & (kSubBuckets - 1));
+    return kSubBuckets + shift * kSubBuckets + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if(index < kSubBuckets)
+        return quint64(index);
+
+    const int shift = (index - kSubBuckets) / kSubBuckets;
+    const int sub = (index - kSubBuckets) % kSubBuckets;
+    const quint64 lower = (quint64(1) << (shift + kSubBucketBits)) + (quint64(sub) << shift);
+    return lower + (quint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(quint64 us)
+{
+    m_buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+
+    quint64 current = m_min.load(std::memory_order_relaxed);
+    while(us < current && !m_min.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+    current = m_max.load(std::memory_order_relaxed);
+    while(us > current && !m_max.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+}
+
+quint64 LatencyHistogram::min() const
+{
+    return 0 == count() ? 0 : m_min.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    const quint64 n = count();
+    return 0 == n ? 0.0 : double(m_sum.load(std::memory_order_relaxed)) / n;
+}
+
+quint64 LatencyHistogram::percentile(double fraction) const
+{
+    const quint64 n = count();
+    if(0 == n)
+        return 0;
+
+    const quint64 rank = qMax<quint64>(1, quint64(fraction * n + 0.5));
+    quint64 seen = 0;
+    for(int i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if(seen >= rank)
+            return qMin(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+QJsonObject LatencyHistogram::toJson() const
+{
+    QJsonObject json;
+    json["count"] = qint64(count());
+    json["min_us"] = qint64(min());
+    json["max_us"] = qint64(max());
+    json["mean_us"] = mean();
+    json["p50_us"] = qint64(percentile(0.50));
+    json["p90_us"] = qint64(percentile(0.90));
+    json["p99_us"] = qint64(percentile(0.99));
+    json["p999_us"] = qint64(percentile(0.999));
+
+    QJsonArray buckets;
+    for(int i = 0; i < kBucketCount; ++i) {
+        const quint64 c = m_buckets[i].load(std::memory_order_relaxed);
+        if(0 != c)
+            buckets.append(QJsonArray() << qint64(bucketUpperBound(i)) << qint64(c));
+    }
+    json["buckets"] = buckets;
+    return json;
+}
@@ -0,0 +1,52 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+
+#include <atomic>
+
+/**
+ * HDR-style log-linear histogram of durations in microseconds: values below
+ * 32 us are exact, above that each power of two is split into 32 buckets
+ * (about 3% relative error) up to roughly 25 days. Recording is a handful of
+ * relaxed atomic operations, safe from any thread, and never allocates.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void recordNanoseconds(qint64 ns) { record(ns < 0 ? 0 : quint64(ns) / 1000); }
+    void record(quint64 us);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 min() const;
+    quint64 max() const { return m_max.load(std::memory_order_relaxed); }
+    double mean() const;
+    // value at or below which the given fraction (0..1) of samples fall
+    quint64 percentile(double fraction) const;
+
+    // summary plus the non-empty buckets as [upper bound us, count] pairs
+    QJsonObject toJson() const;
+
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxMagnitude = 40;
+    static const int kBucketCount = kSubBuckets + (kMaxMagnitude - kSubBucketBits + 1) * kSubBuckets;
+
+    static int bucketIndex(quint64 us);
+    static quint64 bucketUpperBound(int index);
+
+private:
+    std::atomic<quint64> m_buckets[kBucketCount];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<quint64> m_min;
+    std::atomic<quint64> m_max;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,83 @@
+#include "latencyrecorder.h"
+#include "structlog.h"
+
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <chrono>
+
+qint64 LatencyRecorder::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *LatencyRecorder::phaseName(Phase phase)
+{
+    switch(phase) {
+    case ScanToDiscovery: return "scan_to_discovery";
+    case ConnectQueue: return "connect_queue";
+    case Connect: return "connect";
+    case ServiceDiscovery: return "service_discovery";
+    case ServiceDetails: return "service_details";
+    case ServiceDetailsSubscribeOnly: return "service_details_subscribe_only";
+    case Subscribe: return "subscribe";
+    case FirstReading: return "first_reading";
+    case ConnectToFirstReading: return "connect_to_first_reading";
+    case DiscoveryToFirstReading: return "discovery_to_first_reading";
+    case Recovery: return "recovery";
+    default: return "unknown";
+    }
+}
+
+void LatencyRecorder::recordSince(Phase phase, qint64 start)
+{
+    if(0 < start)
+        record(phase, now() - start);
+}
+
+void LatencyRecorder::reset()
+{
+    for(LatencyHistogram &histogram : m_histograms)
+        histogram.reset();
+}
+
+QJsonObject LatencyRecorder::toJson() const
+{
+    QJsonObject phases;
+    for(int i = 0; i < PhaseCount; ++i)
+        phases[phaseName(Phase(i))] = m_histograms[i].toJson();
+
+    QJsonObject json;
+    json["generated"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    json["unit"] = "us";
+    json["phases"] = phases;
+
+    // what subscribe-only discovery saves, once both variants have been seen
+    const LatencyHistogram &full = m_histograms[ServiceDetails];
+    const LatencyHistogram &subscribeOnly = m_histograms[ServiceDetailsSubscribeOnly];
+    if(0 < full.count() && 0 < subscribeOnly.count()) {
+        QJsonObject saving;
+        saving["p50_us"] = qint64(full.percentile(0.50)) - qint64(subscribeOnly.percentile(0.50));
+        saving["mean_us"] = full.mean() - subscribeOnly.mean();
+        json["discovery_saving"] = saving;
+    }
+    return json;
+}
+
+bool LatencyRecorder::writeJson(const QString &path) const
+{
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        LOG_ERROR("latency.dump_failed", "path", path, "error", file.errorString());
+        return false;
+    }
+    file.write(QJsonDocument(toJson()).toJson());
+    if(!file.commit()) {
+        LOG_ERROR("latency.dump_failed", "path", path, "error", file.errorString());
+        return false;
+    }
+    LOG_INFO("latency.dumped", "path", path);
+    return true;
+}
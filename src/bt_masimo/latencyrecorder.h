@@ -0,0 +1,49 @@
+#ifndef LATENCYRECORDER_H
+#define LATENCYRECORDER_H
+
+#include "latencyhistogram.h"
+
+#include <QString>
+
+/**
+ * Histograms of the session lifecycle phases, aggregated over all sessions.
+ * Spans are taken on the monotonic clock returned by now() and can be dumped
+ * as JSON at any time.
+ */
+class LatencyRecorder
+{
+public:
+    enum Phase {
+        ScanToDiscovery,          // scan start to the target's advertisement
+        ConnectQueue,             // waiting for a connection slot
+        Connect,                  // connectToDevice to connected
+        ServiceDiscovery,         // discoverServices to discoveryFinished
+        ServiceDetails,           // openService to serviceReady
+        ServiceDetailsSubscribeOnly,  // the same without reading values
+        Subscribe,                // CCCD write to confirmation
+        FirstReading,             // subscribed to the first measurement
+        ConnectToFirstReading,    // connectToDevice to the first measurement
+        DiscoveryToFirstReading,  // advertisement to the first measurement
+        Recovery,                 // link drop to subscribed again
+        PhaseCount
+    };
+
+    // monotonic nanoseconds, comparable across threads
+    static qint64 now();
+    static const char *phaseName(Phase phase);
+
+    void record(Phase phase, qint64 ns) { m_histograms[phase].recordNanoseconds(ns); }
+    // record the span from start to now, ignored when start was never set
+    void recordSince(Phase phase, qint64 start);
+
+    const LatencyHistogram &histogram(Phase phase) const { return m_histograms[phase]; }
+    void reset();
+
+    QJsonObject toJson() const;
+    bool writeJson(const QString &path) const;
+
+private:
+    LatencyHistogram m_histograms[PhaseCount];
+};
+
+#endif // LATENCYRECORDER_H
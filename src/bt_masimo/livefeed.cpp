@@ -0,0 +1,372 @@
+#include "livefeed.h"
+#include "latencyrecorder.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'P', 'L', 'I', 'V', 'E', 'F', 'D', '1'};
+const quint32 kVersion = 2;
+
+// version is 2n+1 while reading n is being written and 2n+2 once it is complete
+struct Slot
+{
+    std::atomic<quint64> version;
+    LiveFeed::Record record;
+};
+
+static_assert(sizeof(LiveFeed::Record) == 120, "feed records are 120 bytes");
+static_assert(sizeof(Slot) == 128, "feed slots are two cache lines");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the feed needs address-free atomics to share them between processes");
+
+#ifdef Q_OS_UNIX
+QByteArray shmName(const QString &name)
+{
+    // one path component with a leading slash is all shm_open promises to accept
+    QString n = name;
+    while(n.startsWith(QLatin1Char('/')))
+        n.remove(0, 1);
+    n.replace(QLatin1Char('/'), QLatin1Char('_'));
+    return ('/' + n).toLocal8Bit();
+}
+
+QString lastError(const char *what)
+{
+    return QStringLiteral("%1: %2").arg(QLatin1String(what), QString::fromLocal8Bit(std::strerror(errno)));
+}
+#endif
+
+}
+
+// header on its own lines, then the slots
+struct LiveFeed::Segment
+{
+    char magic[8];               // written last, a reader opening mid-setup sees no feed
+    quint32 version;
+    quint32 recordSize;          // sizeof(Slot)
+    quint32 capacity;            // slots, a power of two
+    quint32 reserved0;
+    qint64 writerPid;
+    qint64 createdMs;
+    alignas(64) std::atomic<quint64> head;   // readings committed
+    alignas(64) std::atomic<quint32> wake;   // bumped per commit, the futex word
+
+    Slot *slots() { return reinterpret_cast<Slot *>(this + 1); }
+    const Slot *slots() const { return reinterpret_cast<const Slot *>(this + 1); }
+};
+
+QString LiveFeed::defaultName()
+{
+    return QStringLiteral("pine_plus.live");
+}
+
+LiveFeed::LiveFeed()
+{
+    static_assert(sizeof(Segment) == 192, "feed header is three cache lines");
+}
+
+LiveFeed::~LiveFeed()
+{
+    close();
+}
+
+bool LiveFeed::open(const QString &name, quint32 capacity)
+{
+    close();
+#ifdef Q_OS_UNIX
+    quint32 size = 2;
+    while(size < capacity)
+        size <<= 1;
+
+    // a segment left by a crashed run is replaced, its readers keep the old mapping
+    const QByteArray path = shmName(name);
+    ::shm_unlink(path.constData());
+    const int fd = ::shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) {
+        m_error = lastError("shm_open");
+        return false;
+    }
+    m_size = qint64(sizeof(Segment)) + qint64(size) * qint64(sizeof(Slot));
+    if(0 != ::ftruncate(fd, off_t(m_size))) {
+        m_error = lastError("ftruncate");
+        ::close(fd);
+        ::shm_unlink(path.constData());
+        return false;
+    }
+    void *map = ::mmap(nullptr, size_t(m_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(MAP_FAILED == map) {
+        m_error = lastError("mmap");
+        ::shm_unlink(path.constData());
+        return false;
+    }
+
+    // ftruncate zero-fills: every slot version is 0, which no reading ever matches
+    m_segment = static_cast<Segment *>(map);
+    m_segment->version = kVersion;
+    m_segment->recordSize = sizeof(Slot);
+    m_segment->capacity = size;
+    m_segment->writerPid = qint64(::getpid());
+    m_segment->createdMs = QDateTime::currentMSecsSinceEpoch();
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_segment->magic, kMagic, sizeof(kMagic));
+
+    m_name = name;
+    m_next = 0;
+    m_committed.store(0, std::memory_order_relaxed);
+    return true;
+#else
+    Q_UNUSED(name)
+    Q_UNUSED(capacity)
+    m_error = QStringLiteral("the live feed needs POSIX shared memory");
+    return false;
+#endif
+}
+
+void LiveFeed::close()
+{
+#ifdef Q_OS_UNIX
+    if(nullptr == m_segment)
+        return;
+    commit();
+    ::munmap(m_segment, size_t(m_size));
+    ::shm_unlink(shmName(m_name).constData());
+#endif
+    m_segment = nullptr;
+    m_size = 0;
+}
+
+LiveFeed::Record &LiveFeed::claim(quint64 *n)
+{
+    *n = m_next++;
+    Slot &slot = m_segment->slots()[*n & (m_segment->capacity - 1)];
+    // odd first: a reader that copies while this runs sees the version move
+    slot.version.store(2 * *n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memset(&slot.record, 0, sizeof(Record));
+    return slot.record;
+}
+
+void LiveFeed::release(quint64 n)
+{
+    m_segment->slots()[n & (m_segment->capacity - 1)].version.store(2 * n + 2, std::memory_order_release);
+}
+
+void LiveFeed::publish(quint64 address, qint64 receivedMs, qint64 slotNs, const TemperatureMeasurement &m)
+{
+    QMutexLocker locker(&m_writeLock);
+    if(nullptr == m_segment)
+        return;
+    quint64 n;
+    Record &r = claim(&n);
+    r.receivedMs = receivedMs;
+    r.measuredMs = m.measuredMs;
+    r.slotNs = slotNs;
+    r.publishedNs = LatencyRecorder::now();
+    r.address = address;
+    r.values[0] = m.value;
+    r.service = 0x1809;
+    r.characteristic = 0x2A1C;
+    r.flags = m.flags;
+    r.present = 0x01;
+    r.type = m.type;
+    r.status[0] = m.status;
+    release(n);
+}
+
+void LiveFeed::publish(quint64 address, qint64 receivedMs, qint64 slotNs, const GattReading &reading)
+{
+    QMutexLocker locker(&m_writeLock);
+    if(nullptr == m_segment)
+        return;
+    quint64 n;
+    Record &r = claim(&n);
+    r.receivedMs = receivedMs;
+    r.slotNs = slotNs;
+    r.publishedNs = LatencyRecorder::now();
+    r.address = address;
+    std::memcpy(r.values, reading.values, sizeof(r.values));
+    r.service = reading.service;
+    r.characteristic = reading.characteristic;
+    r.flags = reading.flags;
+    r.present = reading.present;
+    std::memcpy(r.status, reading.status, sizeof(r.status));
+    release(n);
+}
+
+quint64 LiveFeed::published() const
+{
+    QMutexLocker locker(&m_writeLock);
+    return m_next;
+}
+
+void LiveFeed::commit()
+{
+    QMutexLocker locker(&m_writeLock);
+    if(nullptr == m_segment || m_committed.load(std::memory_order_relaxed) == m_next)
+        return;
+    m_committed.store(m_next, std::memory_order_relaxed);
+    m_segment->head.store(m_next, std::memory_order_release);
+    m_segment->wake.fetch_add(1, std::memory_order_release);
+#ifdef Q_OS_LINUX
+    // shared, not FUTEX_PRIVATE: the sleepers are other processes
+    ::syscall(SYS_futex, reinterpret_cast<int *>(&m_segment->wake), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+LiveFeedReader::LiveFeedReader()
+{
+}
+
+LiveFeedReader::~LiveFeedReader()
+{
+    close();
+}
+
+bool LiveFeedReader::open(const QString &name, bool fromOldest)
+{
+    close();
+#ifdef Q_OS_UNIX
+    const int fd = ::shm_open(shmName(name).constData(), O_RDONLY, 0);
+    if(fd < 0) {
+        m_error = lastError("shm_open");
+        return false;
+    }
+    struct stat st;
+    if(0 != ::fstat(fd, &st) || st.st_size < qint64(sizeof(LiveFeed::Segment))) {
+        m_error = QStringLiteral("not a live feed");
+        ::close(fd);
+        return false;
+    }
+    m_size = st.st_size;
+    void *map = ::mmap(nullptr, size_t(m_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(MAP_FAILED == map) {
+        m_error = lastError("mmap");
+        return false;
+    }
+
+    const LiveFeed::Segment *s = static_cast<const LiveFeed::Segment *>(map);
+    const bool ready = 0 == std::memcmp(s->magic, kMagic, sizeof(kMagic));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(!ready || kVersion != s->version || sizeof(Slot) != s->recordSize
+       || 0 == s->capacity || 0 != (s->capacity & (s->capacity - 1))
+       || m_size < qint64(sizeof(LiveFeed::Segment)) + qint64(s->capacity) * qint64(sizeof(Slot))) {
+        m_error = QStringLiteral("not a live feed");
+        ::munmap(map, size_t(m_size));
+        return false;
+    }
+
+    m_segment = s;
+    m_lost = 0;
+    const quint64 head = s->head.load(std::memory_order_acquire);
+    m_next = head;
+    if(fromOldest)
+        m_next = head > s->capacity ? head - s->capacity : 0;
+    return true;
+#else
+    Q_UNUSED(name)
+    Q_UNUSED(fromOldest)
+    m_error = QStringLiteral("the live feed needs POSIX shared memory");
+    return false;
+#endif
+}
+
+void LiveFeedReader::close()
+{
+#ifdef Q_OS_UNIX
+    if(nullptr != m_segment)
+        ::munmap(const_cast<LiveFeed::Segment *>(m_segment), size_t(m_size));
+#endif
+    m_segment = nullptr;
+    m_size = 0;
+}
+
+quint32 LiveFeedReader::capacity() const
+{
+    return nullptr == m_segment ? 0 : m_segment->capacity;
+}
+
+qint64 LiveFeedReader::writerPid() const
+{
+    return nullptr == m_segment ? 0 : m_segment->writerPid;
+}
+
+int LiveFeedReader::read(LiveFeed::Record *out, int max)
+{
+    if(nullptr == m_segment)
+        return 0;
+    const quint64 capacity = m_segment->capacity;
+    const quint64 head = m_segment->head.load(std::memory_order_acquire);
+    if(head - m_next > capacity) {
+        m_lost += head - m_next - capacity;
+        m_next = head - capacity;
+    }
+
+    const Slot *slots = m_segment->slots();
+    int count = 0;
+    while(count < max && m_next < head) {
+        const Slot &slot = slots[m_next & (capacity - 1)];
+        const quint64 expected = 2 * m_next + 2;
+        if(slot.version.load(std::memory_order_acquire) == expected) {
+            std::memcpy(out + count, &slot.record, sizeof(LiveFeed::Record));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot.version.load(std::memory_order_relaxed) == expected) {
+                ++count;
+                ++m_next;
+                continue;
+            }
+        }
+        // the writer has lapped this reader and is reusing the slot
+        ++m_lost;
+        ++m_next;
+    }
+    return count;
+}
+
+bool LiveFeedReader::wait(int timeoutMs)
+{
+    if(nullptr == m_segment)
+        return false;
+    QElapsedTimer timer;
+    timer.start();
+    for(;;) {
+        // the word before the head, so a commit in between changes the word and the wait returns
+        const quint32 word = m_segment->wake.load(std::memory_order_acquire);
+        if(m_segment->head.load(std::memory_order_acquire) != m_next)
+            return true;
+        const qint64 remaining = qint64(timeoutMs) - timer.elapsed();
+        if(remaining <= 0)
+            return false;
+#ifdef Q_OS_LINUX
+        struct timespec timeout;
+        timeout.tv_sec = time_t(remaining / 1000);
+        timeout.tv_nsec = long(remaining % 1000) * 1000000L;
+        ::syscall(SYS_futex, reinterpret_cast<const int *>(&m_segment->wake), FUTEX_WAIT, int(word),
+                  &timeout, nullptr, 0);
+#else
+        // no futex to sleep on, poll at a rate that costs nothing measurable
+        Q_UNUSED(word)
+        QThread::usleep(200);
+#endif
+    }
+}
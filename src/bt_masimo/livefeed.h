@@ -0,0 +1,129 @@
+#ifndef LIVEFEED_H
+#define LIVEFEED_H
+
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+
+/**
+ * Decoded readings published to other processes on the station through a
+ * POSIX shared-memory ring, with no sockets and no serialisation. The
+ * session core is the only writer and never waits for readers: each slot is
+ * a seqlock, so a reader that falls more than a ring behind loses the
+ * oldest readings and knows how many. Any number of readers map the segment
+ * read-only and either poll or sleep on the futex the writer bumps once per
+ * commit. Thermometer readings and those of the GattDecoder profiles (PLX,
+ * Blood Pressure) share the ring, told apart by characteristic; the ingest
+ * worker and the event loop both publish, one at a time. Unix only; open()
+ * fails elsewhere.
+ */
+class LiveFeed
+{
+public:
+    // one reading, the payload of a 128-byte slot
+    struct Record
+    {
+        qint64  receivedMs;   // UTC ms since the epoch when the notification arrived
+        qint64  measuredMs;   // thermometer timestamp on the host clock, 0 when unknown
+        qint64  slotNs;       // LatencyRecorder::now() in the BLE slot, CLOCK_MONOTONIC
+        qint64  publishedNs;  // LatencyRecorder::now() when written to the ring
+        quint64 address;      // 48-bit peripheral address
+        double  values[GattReading::kMaxValues];   // a temperature in values[0]
+        quint16 service;      // 16-bit SIG UUIDs, 0x1809 and 0x2A1C for a thermometer
+        quint16 characteristic;
+        quint16 flags;        // the characteristic's flags, TemperatureMeasurement::Flag for 0x2A1C
+        quint8  present;      // bit per value slot
+        quint8  type;         // temperature type, 0 for the other characteristics
+        quint8  status[GattReading::kMaxValues];   // TemperatureMeasurement::Status per value slot
+
+        bool isTemperature() const { return 0x2A1C == characteristic; }
+        bool isFahrenheit() const { return isTemperature() && (flags & TemperatureMeasurement::Fahrenheit); }
+        bool has(int slot) const { return present & (1u << slot); }
+        bool isValid(int slot) const { return has(slot) && TemperatureMeasurement::Valid == status[slot]; }
+    };
+
+    struct Segment;
+
+    LiveFeed();
+    ~LiveFeed();
+    LiveFeed(const LiveFeed &) = delete;
+    LiveFeed &operator=(const LiveFeed &) = delete;
+
+    // the segment name used when none is given, under /dev/shm on Linux
+    static QString defaultName();
+
+    // create the segment, replacing one a previous run left behind;
+    // capacity is rounded up to a power of two
+    bool open(const QString &name, quint32 capacity = 65536);
+    // unlinks the name, readers keep what they have mapped
+    void close();
+    bool isOpen() const { return nullptr != m_segment; }
+    QString errorString() const { return m_error; }
+
+    // any thread, one at a time; visible to readers at the next commit()
+    void publish(quint64 address, qint64 receivedMs, qint64 slotNs, const TemperatureMeasurement &m);
+    void publish(quint64 address, qint64 receivedMs, qint64 slotNs, const GattReading &reading);
+    // make everything published so far visible and wake sleeping readers
+    void commit();
+
+    quint64 published() const;
+    // from any thread, what readers can see
+    quint64 committed() const { return m_committed.load(std::memory_order_relaxed); }
+
+private:
+    Segment *m_segment = nullptr;
+    qint64 m_size = 0;
+    QString m_name;
+    QString m_error;
+    mutable QMutex m_writeLock;     // uncontended unless a GATT reading lands mid-batch
+    quint64 m_next = 0;
+    std::atomic<quint64> m_committed {0};
+
+    Record &claim(quint64 *n);
+    void release(quint64 n);
+};
+
+/**
+ * A consumer of a LiveFeed, usually in another process. Not thread safe;
+ * each thread that reads opens its own.
+ */
+class LiveFeedReader
+{
+public:
+    LiveFeedReader();
+    ~LiveFeedReader();
+    LiveFeedReader(const LiveFeedReader &) = delete;
+    LiveFeedReader &operator=(const LiveFeedReader &) = delete;
+
+    // map the segment read-only; reading starts at the next commit, or at
+    // the oldest reading still in the ring when fromOldest is set
+    bool open(const QString &name, bool fromOldest = false);
+    void close();
+    bool isOpen() const { return nullptr != m_segment; }
+    QString errorString() const { return m_error; }
+
+    // copy up to max readings in order, 0 when there is nothing new
+    int read(LiveFeed::Record *out, int max);
+    // sleep until something is committed or timeoutMs passes, false on timeout
+    bool wait(int timeoutMs);
+
+    // overwritten before this reader got to them
+    quint64 lost() const { return m_lost; }
+    quint32 capacity() const;
+    // the publishing process, to notice it has gone
+    qint64 writerPid() const;
+
+private:
+    const LiveFeed::Segment *m_segment = nullptr;
+    qint64 m_size = 0;
+    QString m_error;
+    quint64 m_next = 0;
+    quint64 m_lost = 0;
+};
+
+#endif // LIVEFEED_H
@@ -1,15 +1,388 @@
+#include "adapterpool.h"
 #include "mainwindow.h"
+#include "metrics.h"
+#include "sessionmanager.h"
+#include "readingwriter.h"
+#include "nativetransport.h"
+#include "pineuploader.h"
+#include "simtransport.h"
+#include "slotprofiler.h"
+#include "stallwatchdog.h"
+#include "structlog.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <cstring>
+#include <functional>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// resident set size in kB from /proc, 0 where unavailable
+qint64 residentSetSize()
+{
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly))
+        return 0;
+    for(QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if(line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return 0;
+}
+
+// cold start cost: time from main() to the first event loop pass, plus RSS at
+// that point, and to the first advertisement through the scan filter
+void reportStartup(const QElapsedTimer &timer, const char *mode, BLETransport *transport)
+{
+    QTimer::singleShot(0, [timer, mode]() {
+        qInfo("startup (%s): %.3f ms to event loop, RSS %lld kB",
+              mode, timer.nsecsElapsed() / 1e6, residentSetSize());
+    });
+    QMetaObject::Connection *first = new QMetaObject::Connection;
+    *first = QObject::connect(transport, &BLETransport::deviceDiscovered, [timer, mode, first]() {
+        qInfo("startup (%s): %.3f ms to first scan result", mode, timer.nsecsElapsed() / 1e6);
+        QObject::disconnect(*first);
+        delete first;
+    });
+}
+
+#ifdef Q_OS_UNIX
+int usr1Fd[2];
+
+void usr1Handler(int)
+{
+    // only async-signal-safe work here, the event loop picks it up
+    char c = 1;
+    ssize_t written = ::write(usr1Fd[0], &c, sizeof(c));
+    Q_UNUSED(written)
+}
+#endif
+
+// run fn on the event loop whenever the process receives SIGUSR1
+void onUsr1(QObject *context, std::function<void()> fn)
+{
+#ifdef Q_OS_UNIX
+    if(0 != ::socketpair(AF_UNIX, SOCK_STREAM, 0, usr1Fd)) {
+        LOG_ERROR("usr1.socketpair_failed", "errno", errno);
+        return;
+    }
+    QSocketNotifier *notifier = new QSocketNotifier(usr1Fd[1], QSocketNotifier::Read, context);
+    QObject::connect(notifier, &QSocketNotifier::activated, context, [fn]() {
+        char c;
+        ssize_t got = ::read(usr1Fd[1], &c, sizeof(c));
+        Q_UNUSED(got)
+        fn();
+    });
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = usr1Handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGUSR1, &action, nullptr);
+#else
+    Q_UNUSED(context)
+    Q_UNUSED(fn)
+#endif
+}
+
+bool hasArgument(int argc, char *argv[], const char *name)
+{
+    for(int i = 1; i < argc; ++i) {
+        if(0 == std::strcmp(argv[i], name))
+            return true;
+    }
+    return false;
+}
+
+void addOptions(QCommandLineParser &parser)
+{
+    parser.addHelpOption();
+    parser.addOption({"headless", "Run without a user interface."});
+    parser.addOption({"socket", "Write readings to local socket <name> instead of stdout (headless).", "name"});
+    parser.addOption({"config", "Read and write adapter, peripheral and GATT settings in <file>, default bt.ini in the"
+                                " application config directory.", "file"});
+    parser.addOption({"peripheral", "Connect to peripheral <address>, may be repeated.", "address"});
+    parser.addOption({"max-connects", "Outstanding connection attempts, default 1.", "count", "1"});
+    parser.addOption({"adapters", "Use at most <count> local adapters, default 0 uses every one.", "count", "0"});
+    parser.addOption({"links-per-adapter", "Concurrent links one adapter is expected to carry, default 7.", "count", "7"});
+    parser.addOption({"discovery", "Service discovery after connect: full, subscribe-only or compare, default subscribe-only.",
+                      "mode", "subscribe-only"});
+    parser.addOption({"scan-window", "Scan in windows of <ms>, default 0 scans until every target is found.", "ms", "0"});
+    parser.addOption({"scan-idle", "Rest between scan windows, doubled while nothing new is found, default 2000.", "ms", "2000"});
+    parser.addOption({"min-rssi", "Ignore advertisements weaker than <dbm>.", "dbm"});
+    parser.addOption({"journal", "Journal readings to <file>, default in the application data directory"
+                                 " (not when simulating).", "file"});
+    parser.addOption({"no-journal", "Do not journal readings."});
+    parser.addOption({"journal-sync", "Readings that may be lost on power failure, default 4096.", "count", "4096"});
+    parser.addOption({"journal-sync-ms", "Milliseconds of readings that may be lost on power failure, default 1000.",
+                      "ms", "1000"});
+    parser.addOption({"live-feed", "Publish readings to the shared-memory segment <name> for local readers.", "name"});
+    parser.addOption({"live-feed-size", "Readings the live feed holds before the oldest are overwritten, default 65536.",
+                      "count", "65536"});
+    parser.addOption({"metrics-port", "Serve Prometheus metrics on 127.0.0.1:<port>.", "port"});
+    parser.addOption({"metrics-socket", "Serve Prometheus metrics on the local socket <name>.", "name"});
+    parser.addOption({"pine-url", "POST reading batches to the Pine endpoint <url>.", "url"});
+    parser.addOption({"pine-queue", "Directory of batches waiting for Pine, default in the application data directory.",
+                      "dir"});
+    parser.addOption({"pine-batch", "Readings per Pine batch, default 200.", "count", "200"});
+    parser.addOption({"pine-batch-ms", "Longest a reading waits for its batch to fill, default 1000.", "ms", "1000"});
+    parser.addOption({"inline-decode", "Decode notifications in the BLE slot instead of on the ingest thread."});
+    parser.addOption({"no-reconnect", "Do not reconnect automatically after a link drops."});
+    parser.addOption({"log", "Write the log to <file> instead of stderr.", "file"});
+    parser.addOption({"log-level", "Least severe level logged: trace, debug, info, warning or error, default info."
+                                   " Levels below the build's PINE_LOG_LEVEL are compiled out.", "level", "info"});
+    parser.addOption({"stall-ms", "Log event loop stalls longer than <ms> and the handler they are in, default 250,"
+                                  " 0 does not watch.", "ms", "250"});
+    parser.addOption({"profile", "Time the event loop handlers, exposed as pine_slot_duration_seconds."});
+    parser.addOption({"profile-trace", "Write the latest handler runs and stalls as a Chrome trace to <file> on SIGUSR1"
+                                       " and at exit, implies --profile.", "file"});
+    parser.addOption({"profile-trace-size", "Handler runs the trace keeps, default 100000.", "count", "100000"});
+    parser.addOption({"startup-report", "Print startup time, RSS and the time to the first scan result."});
+    parser.addOption({"latency-dump", "Write latency histograms as JSON to <file> on SIGUSR1 and at exit.", "file"});
+    parser.addOption({"simulate", "Use <count> simulated thermometers instead of the Bluetooth adapter.", "count"});
+    parser.addOption({"sim-rate", "Simulated notifications per second per device, default 1.", "hz", "1"});
+    parser.addOption({"sim-recording", "Replay hex notifications from <file>, one per line.", "file"});
+    parser.addOption({"sim-latency", "Simulated connect/discovery/subscribe latency, default 0.", "ms", "0"});
+    parser.addOption({"sim-read-latency", "Simulated latency of each characteristic value read, default 0.", "ms", "0"});
+    parser.addOption({"sim-jitter", "Extra uniform random latency, default 0.", "ms", "0"});
+    parser.addOption({"sim-drop-after", "Drop each simulated link <ms> after connecting.", "ms", "0"});
+    parser.addOption({"sim-drop-probability", "Chance of a drop after each notification.", "p", "0"});
+    parser.addOption({"sim-adapters", "Simulated local adapters, default 1.", "count", "1"});
+    parser.addOption({"sim-max-links", "Links a simulated adapter accepts, default 0 for no limit.", "count", "0"});
+}
+
+QList<SimPeripheral> simulatedPeripherals(const QCommandLineParser &parser)
+{
+    QList<SimPeripheral> peripherals;
+    QList<QByteArray> recording;
+    if(parser.isSet("sim-recording"))
+        recording = SimTransport::loadRecording(parser.value("sim-recording"));
+
+    const int count = qMax(1, parser.value("simulate").toInt());
+    for(int i = 0; i < count; ++i) {
+        SimPeripheral p = SimTransport::thermometer(i);
+        if(!recording.isEmpty())
+            p.notifications = recording;
+        p.rateHz = parser.value("sim-rate").toDouble();
+        p.connectLatencyMs = parser.value("sim-latency").toInt();
+        p.discoveryLatencyMs = p.connectLatencyMs;
+        p.subscribeLatencyMs = p.connectLatencyMs;
+        p.valueReadLatencyMs = parser.value("sim-read-latency").toInt();
+        p.latencyJitterMs = parser.value("sim-jitter").toInt();
+        p.disconnectAfterMs = parser.value("sim-drop-after").toInt();
+        p.dropProbability = parser.value("sim-drop-probability").toDouble();
+        peripherals << p;
+    }
+    return peripherals;
+}
+
+// every local adapter behind one pool, simulated ones with the same peripherals in range of each
+AdapterPool *createTransport(const QCommandLineParser &parser, QObject *parent)
+{
+    AdapterPool *pool = nullptr;
+    if(!parser.isSet("simulate")) {
+        pool = new AdapterPool([](QObject *p) -> BLETransport * { return new NativeTransport(p); }, parent);
+    } else {
+        const QList<SimPeripheral> peripherals = simulatedPeripherals(parser);
+        const int maxLinks = parser.value("sim-max-links").toInt();
+        pool = new AdapterPool([peripherals, maxLinks](QObject *p) -> BLETransport * {
+            SimTransport *transport = new SimTransport(p);
+            for(const SimPeripheral &peripheral : peripherals)
+                transport->addPeripheral(peripheral);
+            transport->setMaxLinks(maxLinks);
+            return transport;
+        }, parent);
+        QList<QBluetoothAddress> adapters;
+        for(int i = 0; i < qMax(1, parser.value("sim-adapters").toInt()); ++i)
+            adapters << QBluetoothAddress(Q_UINT64_C(0x00005E000001) + quint64(i));
+        pool->setAdapters(adapters);
+    }
+    pool->setMaxAdapters(parser.value("adapters").toInt());
+    pool->setLinksPerAdapter(parser.value("links-per-adapter").toInt());
+    return pool;
+}
+
+// starts the log writer; it drains and stops when the guard goes out of scope,
+// after everything declared later has been destroyed
+struct LogGuard
+{
+    explicit LogGuard(const QCommandLineParser &parser)
+    {
+        Log::Level level = Log::Info;
+        if(!Log::levelFromName(parser.value("log-level"), &level))
+            qWarning() << "unknown log level" << parser.value("log-level");
+        Log::setLevel(level);
+        if(Log::start(parser.value("log")))
+            Log::captureQtMessages();
+        else
+            qWarning() << "cannot write log" << parser.value("log");
+    }
+    ~LogGuard() { Log::stop(); }
+};
+
+void configureManager(SessionManager &manager, const QCommandLineParser &parser)
+{
+    const QString latencyDump = parser.value("latency-dump");
+    const QString trace = parser.value("profile-trace");
+    // only what was asked for, instances sharing a default file would overwrite each other's
+    auto dump = [&manager, latencyDump, trace]() {
+        if(!latencyDump.isEmpty())
+            manager.dumpLatency(latencyDump);
+        if(!trace.isEmpty())
+            SlotProfiler::writeChromeTrace(trace);
+    };
+    // installed either way, SIGUSR1 would otherwise end the process
+    onUsr1(&manager, dump);
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, &manager, dump);
+
+    SlotProfiler::setEnabled(parser.isSet("profile") || !trace.isEmpty());
+    if(!trace.isEmpty())
+        SlotProfiler::setTraceCapacity(parser.value("profile-trace-size").toInt());
+    // goes with the manager, before the loop it watches
+    const int stallMs = parser.value("stall-ms").toInt();
+    if(0 < stallMs)
+        (new StallWatchdog(stallMs, &manager))->watch();
+
+    // simulated runs never write settings, nor take the real adapter's unless told to
+    if(parser.isSet("config"))
+        manager.setSettingsPath(parser.value("config"));
+    else if(parser.isSet("simulate"))
+        manager.setSettingsPath(QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation))
+                                .filePath("bt-simulated.ini"));
+
+    manager.setMaxPendingConnects(parser.value("max-connects").toInt());
+    manager.setAutoReconnect(!parser.isSet("no-reconnect"));
+    manager.setThreadedDecode(!parser.isSet("inline-decode"));
+    manager.setScanDutyCycle(parser.value("scan-window").toInt(), parser.value("scan-idle").toInt());
+    if(parser.isSet("min-rssi"))
+        manager.setMinimumRssi(qint16(parser.value("min-rssi").toInt()));
+    const QString discovery = parser.value("discovery");
+    if("full" == discovery)
+        manager.setDiscoveryMode(BLESession::FullDiscovery);
+    else if("compare" == discovery)
+        manager.setDiscoveryMode(BLESession::CompareDiscovery);
+    else
+        manager.setDiscoveryMode(BLESession::SubscribeOnly);
+    for(const QString &address : parser.values("peripheral"))
+        manager.addTarget(QBluetoothAddress(address));
+
+    QString journal = parser.value("journal");
+    if(journal.isEmpty() && !parser.isSet("simulate")) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        journal = QDir(dir).filePath("measurements.journal");
+    }
+    if(!journal.isEmpty() && !parser.isSet("no-journal"))
+        manager.openJournal(journal, parser.value("journal-sync").toInt(), parser.value("journal-sync-ms").toInt());
+
+    if(parser.isSet("metrics-port") || parser.isSet("metrics-socket")) {
+        MetricsServer *metrics = new MetricsServer(&manager);
+        if(parser.isSet("metrics-port") && !metrics->listen(quint16(parser.value("metrics-port").toUInt())))
+            LOG_ERROR("metrics.listen_failed", "port", parser.value("metrics-port"), "error", metrics->errorString());
+        if(parser.isSet("metrics-socket") && !metrics->listenLocal(parser.value("metrics-socket")))
+            LOG_ERROR("metrics.listen_failed", "socket", parser.value("metrics-socket"), "error", metrics->errorString());
+    }
+
+    if(parser.isSet("live-feed"))
+        manager.openLiveFeed(parser.value("live-feed"), parser.value("live-feed-size").toUInt());
+
+    if(parser.isSet("pine-url")) {
+        QString queue = parser.value("pine-queue");
+        if(queue.isEmpty())
+            queue = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).filePath("pine-queue");
+        PineUploader *uploader = new PineUploader(&manager);
+        uploader->setBatching(parser.value("pine-batch").toInt(), parser.value("pine-batch-ms").toInt());
+        if(uploader->open(QUrl(parser.value("pine-url")), queue)) {
+            QObject::connect(&manager, &SessionManager::temperatureMeasured,
+                             uploader, &PineUploader::enqueue);
+            QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                             uploader, &PineUploader::flush);
+        }
+    }
+
+    if(parser.isSet("simulate")) {
+        for(int i = 0; i < qMax(1, parser.value("simulate").toInt()); ++i)
+            manager.addTarget(SimTransport::thermometer(i).info.address());
+    }
+}
+
+}
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
+
     QCoreApplication::setOrganizationName("CLSA");
     QCoreApplication::setOrganizationDomain("clsa-elcv.ca");
     QCoreApplication::setApplicationName("pine_masimo");
 
+    // decided before the application object exists: headless never loads
+    // the widgets stack or opens a display connection
+    if(hasArgument(argc, argv, "--headless")) {
+        QCoreApplication a(argc, argv);
+
+        QCommandLineParser parser;
+        addOptions(parser);
+        parser.process(a);
+        LogGuard log(parser);
+
+        ReadingWriter writer;
+        if(!writer.open(parser.value("socket")))
+            return 1;
+
+        BLETransport *transport = createTransport(parser, &a);
+        SessionManager manager(transport);
+        configureManager(manager, parser);
+        manager.setAutoConnect(true);
+        QObject::connect(&manager, &SessionManager::temperatureMeasured,
+                         &writer, &ReadingWriter::write);
+        QObject::connect(&manager, &SessionManager::readingDecoded,
+                         &writer, &ReadingWriter::writeReading);
+        QObject::connect(&a, &QCoreApplication::aboutToQuit,
+                         &manager, &SessionManager::writeSettings);
+        QObject::connect(&manager, &SessionManager::started, [](bool ok) {
+            if(!ok)
+                QCoreApplication::exit(1);
+        });
+        manager.startAsync();
+
+        if(parser.isSet("startup-report"))
+            reportStartup(startup, "headless", transport);
+        return a.exec();
+    }
+
     QApplication a(argc, argv);
-    MainWindow w;
+
+    QCommandLineParser parser;
+    addOptions(parser);
+    parser.process(a);
+    LogGuard log(parser);
+
+    BLETransport *transport = createTransport(parser, &a);
+    MainWindow w(transport);
+    configureManager(*w.sessionManager(), parser);
+    w.setLatencyDumpPath(parser.value("latency-dump"));
+    w.setTracePath(parser.value("profile-trace"));
+    // the window comes up while the settings load and the adapters are probed
     w.show();
+    w.start();
+    if(parser.isSet("startup-report"))
+        reportStartup(startup, "gui", transport);
     return a.exec();
 }
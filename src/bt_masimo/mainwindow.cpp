@@ -1,567 +1,141 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include <QSettings>
-#include <QDebug>
-#include <QMetaEnum>
-#include <QBitArray>
-
-#include <QtBluetooth/QBluetoothLocalDevice>
-#include <QtBluetooth/QBluetoothDeviceInfo>
-#include <QtBluetooth/QLowEnergyController>
-
-// TODO have the user enter the mac address of the thermometer found on the label on
-// the underside of the device
-//
-const QString peripheralMAC = "C0:26:DA:13:B0:DF";
-
-MainWindow::MainWindow(QWidget *parent)
+#include "sessionmanager.h"
+#include "readingmodel.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+#include "trendchart.h"
+#include <QBluetoothAddress>
+#include <QMenu>
+#include <QScrollBar>
+
+MainWindow::MainWindow(BLETransport *transport, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , manager(new SessionManager(transport, this))
+    , readings(new ReadingModel(10000, this))
 {
     ui->setupUi(this);
     ui->scanButton->setEnabled(false);
     ui->connectButton->setEnabled(false);
 
-    readSettings();
-
-    QString s( "test" );
-    ui->listWidget->addItem(s);
-
-    // verify that the stored local host (client) is the one saved in settings
-    // if client is nullptr, find and assign the first local adapter
-    if(nullptr==client) {
-       QList<QBluetoothHostInfo> localAdapters = QBluetoothLocalDevice::allDevices();
-       if(localAdapters.empty()) {
-          qDebug() << "failed to find a local adapter";
-          close();
-       }
-       else {
-         client = new QBluetoothLocalDevice(localAdapters.at(0).address());
-         qDebug() << "added local adapter from list";
-       }
-    }
-    QList<QBluetoothAddress> devices = client->connectedDevices();
-    if(devices.empty()) {
-        qDebug() << "client has no connected devices";
-    } else {
-        qDebug() << "client has " << QString::number(devices.count()) << " devices";
-    }
-
-    agent = new QBluetoothDeviceDiscoveryAgent(this);
-
-    connect(agent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered,
-            this, &MainWindow::deviceDiscovered);
-    connect(agent, QOverload<QBluetoothDeviceDiscoveryAgent::Error>::of(&QBluetoothDeviceDiscoveryAgent::error),
-            this, &MainWindow::deviceScanError);
-    connect(agent, &QBluetoothDeviceDiscoveryAgent::finished,
-            this, &MainWindow::deviceDiscoveryComplete);
-    agent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
-
+    ui->readingView->setModel(readings);
+    trends = new TrendChart(300, ui->trendArea);
+    ui->trendArea->setWidget(trends);
+    ui->splitter->setStretchFactor(0, 3);
+    ui->splitter->setStretchFactor(1, 2);
+
+    // follow new readings unless the user has scrolled back
+    connect(readings, &ReadingModel::rowsAboutToBeInserted, this, [this]() {
+        const QScrollBar *bar = ui->readingView->verticalScrollBar();
+        followReadings = bar->value() == bar->maximum();
+    });
+    connect(readings, &ReadingModel::rowsInserted, this, [this]() {
+        if(followReadings)
+            ui->readingView->scrollToBottom();
+    });
+
+    connect(manager, &SessionManager::sessionAdded,
+            this, &MainWindow::updateConnectButton);
+    connect(manager, &SessionManager::sessionStateChanged,
+            this, &MainWindow::updateConnectButton);
+    connect(manager, &SessionManager::temperatureMeasured,
+            readings, &ReadingModel::appendTemperature);
+    connect(manager, &SessionManager::temperatureMeasured,
+            this, &MainWindow::temperatureMeasured);
+    connect(manager, &SessionManager::readingDecoded,
+            readings, &ReadingModel::appendReading);
+    connect(manager, &SessionManager::readingDecoded,
+            this, &MainWindow::readingDecoded);
+    connect(manager, &SessionManager::signalAssessed,
+            this, &MainWindow::signalAssessed);
+
+    connect(manager, &SessionManager::started, this, [this](bool ok) {
+        if(!ok)
+            ui->statusbar->showMessage(tr("No usable Bluetooth adapter"));
+    });
+
+    connect(ui->connectButton, &QPushButton::clicked,
+            manager, &SessionManager::connectAll);
+
+    QMenu *diagnostics = ui->menubar->addMenu(tr("&Diagnostics"));
+    diagnostics->addAction(tr("Dump latency histograms"), this, [this]() {
+        if(!latencyDumpPath.isEmpty() && manager->dumpLatency(latencyDumpPath))
+            ui->statusbar->showMessage(tr("Latency histograms written to %1").arg(latencyDumpPath), 5000);
+    });
+    diagnostics->addAction(tr("Write slot trace"), this, [this]() {
+        if(!tracePath.isEmpty() && SlotProfiler::writeChromeTrace(tracePath))
+            ui->statusbar->showMessage(tr("Slot trace written to %1").arg(tracePath), 5000);
+    });
 }
 
 MainWindow::~MainWindow()
 {
     delete ui;
-    if(nullptr!=client) {
-      delete client;
-    }
-    if(nullptr!=peripheral) {
-      delete peripheral;
-    }
-    if(nullptr!=agent) {
-      delete agent;
-    }
-    if(nullptr!=controller) {
-      delete controller;
-    }
 }
 
-void MainWindow::readSettings()
+void MainWindow::start()
 {
-   QSettings settings("/home/dean/Documents/repository/pine_plus/bt.ini",QSettings::IniFormat);
-   QString address = settings.value("client/address").toString();
-   if(!address.isEmpty()) {
-     client = new QBluetoothLocalDevice(QBluetoothAddress(address));
-
-     if(!client->isValid()) {
-         qDebug() << "client is invalid";
-         close();
-     }
-     client->setHostMode(settings.value("client/hostmode").value<QBluetoothLocalDevice::HostMode>());
-     qDebug() << "constructed client from settings file";
-
-     //QBluetoothLocalDevice::HostMode mode = client->hostMode();
-
-     if(client->hostMode()==QBluetoothLocalDevice::HostPoweredOff)
-     {
-         qDebug() << "client is powered off";
-         client->powerOn();
-     }
-     if(client->hostMode()!=QBluetoothLocalDevice::HostDiscoverable)
-     {
-         qDebug() << "setting client host mode to host discoverable";
-         client->setHostMode(QBluetoothLocalDevice::HostDiscoverable);
-     }
-
-     /*
-     else if (mode==QBluetoothLocalDevice::HostConnectable)
-         qDebug() << "client is host connectable";
-     else if (mode==QBluetoothLocalDevice::HostDiscoverable)
-         qDebug() << "client is host discoverable";
-     else if (mode==QBluetoothLocalDevice::HostDiscoverableLimitedInquiry)
-         qDebug() << "client is host discoverable limited inquiry";
-     else
-         qDebug() << "unknown client host mode";
-     */
-   }
-
-   address = settings.value("peripheral/address").toString();
-   if(!address.isEmpty()) {
-     //client = new QBluetoothLocalDevice(QBluetoothAddress(address));
-     qDebug() << "constructed peripheral from settings file";
-   }
-
-}
-
-void MainWindow::writeSettings()
-{
-   QSettings settings("/home/dean/Documents/repository/pine_plus/bt.ini",QSettings::IniFormat);
-   if(nullptr!=client) {
-     settings.setValue("client/name",client->name());
-     settings.setValue("client/address",client->address().toString());
-     settings.setValue("client/hostmode",client->hostMode());
-     qDebug() << "wrote client to settings file";
-   }
-   if(nullptr!=peripheral) {
-     settings.setValue("peripheral/name",peripheral->name());
-     settings.setValue("peripheral/address",peripheral->address().toString());
-     qDebug() << "wrote peripheral to settings file";
-   }
+    manager->startAsync();
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    qDebug() << "close event called";
-    writeSettings();
+    PROFILE_SLOT("MainWindow::closeEvent");
+    LOG_DEBUG("ui.close");
+    manager->writeSettings();
     event->accept();
 }
 
-void MainWindow::deviceDiscovered(const QBluetoothDeviceInfo &info)
+void MainWindow::temperatureMeasured(const QString &address, const TemperatureMeasurement &m)
 {
-    qDebug() << "Found new device:" << info.name() << '(' << info.address().toString() << ')';
-
-    // we can stop the scanning once we find our target device
-    if(info.address().toString()==peripheralMAC) {
-        qDebug() << "Found target peripheal with MAC " << info.address().toString() << " ... stopping scan";
-        agent->stop();
-        peripheral = new QBluetoothDeviceInfo(info);
-        controller = QLowEnergyController::createCentral(*peripheral);
-
-        connect(controller, &QLowEnergyController::connected,
-                this,&MainWindow::discoverServices);
-
-        connect(controller, &QLowEnergyController::disconnected,
-                this,&MainWindow::deviceDisconnected);
-
-        connect(controller, &QLowEnergyController::serviceDiscovered,
-                this, &MainWindow::serviceDiscovered);
-
-        connect(controller, QOverload<QLowEnergyController::Error>::of(&QLowEnergyController::error),
-                this, &MainWindow::serviceScanError);
-
-        connect(controller, &QLowEnergyController::discoveryFinished,
-                this, &MainWindow::serviceDiscoveryComplete);
-
-        controller->setRemoteAddressType(QLowEnergyController::PublicAddress);
-
-        ui->connectButton->setEnabled(true);
-
-        connect(ui->connectButton,&QPushButton::clicked,
-            this,[this](){
-            qDebug() << "controller connecting to device";
-            controller->connectToDevice();
-            });
-    }
-}
-
-void MainWindow::deviceDiscoveryComplete()
-{
-    // list all the devices
-    QList<QBluetoothDeviceInfo> devices = agent->discoveredDevices();
-    qDebug() << "Found " << QString::number(devices.count()) << " devices";
-}
-
-void MainWindow::deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error)
-{
-    if (error == QBluetoothDeviceDiscoveryAgent::PoweredOffError)
-        qDebug() << "The Bluetooth adaptor is powered off, power it on before doing discovery.";
-    else if (error == QBluetoothDeviceDiscoveryAgent::InputOutputError)
-        qDebug() << "Writing or reading from the device resulted in an error.";
-    else {
-        static QMetaEnum qme = agent->metaObject()->enumerator(
-                    agent->metaObject()->indexOfEnumerator("Error"));
-        qDebug() << "Error: " << QLatin1String(qme.valueToKey(error));
-    }
-
-//    m_deviceScanState = false;
-//    emit devicesUpdated();
-//    emit stateChanged();
-}
-
-void MainWindow::deviceDisconnected()
-{
-    ui->connectButton->setEnabled(true);
-    qDebug() << (nullptr==controller ? "controller not activated error" : "controller disconnected from peripheral");
-}
-
-void MainWindow::discoverServices()
-{
-    ui->connectButton->setEnabled(false); // we are connected, so dont allow repeated connect button clicks until we disconnect
-    qDebug() << (controller->remoteAddressType()==QLowEnergyController::RandomAddress ? "remote address type" : "public address type");
-    qDebug() << "controller finding device services";
-    controller->discoverServices();
+    PROFILE_SLOT("MainWindow::temperatureMeasured");
+    if(m.isValid())
+        trends->addPoint(QBluetoothAddress(address).toUInt64(),
+                         m.isFahrenheit() ? QStringLiteral("temperature F") : QStringLiteral("temperature C"), m.value);
 }
 
-void MainWindow::serviceDiscovered(const QBluetoothUuid &serviceUuid)
+void MainWindow::readingDecoded(const QString &address, const GattReading &reading)
 {
-  qDebug() << "service discovered ";
-  if(serviceUuid == QBluetoothUuid(QBluetoothUuid::HealthThermometer))
-  {
-      qDebug() << "discovered the health thermometer service";
-      foundThermometer = true;
-  }
+    PROFILE_SLOT("MainWindow::readingDecoded");
+    const GattDecoder::Entry *decoder = GattDecoder::find(reading);
+    if(nullptr!=decoder && reading.isValid(0))
+        trends->addPoint(QBluetoothAddress(address).toUInt64(),
+                         QLatin1String(decoder->values[0]), reading.values[0]);
 }
 
-void MainWindow::serviceDiscoveryComplete()
+void MainWindow::signalAssessed(const QString &address, const SignalQuality::Result &result)
 {
-  qDebug() << "controller service discovery complete";
-
-  //
-  if(!foundThermometer)
-  {
-      qDebug() << "error: did not discover the health thermometer service";
-      return;
-  }
-
-  QLowEnergyService *service = controller->createServiceObject(QBluetoothUuid(QBluetoothUuid::HealthThermometer));
-  if (!service) {
-      qDebug() << "Cannot create service for thermometer";
-      return;
-  }
-
-  connect(service, &QLowEnergyService::stateChanged, this, &MainWindow::serviceDetailsState);
-
-  connect(service, &QLowEnergyService::characteristicChanged, this, &MainWindow::updateTemperatureValue);
-
-  connect(service, &QLowEnergyService::descriptorWritten, this, &MainWindow::confirmedDescriptorWrite);
-
-  service->discoverDetails();
-}
-
-void MainWindow::confirmedDescriptorWrite(const QLowEnergyDescriptor& d, const QByteArray& a)
-{
-   qDebug() << "confirmed descriptor write with value: " << BLEInfo::valueToString(a);
-
-   if(d.isValid() && a == QByteArray::fromHex("0100"))
-   {
-      qDebug() << "success write";
-      //controller->disconnectFromDevice();
-   }
-   else
-   {
-       qDebug() << "write error";
-   }
-}
-
-void MainWindow::serviceDetailsState(QLowEnergyService::ServiceState newState)
-{
-    if (newState != QLowEnergyService::ServiceDiscovered) {
-/*
-        // do not hang in "Scanning for characteristics" mode forever
-        // in case the service discovery failed
-        // We have to queue the signal up to give UI time to even enter
-        // the above mode
-        if (newState != QLowEnergyService::DiscoveringServices) {
-            QMetaObject::invokeMethod(this, "characteristicsUpdated",
-                                      Qt::QueuedConnection);
-        }
-*/
+    PROFILE_SLOT("MainWindow::signalAssessed");
+    enum { Settling, Lost, Motion, Stable };
+    const int edge = result.dropout ? Lost : result.motion ? Motion : result.stable ? Stable : Settling;
+    // edges only, as SessionManager logs them; a repaint per reading is what the frame timers avoid
+    auto last = signalStates.find(address);
+    if(signalStates.end() != last && edge == *last)
         return;
-    }
-
-    auto service = qobject_cast<QLowEnergyService *>(sender());
-    if (!service)
-    {
-        qDebug() << "error: failed to create LE service from sender";
-        return;
-    }
-    const QLowEnergyCharacteristic tempChar = service->characteristic(QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement));
-    if (!tempChar.isValid())
-    {
-        qDebug() << "Temperature measurement data not found.";
-        return;
-    }
-
-    QLowEnergyDescriptor desc = tempChar.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
-    if (desc.isValid())
-    {
-        qDebug() << "LE descriptor found ... writing";
-        service->writeDescriptor(desc, QByteArray::fromHex("0100"));
-    }
-/*
-    const QList<QLowEnergyCharacteristic> chars = service->characteristics();
-    for (const QLowEnergyCharacteristic &ch : chars) {
-        qDebug() << "characteristic: " << ch.name() << (ch.isValid()? " valid ":" invalid ") << ", uuid: "<< BLEInfo::uuidToString(ch.uuid())<< " handle: " << BLEInfo::handleToString(ch.handle());
-        qDebug() << "permissions: " << BLEInfo::permissionToString(ch);
-        qDebug() << "contains " << QString::number(ch.descriptors().count()) << " descriptors";
-        qDebug() << "value: " << BLEInfo::valueToString(ch.value()) << " " << QString::number(ch.value().size()) << " bytes";
-
-        if(ch.descriptors().count()>0)
-        {
-          QList<QLowEnergyDescriptor> descs = ch.descriptors();
-          QLowEnergyDescriptor des = descs.at(0);
-          qDebug() << "descriptor : " <<  des.name() << (des.isValid()? " valid ":" invalid ") << ", uuid: " << BLEInfo::uuidToString(des.uuid()) << " handle: " << BLEInfo::handleToString(des.handle());
-          qDebug() << "value: " << BLEInfo::valueToString(des.value()) << " " << QString::number(des.value().size()) << " bytes";
-        }
-
-        // NOTE that desc.name() and QBluetoothUuid::descriptorToString(des.type()) produce the same result
-        //
-    }
-*/
-
-
-    /*
-
-    switch (newState) {
-    case QLowEnergyService::DiscoveringServices:
-        qDebug() << "Discovering services...";
-        break;
-    case QLowEnergyService::ServiceDiscovered:
-    {
-        setInfo(tr("Service discovered."));
-
-        const QLowEnergyCharacteristic hrChar = m_service->characteristic(QBluetoothUuid(QBluetoothUuid::HeartRateMeasurement));
-        if (!hrChar.isValid()) {
-            setError("HR Data not found.");
+    signalStates.insert(address, edge);
+
+    QString state = tr("settling");
+    if(Lost == edge)
+        state = tr("signal lost");
+    else if(Motion == edge)
+        state = tr("motion");
+    else if(Stable == edge)
+        state = tr("stable SpO2 %1% pulse %2").arg(result.acceptedSpo2, 0, 'f', 1).arg(result.acceptedPulse, 0, 'f', 0);
+    ui->statusbar->showMessage(address + " " + state, 2000);
+}
+
+void MainWindow::updateConnectButton()
+{
+    PROFILE_SLOT("MainWindow::updateConnectButton");
+    // only allow connect clicks while some found device is not connected
+    bool idle = false;
+    for(const BLESession *session : manager->sessions()) {
+        if(BLESession::Idle == session->state() || BLESession::Disconnected == session->state()
+           || BLESession::Reconnecting == session->state()) {
+            idle = true;
             break;
         }
-
-        m_notificationDesc = hrChar.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
-        if (m_notificationDesc.isValid())
-            m_service->writeDescriptor(m_notificationDesc, QByteArray::fromHex("0100"));
-
-        break;
-    }
-    default:
-        //nothing for now
-        break;
-    }
-    */
-}
-
-void MainWindow::updateTemperatureValue(const QLowEnergyCharacteristic &c, const QByteArray& a)
-{
-  qDebug() << "temperature value update";
-  if (c.uuid() != QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement) || a.isEmpty())
-  {
-      qDebug() << "update temperature error: wrong characteristic or empty data";
-      return;
-  }
-
-
-  /**
-   * The Temperature Measurement Value field may contain special float value NaN
-(0x007FFFFF) defined in IEEE 11073-20601 [4] to report an invalid result from a
-computation step or missing data due to the hardware’s inability to provide a valid
-measurement
-   *
-   * */
-  /**
-   * flags field: 8bit
-   * temperature field: sint16
-   * datetime field:
-   * year uint16
-   * month uint8
-   * day uint8
-   * hours (past midnight) uint8
-   * minutes (since start of hour) uint8
-   * seconds (since start of minute) uint8
-   * temperature type: 8bit
-   *
-   * example: 07 d3 03 00 ff e5 07 07 08 0f 22 00 01
-   * flags: 07, hex to binary = 00000111, bit 0 = 1 => Fahrenheit, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
-   * temperature: d3 03 => 03d3 = 979 => 97.9 F
-   * year: e5 07 => 07 e5 => 2021
-   * month: 07 => 7 => July (0 => month is not known)
-   * day: 08 => 8
-   * hours: 0f => 15
-   * minutes: 22 => 34
-   * seconds: 00 => 0
-   * type: 01 => ?  body, surface or room (body)
-   *
-   *
-   * example: 07d80300ffe50707090b060001
-   * flags: 07, hex to binary = 00000111, bit 0 = 1 => Fahrenheit, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
-   * temperature: d8 03 => 03d8 = 984 => 98.4 F
-   * year: e5 07 => 07 e5 => 2021
-   * month: 07 => 7 => July (0 => month is not known)
-   * day: 09 => 9
-   * hours: 0b => 11
-   * minutes: 06 => 6
-   * seconds: 00 => 0
-   * type: 01 => ?  body, surface or room (body)
-   *
-   * example: 066b0100ffe50707090c150001
-   * flags: 06, hex to binary = 00000110, bit 0 = 0 => Celsius, bit 1 = 1 => datetime available, bit 2 =1 => temperature type available
-   * temperature: 6b 01 => 016b = 363 => 36.3 V
-   * year: e5 07 => 07 e5 => 2021
-   * month: 07 => 7 => July (0 => month is not known)
-   * day: 09 => 9
-   * hours: 0c => 12
-   * minutes: 15 => 21
-   * seconds: 00 => 0
-   * type: 01 => ?  body, surface or room (body)
-   *
-   *
-   * */
-
-   // flags:
-   QBitArray f_arr = QBitArray::fromBits(a.data(),3);
-   QString t_format_str = f_arr.at(0) ? "F" : "C";
-   for(int i=0;i<f_arr.size();i++)
-   {
-       qDebug() << "flag bit number: " << QString::number(i) << " value: " << (f_arr.at(i) ? "on":"off");
-   }
-   // fahrenheit if bit 0 is on, celcius if off
-   // datetime if bit 1 is on, no datetime if off
-   // temperature type if bit 2 is on , no type if off
-
-   // temperature:
-   QByteArray t_arr = a.mid(1,2);
-   std::reverse(t_arr.begin(), t_arr.end());
-   double t_value = t_arr.toHex().toInt(nullptr,16)*0.1;
-   QString t_value_str = QString::number(t_value);
-
-   // 06 6b 01 00 ff e5 07 07 09 0c 15 00 01
-   // 0  1  2  3  4  5  6  7  8  9  10 11 12
-   // f  t1 t2 x  x  y1 y2 m  d  h  j  s  t
-
-   // datetime:
-   QByteArray y_arr = a.mid(5,2);
-   std::reverse(y_arr.begin(), y_arr.end());
-   int y_value = y_arr.toHex().toInt(nullptr,16);
-   QString y_value_str = QString::number(y_value);
-
-   int m_value = a.mid(7,1).toHex().toInt(nullptr,16);
-   QString m_value_str = (m_value < 10 ? "0" : "") + QString::number(m_value);
-
-   int d_value = a.mid(8,1).toHex().toInt(nullptr,16);
-   QString d_value_str = (d_value < 10 ? "0" : "") + QString::number(d_value);
-
-   int h_value = a.mid(9,1).toHex().toInt(nullptr,16);
-   QString h_value_str = (h_value < 10 ? "0" : "") + QString::number(h_value);
-
-   int j_value = a.mid(10,1).toHex().toInt(nullptr,16);
-   QString j_value_str = (j_value < 10 ? "0" : "") + QString::number(j_value);
-
-   int s_value = a.mid(11,1).toHex().toInt(nullptr,16);
-   QString s_value_str = (s_value < 10 ? "0" : "") + QString::number(s_value);
-
-   int t_type = a.mid(12,1).toHex().toInt(nullptr,16);
-   QString t_type_str = t_type == 1 ? "body" : "surface/room";
-
-   QStringList date_str;
-   date_str << y_value_str << m_value_str << d_value_str;
-   QStringList time_str;
-   time_str << h_value_str << j_value_str << s_value_str;
-
-   qDebug() << t_value_str << t_format_str << " (" << t_type_str << ") " << date_str.join("-") << " " << time_str.join(":");
-}
-
-void MainWindow::serviceScanError(QLowEnergyController::Error error)
-{
-     qDebug() << "controller error string: " << controller->errorString();
-
-    if (error == QLowEnergyController::UnknownError)
-        qDebug() << "An unknown error has occurred.";
-    else if (error == QLowEnergyController::UnknownRemoteDeviceError)
-        qDebug() << "The remote Bluetooth Low Energy device with the address passed to the constructor of this class cannot be found.";
-    else if (error == QLowEnergyController::NetworkError)
-        qDebug() << "The attempt to read from or write to the remote device failed.";
-    else if (error == QLowEnergyController::InvalidBluetoothAdapterError)
-        qDebug() << "The local Bluetooth device with the address passed to the constructor of this class cannot be found or there is no local Bluetooth device.";
-    else if (error == QLowEnergyController::ConnectionError)
-        qDebug() << "The attempt to connect to the remote device failed.";
-    else if (error == QLowEnergyController::AdvertisingError)
-        qDebug() << "The attempt to start advertising failed.";
-    else if (error == QLowEnergyController::RemoteHostClosedError)
-        qDebug() << "The remote device closed the connection.";
- //   else if (error == QLowEnergyController::AuthorizationError)
- //       qDebug() << "The local Bluetooth device closed the connection due to insufficient authorization.";
-
-    else {
-        static QMetaEnum qme = controller->metaObject()->enumerator(
-                    agent->metaObject()->indexOfEnumerator("Error"));
-        qDebug() << "Error: " << QLatin1String(qme.valueToKey(error));
-    }
-}
-
-
-QString BLEInfo::uuidToString(const QBluetoothUuid& uuid)
-{
-    bool success = false;
-    quint16 result16 = uuid.toUInt16(&success);
-    if (success)
-        return QStringLiteral("0x") + QString::number(result16, 16);
-
-    quint32 result32 = uuid.toUInt32(&success);
-    if (success)
-        return QStringLiteral("0x") + QString::number(result32, 16);
-
-    return uuid.toString().remove(QLatin1Char('{')).remove(QLatin1Char('}'));
-}
-
-QString BLEInfo::valueToString(const QByteArray& a)
-{
-    // Show raw string first and hex value below
-    QString result;
-    if (a.isEmpty()) {
-        result = QStringLiteral("<none>");
-        return result;
     }
-
-    result = a;
-    result += QLatin1Char('\n');
-    result += a.toHex();
-
-    return result;
-}
-
-QString BLEInfo::handleToString(const QLowEnergyHandle& h)
-{
-    return QStringLiteral("0x") + QString::number(h, 16);
-}
-
-QString BLEInfo::permissionToString(const QLowEnergyCharacteristic& c)
-{
-    QString properties = "( ";
-    uint permission = c.properties();
-    if (permission & QLowEnergyCharacteristic::Read)
-        properties += QStringLiteral(" Read");
-    if (permission & QLowEnergyCharacteristic::Write)
-        properties += QStringLiteral(" Write");
-    if (permission & QLowEnergyCharacteristic::Notify)
-        properties += QStringLiteral(" Notify");
-    if (permission & QLowEnergyCharacteristic::Indicate)
-        properties += QStringLiteral(" Indicate");
-    if (permission & QLowEnergyCharacteristic::ExtendedProperty)
-        properties += QStringLiteral(" ExtendedProperty");
-    if (permission & QLowEnergyCharacteristic::Broadcasting)
-        properties += QStringLiteral(" Broadcast");
-    if (permission & QLowEnergyCharacteristic::WriteNoResponse)
-        properties += QStringLiteral(" WriteNoResp");
-    if (permission & QLowEnergyCharacteristic::WriteSigned)
-        properties += QStringLiteral(" WriteSigned");
-    properties += " )";
-    return properties;
+    ui->connectButton->setEnabled(idle);
 }
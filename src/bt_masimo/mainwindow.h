@@ -1,66 +1,62 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QHash>
 #include <QMainWindow>
 #include <QCloseEvent>
-#include <QtBluetooth/QBluetoothDeviceDiscoveryAgent>
-#include <QtBluetooth/QLowEnergyController>
 
-QT_FORWARD_DECLARE_CLASS(QBluetoothDeviceInfo)
-QT_FORWARD_DECLARE_CLASS(QBluetoothLocalDevice)
+#include "gattdecoder.h"
+#include "signalquality.h"
+#include "thermometerdecoder.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
-extern const QString peripheralMAC;
-
-class BLEInfo : public QObject
-{
-    Q_OBJECT
-public:
-    static QString uuidToString(const QBluetoothUuid&);
-    static QString valueToString(const QByteArray&);
-    static QString handleToString(const QLowEnergyHandle&);
-    static QString permissionToString(const QLowEnergyCharacteristic&);
-};
+class BLETransport;
+class ReadingModel;
+class SessionManager;
+class TrendChart;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    MainWindow(BLETransport *transport, QWidget *parent = nullptr);
     ~MainWindow();
 
+    SessionManager *sessionManager() const { return manager; }
+
+    // start scanning once the adapter is up, which the window need not wait for;
+    // the status bar says so if no adapter is usable
+    void start();
+
+    // where Diagnostics writes the latency histograms, none when empty
+    void setLatencyDumpPath(const QString &path) { latencyDumpPath = path; }
+    // where Diagnostics writes the slot trace, none when empty
+    void setTracePath(const QString &path) { tracePath = path; }
+
 protected:
     void closeEvent(QCloseEvent *event) override;
 
 private slots:
-    void deviceDiscovered(const QBluetoothDeviceInfo &info);
-    void deviceDiscoveryComplete();
-    void deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error);
-
-    void serviceDiscovered(const QBluetoothUuid &service);
-    void serviceDiscoveryComplete();
-    void serviceScanError(QLowEnergyController::Error error);
-    void deviceDisconnected();
-    void discoverServices();
-    void serviceDetailsState(QLowEnergyService::ServiceState newState);
-
-    void updateTemperatureValue(const QLowEnergyCharacteristic &c, const QByteArray& a);
-    void confirmedDescriptorWrite(const QLowEnergyDescriptor& d, const QByteArray& a);
+    void temperatureMeasured(const QString &address, const TemperatureMeasurement &m);
+    void readingDecoded(const QString &address, const GattReading &reading);
+    void signalAssessed(const QString &address, const SignalQuality::Result &result);
 
 private:
     Ui::MainWindow *ui;
 
-    QBluetoothDeviceInfo *peripheral = nullptr;
-    QBluetoothLocalDevice *client = nullptr;
-    QBluetoothDeviceDiscoveryAgent *agent = nullptr;
-    QLowEnergyController *controller = nullptr;
-    void readSettings();
-    void writeSettings();
+    SessionManager *manager = nullptr;
+    ReadingModel *readings = nullptr;
+    TrendChart *trends = nullptr;
+    QString latencyDumpPath;
+    QString tracePath;
+    bool followReadings = true;
+    // last signal state shown per device
+    QHash<QString, int> signalStates;
 
-    bool foundThermometer = false;
+    void updateConnectButton();
 };
 #endif // MAINWINDOW_H
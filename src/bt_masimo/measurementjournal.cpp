@@ -0,0 +1,342 @@
+#include "measurementjournal.h"
+#include "replayfilter.h"
+#include "structlog.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct MeasurementJournal::Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    quint64 committed;      // records known to be on disk
+    quint64 reserved[5];
+};
+
+namespace {
+
+const char kMagic[8] = {'P', 'M', 'J', 'O', 'U', 'R', 'N', 'L'};
+const quint32 kVersion = 1;
+const qint64 kHeaderSize = 64;
+const quint64 kInitialCapacity = 65536;
+const quint64 kMaxGrowth = 1 << 20;
+
+struct Crc32Table
+{
+    quint32 entries[256];
+
+    Crc32Table()
+    {
+        for(quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+}
+
+static_assert(sizeof(MeasurementJournal::Record) == 48, "journal records are 48 bytes on disk");
+
+quint32 MeasurementJournal::crc32(const void *data, int size)
+{
+    static const Crc32Table table;
+    const uchar *p = static_cast<const uchar *>(data);
+    quint32 c = 0xFFFFFFFFu;
+    for(int i = 0; i < size; ++i)
+        c = table.entries[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+MeasurementJournal::MeasurementJournal()
+{
+    static_assert(sizeof(Header) == kHeaderSize, "journal header is 64 bytes on disk");
+}
+
+MeasurementJournal::~MeasurementJournal()
+{
+    close();
+}
+
+MeasurementJournal::Header *MeasurementJournal::header() const
+{
+    return reinterpret_cast<Header *>(m_map);
+}
+
+MeasurementJournal::Record *MeasurementJournal::records() const
+{
+    return reinterpret_cast<Record *>(m_map + kHeaderSize);
+}
+
+void MeasurementJournal::setSyncPolicy(int maxRecords, int maxMs)
+{
+    QMutexLocker locker(&m_lock);
+    m_syncRecords = qMax(0, maxRecords);
+    m_syncMs = qMax(0, maxMs);
+}
+
+bool MeasurementJournal::map(quint64 capacity)
+{
+    const qint64 size = kHeaderSize + qint64(capacity * sizeof(Record));
+    if(m_file.size() < size && !m_file.resize(size)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_map = m_file.map(0, size);
+    if(nullptr == m_map) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_capacity = capacity;
+    return true;
+}
+
+void MeasurementJournal::unmap()
+{
+    if(nullptr != m_map)
+        m_file.unmap(m_map);
+    m_map = nullptr;
+    m_capacity = 0;
+}
+
+bool MeasurementJournal::open(const QString &path)
+{
+    QMutexLocker locker(&m_lock);
+    QElapsedTimer timer;
+    timer.start();
+
+    m_file.setFileName(path);
+    if(!m_file.open(QIODevice::ReadWrite)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    m_count = m_synced = m_recovered = 0;
+    m_blocks.clear();
+    m_deviceBlocks.clear();
+
+    if(m_file.size() < kHeaderSize) {
+        if(!map(kInitialCapacity)) {
+            m_file.close();
+            return false;
+        }
+        Header *h = header();
+        std::memset(h, 0, sizeof(Header));
+        std::memcpy(h->magic, kMagic, sizeof(kMagic));
+        h->version = kVersion;
+        h->recordSize = sizeof(Record);
+        syncRange(0, 0);
+    } else {
+        if(!map(quint64(m_file.size() - kHeaderSize) / sizeof(Record))) {
+            m_file.close();
+            return false;
+        }
+        const Header *h = header();
+        if(0 != std::memcmp(h->magic, kMagic, sizeof(kMagic)) || kVersion != h->version
+           || sizeof(Record) != h->recordSize) {
+            m_error = QStringLiteral("not a measurement journal");
+            unmap();
+            m_file.close();
+            return false;
+        }
+
+        // trust the synced prefix once its last record checks out, verify the rest
+        quint64 committed = qMin(h->committed, m_capacity);
+        if(0 < committed && !valid(committed - 1))
+            committed = 0;
+        quint64 end = committed;
+        while(end < m_capacity && valid(end))
+            ++end;
+        m_count = end;
+        m_recovered = end - committed;
+
+        // wipe what a torn write left behind so older records further on can
+        // never be mistaken for new ones
+        quint64 wiped = end;
+        for(; wiped < m_capacity; ++wiped) {
+            Record *r = records() + wiped;
+            if(0 == r->sequence && 0 == r->crc)
+                break;
+            std::memset(r, 0, sizeof(Record));
+        }
+
+        for(quint64 i = 0; i < m_count; ++i)
+            index(i);
+        // the wipe too, or a power loss could bring the stale records back
+        flushRecords(end, wiped);
+        syncRange(committed, m_count);
+        if(0 < m_recovered)
+            LOG_WARNING("journal.recovered", "path", path, "readings", m_recovered);
+    }
+
+    m_sinceSync.start();
+    m_recoveryNs = timer.nsecsElapsed();
+    return true;
+}
+
+void MeasurementJournal::close()
+{
+    QMutexLocker locker(&m_lock);
+    if(nullptr == m_map)
+        return;
+    syncRange(m_synced, m_count);
+    unmap();
+    m_file.close();
+}
+
+bool MeasurementJournal::valid(quint64 i) const
+{
+    const Record *r = records() + i;
+    return i == r->sequence && r->crc == crc32(r, offsetof(Record, crc));
+}
+
+void MeasurementJournal::index(quint64 i)
+{
+    const Record &r = records()[i];
+    const quint32 block = quint32(i / kBlockRecords);
+    if(block == quint32(m_blocks.size())) {
+        Block b;
+        b.minMs = b.maxMs = r.receivedMs;
+        m_blocks << b;
+    } else {
+        Block &b = m_blocks[int(block)];
+        b.minMs = qMin(b.minMs, r.receivedMs);
+        b.maxMs = qMax(b.maxMs, r.receivedMs);
+    }
+
+    QVector<quint32> &blocks = m_deviceBlocks[r.address];
+    if(blocks.isEmpty() || blocks.last() != block)
+        blocks << block;
+}
+
+bool MeasurementJournal::append(quint64 address, qint64 receivedMs, const TemperatureMeasurement &m)
+{
+    QMutexLocker locker(&m_lock);
+    if(nullptr == m_map)
+        return false;
+
+    if(m_count == m_capacity) {
+        // everything written so far goes to disk before the mapping moves
+        syncRange(m_synced, m_count);
+        // a file cut short inside its first record opens with nothing mapped
+        const quint64 capacity = qMax(kInitialCapacity, m_capacity + qMin(m_capacity, kMaxGrowth));
+        unmap();
+        if(!map(capacity)) {
+            LOG_ERROR("journal.grow_failed", "readings", m_count, "capacity", capacity, "error", m_error);
+            map(m_count);
+            return false;
+        }
+    }
+
+    Record *r = records() + m_count;
+    r->sequence = m_count;
+    r->receivedMs = receivedMs;
+    r->deviceMs = DeviceClock::deviceMs(m);
+    r->address = address;
+    r->value = m.value;
+    r->flags = m.flags;
+    r->type = m.type;
+    r->status = m.status;
+    r->reserved = 0;
+    r->crc = crc32(r, offsetof(Record, crc));
+    index(m_count);
+    ++m_count;
+
+    if((0 < m_syncRecords && m_count - m_synced >= quint64(m_syncRecords))
+       || (0 < m_syncMs && m_sinceSync.elapsed() >= m_syncMs))
+        syncRange(m_synced, m_count);
+    return true;
+}
+
+void MeasurementJournal::sync()
+{
+    QMutexLocker locker(&m_lock);
+    if(nullptr != m_map)
+        syncRange(m_synced, m_count);
+}
+
+void MeasurementJournal::syncIfDue()
+{
+    QMutexLocker locker(&m_lock);
+    if(nullptr != m_map && m_synced < m_count && 0 < m_syncMs && m_sinceSync.elapsed() >= m_syncMs)
+        syncRange(m_synced, m_count);
+}
+
+void MeasurementJournal::flushRecords(quint64 from, quint64 to)
+{
+#ifdef Q_OS_UNIX
+    static const quintptr page = quintptr(::sysconf(_SC_PAGESIZE));
+    if(from < to) {
+        const quintptr begin = quintptr(records() + from) & ~(page - 1);
+        const quintptr end = quintptr(records() + to);
+        if(0 != ::msync(reinterpret_cast<void *>(begin), end - begin, MS_SYNC))
+            LOG_ERROR("journal.sync_failed", "from", from, "to", to, "errno", errno);
+    }
+#else
+    // the mapping is flushed by the OS
+    Q_UNUSED(from)
+    Q_UNUSED(to)
+#endif
+}
+
+void MeasurementJournal::syncRange(quint64 from, quint64 to)
+{
+    m_sinceSync.restart();
+#ifdef Q_OS_UNIX
+    // records first, then the header that vouches for them
+    flushRecords(from, to);
+    header()->committed = to;
+    ::msync(m_map, sizeof(Header), MS_SYNC);
+#else
+    // no msync: the mapping is flushed by the OS, only the header is kept current
+    Q_UNUSED(from)
+    header()->committed = to;
+#endif
+    m_synced = to;
+}
+
+quint64 MeasurementJournal::count() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_count;
+}
+
+QVector<MeasurementJournal::Record> MeasurementJournal::query(qint64 fromMs, qint64 toMs, quint64 address) const
+{
+    QMutexLocker locker(&m_lock);
+    QVector<Record> result;
+    if(nullptr == m_map)
+        return result;
+
+    QVector<quint32> candidates;
+    if(0 != address) {
+        candidates = m_deviceBlocks.value(address);
+    } else {
+        candidates.reserve(m_blocks.size());
+        for(int b = 0; b < m_blocks.size(); ++b)
+            candidates << quint32(b);
+    }
+
+    for(quint32 block : qAsConst(candidates)) {
+        const Block &b = m_blocks.at(int(block));
+        if(b.maxMs < fromMs || b.minMs > toMs)
+            continue;
+        const quint64 first = quint64(block) * kBlockRecords;
+        const quint64 last = qMin(first + kBlockRecords, m_count);
+        for(quint64 i = first; i < last; ++i) {
+            const Record &r = records()[i];
+            if(r.receivedMs >= fromMs && r.receivedMs <= toMs && (0 == address || address == r.address))
+                result << r;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,104 @@
+#ifndef MEASUREMENTJOURNAL_H
+#define MEASUREMENTJOURNAL_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "thermometerdecoder.h"
+
+/**
+ * Append-only journal of readings in a memory-mapped file of fixed-size,
+ * CRC-protected records. Records are made durable (msync) after a bounded
+ * number of records or milliseconds, whichever comes first; the header
+ * remembers how far that got so opening after a crash only verifies the
+ * tail. A sparse index of 1024-record blocks (time span per block, blocks
+ * per device) is rebuilt on open and answers range queries without
+ * scanning the whole file.
+ */
+class MeasurementJournal
+{
+public:
+    struct Record
+    {
+        quint64 sequence;     // position in the journal, guards against stale bytes
+        qint64  receivedMs;   // UTC ms since the epoch when the notification arrived
+        qint64  deviceMs;     // device clock as UTC ms, 0 without a timestamp field
+        quint64 address;      // 48-bit peripheral address
+        double  value;
+        quint8  flags;        // TemperatureMeasurement::Flag, carries the unit
+        quint8  type;
+        quint8  status;
+        quint8  reserved;
+        quint32 crc;          // CRC-32 of the bytes above
+
+        bool isFahrenheit() const { return flags & TemperatureMeasurement::Fahrenheit; }
+    };
+
+    MeasurementJournal();
+    ~MeasurementJournal();
+    MeasurementJournal(const MeasurementJournal &) = delete;
+    MeasurementJournal &operator=(const MeasurementJournal &) = delete;
+
+    // create or recover the journal at path
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return nullptr != m_map; }
+    QString errorString() const { return m_error; }
+
+    // at most maxRecords readings or maxMs milliseconds are lost on power failure, 0 disables that bound
+    void setSyncPolicy(int maxRecords, int maxMs);
+
+    bool append(quint64 address, qint64 receivedMs, const TemperatureMeasurement &m);
+    void sync();
+    // sync when the time bound has passed, for callers that are idle between appends
+    void syncIfDue();
+
+    quint64 count() const;
+    // records past the last sync found valid when the journal was opened, and how long opening took
+    quint64 recoveredRecords() const { return m_recovered; }
+    qint64 recoveryNs() const { return m_recoveryNs; }
+
+    // readings received in [fromMs, toMs], all devices when address is 0
+    QVector<Record> query(qint64 fromMs, qint64 toMs, quint64 address = 0) const;
+
+    static quint32 crc32(const void *data, int size);
+
+private:
+    struct Header;
+    struct Block {
+        qint64 minMs;
+        qint64 maxMs;
+    };
+
+    static const int kBlockRecords = 1024;
+
+    bool map(quint64 capacity);
+    void unmap();
+    bool valid(quint64 index) const;
+    void index(quint64 index);
+    void flushRecords(quint64 from, quint64 to);
+    void syncRange(quint64 from, quint64 to);
+    Header *header() const;
+    Record *records() const;
+
+    mutable QMutex m_lock;
+    QFile m_file;
+    uchar *m_map = nullptr;
+    quint64 m_capacity = 0;
+    quint64 m_count = 0;
+    quint64 m_synced = 0;
+    quint64 m_recovered = 0;
+    qint64 m_recoveryNs = 0;
+    int m_syncRecords = 4096;
+    int m_syncMs = 1000;
+    QElapsedTimer m_sinceSync;
+    QString m_error;
+
+    QVector<Block> m_blocks;
+    QHash<quint64, QVector<quint32> > m_deviceBlocks;
+};
+
+#endif // MEASUREMENTJOURNAL_H
@@ -0,0 +1,288 @@
+#include "metrics.h"
+#include "latencyhistogram.h"
+#include "slotprofiler.h"
+
+#include <QHostAddress>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QMutex>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+
+#include <cmath>
+
+namespace {
+
+struct Series
+{
+    QByteArray labels;
+    MetricsCounter *counter = nullptr;          // never freed, callers hold the pointer
+    Metrics::Sampler sampler;
+    const LatencyHistogram *histogram = nullptr;
+    QPointer<QObject> owner;
+    bool owned = false;                         // drop once owner is gone
+};
+
+struct Family
+{
+    QByteArray help;
+    const char *type = "";
+    QVector<Series> series;
+};
+
+struct Registry
+{
+    QMutex lock;
+    QMap<QByteArray, Family> families;          // sorted, the exposition is stable
+};
+
+Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+Family &family(Registry &r, const char *name, const char *help, const char *type)
+{
+    Family &f = r.families[QByteArray(name)];
+    if(f.help.isEmpty()) {
+        f.help = QByteArray(help).replace('\\', "\\\\").replace('\n', "\\n");
+        f.type = type;
+    }
+    return f;
+}
+
+Series *find(Family &f, const QByteArray &labels)
+{
+    for(Series &s : f.series) {
+        if(s.labels == labels)
+            return &s;
+    }
+    return nullptr;
+}
+
+QByteArray number(double value)
+{
+    if(std::isnan(value))
+        return "NaN";
+    if(std::isinf(value))
+        return value > 0 ? "+Inf" : "-Inf";
+    // integers exactly, counters and depths are the common case
+    if(value == std::floor(value) && std::fabs(value) < 9007199254740992.0)
+        return QByteArray::number(qint64(value));
+    return QByteArray::number(value, 'g', 12);
+}
+
+void line(QByteArray &out, const QByteArray &name, const QByteArray &labels, const QByteArray &value)
+{
+    out += name;
+    if(!labels.isEmpty())
+        out += '{' + labels + '}';
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+}
+
+MetricsCounter::MetricsCounter()
+{
+    for(Shard &s : m_shards)
+        s.value.store(0, std::memory_order_relaxed);
+}
+
+quint64 MetricsCounter::value() const
+{
+    quint64 sum = 0;
+    for(const Shard &s : m_shards)
+        sum += s.value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+int MetricsCounter::shard()
+{
+    static std::atomic<int> next {0};
+    thread_local const int index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return index;
+}
+
+MetricsCounter *Metrics::counter(const char *name, const char *help, const QByteArray &labels)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.lock);
+    Family &f = family(r, name, help, "counter");
+    if(Series *s = find(f, labels)) {
+        if(nullptr != s->counter)
+            return s->counter;
+    }
+    Series s;
+    s.labels = labels;
+    s.counter = new MetricsCounter;
+    f.series << s;
+    return s.counter;
+}
+
+void Metrics::sample(const QObject *owner, Type type, const char *name, const char *help,
+                     const Sampler &sampler, const QByteArray &labels)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.lock);
+    Family &f = family(r, name, help, Counter == type ? "counter" : "gauge");
+    Series *s = find(f, labels);
+    if(nullptr == s) {
+        f.series << Series();
+        s = &f.series.last();
+        s->labels = labels;
+    }
+    s->sampler = sampler;
+    s->owner = const_cast<QObject *>(owner);
+    s->owned = nullptr != owner;
+}
+
+void Metrics::summary(const QObject *owner, const char *name, const char *help,
+                      const LatencyHistogram *histogram, const QByteArray &labels)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.lock);
+    Family &f = family(r, name, help, "summary");
+    Series *s = find(f, labels);
+    if(nullptr == s) {
+        f.series << Series();
+        s = &f.series.last();
+        s->labels = labels;
+    }
+    s->histogram = histogram;
+    s->owner = const_cast<QObject *>(owner);
+    s->owned = nullptr != owner;
+}
+
+QByteArray Metrics::label(const char *key, const QString &value)
+{
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return QByteArray(key) + "=\"" + escaped + '"';
+}
+
+QByteArray Metrics::exposition()
+{
+    static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    Registry &r = registry();
+    QMutexLocker locker(&r.lock);
+    QByteArray out;
+    out.reserve(16384);
+    for(auto it = r.families.begin(); it != r.families.end(); ++it) {
+        Family &f = it.value();
+        for(int i = f.series.size() - 1; i >= 0; --i) {
+            if(f.series[i].owned && f.series[i].owner.isNull())
+                f.series.remove(i);
+        }
+        if(f.series.isEmpty())
+            continue;
+
+        const QByteArray &name = it.key();
+        out += "# HELP " + name + ' ' + f.help + '\n';
+        out += "# TYPE " + name + ' ' + f.type + '\n';
+        for(const Series &s : qAsConst(f.series)) {
+            if(nullptr != s.histogram) {
+                const QByteArray separator = s.labels.isEmpty() ? QByteArray() : QByteArray(",");
+                for(double q : kQuantiles)
+                    line(out, name, s.labels + separator + "quantile=\"" + QByteArray::number(q) + '"',
+                         number(s.histogram->percentile(q) / 1e6));
+                const quint64 count = s.histogram->count();
+                line(out, name + "_sum", s.labels, number(s.histogram->mean() * double(count) / 1e6));
+                line(out, name + "_count", s.labels, QByteArray::number(count));
+            } else if(nullptr != s.counter) {
+                line(out, name, s.labels, QByteArray::number(s.counter->value()));
+            } else if(s.sampler) {
+                line(out, name, s.labels, number(s.sampler()));
+            }
+        }
+    }
+    return out;
+}
+
+MetricsServer::MetricsServer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+    if(nullptr == m_tcp) {
+        m_tcp = new QTcpServer(this);
+        connect(m_tcp, &QTcpServer::newConnection, this, &MetricsServer::acceptTcp);
+    }
+    if(!m_tcp->listen(QHostAddress::LocalHost, port)) {
+        m_error = m_tcp->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MetricsServer::listenLocal(const QString &name)
+{
+    if(nullptr == m_local) {
+        m_local = new QLocalServer(this);
+        connect(m_local, &QLocalServer::newConnection, this, &MetricsServer::acceptLocal);
+    }
+    // a socket file left by a crashed run would make listen fail
+    QLocalServer::removeServer(name);
+    if(!m_local->listen(name)) {
+        m_error = m_local->errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::acceptTcp()
+{
+    while(QTcpSocket *socket = m_tcp->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        serve(socket);
+    }
+}
+
+void MetricsServer::acceptLocal()
+{
+    while(QLocalSocket *socket = m_local->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        serve(socket);
+    }
+}
+
+void MetricsServer::serve(QIODevice *socket)
+{
+    QByteArray *request = new QByteArray;
+    connect(socket, &QObject::destroyed, [request]() { delete request; });
+    connect(socket, &QIODevice::readyRead, this, [this, socket, request]() {
+        PROFILE_SLOT("MetricsServer::scrape");
+        *request += socket->readAll();
+        // only the request line matters, but answer once the headers are in
+        const bool complete = request->contains("\r\n\r\n") || request->contains("\n\n");
+        if(!complete && request->size() < 8192)
+            return;
+
+        const bool found = request->startsWith("GET /metrics") || request->startsWith("GET / ");
+        const QByteArray body = found ? Metrics::exposition() : QByteArray("not found\n");
+        QByteArray response = found
+            ? "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            : "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+        response += "Content-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n";
+        response += body;
+        socket->write(response);
+        if(found)
+            ++m_scrapes;
+
+        request->clear();
+        socket->disconnect(this);
+        // both close once the response is written
+        if(QTcpSocket *tcp = qobject_cast<QTcpSocket *>(socket))
+            tcp->disconnectFromHost();
+        else if(QLocalSocket *local = qobject_cast<QLocalSocket *>(socket))
+            local->disconnectFromServer();
+    });
+}
@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QtGlobal>
+
+#include <atomic>
+#include <functional>
+
+class LatencyHistogram;
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+/**
+ * A monotonically increasing count that any thread may bump. The count is
+ * spread over cache-line sized shards and each thread sticks to one, so
+ * threads incrementing the same counter do not fight over a line; add() is
+ * one relaxed fetch_add on memory the thread usually owns already. Reading
+ * sums the shards and is only for the scrape.
+ */
+class MetricsCounter
+{
+public:
+    MetricsCounter();
+    MetricsCounter(const MetricsCounter &) = delete;
+    MetricsCounter &operator=(const MetricsCounter &) = delete;
+
+    void add(quint64 n = 1) { m_shards[shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const;
+
+    static const int kShards = 16;
+
+private:
+    struct Shard {
+        std::atomic<quint64> value;
+        char pad[64 - sizeof(std::atomic<quint64>)];
+    };
+
+    // threads are dealt shards round robin on first use
+    static int shard();
+
+    Shard m_shards[kShards];
+};
+
+/**
+ * The process-wide set of metrics, exposed in the Prometheus text format.
+ * Counters are created on first use and live as long as the process, so
+ * the hot paths keep a pointer in a function-local static:
+ *
+ *     static MetricsCounter *const seen = Metrics::counter("pine_advertisements_total", "...");
+ *     seen->add();
+ *
+ * Everything that already keeps its own numbers (queues, the uploader)
+ * registers a sampler instead, called on the scraping thread while its
+ * owner is alive, so it costs nothing between scrapes.
+ */
+class Metrics
+{
+public:
+    enum Type { Counter, Gauge };
+
+    typedef std::function<double()> Sampler;
+
+    // labels are the text between the braces, see label()
+    static MetricsCounter *counter(const char *name, const char *help, const QByteArray &labels = QByteArray());
+    // replaces an earlier sampler for the same name and labels
+    static void sample(const QObject *owner, Type type, const char *name, const char *help,
+                       const Sampler &sampler, const QByteArray &labels = QByteArray());
+    // quantiles, sum and count of a histogram in microseconds, exposed in seconds
+    static void summary(const QObject *owner, const char *name, const char *help,
+                        const LatencyHistogram *histogram, const QByteArray &labels = QByteArray());
+
+    // key="value" with the value escaped
+    static QByteArray label(const char *key, const QString &value);
+
+    // every metric in the text exposition format, version 0.0.4
+    static QByteArray exposition();
+};
+
+/**
+ * Answers HTTP GETs with Metrics::exposition(), on a loopback TCP port for
+ * Prometheus or on a local socket for agents on the station. Scrapes run on
+ * the thread the server lives on.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+
+    // 127.0.0.1 only, there is no authentication
+    bool listen(quint16 port);
+    // a Unix domain socket path or local server name
+    bool listenLocal(const QString &name);
+    QString errorString() const { return m_error; }
+
+    quint64 scrapes() const { return m_scrapes; }
+
+private slots:
+    void acceptTcp();
+    void acceptLocal();
+
+private:
+    void serve(QIODevice *socket);
+
+    QTcpServer *m_tcp = nullptr;
+    QLocalServer *m_local = nullptr;
+    QString m_error;
+    quint64 m_scrapes = 0;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,384 @@
+#include "nativetransport.h"
+#include "bleinfo.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+#include <QMetaEnum>
+#include <QTimer>
+
+#include <QtBluetooth/QBluetoothLocalDevice>
+
+NativeLink::NativeLink(const QBluetoothDeviceInfo &info, const QBluetoothAddress &localAdapter, QObject *parent)
+    : BLELink(parent)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    // the controller of the adapter the pool assigned, not the system default
+    controller = localAdapter.isNull() ? QLowEnergyController::createCentral(info, this)
+                                       : QLowEnergyController::createCentral(info, localAdapter, this);
+#else
+    Q_UNUSED(localAdapter)
+    controller = QLowEnergyController::createCentral(info, this);
+#endif
+
+    connect(controller, &QLowEnergyController::connected,
+            this, &BLELink::connected);
+
+    connect(controller, &QLowEnergyController::disconnected,
+            this, [this]() {
+        clearServices();
+        emit disconnected();
+    });
+
+    connect(controller, &QLowEnergyController::serviceDiscovered,
+            this, &BLELink::serviceDiscovered);
+
+    connect(controller, QOverload<QLowEnergyController::Error>::of(&QLowEnergyController::error),
+            this, &NativeLink::controllerError);
+
+    connect(controller, &QLowEnergyController::discoveryFinished,
+            this, &BLELink::discoveryFinished);
+
+    connect(controller, &QLowEnergyController::connectionUpdated,
+            this, &BLELink::connectionUpdated);
+
+    controller->setRemoteAddressType(QLowEnergyController::PublicAddress);
+}
+
+NativeLink::~NativeLink()
+{
+    qDeleteAll(services);
+}
+
+void NativeLink::retireService(QLowEnergyService *service)
+{
+    // later, this can run inside one of the service's own signals
+    service->disconnect(this);
+    service->deleteLater();
+}
+
+void NativeLink::clearServices()
+{
+    // service objects are only valid for the connection that discovered them
+    for(QLowEnergyService *service : qAsConst(services))
+        retireService(service);
+    services.clear();
+}
+
+void NativeLink::connectToDevice()
+{
+    if(controller->state() != QLowEnergyController::UnconnectedState)
+        return;
+    controller->connectToDevice();
+}
+
+void NativeLink::disconnectFromDevice()
+{
+    controller->disconnectFromDevice();
+}
+
+bool NativeLink::isConnected() const
+{
+    return controller->state() == QLowEnergyController::ConnectedState
+        || controller->state() == QLowEnergyController::DiscoveringState
+        || controller->state() == QLowEnergyController::DiscoveredState;
+}
+
+void NativeLink::discoverServices()
+{
+    LOG_DEBUG("link.discover", "address", Log::mac(controller->remoteAddress().toUInt64()),
+              "random_address", controller->remoteAddressType()==QLowEnergyController::RandomAddress);
+    controller->discoverServices();
+}
+
+bool NativeLink::openService(const QBluetoothUuid &serviceUuid, DetailDiscovery mode)
+{
+    // one object per service and connection: reopening reuses it while it is valid
+    QLowEnergyService *service = services.value(serviceUuid);
+    if (nullptr != service && service->state() != QLowEnergyService::InvalidService) {
+        if (service->state() == QLowEnergyService::ServiceDiscovered)
+            QTimer::singleShot(0, this, [this, serviceUuid]() { emit serviceReady(serviceUuid); });
+        // otherwise the discovery under way answers
+        return true;
+    }
+    if (nullptr != service)
+        retireService(services.take(serviceUuid));
+
+    service = controller->createServiceObject(serviceUuid, this);
+    if (!service) {
+        LOG_WARNING("link.no_service", "service", BLEInfo::uuidToString(serviceUuid));
+        return false;
+    }
+    services.insert(serviceUuid, service);
+
+    connect(service, &QLowEnergyService::stateChanged, this, &NativeLink::serviceDetailsState);
+
+    connect(service, &QLowEnergyService::characteristicChanged,
+            this, [this](const QLowEnergyCharacteristic &c, const QByteArray &a) {
+        emit notification(c.uuid(), a);
+    });
+
+    connect(service, &QLowEnergyService::characteristicRead,
+            this, [this](const QLowEnergyCharacteristic &c, const QByteArray &a) {
+        emit characteristicRead(c.uuid(), a);
+    });
+
+    connect(service, &QLowEnergyService::descriptorWritten, this, &NativeLink::confirmedDescriptorWrite);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+    service->discoverDetails(SkipValues == mode ? QLowEnergyService::SkipValueDiscovery
+                                                : QLowEnergyService::FullDiscovery);
+#else
+    // Qt 5 always reads every readable value during discoverDetails
+    Q_UNUSED(mode)
+    service->discoverDetails();
+#endif
+    return true;
+}
+
+void NativeLink::serviceDetailsState(QLowEnergyService::ServiceState newState)
+{
+    PROFILE_SLOT("NativeLink::serviceDetailsState");
+    if (newState != QLowEnergyService::ServiceDiscovered) {
+        return;
+    }
+
+    auto service = qobject_cast<QLowEnergyService *>(sender());
+    if (!service)
+    {
+        LOG_ERROR("link.no_service_sender");
+        return;
+    }
+/*
+    const QList<QLowEnergyCharacteristic> chars = service->characteristics();
+    for (const QLowEnergyCharacteristic &ch : chars) {
+        qDebug() << "characteristic: " << ch.name() << (ch.isValid()? " valid ":" invalid ") << ", uuid: "<< BLEInfo::uuidToString(ch.uuid())<< " handle: " << BLEInfo::handleToString(ch.handle());
+        qDebug() << "permissions: " << BLEInfo::permissionToString(ch);
+        qDebug() << "contains " << QString::number(ch.descriptors().count()) << " descriptors";
+        qDebug() << "value: " << BLEInfo::valueToString(ch.value()) << " " << QString::number(ch.value().size()) << " bytes";
+
+        if(ch.descriptors().count()>0)
+        {
+          QList<QLowEnergyDescriptor> descs = ch.descriptors();
+          QLowEnergyDescriptor des = descs.at(0);
+          qDebug() << "descriptor : " <<  des.name() << (des.isValid()? " valid ":" invalid ") << ", uuid: " << BLEInfo::uuidToString(des.uuid()) << " handle: " << BLEInfo::handleToString(des.handle());
+          qDebug() << "value: " << BLEInfo::valueToString(des.value()) << " " << QString::number(des.value().size()) << " bytes";
+        }
+
+        // NOTE that desc.name() and QBluetoothUuid::descriptorToString(des.type()) produce the same result
+        //
+    }
+*/
+    emit serviceReady(service->serviceUuid());
+}
+
+bool NativeLink::enableNotifications(const QBluetoothUuid &serviceUuid, const QBluetoothUuid &characteristic)
+{
+    QLowEnergyService *service = services.value(serviceUuid);
+    if (nullptr == service || service->state() != QLowEnergyService::ServiceDiscovered)
+    {
+        LOG_WARNING("link.service_not_open", "service", BLEInfo::uuidToString(serviceUuid));
+        return false;
+    }
+
+    const QLowEnergyCharacteristic c = service->characteristic(characteristic);
+    if (!c.isValid())
+    {
+        LOG_WARNING("link.no_characteristic", "characteristic", BLEInfo::uuidToString(characteristic));
+        return false;
+    }
+
+    QLowEnergyDescriptor desc = c.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
+    if (!desc.isValid())
+    {
+        LOG_WARNING("link.no_cccd", "characteristic", BLEInfo::uuidToString(characteristic));
+        return false;
+    }
+
+    // indicate-only characteristics (PLX spot checks, blood pressure) take 0x0002
+    const bool indicate = (c.properties() & QLowEnergyCharacteristic::Indicate)
+        && !(c.properties() & QLowEnergyCharacteristic::Notify);
+    LOG_DEBUG("link.cccd_write", "characteristic", BLEInfo::uuidToString(characteristic),
+              "handle", uint(desc.handle()), "indicate", indicate);
+    service->writeDescriptor(desc, QByteArray::fromHex(indicate ? "0200" : "0100"));
+    return true;
+}
+
+bool NativeLink::readCharacteristic(const QBluetoothUuid &serviceUuid, const QBluetoothUuid &characteristic)
+{
+    QLowEnergyService *service = services.value(serviceUuid);
+    if (nullptr == service || service->state() != QLowEnergyService::ServiceDiscovered)
+        return false;
+
+    const QLowEnergyCharacteristic c = service->characteristic(characteristic);
+    if (!c.isValid() || !(c.properties() & QLowEnergyCharacteristic::Read))
+        return false;
+    // a failed read reports no characteristic, callers time out
+    service->readCharacteristic(c);
+    return true;
+}
+
+QList<GattAttribute> NativeLink::attributes(const QBluetoothUuid &serviceUuid) const
+{
+    QList<GattAttribute> result;
+    QLowEnergyService *service = services.value(serviceUuid);
+    if (nullptr == service)
+        return result;
+
+    for (const QLowEnergyCharacteristic &c : service->characteristics())
+    {
+        GattAttribute attribute;
+        attribute.service = serviceUuid;
+        attribute.characteristic = c.uuid();
+        attribute.valueHandle = c.handle();
+        attribute.cccdHandle = c.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration).handle();
+        result << attribute;
+    }
+    return result;
+}
+
+void NativeLink::requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters)
+{
+    // BlueZ applies this as an LE connection update; other platforms may ignore it
+    if(controller->state() == QLowEnergyController::UnconnectedState)
+        return;
+    controller->requestConnectionUpdate(parameters);
+}
+
+void NativeLink::confirmedDescriptorWrite(const QLowEnergyDescriptor& d, const QByteArray& a)
+{
+   PROFILE_SLOT("NativeLink::confirmedDescriptorWrite");
+   const bool enabled = d.isValid() && (a == QByteArray::fromHex("0100") || a == QByteArray::fromHex("0200"));
+   LOG_DEBUG("link.cccd_written", "handle", uint(d.handle()), "enabled", enabled);
+
+   // the descriptor belongs to the characteristic it configures
+   auto service = qobject_cast<QLowEnergyService *>(sender());
+   if (nullptr != service)
+   {
+       for (const QLowEnergyCharacteristic &c : service->characteristics())
+       {
+           if (c.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration).handle() == d.handle())
+           {
+               emit notificationsEnabled(c.uuid(), enabled);
+               return;
+           }
+       }
+   }
+}
+
+void NativeLink::controllerError(QLowEnergyController::Error error)
+{
+    PROFILE_SLOT("NativeLink::controllerError");
+    emit errorOccurred(error, controller->errorString());
+}
+
+NativeTransport::NativeTransport(QObject *parent)
+    : BLETransport(parent)
+{
+}
+
+NativeTransport::~NativeTransport()
+{
+    if(nullptr!=client) {
+      delete client;
+    }
+}
+
+bool NativeTransport::open(const QBluetoothAddress &adapter)
+{
+    if(!adapter.isNull()) {
+     client = new QBluetoothLocalDevice(adapter);
+
+     if(!client->isValid()) {
+         LOG_ERROR("adapter.invalid", "address", Log::mac(adapter.toUInt64()));
+         return false;
+     }
+
+     // scanning and connecting as a central needs power, not discoverability;
+     // each host mode change is a round trip to the daemon
+     if(client->hostMode()==QBluetoothLocalDevice::HostPoweredOff)
+     {
+         LOG_INFO("adapter.power_on", "address", Log::mac(adapter.toUInt64()));
+         client->powerOn();
+     }
+    }
+
+    // if client is nullptr, find and assign the first local adapter
+    if(nullptr==client) {
+       QList<QBluetoothHostInfo> localAdapters = QBluetoothLocalDevice::allDevices();
+       if(localAdapters.empty()) {
+          LOG_ERROR("adapter.none");
+          return false;
+       }
+       else {
+         client = new QBluetoothLocalDevice(localAdapters.at(0).address());
+       }
+    }
+    LOG_INFO("adapter.open", "address", Log::mac(client->address().toUInt64()));
+    // another round trip, only made when debug logging is on
+    LOG_DEBUG("adapter.connected_devices", "count", client->connectedDevices().size());
+
+    connect(client, &QBluetoothLocalDevice::hostModeStateChanged,
+            this, [this](QBluetoothLocalDevice::HostMode mode) {
+        LOG_INFO("adapter.host_mode", "address", Log::mac(client->address().toUInt64()), "mode", int(mode));
+        emit poweredChanged(QBluetoothLocalDevice::HostPoweredOff != mode);
+    });
+
+    agent = new QBluetoothDeviceDiscoveryAgent(client->address(), this);
+
+    connect(agent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered,
+            this, &NativeTransport::advertisementReceived);
+    connect(agent, QOverload<QBluetoothDeviceDiscoveryAgent::Error>::of(&QBluetoothDeviceDiscoveryAgent::error),
+            this, &NativeTransport::deviceScanError);
+    connect(agent, &QBluetoothDeviceDiscoveryAgent::finished,
+            this, [this]() {
+        LOG_DEBUG("scan.finished", "devices", deviceIndex().size(),
+                  "filtered", advertisementsFiltered(), "advertisements", advertisementsSeen());
+        emit scanFinished();
+    });
+    return true;
+}
+
+QBluetoothAddress NativeTransport::adapterAddress() const
+{
+    return nullptr==client ? QBluetoothAddress() : client->address();
+}
+
+QString NativeTransport::adapterName() const
+{
+    return nullptr==client ? QString() : client->name();
+}
+
+void NativeTransport::startScan()
+{
+    if(nullptr!=agent)
+        agent->start(QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
+}
+
+void NativeTransport::stopScan()
+{
+    if(nullptr!=agent)
+        agent->stop();
+}
+
+bool NativeTransport::isScanning() const
+{
+    return nullptr!=agent && agent->isActive();
+}
+
+BLELink *NativeTransport::createLink(const QBluetoothDeviceInfo &info, QObject *parent)
+{
+    return new NativeLink(info, adapterAddress(), parent);
+}
+
+bool NativeTransport::isPowered() const
+{
+    return nullptr!=client && client->isValid() && QBluetoothLocalDevice::HostPoweredOff != client->hostMode();
+}
+
+void NativeTransport::deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error)
+{
+    PROFILE_SLOT("NativeTransport::deviceScanError");
+    static const QMetaEnum errors = agent->metaObject()->enumerator(
+                agent->metaObject()->indexOfEnumerator("Error"));
+    LOG_WARNING("scan.error", "error", errors.valueToKey(error), "message", agent->errorString());
+    emit scanError(error, agent->errorString());
+}
@@ -0,0 +1,74 @@
+#ifndef NATIVETRANSPORT_H
+#define NATIVETRANSPORT_H
+
+#include "bletransport.h"
+
+#include <QHash>
+#include <QtBluetooth/QLowEnergyService>
+
+QT_FORWARD_DECLARE_CLASS(QBluetoothLocalDevice)
+
+// BLELink over QLowEnergyController and QLowEnergyService
+class NativeLink : public BLELink
+{
+    Q_OBJECT
+
+public:
+    // a null local adapter lets Qt pick the default one
+    NativeLink(const QBluetoothDeviceInfo &info, const QBluetoothAddress &localAdapter, QObject *parent = nullptr);
+    ~NativeLink();
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    bool isConnected() const override;
+
+    void discoverServices() override;
+    bool openService(const QBluetoothUuid &service, DetailDiscovery mode) override;
+    using BLELink::enableNotifications;
+    bool enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    bool readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    QList<GattAttribute> attributes(const QBluetoothUuid &service) const override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters) override;
+
+private slots:
+    void controllerError(QLowEnergyController::Error error);
+    void serviceDetailsState(QLowEnergyService::ServiceState newState);
+    void confirmedDescriptorWrite(const QLowEnergyDescriptor& d, const QByteArray& a);
+
+private:
+    void retireService(QLowEnergyService *service);
+    void clearServices();
+
+    QLowEnergyController *controller = nullptr;
+    QHash<QBluetoothUuid, QLowEnergyService *> services;   // owned, at most one per service
+};
+
+// BLETransport over QBluetoothLocalDevice and QBluetoothDeviceDiscoveryAgent
+class NativeTransport : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    explicit NativeTransport(QObject *parent = nullptr);
+    ~NativeTransport();
+
+    bool open(const QBluetoothAddress &adapter) override;
+    QBluetoothAddress adapterAddress() const override;
+    QString adapterName() const override;
+
+    void startScan() override;
+    void stopScan() override;
+    bool isScanning() const override;
+
+    BLELink *createLink(const QBluetoothDeviceInfo &info, QObject *parent) override;
+    bool isPowered() const override;
+
+private slots:
+    void deviceScanError(QBluetoothDeviceDiscoveryAgent::Error error);
+
+private:
+    QBluetoothLocalDevice *client = nullptr;
+    QBluetoothDeviceDiscoveryAgent *agent = nullptr;
+};
+
+#endif // NATIVETRANSPORT_H
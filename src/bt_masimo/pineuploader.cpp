@@ -0,0 +1,135 @@
+#include "pineuploader.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
+#include "readingwriter.h"
+#include "slotprofiler.h"
+#include "uploadqueue.h"
+
+PineUploader::PineUploader(QObject *parent)
+    : QObject(parent)
+    , m_queue(new UploadQueue)
+{
+    m_thread.setObjectName("upload");
+    m_queue->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_queue, &QObject::deleteLater);
+    connect(m_queue, &UploadQueue::backpressureChanged, this, &PineUploader::backpressureChanged);
+    connect(m_queue, &UploadQueue::batchDelivered, this, &PineUploader::batchDelivered);
+    m_thread.start();
+
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PineUploader::flush);
+
+    Metrics::sample(this, Metrics::Gauge, "pine_upload_lag_seconds",
+                    "Age of the oldest reading not yet acknowledged by Pine",
+                    [this]() { return lagMs() / 1000.0; });
+    Metrics::sample(this, Metrics::Gauge, "pine_upload_pending_batches",
+                    "Batches queued on disk or in flight", [this]() { return double(pendingBatches()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_upload_pending_bytes",
+                    "Compressed bytes queued on disk", [this]() { return double(pendingBytes()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_upload_backpressure",
+                    "1 while new readings are refused", [this]() { return isBackpressured() ? 1.0 : 0.0; });
+    Metrics::sample(this, Metrics::Counter, "pine_upload_readings_total", "Readings by upload outcome",
+                    [this]() { return double(delivered()); }, "outcome=\"delivered\"");
+    Metrics::sample(this, Metrics::Counter, "pine_upload_readings_total", "Readings by upload outcome",
+                    [this]() { return double(refused()); }, "outcome=\"refused\"");
+    Metrics::sample(this, Metrics::Counter, "pine_upload_failures_total", "Batch POSTs that failed and will be retried",
+                    [this]() { return double(failures()); });
+    Metrics::summary(this, "pine_upload_delivery_seconds", "Enqueue to acknowledgement per reading",
+                     &m_queue->deliveryLatency());
+}
+
+PineUploader::~PineUploader()
+{
+    // written before the thread stops, the queue then goes with it
+    handOff(Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool PineUploader::open(const QUrl &endpoint, const QString &queueDir)
+{
+    // the directory scan and the first sends belong to the queue's thread
+    UploadQueue *queue = m_queue;
+    bool opened = false;
+    QMetaObject::invokeMethod(queue, [queue, endpoint, queueDir, &opened]() {
+        opened = queue->open(endpoint, queueDir);
+    }, Qt::BlockingQueuedConnection);
+    m_open = opened;
+    return opened;
+}
+
+void PineUploader::setBatching(int maxReadings, int maxDelayMs)
+{
+    m_maxReadings = qMax(1, maxReadings);
+    m_maxDelayMs = qMax(0, maxDelayMs);
+}
+
+void PineUploader::setMaxInFlight(int requests)
+{
+    UploadQueue *queue = m_queue;
+    QMetaObject::invokeMethod(queue, [queue, requests]() { queue->setMaxInFlight(requests); });
+}
+
+void PineUploader::setQueueLimit(qint64 bytes)
+{
+    UploadQueue *queue = m_queue;
+    QMetaObject::invokeMethod(queue, [queue, bytes]() { queue->setQueueLimit(bytes); });
+}
+
+bool PineUploader::isBackpressured() const { return m_queue->isBackpressured(); }
+int PineUploader::pendingBatches() const { return m_queue->pendingBatches(); }
+qint64 PineUploader::pendingBytes() const { return m_queue->pendingBytes(); }
+quint64 PineUploader::delivered() const { return m_queue->delivered(); }
+quint64 PineUploader::refused() const { return m_refused + m_queue->refused(); }
+quint64 PineUploader::failures() const { return m_queue->failures(); }
+const LatencyHistogram &PineUploader::deliveryLatency() const { return m_queue->deliveryLatency(); }
+
+qint64 PineUploader::lagMs() const
+{
+    // handed over batches are older than the open one
+    qint64 oldest = m_queue->oldestUnacked();
+    if(0 == oldest && !m_currentEnqueuedAt.isEmpty())
+        oldest = m_currentEnqueuedAt.first();
+    return 0 == oldest ? 0 : (LatencyRecorder::now() - oldest) / 1000000;
+}
+
+bool PineUploader::enqueue(const QString &address, const TemperatureMeasurement &m)
+{
+    PROFILE_SLOT("PineUploader::enqueue");
+    if(m_queue->isBackpressured()) {
+        ++m_refused;
+        return false;
+    }
+    if(m_current.isEmpty())
+        m_flushTimer.start(m_maxDelayMs);
+    m_current.append(ReadingWriter::toJson(address, m));
+    m_currentEnqueuedAt << LatencyRecorder::now();
+    if(m_current.size() >= m_maxReadings)
+        flush();
+    return true;
+}
+
+void PineUploader::flush()
+{
+    PROFILE_SLOT("PineUploader::flush");
+    handOff(Qt::QueuedConnection);
+}
+
+bool PineUploader::handOff(Qt::ConnectionType type)
+{
+    m_flushTimer.stop();
+    if(m_current.isEmpty() || !m_open)
+        return false;
+
+    // only the readings cross, serialising, compressing and the fsync happen over there
+    UploadQueue *queue = m_queue;
+    const quint64 sequence = queue->reserve(m_currentEnqueuedAt.first());
+    const QJsonArray readings = m_current;
+    const QVector<qint64> enqueuedAt = m_currentEnqueuedAt;
+    m_current = QJsonArray();
+    m_currentEnqueuedAt.clear();
+    QMetaObject::invokeMethod(queue, [queue, sequence, readings, enqueuedAt]() {
+        queue->write(sequence, readings, enqueuedAt);
+    }, type);
+    return true;
+}
@@ -0,0 +1,79 @@
+#ifndef PINEUPLOADER_H
+#define PINEUPLOADER_H
+
+#include <QJsonArray>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+
+#include "latencyhistogram.h"
+#include "thermometerdecoder.h"
+
+class UploadQueue;
+
+/**
+ * Delivers readings to CLSA Pine. Readings are coalesced into batches (by
+ * count or age) on the caller's thread, which does nothing more; each
+ * closed batch is handed to an UploadQueue on the uploader's own thread to
+ * be compressed, written to a queue directory and sent, so a batch survives
+ * restarts and outages until the endpoint acknowledges it with a 2xx and
+ * neither the fsync nor the network holds up the event loop. Once the queue
+ * on disk passes its byte budget new readings are refused (they are still
+ * in the measurement journal).
+ */
+class PineUploader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PineUploader(QObject *parent = nullptr);
+    // the open batch goes to disk and is sent by the next run
+    ~PineUploader();
+
+    // picks up batches left in queueDir by an earlier run
+    bool open(const QUrl &endpoint, const QString &queueDir);
+
+    void setBatching(int maxReadings, int maxDelayMs);
+    void setMaxInFlight(int requests);
+    void setQueueLimit(qint64 bytes);
+
+    bool isBackpressured() const;
+    int pendingBatches() const;
+    qint64 pendingBytes() const;
+    quint64 delivered() const;
+    quint64 refused() const;
+    quint64 failures() const;
+    // enqueue to acknowledged, per reading, in microseconds
+    const LatencyHistogram &deliveryLatency() const;
+    // how long the oldest reading of this run still waiting for Pine has waited, 0 for none
+    qint64 lagMs() const;
+
+public slots:
+    // false when refused under backpressure
+    bool enqueue(const QString &address, const TemperatureMeasurement &m);
+    // close the open batch now
+    void flush();
+
+signals:
+    void backpressureChanged(bool engaged);
+    void batchDelivered(int readings);
+
+private:
+    // hand the open batch to the queue, false when there was nothing to hand over
+    bool handOff(Qt::ConnectionType type);
+
+    QThread m_thread;
+    UploadQueue *m_queue;
+    bool m_open = false;
+
+    QJsonArray m_current;
+    QVector<qint64> m_currentEnqueuedAt;
+    QTimer m_flushTimer;
+    int m_maxReadings = 200;
+    int m_maxDelayMs = 1000;
+    quint64 m_refused = 0;
+};
+
+#endif // PINEUPLOADER_H
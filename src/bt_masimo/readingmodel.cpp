@@ -0,0 +1,121 @@
+#include "readingmodel.h"
+#include "bleinfo.h"
+
+#include <QBluetoothAddress>
+#include <QDateTime>
+
+ReadingModel::ReadingModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_rows(qMax(1, capacity))
+{
+    m_pending.reserve(m_rows.size());
+
+    // about one publish per display frame
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setInterval(16);
+    connect(&m_frameTimer, &QTimer::timeout, this, &ReadingModel::flush);
+}
+
+int ReadingModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_size;
+}
+
+QVariant ReadingModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row() >= m_size)
+        return QVariant();
+
+    const Row &row = at(index.row());
+    switch(role) {
+    case Qt::DisplayRole: {
+        QString text;
+        if(row.temperature) {
+            text = BLEInfo::measurementToString(row.measurement);
+        } else {
+            const GattDecoder::Entry *decoder = GattDecoder::find(row.reading);
+            if(nullptr!=decoder)
+                text = GattDecoder::toString(*decoder, row.reading);
+        }
+        return QString("%1 %2 %3")
+                .arg(QDateTime::fromMSecsSinceEpoch(row.time).toString("hh:mm:ss.zzz"))
+                .arg(QBluetoothAddress(row.address).toString())
+                .arg(text);
+    }
+    case AddressRole:
+        return row.address;
+    case TimeRole:
+        return row.time;
+    case ValueRole:
+        if(row.temperature)
+            return row.measurement.isValid() ? QVariant(row.measurement.value) : QVariant();
+        return row.reading.isValid(0) ? QVariant(row.reading.values[0]) : QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+void ReadingModel::appendTemperature(const QString &address, const TemperatureMeasurement &m)
+{
+    Row row;
+    row.time = QDateTime::currentMSecsSinceEpoch();
+    row.address = QBluetoothAddress(address).toUInt64();
+    row.temperature = true;
+    row.measurement = m;
+    append(row);
+}
+
+void ReadingModel::appendReading(const QString &address, const GattReading &reading)
+{
+    Row row;
+    row.time = QDateTime::currentMSecsSinceEpoch();
+    row.address = QBluetoothAddress(address).toUInt64();
+    row.temperature = false;
+    row.reading = reading;
+    append(row);
+}
+
+void ReadingModel::append(const Row &row)
+{
+    ++m_appended;
+    m_pending << row;
+    // a full buffer would only be overwritten again, publish it now
+    if(m_pending.size() >= m_rows.size() || 0 == m_frameTimer.interval())
+        flush();
+    else if(!m_frameTimer.isActive())
+        m_frameTimer.start();
+}
+
+void ReadingModel::flush()
+{
+    m_frameTimer.stop();
+    const int capacity = m_rows.size();
+    const int n = m_pending.size();
+    if(0 == n)
+        return;
+
+    if(n >= capacity) {
+        // every published row goes, cheaper as a reset
+        beginResetModel();
+        for(int i = 0; i < capacity; ++i)
+            m_rows[i] = m_pending[n - capacity + i];
+        m_head = 0;
+        m_size = capacity;
+        endResetModel();
+    } else {
+        const int overflow = m_size + n - capacity;
+        if(0 < overflow) {
+            beginRemoveRows(QModelIndex(), 0, overflow - 1);
+            m_head = (m_head + overflow) % capacity;
+            m_size -= overflow;
+            endRemoveRows();
+        }
+        beginInsertRows(QModelIndex(), m_size, m_size + n - 1);
+        for(int i = 0; i < n; ++i)
+            m_rows[(m_head + m_size + i) % capacity] = m_pending[i];
+        m_size += n;
+        endInsertRows();
+    }
+    // resize keeps the capacity, the buffer is allocated once
+    m_pending.resize(0);
+}
@@ -0,0 +1,69 @@
+#ifndef READINGMODEL_H
+#define READINGMODEL_H
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QVector>
+
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+
+/**
+ * The live reading list: the newest readings in a fixed-capacity ring, oldest
+ * first. Appends are buffered and published to views once per frame as one
+ * remove-from-the-top and one insert-at-the-bottom, so a burst of
+ * notifications costs one layout pass instead of one per reading. Rows are
+ * stored decoded and only formatted when a view asks for the visible ones.
+ */
+class ReadingModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        AddressRole = Qt::UserRole,     // 48-bit address as quint64
+        TimeRole,                       // ms since the epoch, when it arrived
+        ValueRole                       // primary value, temperature/SpO2/systolic
+    };
+
+    explicit ReadingModel(int capacity = 10000, QObject *parent = nullptr);
+
+    int capacity() const { return m_rows.size(); }
+    // readings not yet published to views
+    int pending() const { return m_pending.size(); }
+    quint64 appended() const { return m_appended; }
+
+    // 0 publishes every append straight away
+    void setFrameInterval(int ms) { m_frameTimer.setInterval(ms); }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+public slots:
+    void appendTemperature(const QString &address, const TemperatureMeasurement &m);
+    void appendReading(const QString &address, const GattReading &reading);
+    void flush();
+
+private:
+    struct Row {
+        qint64 time;
+        quint64 address;
+        bool temperature;               // which of the two is set
+        union {
+            TemperatureMeasurement measurement;
+            GattReading reading;
+        };
+    };
+
+    void append(const Row &row);
+    const Row &at(int row) const { return m_rows[(m_head + row) % m_rows.size()]; }
+
+    QVector<Row> m_rows;                // the ring, capacity slots
+    int m_head = 0;                     // oldest published row
+    int m_size = 0;                     // published rows
+    QVector<Row> m_pending;
+    QTimer m_frameTimer;
+    quint64 m_appended = 0;
+};
+
+#endif // READINGMODEL_H
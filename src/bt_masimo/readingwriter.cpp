@@ -0,0 +1,106 @@
+#include "readingwriter.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+
+ReadingWriter::ReadingWriter(QObject *parent)
+    : QObject(parent)
+    , m_stdout(stdout)
+{
+}
+
+bool ReadingWriter::open(const QString &socketName)
+{
+    if(socketName.isEmpty())
+        return true;
+
+    m_socket = new QLocalSocket(this);
+    m_socket->connectToServer(socketName, QIODevice::WriteOnly);
+    if(!m_socket->waitForConnected(1000)) {
+        LOG_ERROR("readings.connect_failed", "socket", socketName, "error", m_socket->errorString());
+        return false;
+    }
+    return true;
+}
+
+QJsonObject ReadingWriter::toJson(const QString &address, const TemperatureMeasurement &m)
+{
+    QJsonObject json;
+    json["address"] = address;
+    json["received"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    json["status"] = m.status;
+    if(m.isValid())
+        json["value"] = m.value;
+    json["unit"] = m.isFahrenheit() ? "F" : "C";
+    if(m.hasType())
+        json["type"] = ThermometerDecoder::typeName(m.type);
+    if(m.hasTimestamp())
+        json["timestamp"] = QString("%1-%2-%3T%4:%5:%6")
+                            .arg(m.year)
+                            .arg(m.month, 2, 10, QLatin1Char('0'))
+                            .arg(m.day, 2, 10, QLatin1Char('0'))
+                            .arg(m.hours, 2, 10, QLatin1Char('0'))
+                            .arg(m.minutes, 2, 10, QLatin1Char('0'))
+                            .arg(m.seconds, 2, 10, QLatin1Char('0'));
+    // the device timestamp mapped onto the host clock
+    if(0 != m.measuredMs)
+        json["measured"] = QDateTime::fromMSecsSinceEpoch(m.measuredMs, Qt::UTC).toString(Qt::ISODateWithMs);
+    return json;
+}
+
+QJsonObject ReadingWriter::toJson(const QString &address, const GattReading &reading)
+{
+    QJsonObject json;
+    json["address"] = address;
+    json["received"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    const GattDecoder::Entry *decoder = GattDecoder::find(reading);
+    if(nullptr == decoder)
+        return json;
+    json["profile"] = decoder->name;
+    json["flags"] = reading.flags;
+    for(int i = 0; i < GattReading::kMaxValues; ++i) {
+        if(reading.isValid(i) && nullptr != decoder->values[i])
+            json[decoder->values[i]] = reading.values[i];
+    }
+    for(int i = 0; i < GattReading::kMaxCodes; ++i) {
+        if(reading.hasCode(i) && nullptr != decoder->codes[i])
+            json[decoder->codes[i]] = qint64(reading.codes[i]);
+    }
+    if(reading.hasTimestamp())
+        json["timestamp"] = QString("%1-%2-%3T%4:%5:%6")
+                            .arg(reading.year)
+                            .arg(reading.month, 2, 10, QLatin1Char('0'))
+                            .arg(reading.day, 2, 10, QLatin1Char('0'))
+                            .arg(reading.hours, 2, 10, QLatin1Char('0'))
+                            .arg(reading.minutes, 2, 10, QLatin1Char('0'))
+                            .arg(reading.seconds, 2, 10, QLatin1Char('0'));
+    return json;
+}
+
+void ReadingWriter::write(const QString &address, const TemperatureMeasurement &m)
+{
+    PROFILE_SLOT("ReadingWriter::write");
+    writeLine(toJson(address, m));
+}
+
+void ReadingWriter::writeReading(const QString &address, const GattReading &reading)
+{
+    PROFILE_SLOT("ReadingWriter::writeReading");
+    writeLine(toJson(address, reading));
+}
+
+void ReadingWriter::writeLine(const QJsonObject &json)
+{
+    QByteArray line = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    line += '\n';
+    if(nullptr != m_socket) {
+        m_socket->write(line);
+    } else {
+        m_stdout << line;
+        m_stdout.flush();
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef READINGWRITER_H
+#define READINGWRITER_H
+
+#include <QJsonObject>
+#include <QObject>
+#include <QTextStream>
+
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+
+QT_FORWARD_DECLARE_CLASS(QLocalSocket)
+
+/**
+ * Headless output: one JSON object per line for every reading, written to
+ * stdout or, when a socket name is given, to a local (Unix domain) socket.
+ */
+class ReadingWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReadingWriter(QObject *parent = nullptr);
+
+    // empty name writes to stdout
+    bool open(const QString &socketName);
+
+    // the object written for one reading, shared with the Pine upload batches
+    static QJsonObject toJson(const QString &address, const TemperatureMeasurement &m);
+    // the same for the other profiles, values named by the decoder's slots
+    static QJsonObject toJson(const QString &address, const GattReading &reading);
+
+public slots:
+    void write(const QString &address, const TemperatureMeasurement &m);
+    void writeReading(const QString &address, const GattReading &reading);
+
+private:
+    void writeLine(const QJsonObject &json);
+
+    QTextStream m_stdout;
+    QLocalSocket *m_socket = nullptr;
+};
+
+#endif // READINGWRITER_H
@@ -0,0 +1,209 @@
+#include "replayfilter.h"
+
+#include <algorithm>
+
+namespace {
+
+inline quint64 mix(quint64 x)
+{
+    // splitmix64 finaliser
+    x ^= x >> 30;
+    x *= Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x ^= x >> 27;
+    x *= Q_UINT64_C(0x94D049BB133111EB);
+    x ^= x >> 31;
+    return x;
+}
+
+inline bool isLeapYear(int year)
+{
+    return (0 == year % 4 && 0 != year % 100) || 0 == year % 400;
+}
+
+// days since 1970-01-01 of a proleptic Gregorian date
+inline qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return qint64(era) * 146097 + dayOfEra - 719468;
+}
+
+}
+
+ReplayIndex::ReplayIndex(int readingsPerDevice, int maxDevices)
+    : m_buckets(1)
+    , m_maxDevices(qMax(1, maxDevices))
+{
+    while(m_buckets * kWays < readingsPerDevice)
+        m_buckets *= 2;
+}
+
+quint64 ReplayIndex::fingerprint(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m)
+{
+    // the raw value fields, so equal readings match exactly whatever the float rounding
+    const quint64 value = quint64(quint32(m.mantissa))
+        | (quint64(quint8(m.exponent)) << 32)
+        | (quint64(m.status) << 40)
+        | (quint64(m.flags & TemperatureMeasurement::Fahrenheit) << 48)
+        | (quint64(m.type) << 56);
+    return mix(mix(address ^ mix(quint64(deviceMs))) ^ value);
+}
+
+int ReplayIndex::slot(quint64 address)
+{
+    auto it = m_slots.constFind(address);
+    if(it != m_slots.constEnd())
+        return it.value();
+
+    int slot;
+    if(m_owners.size() < m_maxDevices) {
+        slot = m_owners.size();
+        m_owners << address;
+        // grow by doubling but never past maxDevices tables
+        const size_t table = size_t(m_buckets) * kWays;
+        if(m_tags.size() + table > m_tags.capacity())
+            m_tags.reserve(qMin(qMax(2 * m_tags.size(), table), table * size_t(m_maxDevices)));
+        m_tags.resize(m_tags.size() + table, 0);
+    } else {
+        // the device known longest gives up its table
+        slot = m_nextRecycle;
+        m_nextRecycle = (m_nextRecycle + 1) % m_maxDevices;
+        m_slots.remove(m_owners[slot]);
+        m_owners[slot] = address;
+        std::fill_n(m_tags.begin() + std::ptrdiff_t(slot) * m_buckets * kWays, m_buckets * kWays, 0u);
+    }
+    m_slots.insert(address, slot);
+    return slot;
+}
+
+quint32 *ReplayIndex::bucket(int slot, quint64 fingerprint)
+{
+    const size_t index = size_t(slot) * size_t(m_buckets) + size_t(fingerprint & quint64(m_buckets - 1));
+    return &m_tags[index * kWays];
+}
+
+const quint32 *ReplayIndex::bucket(int slot, quint64 fingerprint) const
+{
+    const size_t index = size_t(slot) * size_t(m_buckets) + size_t(fingerprint & quint64(m_buckets - 1));
+    return &m_tags[index * kWays];
+}
+
+bool ReplayIndex::insert(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m)
+{
+    const quint64 f = fingerprint(address, deviceMs, m);
+    // the bucket comes from the low bits, the tag from the high ones; 0 marks an empty way
+    const quint32 tag = qMax(quint32(f >> 32), 1u);
+    quint32 *ways = bucket(slot(address), f);
+    for(int i = 0; i < kWays; ++i) {
+        if(tag == ways[i])
+            return false;
+    }
+    // newest first, the oldest falls off the end
+    for(int i = kWays - 1; i > 0; --i)
+        ways[i] = ways[i - 1];
+    ways[0] = tag;
+    return true;
+}
+
+bool ReplayIndex::contains(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m) const
+{
+    auto it = m_slots.constFind(address);
+    if(it == m_slots.constEnd())
+        return false;
+    const quint64 f = fingerprint(address, deviceMs, m);
+    const quint32 tag = qMax(quint32(f >> 32), 1u);
+    const quint32 *ways = bucket(it.value(), f);
+    for(int i = 0; i < kWays; ++i) {
+        if(tag == ways[i])
+            return true;
+    }
+    return false;
+}
+
+DeviceClock::DeviceClock()
+{
+}
+
+qint64 DeviceClock::deviceMs(const TemperatureMeasurement &m)
+{
+    static const int kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    // month or day 0 means unknown in the Date Time characteristic
+    if(!m.hasTimestamp() || m.year < 1 || m.month < 1 || m.month > 12 || m.day < 1
+       || m.hours > 23 || m.minutes > 59 || m.seconds > 59)
+        return 0;
+    const int days = kDaysInMonth[m.month - 1] + (2 == m.month && isLeapYear(m.year) ? 1 : 0);
+    if(m.day > days)
+        return 0;
+    const qint64 seconds = daysFromCivil(m.year, m.month, m.day) * 86400
+        + m.hours * 3600 + m.minutes * 60 + m.seconds;
+    return seconds * 1000;
+}
+
+qint64 DeviceClock::update(quint64 address, qint64 deviceMs, qint64 hostMs)
+{
+    const qint64 sample = hostMs - deviceMs;
+    auto it = m_devices.find(address);
+    if(it == m_devices.end()) {
+        State s;
+        s.offsetMs = double(sample);
+        s.lastHostMs = hostMs;
+        m_devices.insert(address, s);
+        return hostMs;
+    }
+
+    State &s = it.value();
+    // a device clock running slow pushes the true offset up, let the estimate follow
+    if(hostMs > s.lastHostMs)
+        s.offsetMs += double(hostMs - s.lastHostMs) * m_drift;
+    s.lastHostMs = hostMs;
+
+    if(double(sample) <= s.offsetMs + kResolutionMs) {
+        s.offsetMs = qMin(s.offsetMs, double(sample));
+        s.lateSinceMs = 0;
+    } else if(0 == s.lateSinceMs) {
+        s.lateSinceMs = hostMs;
+        s.lateMinimumMs = sample;
+    } else {
+        // late for this long is not a replay burst, the device clock went back
+        s.lateMinimumMs = qMin(s.lateMinimumMs, sample);
+        if(hostMs - s.lateSinceMs >= m_stepAfterMs) {
+            s.offsetMs = double(s.lateMinimumMs);
+            s.lateSinceMs = 0;
+            ++m_steps;
+        }
+    }
+    return deviceMs + qint64(s.offsetMs);
+}
+
+qint64 DeviceClock::toHost(quint64 address, qint64 deviceMs) const
+{
+    auto it = m_devices.constFind(address);
+    return it == m_devices.constEnd() ? deviceMs : deviceMs + qint64(it.value().offsetMs);
+}
+
+bool DeviceClock::offset(quint64 address, qint64 *offsetMs) const
+{
+    auto it = m_devices.constFind(address);
+    if(it == m_devices.constEnd())
+        return false;
+    *offsetMs = qint64(it.value().offsetMs);
+    return true;
+}
+
+bool ReplayFilter::admit(quint64 address, qint64 receivedMs, TemperatureMeasurement *m)
+{
+    const qint64 deviceMs = DeviceClock::deviceMs(*m);
+    // live-only readings repeat values legitimately, only timestamped ones can be replays
+    if(0 == deviceMs)
+        return true;
+    if(!m_index.insert(address, deviceMs, *m)) {
+        ++m_replays;
+        return false;
+    }
+    m->measuredMs = m_clock.update(address, deviceMs, receivedMs);
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef REPLAYFILTER_H
+#define REPLAYFILTER_H
+
+#include <QHash>
+#include <QVector>
+#include <QtGlobal>
+
+#include <vector>
+
+#include "thermometerdecoder.h"
+
+/**
+ * Fingerprints of the timestamped readings each device has sent, to spot the
+ * stored measurements a thermometer re-sends after a reconnect. A device gets
+ * a fixed table of 4-way buckets of 32-bit tags (4 bytes a reading), the
+ * oldest tag in a bucket making way for a new one: about the latest quarter
+ * of readingsPerDevice are caught reliably, older ones while their bucket has
+ * room. Past the device limit the longest-known device's table is recycled,
+ * so memory never grows beyond maxDevices tables. A false match needs a
+ * 32-bit tag collision within one bucket of one device.
+ */
+class ReplayIndex
+{
+public:
+    // readingsPerDevice is rounded up to a power of two, at least 4
+    explicit ReplayIndex(int readingsPerDevice = 1024, int maxDevices = 1024);
+
+    // true the first time (address, deviceMs, value) is seen, false for a replay
+    bool insert(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m);
+    bool contains(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m) const;
+
+    int deviceCount() const { return m_slots.size(); }
+    int readingsPerDevice() const { return m_buckets * kWays; }
+    // the tag tables, the bound on what the index holds
+    qint64 memoryBytes() const { return qint64(m_tags.capacity()) * qint64(sizeof(quint32)); }
+
+    static quint64 fingerprint(quint64 address, qint64 deviceMs, const TemperatureMeasurement &m);
+
+private:
+    static const int kWays = 4;
+
+    quint32 *bucket(int slot, quint64 fingerprint);
+    const quint32 *bucket(int slot, quint64 fingerprint) const;
+    int slot(quint64 address);
+
+    int m_buckets;                      // per device, a power of two
+    int m_maxDevices;
+    QHash<quint64, int> m_slots;
+    QVector<quint64> m_owners;          // address per slot, recycled oldest first
+    int m_nextRecycle = 0;
+    std::vector<quint32> m_tags;        // m_buckets * kWays per slot, 0 is empty
+};
+
+/**
+ * Online estimate of each device clock's offset from the host clock. Every
+ * reading gives host receive time minus device timestamp, which is the
+ * offset plus however long the reading took to arrive, so the estimate is
+ * the smallest such difference: replays and late deliveries only ever read
+ * high. It may creep up at the drift allowance to follow a slow device
+ * clock, and a device clock set back is adopted once readings have arrived
+ * consistently late for stepAfterMs. Constant time per reading.
+ */
+class DeviceClock
+{
+public:
+    DeviceClock();
+
+    // device timestamps are whole seconds, allow for that plus drift
+    void setDriftAllowance(double ppm) { m_drift = ppm * 1e-6; }
+    void setStepAfterMs(qint64 ms) { m_stepAfterMs = ms; }
+
+    // the timestamp fields as UTC ms since the epoch, 0 when absent or not a
+    // real date; integer arithmetic only, cheap enough for every reading
+    static qint64 deviceMs(const TemperatureMeasurement &m);
+
+    // fold in one reading and return when it was taken, in host time
+    qint64 update(quint64 address, qint64 deviceMs, qint64 hostMs);
+    // host time of a device timestamp, deviceMs itself for an unknown device
+    qint64 toHost(quint64 address, qint64 deviceMs) const;
+    bool offset(quint64 address, qint64 *offsetMs) const;
+    void remove(quint64 address) { m_devices.remove(address); }
+
+    // times an estimate jumped to a device clock that was set back
+    quint64 steps() const { return m_steps; }
+
+private:
+    struct State {
+        double offsetMs = 0.0;          // host minus device
+        qint64 lastHostMs = 0;
+        qint64 lateSinceMs = 0;         // first of the current run of late readings, 0 for none
+        qint64 lateMinimumMs = 0;       // smallest offset seen in that run
+    };
+
+    static const qint64 kResolutionMs = 1000;
+
+    double m_drift = 100e-6;
+    qint64 m_stepAfterMs = 10 * 60 * 1000;
+    QHash<quint64, State> m_devices;
+    quint64 m_steps = 0;
+};
+
+/**
+ * The ingestion step for timestamped readings: drop replays, then fill in
+ * measuredMs from the device clock estimate. Readings without a timestamp
+ * pass untouched. One per ingestion thread, it is not thread safe.
+ */
+class ReplayFilter
+{
+public:
+    // false for a replay; otherwise m->measuredMs is set when m has a timestamp
+    bool admit(quint64 address, qint64 receivedMs, TemperatureMeasurement *m);
+
+    const ReplayIndex &index() const { return m_index; }
+    const DeviceClock &clock() const { return m_clock; }
+    DeviceClock &clock() { return m_clock; }
+    quint64 replays() const { return m_replays; }
+
+private:
+    ReplayIndex m_index;
+    DeviceClock m_clock;
+    quint64 m_replays = 0;
+};
+
+#endif // REPLAYFILTER_H
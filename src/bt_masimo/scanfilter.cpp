@@ -0,0 +1,31 @@
+#include "scanfilter.h"
+
+void ScanFilter::addService(const QBluetoothUuid &service)
+{
+    if(!m_services.contains(service))
+        m_services << service;
+}
+
+bool ScanFilter::accepts(const QBluetoothDeviceInfo &info) const
+{
+    // 0 is what Qt reports when the backend gave no reading
+    const qint16 rssi = info.rssi();
+    if(0 != rssi && rssi < m_minimumRssi)
+        return false;
+
+    if(m_addresses.isEmpty() && m_services.isEmpty())
+        return true;
+
+    // the address compare is one integer hash lookup, do it before touching the service list
+    if(m_addresses.contains(info.address().toUInt64()))
+        return true;
+
+    if(!m_services.isEmpty()) {
+        const QList<QBluetoothUuid> advertised = info.serviceUuids();
+        for(const QBluetoothUuid &service : advertised) {
+            if(m_services.contains(service))
+                return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#ifndef SCANFILTER_H
+#define SCANFILTER_H
+
+#include <QList>
+#include <QSet>
+#include <QtBluetooth/QBluetoothDeviceInfo>
+
+/**
+ * Which advertisements a scan passes on. An advertisement must reach the
+ * RSSI threshold and then match a listed address or advertise a listed
+ * service; with no addresses or services listed everything passes.
+ */
+class ScanFilter
+{
+public:
+    void addAddress(const QBluetoothAddress &address) { m_addresses.insert(address.toUInt64()); }
+    void addService(const QBluetoothUuid &service);
+    // dBm, advertisements without an RSSI reading are not dropped
+    void setMinimumRssi(qint16 rssi) { m_minimumRssi = rssi; }
+    qint16 minimumRssi() const { return m_minimumRssi; }
+
+    bool isEmpty() const { return m_addresses.isEmpty() && m_services.isEmpty() && kNoRssiLimit == m_minimumRssi; }
+    bool accepts(const QBluetoothDeviceInfo &info) const;
+
+    static const qint16 kNoRssiLimit = -32768;
+
+private:
+    QSet<quint64> m_addresses;
+    QList<QBluetoothUuid> m_services;
+    qint16 m_minimumRssi = kNoRssiLimit;
+};
+
+#endif // SCANFILTER_H
@@ -0,0 +1,78 @@
+#include "scanscheduler.h"
+#include "bletransport.h"
+#include "structlog.h"
+
+ScanScheduler::ScanScheduler(BLETransport *transport, QObject *parent)
+    : QObject(parent)
+    , m_transport(transport)
+{
+    m_windowTimer.setSingleShot(true);
+    m_idleTimer.setSingleShot(true);
+    connect(&m_windowTimer, &QTimer::timeout, this, &ScanScheduler::endWindow);
+    connect(&m_idleTimer, &QTimer::timeout, this, &ScanScheduler::startWindow);
+    connect(m_transport, &BLETransport::deviceDiscovered, this, &ScanScheduler::deviceFound);
+    // a backend that gives up early ends the window early
+    connect(m_transport, &BLETransport::scanFinished, this, &ScanScheduler::endWindow);
+}
+
+void ScanScheduler::setDutyCycle(int windowMs, int idleMs)
+{
+    m_windowMs = qMax(0, windowMs);
+    m_idleMs = qMax(0, idleMs);
+    m_currentIdleMs = m_idleMs;
+}
+
+void ScanScheduler::start()
+{
+    m_active = true;
+    m_currentIdleMs = m_idleMs;
+    m_windows = 0;
+    startWindow();
+}
+
+void ScanScheduler::stop()
+{
+    m_active = false;
+    m_windowTimer.stop();
+    m_idleTimer.stop();
+    if(m_transport->isScanning())
+        m_transport->stopScan();
+}
+
+void ScanScheduler::startWindow()
+{
+    if(!m_active)
+        return;
+    ++m_windows;
+    m_foundInWindow = false;
+    m_transport->startScan();
+    if(0 < m_windowMs)
+        m_windowTimer.start(m_windowMs);
+}
+
+void ScanScheduler::endWindow()
+{
+    if(!m_active || m_idleTimer.isActive())
+        return;
+    m_windowTimer.stop();
+    if(m_transport->isScanning())
+        m_transport->stopScan();
+
+    if(0 == m_windowMs) {
+        // single shot scan, nothing to repeat
+        m_active = false;
+        return;
+    }
+
+    if(m_foundInWindow)
+        m_currentIdleMs = m_idleMs;
+    else
+        m_currentIdleMs = qMin(qMax(m_idleMs, m_currentIdleMs * 2), m_idleMs * kMaxBackoff);
+    LOG_DEBUG("scan.window", "window", m_windows, "found", m_foundInWindow, "idle_ms", m_currentIdleMs);
+    m_idleTimer.start(m_currentIdleMs);
+}
+
+void ScanScheduler::deviceFound()
+{
+    m_foundInWindow = true;
+}
@@ -0,0 +1,51 @@
+#ifndef SCANSCHEDULER_H
+#define SCANSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+
+class BLETransport;
+
+/**
+ * Duty-cycled scanning: the transport scans for a window, rests, and scans
+ * again. Each window that finds nothing new doubles the rest up to eight
+ * times the configured idle time, a new device brings it back down. With no
+ * window set the transport scans once until it finishes or is stopped.
+ */
+class ScanScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScanScheduler(BLETransport *transport, QObject *parent = nullptr);
+
+    void setDutyCycle(int windowMs, int idleMs);
+    int windowMs() const { return m_windowMs; }
+    int currentIdleMs() const { return m_currentIdleMs; }
+    bool isActive() const { return m_active; }
+    int windows() const { return m_windows; }
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void startWindow();
+    void endWindow();
+    void deviceFound();
+
+private:
+    static const int kMaxBackoff = 8;
+
+    BLETransport *m_transport = nullptr;
+    QTimer m_windowTimer;
+    QTimer m_idleTimer;
+    int m_windowMs = 0;
+    int m_idleMs = 0;
+    int m_currentIdleMs = 0;
+    int m_windows = 0;
+    bool m_foundInWindow = false;
+    bool m_active = false;
+};
+
+#endif // SCANSCHEDULER_H
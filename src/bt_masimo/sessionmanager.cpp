@@ -0,0 +1,444 @@
+#include "sessionmanager.h"
+#include "metrics.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+#include <QDateTime>
+#include <QtConcurrent>
+
+#include <limits>
+
+// TODO have the user enter the mac address of the thermometer found on the label on
+// the underside of the device
+//
+const QString peripheralMAC = "C0:26:DA:13:B0:DF";
+
+SessionManager::SessionManager(BLETransport *transport, QObject *parent)
+    : QObject(parent)
+    , m_transport(transport)
+    , m_scanScheduler(transport)
+{
+    qRegisterMetaType<TemperatureMeasurement>();
+
+    // emitted on the worker thread, queued to our receivers
+    connect(&m_ingest, &IngestQueue::temperatureMeasured,
+            this, &SessionManager::temperatureMeasured);
+
+    // the inline path appends from the event loop, the worker covers the idle sync itself
+    connect(&m_journalTimer, &QTimer::timeout,
+            this, [this]() { m_journal.syncIfDue(); });
+
+    connect(this, &SessionManager::readingDecoded,
+            this, &SessionManager::assessReading);
+    connect(this, &SessionManager::readingDecoded,
+            this, &SessionManager::publishReading);
+
+    connect(&m_profileWatcher, &QFutureWatcherBase::finished,
+            this, &SessionManager::startupStepFinished);
+    connect(&m_probeWatcher, &QFutureWatcherBase::finished,
+            this, &SessionManager::startupStepFinished);
+
+    registerMetrics();
+}
+
+void SessionManager::registerMetrics()
+{
+    // sampled on the scraping thread, the event loop; ingest numbers are atomics
+    Metrics::sample(this, Metrics::Gauge, "pine_ingest_queue_depth", "Notifications waiting for the ingest worker",
+                    [this]() { return double(m_ingest.depth()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_ingest_queue_high_water", "Deepest the ingest queue has been",
+                    [this]() { return double(m_ingest.highWaterMark()); });
+    Metrics::sample(this, Metrics::Counter, "pine_ingest_overflows_total",
+                    "Notifications dropped because the ingest queue was full",
+                    [this]() { return double(m_ingest.overflows()); });
+    Metrics::summary(this, "pine_ingest_queue_delay_seconds", "BLE slot to decoded on the ingest worker",
+                     &m_ingest.queueDelay());
+    Metrics::sample(this, Metrics::Counter, "pine_replays_dropped_total",
+                    "Stored readings a device sent again, dropped before the journal",
+                    [this]() { return double(replaysDropped()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_connect_queue_depth", "Sessions waiting for a connection slot",
+                    [this]() { return double(m_connectQueue.size()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_connects_pending", "Connection attempts outstanding",
+                    [this]() { return double(m_connecting.size()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_sessions", "Known peripherals",
+                    [this]() { return double(m_sessions.size()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_sessions_subscribed", "Peripherals streaming readings",
+                    [this]() {
+        int subscribed = 0;
+        for(const BLESession *session : qAsConst(m_sessions))
+            subscribed += BLESession::Subscribed == session->state();
+        return double(subscribed);
+    });
+    Metrics::sample(this, Metrics::Gauge, "pine_links", "Link objects alive, flat across reconnects",
+                    []() { return double(BLELink::liveCount()); });
+    Metrics::sample(this, Metrics::Gauge, "pine_devices_indexed", "Devices the scan remembers",
+                    [this]() { return double(m_transport->deviceIndex().size()); });
+    Metrics::sample(this, Metrics::Counter, "pine_journal_records_total", "Readings in the measurement journal",
+                    [this]() { return double(m_journal.isOpen() ? m_journal.count() : 0); });
+    Metrics::sample(this, Metrics::Counter, "pine_live_feed_published_total", "Readings published to the live feed",
+                    [this]() { return double(m_liveFeed.committed()); });
+}
+
+bool SessionManager::openJournal(const QString &path, int syncRecords, int syncMs)
+{
+    m_journal.setSyncPolicy(syncRecords, syncMs);
+    if(!m_journal.open(path)) {
+        LOG_ERROR("journal.open_failed", "path", path, "error", m_journal.errorString());
+        return false;
+    }
+    LOG_INFO("journal.opened", "path", path, "readings", m_journal.count(),
+             "recovery_us", m_journal.recoveryNs() / 1000);
+
+    m_ingest.setJournal(&m_journal);
+    m_journalTimer.start(qMax(100, syncMs));
+    return true;
+}
+
+bool SessionManager::openLiveFeed(const QString &name, quint32 capacity)
+{
+    if(!m_liveFeed.open(name, capacity)) {
+        LOG_ERROR("livefeed.open_failed", "name", name, "error", m_liveFeed.errorString());
+        return false;
+    }
+    LOG_INFO("livefeed.opened", "name", name, "capacity", capacity);
+    m_ingest.setLiveFeed(&m_liveFeed);
+    return true;
+}
+
+SessionManager::~SessionManager()
+{
+    // the probe uses the transport
+    m_profileWatcher.waitForFinished();
+    m_probeWatcher.waitForFinished();
+    m_ingest.stop();
+    m_journal.close();
+    m_liveFeed.close();
+    qDeleteAll(m_sessions);
+}
+
+QString SessionManager::settingsPath() const
+{
+    return m_settingsPath.isEmpty() ? StartupProfile::defaultPath() : m_settingsPath;
+}
+
+bool SessionManager::start()
+{
+    return startWith(StartupProfile::read(settingsPath()), QList<QBluetoothAddress>());
+}
+
+void SessionManager::startAsync()
+{
+    // one parses a file, the other waits on the Bluetooth daemon; neither touches this object
+    const QString path = settingsPath();
+    const BLETransport *transport = m_transport;
+    m_startupSteps = 2;
+    m_profileWatcher.setFuture(QtConcurrent::run([path]() { return StartupProfile::read(path); }));
+    m_probeWatcher.setFuture(QtConcurrent::run([transport]() { return transport->probeAdapters(); }));
+}
+
+void SessionManager::startupStepFinished()
+{
+    if(0 < --m_startupSteps)
+        return;
+    emit started(startWith(m_profileWatcher.result(), m_probeWatcher.result()));
+}
+
+bool SessionManager::startWith(const StartupProfile &profile, const QList<QBluetoothAddress> &adapters)
+{
+    m_adapter = profile.adapter;
+    for(const QBluetoothDeviceInfo &info : profile.peripherals)
+        addTarget(info.address());
+    m_gattCache = profile.gattCache;
+
+    if(m_targets.isEmpty())
+        addTarget(QBluetoothAddress(peripheralMAC));
+
+    if(!adapters.isEmpty())
+        m_transport->setProbedAdapters(adapters);
+    // verify that the stored local host (client) is the one saved in settings,
+    // the transport falls back to the first local adapter
+    if(!m_transport->open(m_adapter))
+        return false;
+
+    // targets by address; a cold start also takes anything advertising a
+    // service we can decode so nearby devices show up in the transport's index
+    ScanFilter filter;
+    for(quint64 target : qAsConst(m_targets))
+        filter.addAddress(QBluetoothAddress(target));
+    if(!profile.isWarm()) {
+        for(const GattProfile &known : GattProfile::known())
+            filter.addService(known.service);
+    }
+    filter.setMinimumRssi(m_minimumRssi);
+    m_transport->setScanFilter(filter);
+
+    connect(m_transport, &BLETransport::deviceDiscovered,
+            this, &SessionManager::deviceDiscovered);
+    m_scanStartedAt = LatencyRecorder::now();
+
+    // last run's peripherals need not be heard first, the scan looks for them alongside
+    for(const QBluetoothDeviceInfo &info : profile.peripherals) {
+        if(nullptr!=session(info.address()))
+            continue;
+        LOG_INFO("startup.warm", "address", Log::mac(info.address().toUInt64()), "name", info.name());
+        BLESession *warm = addSession(info);
+        if(m_autoConnect)
+            queueConnect(warm);
+    }
+    m_scanScheduler.start();
+    return true;
+}
+
+void SessionManager::addTarget(const QBluetoothAddress &address)
+{
+    if(!address.isNull())
+        m_targets.insert(address.toUInt64());
+}
+
+void SessionManager::removeTarget(const QBluetoothAddress &address)
+{
+    const quint64 key = address.toUInt64();
+    m_targets.remove(key);
+    m_found.remove(key);
+    m_connectQueue.removeAll(key);
+    m_connecting.remove(key);
+    m_stableSignals.remove(key);
+    m_signalQuality.remove(key);
+    BLESession *session = m_sessions.take(key);
+    if(nullptr==session)
+        return;
+
+    LOG_INFO("session.removed", "address", Log::mac(key), "state", int(session->state()));
+    session->disconnect(this);
+    session->setAutoReconnect(false);
+    session->disconnectFromDevice();
+    // may be inside one of its own signals
+    session->deleteLater();
+    pumpConnectQueue();
+}
+
+void SessionManager::writeSettings()
+{
+   PROFILE_SLOT("SessionManager::writeSettings");
+   if(m_transport->isSimulated())
+     return;
+
+   StartupProfile profile;
+   profile.adapter = m_transport->adapterAddress();
+   profile.adapterName = m_transport->adapterName();
+   for(const BLESession *session : qAsConst(m_sessions)) {
+     QBluetoothDeviceInfo info(session->address(), session->deviceInfo().name(), 0);
+     info.setServiceUuids(QList<QBluetoothUuid>() << session->profile().service, QBluetoothDeviceInfo::DataIncomplete);
+     profile.peripherals << info;
+   }
+   profile.gattCache = m_gattCache;
+   profile.write(settingsPath());
+}
+
+void SessionManager::setDiscoveryMode(BLESession::DiscoveryMode mode)
+{
+    m_discoveryMode = mode;
+    for(BLESession *session : m_sessions)
+        session->setDiscoveryMode(mode);
+}
+
+void SessionManager::setAutoReconnect(bool enabled)
+{
+    m_autoReconnect = enabled;
+    for(BLESession *session : m_sessions)
+        session->setAutoReconnect(enabled);
+}
+
+BLESession *SessionManager::addSession(const QBluetoothDeviceInfo &info)
+{
+    const quint64 key = info.address().toUInt64();
+    BLESession *session = m_sessions.value(key);
+    if(nullptr!=session)
+        return session;
+
+    session = new BLESession(info, m_transport, this);
+    session->setProfile(GattProfile::forDevice(info));
+    session->setLatencyRecorder(&m_latency);
+    session->setGattCache(&m_gattCache);
+    session->setDiscoveryMode(m_discoveryMode);
+    session->setAutoReconnect(m_autoReconnect);
+    if(m_threadedDecode) {
+        session->setIngestQueue(&m_ingest);
+        if(!m_ingest.isRunning())
+            m_ingest.start();
+    }
+    m_sessions.insert(key, session);
+
+    connect(session, &BLESession::stateChanged,
+            this, &SessionManager::updateSessionState);
+    connect(session, &BLESession::readingDecoded,
+            this, &SessionManager::readingDecoded);
+    // threaded sessions hand their bytes to m_ingest, which filters and journals
+    if(m_threadedDecode) {
+        connect(session, &BLESession::temperatureMeasured,
+                this, &SessionManager::temperatureMeasured);
+    } else {
+        connect(session, &BLESession::temperatureMeasured,
+                this, &SessionManager::ingestInline);
+    }
+    // reconnects go through the queue like any other connect
+    connect(session, &BLESession::reconnectDue,
+            this, [this, session]() { queueConnect(session); });
+
+    emit sessionAdded(session);
+    return session;
+}
+
+BLESession *SessionManager::session(const QBluetoothAddress &address) const
+{
+    return m_sessions.value(address.toUInt64());
+}
+
+void SessionManager::connectAll()
+{
+    for(BLESession *session : qAsConst(m_sessions)) {
+        if(BLESession::Idle == session->state() || BLESession::Disconnected == session->state()
+           || BLESession::Reconnecting == session->state())
+            queueConnect(session);
+    }
+}
+
+void SessionManager::queueConnect(BLESession *session)
+{
+    const quint64 key = session->address().toUInt64();
+    if(!m_connectQueue.contains(key)) {
+        session->markQueued(LatencyRecorder::now());
+        m_connectQueue.enqueue(key);
+    }
+    pumpConnectQueue();
+}
+
+void SessionManager::pumpConnectQueue()
+{
+    while(m_connecting.size() < m_maxPendingConnects && !m_connectQueue.isEmpty()) {
+        BLESession *session = m_sessions.value(m_connectQueue.dequeue());
+        if(nullptr==session)
+            continue;
+        // counted in updateSessionState when the session enters Connecting
+        session->connectToDevice();
+    }
+}
+
+void SessionManager::updateSessionState(BLESession::State state)
+{
+    PROFILE_SLOT("SessionManager::updateSessionState");
+    BLESession *session = qobject_cast<BLESession *>(sender());
+    if(nullptr==session)
+        return;
+
+    // track outstanding connects so the queue keeps moving without blocking
+    const quint64 key = session->address().toUInt64();
+    if(BLESession::Connecting == state)
+        m_connecting.insert(key);
+    else
+        m_connecting.remove(key);
+    // a warm session can be on the air before the scan hears it
+    if((BLESession::Discovering == state || BLESession::Subscribing == state || BLESession::Subscribed == state)
+       && m_targets.contains(key) && !m_found.contains(key))
+        markFound(key);
+
+    emit sessionStateChanged(session, state);
+    pumpConnectQueue();
+}
+
+void SessionManager::assessReading(const QString &address, const GattReading &reading)
+{
+    PROFILE_SLOT("SessionManager::assessReading");
+    if(0x2A5F != reading.characteristic)
+        return;
+
+    const quint64 key = QBluetoothAddress(address).toUInt64();
+    const float missing = std::numeric_limits<float>::quiet_NaN();
+    const SignalQuality::Result result = m_signalQuality.push(key,
+        reading.isValid(0) ? float(reading.values[0]) : missing,
+        reading.isValid(1) ? float(reading.values[1]) : missing);
+
+    // log the edges only, the stream itself runs at several readings a second
+    if(result.stable != m_stableSignals.contains(key)) {
+        if(result.stable) {
+            m_stableSignals.insert(key);
+            LOG_INFO("signal.stable", "address", Log::mac(key),
+                     "spo2", result.acceptedSpo2, "pulse_rate", result.acceptedPulse);
+        } else {
+            m_stableSignals.remove(key);
+            LOG_INFO("signal.unstable", "address", Log::mac(key),
+                     "motion", result.motion, "dropout", result.dropout);
+        }
+    }
+    emit signalAssessed(address, result);
+}
+
+void SessionManager::publishReading(const QString &address, const GattReading &reading)
+{
+    PROFILE_SLOT("SessionManager::publishReading");
+    if(!m_liveFeed.isOpen())
+        return;
+    // like the temperatures, a reading with nothing valid in it is not published
+    bool valid = false;
+    for(int slot = 0; slot < GattReading::kMaxValues && !valid; ++slot)
+        valid = reading.isValid(slot);
+    if(!valid)
+        return;
+    // decoded in the slot's call chain, as on the inline temperature path
+    m_liveFeed.publish(QBluetoothAddress(address).toUInt64(), QDateTime::currentMSecsSinceEpoch(),
+                       LatencyRecorder::now(), reading);
+    m_liveFeed.commit();
+}
+
+void SessionManager::ingestInline(const QString &address, const TemperatureMeasurement &m)
+{
+    PROFILE_SLOT("SessionManager::ingestInline");
+    // the worker's steps, on the event loop
+    const quint64 key = QBluetoothAddress(address).toUInt64();
+    const qint64 receivedMs = QDateTime::currentMSecsSinceEpoch();
+    TemperatureMeasurement reading = m;
+    if(!m_inlineFilter.admit(key, receivedMs, &reading)) {
+        LOG_DEBUG("measurement.replay", "address", Log::mac(key));
+        return;
+    }
+    if(m_journal.isOpen())
+        m_journal.append(key, receivedMs, reading);
+    if(m_liveFeed.isOpen()) {
+        // already in the slot's call chain, now is as close to it as this path gets
+        m_liveFeed.publish(key, receivedMs, LatencyRecorder::now(), reading);
+        m_liveFeed.commit();
+    }
+    emit temperatureMeasured(address, reading);
+}
+
+void SessionManager::deviceDiscovered(const QBluetoothDeviceInfo &info)
+{
+    PROFILE_SLOT("SessionManager::deviceDiscovered");
+    const quint64 key = info.address().toUInt64();
+    LOG_DEBUG("scan.device", "address", Log::mac(key), "rssi", info.rssi());
+    if(!m_targets.contains(key) || m_found.contains(key))
+        return;
+
+    LOG_INFO("scan.target", "address", Log::mac(key), "rssi", info.rssi());
+    m_latency.recordSince(LatencyRecorder::ScanToDiscovery, m_scanStartedAt);
+    // a warm start made the session already and may be connecting it
+    BLESession *session = m_sessions.value(key);
+    const bool fresh = nullptr==session;
+    if(fresh) {
+        session = addSession(info);
+        session->markDiscovered(LatencyRecorder::now());
+    }
+    markFound(key);
+
+    if(fresh && m_autoConnect)
+        queueConnect(session);
+}
+
+void SessionManager::markFound(quint64 key)
+{
+    m_found.insert(key);
+    // we can stop the scanning once every target device has been found
+    if(m_found.size() >= m_targets.size() && m_scanScheduler.isActive()) {
+        LOG_INFO("scan.complete", "targets", m_targets.size());
+        m_scanScheduler.stop();
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef SESSIONMANAGER_H
+#define SESSIONMANAGER_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QTimer>
+
+#include "blesession.h"
+#include "ingestqueue.h"
+#include "livefeed.h"
+#include "measurementjournal.h"
+#include "scanscheduler.h"
+#include "signalquality.h"
+#include "startupprofile.h"
+
+extern const QString peripheralMAC;
+
+/**
+ * Drives a BLETransport (scan, local adapter) and owns one BLESession per
+ * target peripheral. Scanning continues until every target has been seen, and
+ * connects are queued so only a bounded number are outstanding at once
+ * (BlueZ serialises LE connection creation; the rest stay on the event loop).
+ */
+class SessionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionManager(BLETransport *transport, QObject *parent = nullptr);
+    ~SessionManager();
+
+    // settings read at start and written by writeSettings(), StartupProfile::defaultPath() unless set
+    void setSettingsPath(const QString &path) { m_settingsPath = path; }
+    QString settingsPath() const;
+
+    // open the transport's local adapter and start scanning, false if no adapter is usable
+    bool start();
+    // start() without holding up the event loop: the settings are read and the
+    // local adapters probed on worker threads at the same time, then the adapter
+    // is opened on the event loop and started() reports the outcome
+    void startAsync();
+
+    void addTarget(const QBluetoothAddress &address);
+    // forget a target and destroy its session, link and service objects with it
+    void removeTarget(const QBluetoothAddress &address);
+    void setAutoConnect(bool autoConnect) { m_autoConnect = autoConnect; }
+    void setMaxPendingConnects(int count) { m_maxPendingConnects = qMax(1, count); }
+    // scan in windowMs bursts separated by at least idleMs, 0 scans continuously
+    void setScanDutyCycle(int windowMs, int idleMs) { m_scanScheduler.setDutyCycle(windowMs, idleMs); }
+    // advertisements weaker than this are dropped by the transport
+    void setMinimumRssi(qint16 rssi) { m_minimumRssi = rssi; }
+    // applies to existing sessions and to those created later
+    void setDiscoveryMode(BLESession::DiscoveryMode mode);
+    void setAutoReconnect(bool enabled);
+    // decode on the ingest worker thread (default) or inline in the BLE slot,
+    // set before sessions are added
+    void setThreadedDecode(bool threaded) { m_threadedDecode = threaded; }
+    const IngestQueue &ingestQueue() const { return m_ingest; }
+    // re-sent stored readings dropped on either decode path
+    quint64 replaysDropped() const { return m_ingest.replays() + m_inlineFilter.replays(); }
+    // journal every reading to path, see MeasurementJournal for the sync bounds
+    bool openJournal(const QString &path, int syncRecords = 4096, int syncMs = 1000);
+    const MeasurementJournal &journal() const { return m_journal; }
+    // publish every reading to the shared-memory segment name for local readers
+    bool openLiveFeed(const QString &name, quint32 capacity = 65536);
+    const LiveFeed &liveFeed() const { return m_liveFeed; }
+    // rolling quality of the PLX Continuous stream, fed from readingDecoded
+    SignalQuality &signalQuality() { return m_signalQuality; }
+
+    // session for a discovered target, created on first sight
+    BLESession *addSession(const QBluetoothDeviceInfo &info);
+    BLESession *session(const QBluetoothAddress &address) const;
+    QList<BLESession *> sessions() const { return m_sessions.values(); }
+
+    LatencyRecorder &latency() { return m_latency; }
+    const LatencyRecorder &latency() const { return m_latency; }
+
+public slots:
+    void connectAll();
+    void writeSettings();
+    bool dumpLatency(const QString &path) const { return m_latency.writeJson(path); }
+
+signals:
+    // after startAsync(), false if no adapter is usable
+    void started(bool ok);
+    void sessionAdded(BLESession *session);
+    void sessionStateChanged(BLESession *session, BLESession::State state);
+    void temperatureMeasured(const QString &address, const TemperatureMeasurement &m);
+    void readingDecoded(const QString &address, const GattReading &reading);
+    // after every PLX Continuous reading
+    void signalAssessed(const QString &address, const SignalQuality::Result &result);
+
+private slots:
+    void deviceDiscovered(const QBluetoothDeviceInfo &info);
+    void updateSessionState(BLESession::State state);
+    void assessReading(const QString &address, const GattReading &reading);
+    void publishReading(const QString &address, const GattReading &reading);
+    void ingestInline(const QString &address, const TemperatureMeasurement &m);
+    void startupStepFinished();
+
+private:
+    void registerMetrics();
+    // the peripherals in a warm profile get sessions, and connects when auto-connecting, at once
+    bool startWith(const StartupProfile &profile, const QList<QBluetoothAddress> &adapters);
+    // heard advertising or connected; scanning stops once every target is
+    void markFound(quint64 key);
+    void queueConnect(BLESession *session);
+    void pumpConnectQueue();
+
+    BLETransport *m_transport = nullptr;
+    QBluetoothAddress m_adapter;
+    QString m_settingsPath;
+    QFutureWatcher<StartupProfile> m_profileWatcher;
+    QFutureWatcher<QList<QBluetoothAddress> > m_probeWatcher;
+    int m_startupSteps = 0;
+    LatencyRecorder m_latency;
+    GattCache m_gattCache;
+    IngestQueue m_ingest;
+    ReplayFilter m_inlineFilter;        // the worker has its own
+    MeasurementJournal m_journal;
+    LiveFeed m_liveFeed;
+    QTimer m_journalTimer;
+    ScanScheduler m_scanScheduler;
+    SignalQuality m_signalQuality;
+    QSet<quint64> m_stableSignals;
+    qint64 m_scanStartedAt = 0;
+    qint16 m_minimumRssi = ScanFilter::kNoRssiLimit;
+
+    QSet<quint64> m_targets;
+    QSet<quint64> m_found;
+    QHash<quint64, BLESession *> m_sessions;
+    QQueue<quint64> m_connectQueue;
+    QSet<quint64> m_connecting;
+    int m_maxPendingConnects = 1;
+    BLESession::DiscoveryMode m_discoveryMode = BLESession::FullDiscovery;
+    bool m_autoReconnect = true;
+    bool m_threadedDecode = true;
+    bool m_autoConnect = false;
+};
+
+#endif // SESSIONMANAGER_H
@@ -0,0 +1,264 @@
+#include "signalquality.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define SIGNALQUALITY_SSE2
+#endif
+
+namespace {
+
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+
+inline bool valid(float x)
+{
+    return x == x;
+}
+
+#ifdef SIGNALQUALITY_SSE2
+inline float horizontalSum(__m128 v)
+{
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 pair = _mm_add_ps(v, high);
+    return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+
+inline float horizontalMin(__m128 v)
+{
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 pair = _mm_min_ps(v, high);
+    return _mm_cvtss_f32(_mm_min_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+
+inline float horizontalMax(__m128 v)
+{
+    __m128 high = _mm_movehl_ps(v, v);
+    __m128 pair = _mm_max_ps(v, high);
+    return _mm_cvtss_f32(_mm_max_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+#endif
+
+}
+
+SignalKernels::Moments SignalKernels::momentsScalar(const float *x, int n, float shift)
+{
+    Moments m = {0, 0.0f, 0.0f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+    for(int i = 0; i < n; ++i) {
+        if(!valid(x[i]))
+            continue;
+        const float d = x[i] - shift;
+        ++m.count;
+        m.sum += d;
+        m.sumSquares += d * d;
+        m.min = qMin(m.min, x[i]);
+        m.max = qMax(m.max, x[i]);
+    }
+    return m;
+}
+
+float SignalKernels::maxStepScalar(const float *x, int n)
+{
+    float step = 0.0f;
+    for(int i = 1; i < n; ++i) {
+        const float d = std::fabs(x[i] - x[i - 1]);
+        if(valid(d))
+            step = qMax(step, d);
+    }
+    return step;
+}
+
+#ifdef SIGNALQUALITY_SSE2
+
+SignalKernels::Moments SignalKernels::moments(const float *x, int n, float shift)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 offset = _mm_set1_ps(shift);
+    __m128 count = _mm_setzero_ps();
+    __m128 sum = _mm_setzero_ps();
+    __m128 squares = _mm_setzero_ps();
+    __m128 low = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 high = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+
+    int i = 0;
+    for(; i + 4 <= n; i += 4) {
+        const __m128 v = _mm_loadu_ps(x + i);
+        // all ones where the lane holds a number, zero for NaN
+        const __m128 present = _mm_cmpord_ps(v, v);
+        const __m128 d = _mm_and_ps(present, _mm_sub_ps(v, offset));
+        count = _mm_add_ps(count, _mm_and_ps(present, one));
+        sum = _mm_add_ps(sum, d);
+        squares = _mm_add_ps(squares, _mm_mul_ps(d, d));
+        // min/max return the second operand when the first is NaN
+        low = _mm_min_ps(v, low);
+        high = _mm_max_ps(v, high);
+    }
+
+    Moments m;
+    m.count = int(horizontalSum(count));
+    m.sum = horizontalSum(sum);
+    m.sumSquares = horizontalSum(squares);
+    m.min = horizontalMin(low);
+    m.max = horizontalMax(high);
+    if(i < n) {
+        const Moments tail = momentsScalar(x + i, n - i, shift);
+        m.count += tail.count;
+        m.sum += tail.sum;
+        m.sumSquares += tail.sumSquares;
+        m.min = qMin(m.min, tail.min);
+        m.max = qMax(m.max, tail.max);
+    }
+    return m;
+}
+
+float SignalKernels::maxStep(const float *x, int n)
+{
+    const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 step = _mm_setzero_ps();
+    int i = 1;
+    for(; i + 4 <= n; i += 4) {
+        const __m128 d = _mm_sub_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(x + i - 1));
+        // NaN differences leave the running maximum alone
+        step = _mm_max_ps(_mm_and_ps(d, magnitude), step);
+    }
+    float result = horizontalMax(step);
+    if(i < n)
+        result = qMax(result, maxStepScalar(x + i - 1, n - i + 1));
+    return result;
+}
+
+#else
+
+SignalKernels::Moments SignalKernels::moments(const float *x, int n, float shift)
+{
+    return momentsScalar(x, n, shift);
+}
+
+float SignalKernels::maxStep(const float *x, int n)
+{
+    return maxStepScalar(x, n);
+}
+
+#endif
+
+SignalQuality::SignalQuality(int window)
+    : m_window(qMax(4, (window + 3) & ~3))
+{
+    qRegisterMetaType<SignalQuality::Result>();
+}
+
+int SignalQuality::slot(quint64 address)
+{
+    auto it = m_slots.constFind(address);
+    if(it != m_slots.constEnd())
+        return it.value();
+
+    int slot;
+    if(!m_free.isEmpty()) {
+        slot = m_free.takeLast();
+    } else {
+        slot = int(m_cursor.size());
+        m_spo2.resize(m_spo2.size() + size_t(2 * m_window));
+        m_pulse.resize(m_pulse.size() + size_t(2 * m_window));
+        m_cursor.push_back(0);
+        m_filled.push_back(0);
+    }
+    std::fill(m_spo2.begin() + slot * 2 * m_window, m_spo2.begin() + (slot + 1) * 2 * m_window, kNaN);
+    std::fill(m_pulse.begin() + slot * 2 * m_window, m_pulse.begin() + (slot + 1) * 2 * m_window, kNaN);
+    m_cursor[size_t(slot)] = 0;
+    m_filled[size_t(slot)] = 0;
+    m_slots.insert(address, slot);
+    return slot;
+}
+
+void SignalQuality::remove(quint64 address)
+{
+    auto it = m_slots.find(address);
+    if(it == m_slots.end())
+        return;
+    m_free << it.value();
+    m_slots.erase(it);
+}
+
+SignalQuality::Result SignalQuality::push(quint64 address, float spo2, float pulse)
+{
+    return update(slot(address), spo2, pulse);
+}
+
+void SignalQuality::pushBatch(const int *slots, const float *spo2, const float *pulse, int n, Result *results)
+{
+    for(int i = 0; i < n; ++i)
+        results[i] = update(slots[i], spo2[i], pulse[i]);
+}
+
+SignalQuality::Result SignalQuality::update(int slot, float spo2, float pulse)
+{
+    const size_t base = size_t(slot) * size_t(2 * m_window);
+    float *s = &m_spo2[base];
+    float *p = &m_pulse[base];
+    int &cursor = m_cursor[size_t(slot)];
+    int &filled = m_filled[size_t(slot)];
+
+    // written twice so [cursor, cursor + window) always holds the window, oldest first
+    s[cursor] = s[cursor + m_window] = spo2;
+    p[cursor] = p[cursor + m_window] = pulse;
+    if(++cursor == m_window)
+        cursor = 0;
+    filled = qMin(filled + 1, m_window);
+
+    const int start = cursor + m_window - filled;
+    Result r;
+    assess(s + start, p + start, filled, &r);
+    return r;
+}
+
+void SignalQuality::assess(const float *spo2, const float *pulse, int n, Result *r) const
+{
+    using namespace SignalKernels;
+    typedef Moments (*MomentsFunction)(const float *, int, float);
+    typedef float (*StepFunction)(const float *, int);
+    const MomentsFunction momentsOf = m_vectorised ? moments : momentsScalar;
+    const StepFunction stepOf = m_vectorised ? maxStep : maxStepScalar;
+
+    // shifting by the newest reading keeps the sums small
+    const float spo2Shift = valid(spo2[n - 1]) ? spo2[n - 1] : 0.0f;
+    const float pulseShift = valid(pulse[n - 1]) ? pulse[n - 1] : 0.0f;
+    const Moments s = momentsOf(spo2, n, spo2Shift);
+    const Moments p = momentsOf(pulse, n, pulseShift);
+
+    r->samples = n;
+    r->dropouts = n - qMin(s.count, p.count);
+    if(0 < s.count) {
+        const float mean = s.sum / s.count;
+        r->spo2Mean = spo2Shift + mean;
+        r->spo2Deviation = std::sqrt(qMax(0.0f, s.sumSquares / s.count - mean * mean));
+    }
+    if(0 < p.count) {
+        const float mean = p.sum / p.count;
+        r->pulseMean = pulseShift + mean;
+        r->pulseDeviation = std::sqrt(qMax(0.0f, p.sumSquares / p.count - mean * mean));
+    }
+    r->dropout = !valid(spo2[n - 1]) || !valid(pulse[n - 1])
+        || r->dropouts > m_thresholds.dropoutFraction * n;
+
+    // motion and stability look at the recent span only
+    const int k = qMin(n, m_thresholds.stableSamples);
+    const float *recentSpo2 = spo2 + n - k;
+    const float *recentPulse = pulse + n - k;
+    r->motion = stepOf(recentSpo2, k) > m_thresholds.spo2Step
+        || stepOf(recentPulse, k) > m_thresholds.pulseStep;
+    if(k < m_thresholds.stableSamples || r->motion)
+        return;
+
+    const Moments rs = momentsOf(recentSpo2, k, spo2Shift);
+    const Moments rp = momentsOf(recentPulse, k, pulseShift);
+    r->stable = k == rs.count && k == rp.count
+        && rs.max - rs.min <= m_thresholds.spo2Range
+        && rp.max - rp.min <= m_thresholds.pulseRange;
+    if(r->stable) {
+        r->acceptedSpo2 = spo2Shift + rs.sum / k;
+        r->acceptedPulse = pulseShift + rp.sum / k;
+    }
+}
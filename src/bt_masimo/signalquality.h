@@ -0,0 +1,106 @@
+#ifndef SIGNALQUALITY_H
+#define SIGNALQUALITY_H
+
+#include <QHash>
+#include <QMetaType>
+#include <QVector>
+#include <QtGlobal>
+
+#include <vector>
+
+/**
+ * Window kernels over plain float arrays. A NaN sample is a dropout: it is
+ * skipped by every kernel and counted as missing. The SSE2 versions are used
+ * on x86 builds, the scalar ones elsewhere and as the reference in the
+ * benchmark; both give the same results up to float rounding.
+ */
+namespace SignalKernels {
+
+struct Moments {
+    int count;      // valid samples
+    float sum;      // of (x - shift)
+    float sumSquares;
+    float min;
+    float max;
+};
+
+// shift is subtracted before summing so the variance keeps its precision
+Moments moments(const float *x, int n, float shift);
+Moments momentsScalar(const float *x, int n, float shift);
+
+// largest |x[i] - x[i-1]| between two valid neighbours, 0 when there is none
+float maxStep(const float *x, int n);
+float maxStepScalar(const float *x, int n);
+
+}
+
+/**
+ * Rolling signal quality for PLX Continuous readings, per device: mean and
+ * variance over the window, dropouts, motion artifacts (a step too large to
+ * be physiological) and whether the last few readings are stable enough to
+ * accept. Samples live in struct-of-arrays buffers, one SpO2 and one pulse
+ * rate array holding every device's window back to back, each window stored
+ * twice so the latest samples are always contiguous for the kernels.
+ */
+class SignalQuality
+{
+public:
+    struct Thresholds {
+        int stableSamples = 8;          // readings that must agree before one is accepted
+        float spo2Range = 1.0f;         // % SpO2 spread allowed across them
+        float pulseRange = 3.0f;        // bpm spread allowed across them
+        float spo2Step = 4.0f;          // a larger jump between readings is motion
+        float pulseStep = 15.0f;
+        float dropoutFraction = 0.25f;  // more missing readings than this in the window
+    };
+
+    struct Result {
+        float spo2Mean = 0.0f;
+        float spo2Deviation = 0.0f;
+        float pulseMean = 0.0f;
+        float pulseDeviation = 0.0f;
+        int samples = 0;                // in the window so far
+        int dropouts = 0;               // missing readings in the window
+        bool motion = false;
+        bool dropout = false;
+        bool stable = false;
+        float acceptedSpo2 = 0.0f;      // means over the stable span, when stable
+        float acceptedPulse = 0.0f;
+    };
+
+    // window is rounded up to a multiple of four
+    explicit SignalQuality(int window = 32);
+
+    void setThresholds(const Thresholds &thresholds) { m_thresholds = thresholds; }
+    const Thresholds &thresholds() const { return m_thresholds; }
+    int window() const { return m_window; }
+    int deviceCount() const { return m_slots.size(); }
+
+    // append one reading, NaN for a value the device could not measure
+    Result push(quint64 address, float spo2, float pulse);
+    // same for a batch, slots from slot(); cheaper when many devices stream
+    void pushBatch(const int *slots, const float *spo2, const float *pulse, int n, Result *results);
+    int slot(quint64 address);
+    void remove(quint64 address);
+
+    // the reference path for the benchmark
+    void setVectorised(bool vectorised) { m_vectorised = vectorised; }
+
+private:
+    Result update(int slot, float spo2, float pulse);
+    void assess(const float *spo2, const float *pulse, int filled, Result *r) const;
+
+    Thresholds m_thresholds;
+    int m_window;
+    bool m_vectorised = true;
+    QHash<quint64, int> m_slots;
+    QVector<int> m_free;
+    std::vector<float> m_spo2;          // 2 * window floats per slot
+    std::vector<float> m_pulse;
+    std::vector<int> m_cursor;          // next write position per slot
+    std::vector<int> m_filled;
+};
+
+Q_DECLARE_METATYPE(SignalQuality::Result)
+
+#endif // SIGNALQUALITY_H
@@ -0,0 +1,358 @@
+#include "simtransport.h"
+#include "structlog.h"
+#include "thermometerdecoder.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTimer>
+
+namespace {
+
+int jittered(int latencyMs, int jitterMs)
+{
+    return latencyMs + (0 < jitterMs ? int(QRandomGenerator::global()->bounded(jitterMs + 1)) : 0);
+}
+
+// cap on notifications emitted per timer tick so a stalled loop cannot burst forever
+const quint64 kMaxBurst = 1000;
+
+}
+
+SimLink::SimLink(const SimPeripheral &peripheral, SimTransport *transport, QObject *parent)
+    : BLELink(parent)
+    , m_peripheral(peripheral)
+    , m_transport(transport)
+    , m_streamTimer(new QTimer(this))
+{
+    m_streamTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_streamTimer, &QTimer::timeout, this, &SimLink::stream);
+}
+
+SimLink::~SimLink()
+{
+    if(nullptr!=m_transport)
+        m_transport->m_connected.remove(this);
+}
+
+void SimLink::later(int latencyMs, std::function<void()> fn)
+{
+    const quint32 generation = m_generation;
+    QTimer::singleShot(jittered(latencyMs, m_peripheral.latencyJitterMs), this, [this, generation, fn]() {
+        if(generation == m_generation)
+            fn();
+    });
+}
+
+void SimLink::connectToDevice()
+{
+    if(m_connected)
+        return;
+    later(m_peripheral.connectLatencyMs, [this]() {
+        // what a controller out of link slots or powered off answers
+        if(nullptr!=m_transport && (!m_transport->m_powered
+           || (0 < m_transport->m_maxLinks && m_transport->m_connected.size() >= m_transport->m_maxLinks))) {
+            emit errorOccurred(QLowEnergyController::ConnectionError, QStringLiteral("simulated adapter refused the link"));
+            return;
+        }
+        m_connected = true;
+        if(nullptr!=m_transport)
+            m_transport->m_connected.insert(this);
+        emit connected();
+        if(0 < m_peripheral.disconnectAfterMs)
+            later(m_peripheral.disconnectAfterMs, [this]() { drop(QLowEnergyController::RemoteHostClosedError); });
+    });
+}
+
+void SimLink::disconnectFromDevice()
+{
+    ++m_generation;
+    if(!m_connected)
+        return;
+    m_connected = false;
+    if(nullptr!=m_transport)
+        m_transport->m_connected.remove(this);
+    m_serviceOpen = false;
+    m_streamTimer->stop();
+    QTimer::singleShot(0, this, &BLELink::disconnected);
+}
+
+void SimLink::drop(QLowEnergyController::Error error)
+{
+    if(!m_connected)
+        return;
+    emit errorOccurred(error, QStringLiteral("simulated link drop"));
+    disconnectFromDevice();
+}
+
+void SimLink::discoverServices()
+{
+    later(m_peripheral.discoveryLatencyMs, [this]() {
+        emit serviceDiscovered(QBluetoothUuid(QBluetoothUuid::HealthThermometer));
+        if(0 < m_peripheral.serviceWalkMs)
+            later(m_peripheral.serviceWalkMs, [this]() { emit discoveryFinished(); });
+        else
+            emit discoveryFinished();
+    });
+}
+
+bool SimLink::openService(const QBluetoothUuid &service, DetailDiscovery mode)
+{
+    if(!m_connected || service != QBluetoothUuid(QBluetoothUuid::HealthThermometer))
+        return false;
+    int latencyMs = m_peripheral.discoveryLatencyMs;
+    if(FullDetails == mode)
+        latencyMs += m_peripheral.characteristicCount * m_peripheral.valueReadLatencyMs;
+    later(latencyMs, [this, service]() {
+        m_serviceOpen = true;
+        emit serviceReady(service);
+    });
+    return true;
+}
+
+bool SimLink::enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+{
+    Q_UNUSED(service)
+    if(!m_serviceOpen || characteristic != QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement))
+        return false;
+    later(m_peripheral.subscribeLatencyMs, [this, characteristic]() { startStream(characteristic); });
+    return true;
+}
+
+bool SimLink::readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic)
+{
+    Q_UNUSED(service)
+    QByteArray value;
+    if(characteristic == QBluetoothUuid(QBluetoothUuid::TemperatureType))
+        value = QByteArray::fromHex("02");          // body
+    else if(characteristic == QBluetoothUuid(QBluetoothUuid::MeasurementInterval))
+        value = QByteArray::fromHex("0100");        // one second
+    if(!m_serviceOpen || value.isEmpty())
+        return false;
+    later(m_peripheral.valueReadLatencyMs, [this, characteristic, value]() {
+        emit characteristicRead(characteristic, value);
+    });
+    return true;
+}
+
+QList<GattAttribute> SimLink::attributes(const QBluetoothUuid &service) const
+{
+    QList<GattAttribute> result;
+    if(!m_serviceOpen || service != QBluetoothUuid(QBluetoothUuid::HealthThermometer))
+        return result;
+
+    GattAttribute attribute;
+    attribute.service = service;
+    attribute.characteristic = QBluetoothUuid(QBluetoothUuid::TemperatureMeasurement);
+    attribute.valueHandle = m_peripheral.cccdHandle - 1;
+    attribute.cccdHandle = m_peripheral.cccdHandle;
+    result << attribute;
+    return result;
+}
+
+bool SimLink::enableNotifications(const GattAttribute &cached)
+{
+    if(!m_connected)
+        return false;
+    const QBluetoothUuid characteristic = cached.characteristic;
+    if(cached.cccdHandle != m_peripheral.cccdHandle) {
+        // a write to the wrong handle fails like an ATT error would
+        later(m_peripheral.subscribeLatencyMs, [this, characteristic]() {
+            emit notificationsEnabled(characteristic, false);
+        });
+        return true;
+    }
+    later(m_peripheral.subscribeLatencyMs, [this, characteristic]() { startStream(characteristic); });
+    return true;
+}
+
+void SimLink::requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters)
+{
+    if(!m_connected)
+        return;
+    // accepted after one round trip, like an LL connection update
+    later(m_peripheral.subscribeLatencyMs, [this, parameters]() {
+        m_parameters = parameters;
+        emit connectionUpdated(parameters);
+    });
+}
+
+void SimLink::startStream(const QBluetoothUuid &characteristic)
+{
+    emit notificationsEnabled(characteristic, true);
+    if(m_peripheral.notifications.isEmpty() || 0.0 >= m_peripheral.rateHz)
+        return;
+    m_streamed = 0;
+    m_streamClock.start();
+    m_streamTimer->start(qMax(1, int(1000.0 / m_peripheral.rateHz)));
+}
+
+void SimLink::stream()
+{
+    // emit however many notifications are due so rates above the timer
+    // resolution are met in bursts instead of being silently capped
+    const quint64 due = quint64(m_streamClock.nsecsElapsed() * m_peripheral.rateHz / 1e9);
+    quint64 burst = qMin(due > m_streamed ? due - m_streamed : 0, kMaxBurst);
+    const QBluetoothUuid characteristic(QBluetoothUuid::TemperatureMeasurement);
+    const quint32 generation = m_generation;
+
+    while(0 < burst-- && generation == m_generation) {
+        QByteArray value = m_peripheral.notifications.at(m_cursor);
+        m_cursor = (m_cursor + 1) % m_peripheral.notifications.size();
+        stamp(&value);
+        ++m_streamed;
+        ++m_sent;
+        emit notification(characteristic, value);
+
+        if(0.0 < m_peripheral.dropProbability
+           && QRandomGenerator::global()->generateDouble() < m_peripheral.dropProbability)
+            drop(QLowEnergyController::RemoteHostClosedError);
+    }
+}
+
+void SimLink::stamp(QByteArray *value)
+{
+    // flags, FLOAT, then year month day hours minutes seconds when flagged
+    if(value->size() < 12 || !(quint8(value->at(0)) & TemperatureMeasurement::HasTimestamp))
+        return;
+
+    // a whole second per reading and never behind the host, like a device
+    // clock ticking fast; a looping fixture then never repeats a reading
+    m_deviceMs = qMax(m_deviceMs + 1000, QDateTime::currentMSecsSinceEpoch() / 1000 * 1000);
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(m_deviceMs, Qt::UTC);
+    const QDate date = time.date();
+    const QTime clock = time.time();
+    char *p = value->data() + 5;
+    p[0] = char(date.year() & 0xff);
+    p[1] = char(date.year() >> 8);
+    p[2] = char(date.month());
+    p[3] = char(date.day());
+    p[4] = char(clock.hour());
+    p[5] = char(clock.minute());
+    p[6] = char(clock.second());
+}
+
+SimTransport::SimTransport(QObject *parent)
+    : BLETransport(parent)
+{
+}
+
+SimPeripheral SimTransport::thermometer(int index)
+{
+    SimPeripheral p;
+    p.info = QBluetoothDeviceInfo(QBluetoothAddress(Q_UINT64_C(0xC026DA000000) + quint64(index)),
+                                  QString("simulated thermometer %1").arg(index), 0);
+    p.info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+    p.info.setServiceUuids(QList<QBluetoothUuid>() << QBluetoothUuid(QBluetoothUuid::HealthThermometer),
+                           QBluetoothDeviceInfo::DataIncomplete);
+    p.info.setRssi(-55);
+    // fixtures documented in BLESession::processMeasurement
+    p.notifications << QByteArray::fromHex("07d30300ffe50707080f220001")
+                    << QByteArray::fromHex("07d80300ffe50707090b060001")
+                    << QByteArray::fromHex("066b0100ffe50707090c150001");
+    return p;
+}
+
+QList<QByteArray> SimTransport::loadRecording(const QString &path)
+{
+    QList<QByteArray> notifications;
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        LOG_ERROR("sim.recording_failed", "path", path, "error", file.errorString());
+        return notifications;
+    }
+    while(!file.atEnd()) {
+        QByteArray line = file.readLine();
+        const int comment = line.indexOf('#');
+        if(0 <= comment)
+            line.truncate(comment);
+        line = line.trimmed();
+        if(!line.isEmpty())
+            notifications << QByteArray::fromHex(line);
+    }
+    return notifications;
+}
+
+void SimTransport::addPeripheral(const SimPeripheral &peripheral)
+{
+    m_peripherals << peripheral;
+}
+
+bool SimTransport::open(const QBluetoothAddress &adapter)
+{
+    m_adapter = adapter.isNull() ? QBluetoothAddress(Q_UINT64_C(0x00005E000001)) : adapter;
+    return true;
+}
+
+void SimTransport::setPowered(bool powered)
+{
+    if(m_powered == powered)
+        return;
+    m_powered = powered;
+    LOG_INFO("sim.adapter_power", "address", Log::mac(m_adapter.toUInt64()), "powered", powered,
+             "links", m_connected.size());
+    if(!powered) {
+        stopScan();
+        // drop() leaves the set through disconnectFromDevice
+        const QSet<SimLink *> links = m_connected;
+        for(SimLink *link : links)
+            link->drop(QLowEnergyController::UnknownError);
+    }
+    emit poweredChanged(powered);
+}
+
+void SimTransport::startScan()
+{
+    if(!m_powered) {
+        emit scanError(QBluetoothDeviceDiscoveryAgent::PoweredOffError, QStringLiteral("simulated adapter is powered off"));
+        return;
+    }
+    const quint32 generation = ++m_scanGeneration;
+    m_scanning = true;
+
+    int lastAdvertiseMs = 0;
+    for(const SimPeripheral &p : qAsConst(m_peripherals)) {
+        const QBluetoothDeviceInfo info = p.info;
+        QTimer::singleShot(p.advertiseDelayMs, this, [this, generation, info]() {
+            if(generation == m_scanGeneration && m_scanning)
+                advertisementReceived(info);
+        });
+        lastAdvertiseMs = qMax(lastAdvertiseMs, p.advertiseDelayMs);
+    }
+    for(int i = 0; i < m_passersBy; ++i) {
+        // static random: the two top bits set
+        const quint64 address = (QRandomGenerator::global()->generate64() & Q_UINT64_C(0xFFFFFFFFFFFF))
+            | Q_UINT64_C(0xC00000000000);
+        QBluetoothDeviceInfo info(QBluetoothAddress(address), QStringLiteral("passer-by"), 0);
+        info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+        info.setServiceUuids(QList<QBluetoothUuid>() << QBluetoothUuid(QBluetoothUuid::HealthThermometer),
+                             QBluetoothDeviceInfo::DataIncomplete);
+        info.setRssi(-80);
+        QTimer::singleShot(0, this, [this, generation, info]() {
+            if(generation == m_scanGeneration && m_scanning)
+                advertisementReceived(info);
+        });
+    }
+    QTimer::singleShot(lastAdvertiseMs + 1, this, [this, generation]() {
+        if(generation == m_scanGeneration && m_scanning) {
+            m_scanning = false;
+            emit scanFinished();
+        }
+    });
+}
+
+void SimTransport::stopScan()
+{
+    ++m_scanGeneration;
+    m_scanning = false;
+}
+
+BLELink *SimTransport::createLink(const QBluetoothDeviceInfo &info, QObject *parent)
+{
+    for(const SimPeripheral &p : qAsConst(m_peripherals)) {
+        if(p.info.address() == info.address())
+            return new SimLink(p, this, parent);
+    }
+    LOG_WARNING("sim.no_peripheral", "address", Log::mac(info.address().toUInt64()));
+    return nullptr;
+}
@@ -0,0 +1,142 @@
+#ifndef SIMTRANSPORT_H
+#define SIMTRANSPORT_H
+
+#include "bletransport.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+/**
+ * One simulated peripheral: a Health Thermometer that replays a recorded
+ * notification stream at a fixed rate, with injected latencies and drops.
+ */
+struct SimPeripheral
+{
+    QBluetoothDeviceInfo info;
+    QList<QByteArray> notifications;  // replayed in order, looping; timestamps are restamped
+
+    double rateHz = 1.0;              // notifications per second, thousands are fine
+    int advertiseDelayMs = 0;         // scan start to deviceDiscovered
+    int connectLatencyMs = 0;
+    int discoveryLatencyMs = 0;       // discoverServices and openService each
+    int serviceWalkMs = 0;            // rest of the primary service walk once the thermometer is found
+    int subscribeLatencyMs = 0;       // CCCD write round trip
+    int characteristicCount = 4;      // Health Thermometer characteristics read by full discovery
+    int valueReadLatencyMs = 0;       // per characteristic value read
+    int latencyJitterMs = 0;          // uniform extra delay added to each latency
+    int disconnectAfterMs = 0;        // drop the link this long after subscribing, 0 never
+    QLowEnergyHandle cccdHandle = 0x0010;  // Temperature Measurement CCCD, change to model a firmware update
+    double dropProbability = 0.0;     // chance of a drop after each notification
+};
+
+class SimTransport;
+
+class SimLink : public BLELink
+{
+    Q_OBJECT
+
+public:
+    SimLink(const SimPeripheral &peripheral, SimTransport *transport, QObject *parent = nullptr);
+    ~SimLink();
+
+    void connectToDevice() override;
+    void disconnectFromDevice() override;
+    bool isConnected() const override { return m_connected; }
+
+    void discoverServices() override;
+    bool openService(const QBluetoothUuid &service, DetailDiscovery mode) override;
+    using BLELink::enableNotifications;
+    bool enableNotifications(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    // Temperature Type and Measurement Interval, each after valueReadLatencyMs
+    bool readCharacteristic(const QBluetoothUuid &service, const QBluetoothUuid &characteristic) override;
+    QList<GattAttribute> attributes(const QBluetoothUuid &service) const override;
+    bool enableNotifications(const GattAttribute &cached) override;
+    void requestConnectionUpdate(const QLowEnergyConnectionParameters &parameters) override;
+
+    quint64 notificationsSent() const { return m_sent; }
+    const QLowEnergyConnectionParameters &connectionParameters() const { return m_parameters; }
+
+private slots:
+    void stream();
+
+private:
+    // run fn after the given latency unless the connection has gone away
+    void later(int latencyMs, std::function<void()> fn);
+    void drop(QLowEnergyController::Error error);
+    void startStream(const QBluetoothUuid &characteristic);
+    // rewrite a timestamp field with the link's device clock
+    void stamp(QByteArray *value);
+
+    friend class SimTransport;
+
+    SimPeripheral m_peripheral;
+    QPointer<SimTransport> m_transport;
+    QLowEnergyConnectionParameters m_parameters;
+    QTimer *m_streamTimer = nullptr;
+    QElapsedTimer m_streamClock;
+    quint64 m_streamed = 0;           // notifications sent since subscribing
+    quint64 m_sent = 0;               // over the link lifetime
+    int m_cursor = 0;
+    qint64 m_deviceMs = 0;            // last timestamp sent, UTC ms
+    quint32 m_generation = 0;         // bumped on disconnect to cancel pending steps
+    bool m_connected = false;
+    bool m_serviceOpen = false;
+};
+
+class SimTransport : public BLETransport
+{
+    Q_OBJECT
+
+public:
+    explicit SimTransport(QObject *parent = nullptr);
+
+    void addPeripheral(const SimPeripheral &peripheral);
+    const QList<SimPeripheral> &peripherals() const { return m_peripherals; }
+
+    // thermometer n with the documented fixture stream, address C0:26:DA:00:xx:xx
+    static SimPeripheral thermometer(int index);
+
+    // one hex encoded notification per line, '#' starts a comment
+    static QList<QByteArray> loadRecording(const QString &path);
+
+    bool open(const QBluetoothAddress &adapter) override;
+    QBluetoothAddress adapterAddress() const override { return m_adapter; }
+    QString adapterName() const override { return QStringLiteral("simulated"); }
+
+    void startScan() override;
+    void stopScan() override;
+    bool isScanning() const override { return m_scanning; }
+
+    BLELink *createLink(const QBluetoothDeviceInfo &info, QObject *parent) override;
+    bool isSimulated() const override { return true; }
+
+    // a controller's limit on concurrent LE links, connects beyond it fail; 0 for none
+    void setMaxLinks(int count) { m_maxLinks = count; }
+    int connectedLinks() const { return m_connected.size(); }
+    // every scan window also hears this many thermometers nobody targets, each
+    // at a fresh random address, the way devices with private addresses pass by
+    void setPassersBy(int count) { m_passersBy = count; }
+    // powering off drops every link and fails connects and scans until powered again
+    void setPowered(bool powered);
+    bool isPowered() const override { return m_powered; }
+
+private:
+    friend class SimLink;
+
+    QList<SimPeripheral> m_peripherals;
+    QBluetoothAddress m_adapter;
+    QSet<SimLink *> m_connected;
+    int m_maxLinks = 0;
+    int m_passersBy = 0;
+    bool m_powered = true;
+    quint32 m_scanGeneration = 0;
+    bool m_scanning = false;
+};
+
+#endif // SIMTRANSPORT_H
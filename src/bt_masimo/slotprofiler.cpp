@@ -0,0 +1,248 @@
+#include "slotprofiler.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
+#include "structlog.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+#include <cstring>
+
+std::atomic<int> SlotProfiler::s_flags(0);
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    qint64 startedAt;
+    qint64 duration;
+    quint64 thread;
+};
+
+struct State
+{
+    QMutex mutex;
+    QList<SlotProfiler::Site *> sites;
+    QVector<TraceEvent> trace;          // ring, oldest at next once wrapped
+    int next = 0;
+    bool wrapped = false;
+    std::atomic<bool> tracing;
+
+    // written by the event loop thread only
+    std::atomic<const char *> running[SlotProfiler::kMaxDepth];
+    std::atomic<int> depth;
+    std::atomic<qint64> outerStartedAt;
+    std::atomic<quint64> loopThread;
+    std::atomic<int> watchers;
+
+    State() : tracing(false), depth(0), outerStartedAt(0), loopThread(0), watchers(0)
+    {
+        for(std::atomic<const char *> &name : running)
+            name.store(nullptr, std::memory_order_relaxed);
+    }
+};
+
+State &state()
+{
+    static State s;
+    return s;
+}
+
+thread_local bool t_eventLoop = false;
+
+quint64 currentThread()
+{
+    return quint64(quintptr(QThread::currentThreadId()));
+}
+
+void record(State &s, const TraceEvent &event)
+{
+    QMutexLocker lock(&s.mutex);
+    if(s.trace.isEmpty())
+        return;
+    s.trace[s.next] = event;
+    if(++s.next == s.trace.size()) {
+        s.next = 0;
+        s.wrapped = true;
+    }
+}
+
+}
+
+SlotProfiler::Site *SlotProfiler::site(const char *name)
+{
+    State &s = state();
+    QMutexLocker lock(&s.mutex);
+    for(Site *site : qAsConst(s.sites)) {
+        if(0 == std::strcmp(site->name, name))
+            return site;
+    }
+    Site *site = new Site;
+    site->name = name;
+    s.sites << site;
+    lock.unlock();
+
+    Metrics::summary(nullptr, "pine_slot_duration_seconds", "Time in each profiled event loop handler",
+                     &site->duration, Metrics::label("slot", QString::fromLatin1(name)));
+    return site;
+}
+
+void SlotProfiler::setTraceCapacity(int events)
+{
+    State &s = state();
+    QMutexLocker lock(&s.mutex);
+    s.trace = QVector<TraceEvent>(qMax(0, events));
+    s.next = 0;
+    s.wrapped = false;
+    s.tracing.store(0 < events, std::memory_order_relaxed);
+}
+
+void SlotProfiler::setEventLoopThread()
+{
+    t_eventLoop = true;
+    state().loopThread.store(currentThread(), std::memory_order_relaxed);
+}
+
+void SlotProfiler::setWatched(bool watched)
+{
+    if(0 < state().watchers.fetch_add(watched ? 1 : -1, std::memory_order_relaxed) + (watched ? 1 : -1))
+        s_flags.fetch_or(Stacked, std::memory_order_relaxed);
+    else
+        s_flags.fetch_and(~Stacked, std::memory_order_relaxed);
+}
+
+int SlotProfiler::running(const char **names, int max, qint64 *outerStartedAt)
+{
+    const State &s = state();
+    const int depth = s.depth.load(std::memory_order_acquire);
+    const int count = qMin(qMin(depth, max), int(kMaxDepth));
+    for(int i = 0; i < count; ++i)
+        names[i] = s.running[i].load(std::memory_order_relaxed);
+    if(nullptr!=outerStartedAt)
+        *outerStartedAt = 0 < depth ? s.outerStartedAt.load(std::memory_order_relaxed) : 0;
+    return count;
+}
+
+qint64 SlotProfiler::enter(Site *site, int *flags)
+{
+    // only the event loop thread stacks, and then for timing as well as watching
+    if(t_eventLoop)
+        *flags |= Stacked;
+    else
+        *flags &= ~Stacked;
+    const qint64 now = 0 != (*flags & Timed) ? LatencyRecorder::now() : 0;
+    if(0 != (*flags & Stacked)) {
+        State &s = state();
+        const int depth = s.depth.load(std::memory_order_relaxed);
+        if(depth < kMaxDepth)
+            s.running[depth].store(site->name, std::memory_order_relaxed);
+        if(0 == depth)
+            s.outerStartedAt.store(0 != now ? now : LatencyRecorder::now(), std::memory_order_relaxed);
+        s.depth.store(depth + 1, std::memory_order_release);
+    }
+    return now;
+}
+
+void SlotProfiler::leave(Site *site, int flags, qint64 startedAt)
+{
+    State &s = state();
+    if(0 != (flags & Stacked))
+        s.depth.store(s.depth.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+    if(0 == (flags & Timed))
+        return;
+    const qint64 duration = LatencyRecorder::now() - startedAt;
+    site->duration.recordNanoseconds(duration);
+    if(s.tracing.load(std::memory_order_relaxed)) {
+        const TraceEvent event = { site->name, "slot", startedAt, duration, currentThread() };
+        record(s, event);
+    }
+}
+
+void SlotProfiler::traceSpan(const char *name, const char *category, qint64 startedAt, qint64 duration)
+{
+    State &s = state();
+    if(!s.tracing.load(std::memory_order_relaxed))
+        return;
+    // spans about the event loop go on its track
+    quint64 thread = s.loopThread.load(std::memory_order_relaxed);
+    if(0 == thread)
+        thread = currentThread();
+    const TraceEvent event = { name, category, startedAt, duration, thread };
+    record(s, event);
+}
+
+bool SlotProfiler::writeChromeTrace(const QString &path)
+{
+    State &s = state();
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    QJsonObject sites;
+    {
+        QMutexLocker lock(&s.mutex);
+        const int count = s.wrapped ? s.trace.size() : s.next;
+        const int first = s.wrapped ? s.next : 0;
+        for(int i = 0; i < count; ++i) {
+            const TraceEvent &e = s.trace.at((first + i) % s.trace.size());
+            QJsonObject event;
+            event["name"] = QString::fromLatin1(e.name);
+            event["cat"] = QString::fromLatin1(e.category);
+            event["ph"] = "X";
+            event["ts"] = e.startedAt / 1000.0;
+            event["dur"] = e.duration / 1000.0;
+            event["pid"] = double(pid);
+            event["tid"] = double(e.thread);
+            events.append(event);
+        }
+        for(const Site *site : qAsConst(s.sites))
+            sites[QString::fromLatin1(site->name)] = site->duration.toJson();
+    }
+
+    const quint64 loop = s.loopThread.load(std::memory_order_relaxed);
+    if(0 != loop) {
+        QJsonObject name;
+        name["name"] = "thread_name";
+        name["ph"] = "M";
+        name["pid"] = double(pid);
+        name["tid"] = double(loop);
+        name["args"] = QJsonObject{{"name", "event loop"}};
+        events.prepend(name);
+    }
+
+    QJsonObject json;
+    json["traceEvents"] = events;
+    json["displayTimeUnit"] = "ms";
+    // ignored by the viewers, the whole run rather than the ring's window
+    json["slots"] = sites;
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly)) {
+        LOG_ERROR("profile.trace_failed", "path", path, "error", file.errorString());
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    if(!file.commit()) {
+        LOG_ERROR("profile.trace_failed", "path", path, "error", file.errorString());
+        return false;
+    }
+    LOG_INFO("profile.trace_written", "path", path, "events", events.size());
+    return true;
+}
+
+void SlotProfiler::reset()
+{
+    State &s = state();
+    QMutexLocker lock(&s.mutex);
+    for(Site *site : qAsConst(s.sites))
+        site->duration.reset();
+    s.next = 0;
+    s.wrapped = false;
+}
@@ -0,0 +1,116 @@
+#ifndef SLOTPROFILER_H
+#define SLOTPROFILER_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+#include "latencyhistogram.h"
+
+/**
+ * Time spent in the handlers that share the event loop. A handler opens a
+ * scope at its top with a static name:
+ *
+ *     void SessionManager::deviceDiscovered(const QBluetoothDeviceInfo &info)
+ *     {
+ *         PROFILE_SLOT("SessionManager::deviceDiscovered");
+ *
+ * The first pass registers the site, later ones cost one relaxed load while
+ * profiling is off. Switched on, every run goes into the site's histogram
+ * (exposed as pine_slot_duration_seconds{slot=...}) and, while a trace is
+ * kept, into a ring of the most recent runs that writeChromeTrace() turns
+ * into a file for chrome://tracing or Perfetto. On the event loop thread
+ * the scopes also keep a stack of the names running, which StallWatchdog
+ * reads from its own thread to say which handler a stall is in. The stack
+ * is kept while a watchdog is watching, whether profiling is on or not.
+ *
+ * PINE_PROFILE 0 compiles the scopes out.
+ */
+
+#ifndef PINE_PROFILE
+#  define PINE_PROFILE 1
+#endif
+
+#if PINE_PROFILE
+#  define PROFILE_SLOT(name) \
+    static SlotProfiler::Site *const pineProfileSite = SlotProfiler::site(name); \
+    const SlotProfiler::Scope pineProfileScope(pineProfileSite)
+#else
+#  define PROFILE_SLOT(name) do {} while(0)
+#endif
+
+class SlotProfiler
+{
+public:
+    struct Site
+    {
+        const char *name;
+        LatencyHistogram duration;
+    };
+
+    class Scope
+    {
+    public:
+        explicit Scope(Site *site)
+            : m_site(site)
+            , m_flags(s_flags.load(std::memory_order_relaxed))
+        {
+            if(0 != m_flags)
+                m_startedAt = enter(m_site, &m_flags);
+        }
+        ~Scope()
+        {
+            if(0 != m_flags)
+                leave(m_site, m_flags, m_startedAt);
+        }
+
+    private:
+        Q_DISABLE_COPY(Scope)
+
+        Site *m_site;
+        int m_flags;        // what this scope does, settled by enter()
+        qint64 m_startedAt = 0;
+    };
+
+    // registered once per name and kept for the life of the process
+    static Site *site(const char *name);
+
+    // time the runs into the histograms and the trace
+    static void setEnabled(bool enabled)
+    {
+        if(enabled)
+            s_flags.fetch_or(Timed, std::memory_order_relaxed);
+        else
+            s_flags.fetch_and(~Timed, std::memory_order_relaxed);
+    }
+    static bool isEnabled() { return s_flags.load(std::memory_order_relaxed) & Timed; }
+    // keep the last events runs for the trace, 0 keeps none
+    static void setTraceCapacity(int events);
+
+    // the calling thread's scopes are the ones stacked for the watchdog
+    static void setEventLoopThread();
+    // keep the stack while at least one watcher wants it, each true paired with a false
+    static void setWatched(bool watched);
+    static const int kMaxDepth = 16;
+    // names of the scopes open on the event loop thread, outermost first, and
+    // when the outermost opened; any thread, may be a moment stale
+    static int running(const char **names, int max, qint64 *outerStartedAt = nullptr);
+
+    // a span that is not a scope, e.g. a stall, for the trace
+    static void traceSpan(const char *name, const char *category, qint64 startedAt, qint64 duration);
+
+    // the trace ring plus a summary of every site, in the Trace Event Format
+    static bool writeChromeTrace(const QString &path);
+    static void reset();
+
+private:
+    enum Flag { Timed = 1, Stacked = 2 };
+
+    static qint64 enter(Site *site, int *flags);
+    static void leave(Site *site, int flags, qint64 startedAt);
+
+    static std::atomic<int> s_flags;
+};
+
+#endif // SLOTPROFILER_H
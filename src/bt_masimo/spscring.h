@@ -0,0 +1,82 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+/**
+ * Bounded single-producer/single-consumer ring. One thread pushes, one
+ * other thread pops; neither ever blocks or allocates after construction.
+ * The capacity is rounded up to a power of two. Head and tail sit on
+ * separate cache lines and each side keeps a stale copy of the other's
+ * index so the common case touches only its own line.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(quint32 capacity)
+    {
+        quint32 size = 2;
+        while(size < capacity)
+            size <<= 1;
+        m_slots.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    quint32 capacity() const { return m_mask + 1; }
+    // exact on either side, a snapshot from anywhere else
+    quint32 size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    // producer only, false when full
+    bool tryPush(const T &value)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        if(head - m_cachedTail > m_mask) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if(head - m_cachedTail > m_mask)
+                return false;
+        }
+        m_slots[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only, copies up to max values into out and returns how many
+    int popBatch(T *out, int max)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        if(m_cachedHead == tail)
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+        const quint32 available = m_cachedHead - tail;
+        const int count = int(qMin<quint32>(available, quint32(max)));
+        for(int i = 0; i < count; ++i)
+            out[i] = m_slots[(tail + quint32(i)) & m_mask];
+        m_tail.store(tail + quint32(count), std::memory_order_release);
+        return count;
+    }
+
+private:
+    static const int kCacheLine = 64;
+
+    std::vector<T> m_slots;
+    quint32 m_mask = 0;
+
+    char m_pad0[kCacheLine];
+    std::atomic<quint32> m_head {0};     // written by the producer
+    quint32 m_cachedTail = 0;            // producer's view of m_tail
+    char m_pad1[kCacheLine];
+    std::atomic<quint32> m_tail {0};     // written by the consumer
+    quint32 m_cachedHead = 0;            // consumer's view of m_head
+    char m_pad2[kCacheLine];
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,112 @@
+#include "stallwatchdog.h"
+#include "latencyrecorder.h"
+#include "metrics.h"
+#include "slotprofiler.h"
+#include "structlog.h"
+
+StallWatchdog::StallWatchdog(int thresholdMs, QObject *parent)
+    : QThread(parent)
+    , m_thresholdNs(qint64(qMax(1, thresholdMs)) * 1000000LL)
+    , m_intervalMs(qMax(1, thresholdMs / 4))
+    , m_lastBeat(0)
+    , m_stalls(0)
+{
+    setObjectName("watchdog");
+    m_beat.setTimerType(Qt::PreciseTimer);
+    connect(&m_beat, &QTimer::timeout, this, &StallWatchdog::beat);
+
+    Metrics::sample(this, Metrics::Counter, "pine_event_loop_stalls_total",
+                    "Times the event loop went longer than the stall threshold without a pass",
+                    [this]() { return double(stalls()); });
+    Metrics::summary(this, "pine_event_loop_stall_seconds", "How long each event loop stall lasted",
+                     &m_stallTime);
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::watch()
+{
+    SlotProfiler::setEventLoopThread();
+    // names the stalled handler whether or not profiling is on
+    SlotProfiler::setWatched(true);
+    m_lastBeat.store(LatencyRecorder::now(), std::memory_order_release);
+    m_beat.start(m_intervalMs);
+    start(QThread::HighPriority);
+}
+
+void StallWatchdog::stop()
+{
+    m_beat.stop();
+    if(!isRunning())
+        return;
+    requestInterruption();
+    {
+        QMutexLocker locker(&m_sleepLock);
+        m_sleep.wakeOne();
+    }
+    wait();
+    SlotProfiler::setWatched(false);
+}
+
+void StallWatchdog::run()
+{
+    qint64 reported = 0;
+    QMutexLocker locker(&m_sleepLock);
+    while(!isInterruptionRequested()) {
+        m_sleep.wait(&m_sleepLock, ulong(m_intervalMs));
+        const qint64 beat = m_lastBeat.load(std::memory_order_acquire);
+        const qint64 now = LatencyRecorder::now();
+        // measured from when the next beat was due, as beat() does
+        const qint64 late = now - beat - qint64(m_intervalMs) * 1000000LL;
+        if(late < m_thresholdNs || beat == reported)
+            continue;
+
+        // once per stall, while the handler responsible is still on the stack
+        reported = beat;
+        const char *names[SlotProfiler::kMaxDepth];
+        qint64 outerStartedAt = 0;
+        const int depth = SlotProfiler::running(names, SlotProfiler::kMaxDepth, &outerStartedAt);
+        const char *in = 0 < depth ? names[depth - 1] : nullptr;
+        const char *outer = 0 < depth ? names[0] : nullptr;
+        {
+            QMutexLocker seen(&m_seenLock);
+            m_seenAfter = beat;
+            m_seenIn = in;
+            m_seenOuter = outer;
+        }
+        LOG_WARNING("eventloop.stalled", "ms", late / 1000000, "slot", nullptr!=in ? in : "unprofiled",
+                    "outer", nullptr!=outer ? outer : "unprofiled",
+                    "outer_ms", 0 < depth ? (now - outerStartedAt) / 1000000 : 0);
+    }
+}
+
+void StallWatchdog::beat()
+{
+    const qint64 now = LatencyRecorder::now();
+    const qint64 previous = m_lastBeat.exchange(now, std::memory_order_acq_rel);
+    // how far past due this beat ran
+    const qint64 late = now - previous - qint64(m_intervalMs) * 1000000LL;
+    if(late < m_thresholdNs)
+        return;
+
+    // a stall shorter than the watchdog's wake-up may end before it looks
+    const char *in = "unseen";
+    const char *outer = "unseen";
+    bool profiled = false;
+    {
+        QMutexLocker seen(&m_seenLock);
+        if(previous == m_seenAfter) {
+            profiled = nullptr!=m_seenIn;
+            in = profiled ? m_seenIn : "unprofiled";
+            outer = profiled ? m_seenOuter : "unprofiled";
+        }
+    }
+    m_stalls.fetch_add(1, std::memory_order_relaxed);
+    m_stallTime.recordNanoseconds(late);
+    SlotProfiler::traceSpan("event loop stall", "stall", now - late, late);
+    LOG_WARNING("eventloop.stall", "ms", late / 1000000, "slot", in, "outer", outer);
+    emit stalled(late / 1000000, profiled ? QString::fromLatin1(in) : QString());
+}
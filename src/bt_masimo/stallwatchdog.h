@@ -0,0 +1,70 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QMutex>
+#include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include <atomic>
+
+#include "latencyhistogram.h"
+
+/**
+ * Notices when the event loop of the thread that creates it stops turning.
+ * A timer on that loop stamps a heartbeat every quarter of the threshold; a
+ * thread of the watchdog's own wakes as often and, finding the heartbeat
+ * older than the threshold, reads SlotProfiler's stack of running handlers
+ * and logs eventloop.stalled there and then, so a loop that never comes
+ * back is still reported. The first late beat afterwards measures the whole
+ * stall, logs eventloop.stall, adds it to the Chrome trace and emits
+ * stalled(). Only handlers with a PROFILE_SLOT scope can be named, profiling
+ * on or not.
+ */
+class StallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit StallWatchdog(int thresholdMs = 250, QObject *parent = nullptr);
+    ~StallWatchdog();
+
+    int threshold() const { return int(m_thresholdNs / 1000000); }
+
+    // start beating on the creating thread's loop and watching it
+    void watch();
+    void stop();
+
+    quint64 stalls() const { return m_stalls.load(std::memory_order_relaxed); }
+    const LatencyHistogram &stallTime() const { return m_stallTime; }
+
+signals:
+    // on the watched thread once its loop is back; in is the innermost
+    // profiled handler running when the watchdog looked, empty if none was
+    void stalled(qint64 ms, const QString &in);
+
+protected:
+    void run() override;
+
+private slots:
+    void beat();
+
+private:
+    qint64 m_thresholdNs;
+    int m_intervalMs;
+    QTimer m_beat;
+    std::atomic<qint64> m_lastBeat;
+    std::atomic<quint64> m_stalls;
+    LatencyHistogram m_stallTime;
+
+    // what the watchdog saw during the stall that began after the beat at m_seenAfter
+    QMutex m_seenLock;
+    qint64 m_seenAfter = 0;
+    const char *m_seenIn = nullptr;
+    const char *m_seenOuter = nullptr;
+
+    QMutex m_sleepLock;
+    QWaitCondition m_sleep;
+};
+
+#endif // STALLWATCHDOG_H
@@ -0,0 +1,82 @@
+#include "startupprofile.h"
+#include "structlog.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+
+namespace {
+
+QBluetoothDeviceInfo peripheral(const QString &address, const QString &name, const QString &service)
+{
+    QBluetoothDeviceInfo info(QBluetoothAddress(address), name, 0);
+    info.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+    if(!service.isEmpty())
+        info.setServiceUuids(QList<QBluetoothUuid>() << QBluetoothUuid(service), QBluetoothDeviceInfo::DataIncomplete);
+    return info;
+}
+
+}
+
+QString StartupProfile::defaultPath()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)).filePath("bt.ini");
+}
+
+StartupProfile StartupProfile::read(const QString &path)
+{
+    StartupProfile profile;
+    QSettings settings(path, QSettings::IniFormat);
+    profile.adapter = QBluetoothAddress(settings.value("client/address").toString());
+    profile.adapterName = settings.value("client/name").toString();
+
+    // single peripheral entry written by earlier versions
+    const QString address = settings.value("peripheral/address").toString();
+    if(!address.isEmpty()) {
+        profile.peripherals << peripheral(address, QString(), QString());
+        LOG_DEBUG("settings.peripheral", "address", Log::mac(QBluetoothAddress(address).toUInt64()));
+    }
+
+    const int size = settings.beginReadArray("peripherals");
+    for(int i = 0; i < size; ++i) {
+        settings.setArrayIndex(i);
+        const QBluetoothDeviceInfo info = peripheral(settings.value("address").toString(),
+                                                     settings.value("name").toString(),
+                                                     settings.value("service").toString());
+        if(!info.address().isNull())
+            profile.peripherals << info;
+    }
+    settings.endArray();
+    if(0 < size) {
+        LOG_DEBUG("settings.peripherals", "count", size);
+    }
+
+    profile.gattCache.read(settings);
+    return profile;
+}
+
+void StartupProfile::write(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSettings settings(path, QSettings::IniFormat);
+    if(!adapter.isNull()) {
+        settings.setValue("client/name", adapterName);
+        settings.setValue("client/address", adapter.toString());
+    }
+    if(!peripherals.isEmpty()) {
+        settings.remove("peripheral");
+        settings.beginWriteArray("peripherals", peripherals.size());
+        for(int i = 0; i < peripherals.size(); ++i) {
+            const QBluetoothDeviceInfo &info = peripherals.at(i);
+            settings.setArrayIndex(i);
+            settings.setValue("name", info.name());
+            settings.setValue("address", info.address().toString());
+            if(!info.serviceUuids().isEmpty())
+                settings.setValue("service", info.serviceUuids().first().toString());
+        }
+        settings.endArray();
+        LOG_DEBUG("settings.written", "peripherals", peripherals.size());
+    }
+    gattCache.write(settings);
+}
@@ -0,0 +1,34 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include "gattcache.h"
+
+#include <QBluetoothDeviceInfo>
+#include <QList>
+#include <QString>
+
+/**
+ * What the settings file keeps between runs: the local adapter last used,
+ * the peripherals there were sessions for and their GATT handles. Reading it
+ * is file parsing with no Bluetooth or QObject state involved, so startup can
+ * do it on a worker thread while the adapters are probed. A warm profile lets
+ * the next run connect to its peripherals before a scan has heard them.
+ */
+struct StartupProfile
+{
+    QBluetoothAddress adapter;
+    QString adapterName;
+    // address, name and the service of the profile in use, as an advertisement would give them
+    QList<QBluetoothDeviceInfo> peripherals;
+    GattCache gattCache;
+
+    bool isWarm() const { return !peripherals.isEmpty(); }
+
+    // bt.ini in the application's config directory
+    static QString defaultPath();
+    static StartupProfile read(const QString &path);
+    // a null adapter or no peripherals leave what the file has for them
+    void write(const QString &path) const;
+};
+
+#endif // STARTUPPROFILE_H
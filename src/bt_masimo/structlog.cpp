@@ -0,0 +1,315 @@
+#include "structlog.h"
+#include "spscring.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+std::atomic<int> Log::s_level {PINE_LOG_LEVEL};
+
+namespace {
+
+// records per thread before new ones are dropped, about 1 MB
+const quint32 kRingCapacity = 8192;
+const int kBatch = 256;
+// how long the writer sleeps once every ring is empty
+const int kIdleMs = 5;
+
+struct ThreadRing
+{
+    ThreadRing(quint32 id) : ring(kRingCapacity), id(id) {}
+
+    SpscRing<Log::Record> ring;
+    const quint32 id;
+    std::atomic<quint64> dropped {0};
+    std::atomic<bool> orphaned {false};     // its thread has exited
+};
+
+// marks the ring for reclamation when the owning thread exits
+struct RingHandle
+{
+    ThreadRing *ring = nullptr;
+    ~RingHandle()
+    {
+        if(nullptr!=ring)
+            ring->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+thread_local RingHandle t_ring;
+
+QMutex registryMutex;
+QVector<ThreadRing *> registry;
+quint32 nextThreadId = 0;
+quint64 droppedByExitedThreads = 0;
+std::atomic<quint64> recordsWritten {0};
+
+void release(const Log::Record &r)
+{
+    for(int i = 0; i < r.count; ++i) {
+        if(Log::Text == r.types[i])
+            delete r.values[i].text;
+    }
+}
+
+void appendValue(QByteArray &line, quint8 type, const Log::Value &v)
+{
+    switch(type) {
+    case Log::Int: line += QByteArray::number(v.i); break;
+    case Log::UInt: line += QByteArray::number(v.u); break;
+    case Log::Double: line += QByteArray::number(v.d, 'g', 6); break;
+    case Log::Bool: line += v.u ? "true" : "false"; break;
+    case Log::Mac: {
+        char mac[18];
+        std::snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+                      unsigned(v.u >> 40) & 0xff, unsigned(v.u >> 32) & 0xff, unsigned(v.u >> 24) & 0xff,
+                      unsigned(v.u >> 16) & 0xff, unsigned(v.u >> 8) & 0xff, unsigned(v.u) & 0xff);
+        line += mac;
+        break;
+    }
+    case Log::Literal:
+    case Log::Text: {
+        const QByteArray text = Log::Literal == type ? QByteArray(nullptr!=v.s ? v.s : "")
+                                                     : v.text->toUtf8();
+        // quote anything a key=value reader would split on
+        if(text.isEmpty() || text.contains(' ') || text.contains('=') || text.contains('"')) {
+            line += '"';
+            line += QByteArray(text).replace('"', "\\\"").replace('\n', "\\n");
+            line += '"';
+        } else {
+            line += text;
+        }
+        break;
+    }
+    }
+}
+
+// wallMs and steadyNs are one moment on both clocks, to place the steady timestamp
+void format(QByteArray &text, quint32 thread, const Log::Record &r, qint64 wallMs, qint64 steadyNs)
+{
+    static const char levels[] = "TDIWE";
+    const qint64 ms = wallMs + (r.time - steadyNs) / 1000000;
+    text += QDateTime::fromMSecsSinceEpoch(ms, Qt::UTC).toString(Qt::ISODateWithMs).toLatin1();
+    text += ' ';
+    text += levels[qMin<int>(r.level, Log::Error)];
+    text += " t";
+    text += QByteArray::number(thread);
+    text += ' ';
+    text += r.event;
+    for(int i = 0; i < r.count; ++i) {
+        text += ' ';
+        text += r.keys[i];
+        text += '=';
+        appendValue(text, r.types[i], r.values[i]);
+    }
+    text += '\n';
+}
+
+class LogWriter : public QThread
+{
+public:
+    LogWriter(QFile *out) : m_out(out) {}
+
+    void stop()
+    {
+        m_stopping.store(true, std::memory_order_release);
+        wait();
+    }
+
+protected:
+    void run() override
+    {
+        // wall time for the steady timestamps, taken once
+        m_wallMs = QDateTime::currentMSecsSinceEpoch();
+        m_steadyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        while(!m_stopping.load(std::memory_order_acquire)) {
+            if(0 == drain())
+                msleep(kIdleMs);
+        }
+        // whatever was logged before stop() was called
+        while(0 < drain()) {}
+    }
+
+private:
+    int drain()
+    {
+        QVector<ThreadRing *> rings;
+        {
+            QMutexLocker lock(&registryMutex);
+            for(int i = registry.size() - 1; 0 <= i; --i) {
+                ThreadRing *ring = registry.at(i);
+                if(ring->orphaned.load(std::memory_order_acquire) && 0 == ring->ring.size()) {
+                    droppedByExitedThreads += ring->dropped.load(std::memory_order_relaxed);
+                    registry.remove(i);
+                    delete ring;
+                }
+            }
+            rings = registry;
+        }
+
+        m_records.clear();
+        Log::Record batch[kBatch];
+        for(ThreadRing *ring : rings) {
+            const int count = ring->ring.popBatch(batch, kBatch);
+            for(int i = 0; i < count; ++i)
+                m_records.append(qMakePair(ring->id, batch[i]));
+        }
+        if(m_records.isEmpty())
+            return 0;
+
+        // rings are drained one after another, put threads back in time order
+        std::stable_sort(m_records.begin(), m_records.end(),
+                         [](const QPair<quint32, Log::Record> &a, const QPair<quint32, Log::Record> &b) {
+            return a.second.time < b.second.time;
+        });
+
+        m_text.clear();
+        for(const QPair<quint32, Log::Record> &entry : qAsConst(m_records)) {
+            format(m_text, entry.first, entry.second, m_wallMs, m_steadyNs);
+            release(entry.second);
+        }
+        m_out->write(m_text);
+        m_out->flush();
+        recordsWritten.fetch_add(quint64(m_records.size()), std::memory_order_relaxed);
+        return m_records.size();
+    }
+
+    QFile *m_out;
+    std::atomic<bool> m_stopping {false};
+    qint64 m_wallMs = 0;
+    qint64 m_steadyNs = 0;
+    QVector<QPair<quint32, Log::Record>> m_records;
+    QByteArray m_text;
+};
+
+LogWriter *writer = nullptr;
+QFile *output = nullptr;
+// after stop() there is no writer left to drain the rings, records go straight to stderr
+std::atomic<bool> stopped {false};
+QtMessageHandler previousHandler = nullptr;
+bool capturing = false;
+
+void qtMessage(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    Log::Level level = Log::Debug;
+    switch(type) {
+    case QtDebugMsg: level = Log::Debug; break;
+    case QtInfoMsg: level = Log::Info; break;
+    case QtWarningMsg: level = Log::Warning; break;
+    case QtCriticalMsg:
+    case QtFatalMsg: level = Log::Error; break;
+    }
+    if(QtFatalMsg == type) {
+        // nothing after this returns, get everything out first
+        Log::stop();
+        std::fprintf(stderr, "%s\n", qPrintable(message));
+        std::abort();
+    }
+    if(Log::enabled(level))
+        Log::write(level, "qt", "message", message);
+}
+
+}
+
+void Log::submit(const Record &r)
+{
+    if(nullptr==t_ring.ring) {
+        QMutexLocker lock(&registryMutex);
+        t_ring.ring = new ThreadRing(nextThreadId++);
+        registry << t_ring.ring;
+    }
+    if(stopped.load(std::memory_order_acquire)) {
+        QByteArray line;
+        format(line, t_ring.ring->id, r, QDateTime::currentMSecsSinceEpoch(), r.time);
+        std::fwrite(line.constData(), 1, size_t(line.size()), stderr);
+        release(r);
+        return;
+    }
+    if(!t_ring.ring->ring.tryPush(r)) {
+        // never wait on the writer, a hot path would rather lose the line
+        t_ring.ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        release(r);
+    }
+}
+
+bool Log::start(const QString &path)
+{
+    if(nullptr!=writer)
+        return true;
+    output = path.isEmpty() ? new QFile : new QFile(path);
+    const bool opened = path.isEmpty() ? output->open(stderr, QIODevice::WriteOnly | QIODevice::Unbuffered)
+                                       : output->open(QIODevice::WriteOnly | QIODevice::Append);
+    if(!opened) {
+        delete output;
+        output = nullptr;
+        return false;
+    }
+    writer = new LogWriter(output);
+    writer->start(QThread::LowPriority);
+    stopped.store(false, std::memory_order_release);
+    return true;
+}
+
+void Log::stop()
+{
+    // Qt's own handler again, nothing would write what qtMessage queues
+    if(capturing) {
+        qInstallMessageHandler(previousHandler);
+        capturing = false;
+    }
+    if(nullptr==writer)
+        return;
+    stopped.store(true, std::memory_order_release);
+    writer->stop();
+    delete writer;
+    writer = nullptr;
+    delete output;
+    output = nullptr;
+}
+
+bool Log::isRunning()
+{
+    return nullptr!=writer;
+}
+
+bool Log::levelFromName(const QString &name, Level *level)
+{
+    static const char *names[] = {"trace", "debug", "info", "warning", "error"};
+    for(int i = 0; i <= Error; ++i) {
+        if(0 == name.compare(QLatin1String(names[i]), Qt::CaseInsensitive)) {
+            *level = Level(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Log::captureQtMessages()
+{
+    if(capturing)
+        return;
+    previousHandler = qInstallMessageHandler(qtMessage);
+    capturing = true;
+}
+
+quint64 Log::written()
+{
+    return recordsWritten.load(std::memory_order_relaxed);
+}
+
+quint64 Log::dropped()
+{
+    QMutexLocker lock(&registryMutex);
+    quint64 total = droppedByExitedThreads;
+    for(ThreadRing *ring : qAsConst(registry))
+        total += ring->dropped.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,136 @@
+#ifndef STRUCTLOG_H
+#define STRUCTLOG_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * Structured logging for the hot paths. A record is an event name plus up to
+ * kMaxFields key/value pairs, copied in binary form into a ring owned by the
+ * calling thread; nothing is formatted there. A background thread started by
+ * Log::start() drains every ring, formats and writes the lines.
+ *
+ *     LOG_DEBUG("measurement", "address", Log::mac(a), "value", m.value);
+ *
+ * Events, keys and const char * values must be string literals or otherwise
+ * static, only the pointer is kept. QString values are copied to the heap,
+ * keep them to the rare paths.
+ *
+ * Levels below PINE_LOG_LEVEL compile to nothing, arguments included; the
+ * runtime level set with Log::setLevel() can only raise that floor.
+ */
+
+#ifndef PINE_LOG_LEVEL
+#  ifdef QT_NO_DEBUG
+#    define PINE_LOG_LEVEL 2    // Info
+#  else
+#    define PINE_LOG_LEVEL 1    // Debug
+#  endif
+#endif
+
+#define PINE_LOG(level, ...) \
+    do { if((level) >= PINE_LOG_LEVEL && Log::enabled(level)) Log::write(level, __VA_ARGS__); } while(0)
+
+#define LOG_TRACE(...)   PINE_LOG(Log::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...)   PINE_LOG(Log::Debug, __VA_ARGS__)
+#define LOG_INFO(...)    PINE_LOG(Log::Info, __VA_ARGS__)
+#define LOG_WARNING(...) PINE_LOG(Log::Warning, __VA_ARGS__)
+#define LOG_ERROR(...)   PINE_LOG(Log::Error, __VA_ARGS__)
+
+class Log
+{
+public:
+    enum Level { Trace, Debug, Info, Warning, Error };
+
+    static const int kMaxFields = 6;
+
+    // a Bluetooth address kept as its 48 bit value until formatted
+    struct Address { quint64 value; };
+    static Address mac(quint64 address) { Address a; a.value = address; return a; }
+
+    enum Type : quint8 { Int, UInt, Double, Bool, Literal, Text, Mac };
+
+    union Value {
+        qint64 i;
+        quint64 u;
+        double d;
+        const char *s;
+        QString *text;      // owned by the record, freed by the writer
+    };
+
+    struct Record {
+        qint64 time;        // steady clock, ns
+        const char *event;
+        quint8 level;
+        quint8 count;
+        quint8 types[kMaxFields];
+        const char *keys[kMaxFields];
+        Value values[kMaxFields];
+    };
+
+    // starts the writer thread, appending to path or to stderr when empty
+    static bool start(const QString &path = QString());
+    // drains every ring and joins the writer; later records go straight to stderr
+    // and Qt messages back to the handler captureQtMessages() replaced
+    static void stop();
+    static bool isRunning();
+
+    static void setLevel(Level level) { s_level.store(level, std::memory_order_relaxed); }
+    static Level level() { return Level(s_level.load(std::memory_order_relaxed)); }
+    static bool enabled(Level level) { return level >= s_level.load(std::memory_order_relaxed); }
+    // trace, debug, info, warning or error
+    static bool levelFromName(const QString &name, Level *level);
+
+    // sends qDebug() and friends through the writer so output stays in one stream
+    static void captureQtMessages();
+
+    static quint64 written();
+    static quint64 dropped();   // records lost to full rings
+
+    template <typename... Fields>
+    static void write(Level level, const char *event, const Fields &... fields)
+    {
+        Record r;
+        r.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        r.event = event;
+        r.level = quint8(level);
+        r.count = 0;
+        fill(r, fields...);
+        submit(r);
+    }
+
+private:
+    static void submit(const Record &r);
+
+    static void fill(Record &) {}
+    template <typename V, typename... Rest>
+    static void fill(Record &r, const char *key, const V &value, const Rest &... rest)
+    {
+        if(r.count < kMaxFields) {
+            r.keys[r.count] = key;
+            r.types[r.count] = set(r.values[r.count], value);
+            ++r.count;
+        }
+        fill(r, rest...);
+    }
+
+    static quint8 set(Value &v, int x) { v.i = x; return Int; }
+    static quint8 set(Value &v, long x) { v.i = x; return Int; }
+    static quint8 set(Value &v, long long x) { v.i = x; return Int; }
+    static quint8 set(Value &v, unsigned x) { v.u = x; return UInt; }
+    static quint8 set(Value &v, unsigned long x) { v.u = x; return UInt; }
+    static quint8 set(Value &v, unsigned long long x) { v.u = x; return UInt; }
+    static quint8 set(Value &v, double x) { v.d = x; return Double; }
+    static quint8 set(Value &v, bool x) { v.u = x ? 1 : 0; return Bool; }
+    static quint8 set(Value &v, const char *x) { v.s = x; return Literal; }
+    static quint8 set(Value &v, Address x) { v.u = x.value; return Mac; }
+    static quint8 set(Value &v, const QString &x) { v.text = new QString(x); return Text; }
+
+    static std::atomic<int> s_level;
+};
+
+#endif // STRUCTLOG_H
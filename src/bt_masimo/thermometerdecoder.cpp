@@ -0,0 +1,101 @@
+#include "thermometerdecoder.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// powers of ten for the exponents thermometers actually use
+const double kPow10[] = {
+    1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1,
+    1e0,
+    1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8
+};
+
+inline double pow10(int exponent)
+{
+    if(exponent >= -8 && exponent <= 8)
+        return kPow10[exponent + 8];
+    return std::pow(10.0, exponent);
+}
+
+inline quint16 readU16(const uchar *p)
+{
+    return quint16(p[0] | (p[1] << 8));
+}
+
+}
+
+quint8 ThermometerDecoder::decodeFloat(const uchar *p, qint32 *mantissa, qint8 *exponent, double *value)
+{
+    quint32 raw = quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16);
+    *exponent = qint8(p[3]);
+    *value = 0.0;
+
+    // special values are only defined with a zero exponent
+    if(0 == *exponent) {
+        switch(raw) {
+        case 0x007FFFFF: *mantissa = qint32(raw); return TemperatureMeasurement::NaN;
+        case 0x00800000: *mantissa = qint32(raw); return TemperatureMeasurement::NRes;
+        case 0x007FFFFE: *mantissa = qint32(raw); return TemperatureMeasurement::PositiveInfinity;
+        case 0x00800002: *mantissa = qint32(raw); return TemperatureMeasurement::NegativeInfinity;
+        case 0x00800001: *mantissa = qint32(raw); return TemperatureMeasurement::Reserved;
+        default: break;
+        }
+    }
+
+    // sign extend the 24 bit mantissa
+    *mantissa = (raw & 0x00800000) ? qint32(raw | 0xFF000000) : qint32(raw);
+    *value = *mantissa * pow10(*exponent);
+    return TemperatureMeasurement::Valid;
+}
+
+bool ThermometerDecoder::decode(const char *data, int size, TemperatureMeasurement *m)
+{
+    std::memset(m, 0, sizeof(TemperatureMeasurement));
+    if(nullptr == data || size < 5)
+        return false;
+
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+
+    m->flags = *p++;
+    m->status = decodeFloat(p, &m->mantissa, &m->exponent, &m->value);
+    p += 4;
+
+    if(m->hasTimestamp()) {
+        if(end - p < 7)
+            return false;
+        m->year = readU16(p);
+        m->month = p[2];
+        m->day = p[3];
+        m->hours = p[4];
+        m->minutes = p[5];
+        m->seconds = p[6];
+        p += 7;
+    }
+
+    if(m->hasType()) {
+        if(end - p < 1)
+            return false;
+        m->type = *p;
+    }
+
+    return true;
+}
+
+const char *ThermometerDecoder::typeName(quint8 type)
+{
+    switch(type) {
+    case 1: return "armpit";
+    case 2: return "body";
+    case 3: return "ear";
+    case 4: return "finger";
+    case 5: return "gastro-intestinal tract";
+    case 6: return "mouth";
+    case 7: return "rectum";
+    case 8: return "toe";
+    case 9: return "tympanum";
+    default: return "unknown";
+    }
+}
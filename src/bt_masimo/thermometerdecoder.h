@@ -0,0 +1,70 @@
+#ifndef THERMOMETERDECODER_H
+#define THERMOMETERDECODER_H
+
+#include <QtGlobal>
+
+/**
+ * Health Thermometer Temperature Measurement (characteristic 0x2A1C)
+ * decoded into plain data: no heap members, safe to copy by value or memcpy.
+ *
+ * Layout on the wire (little endian):
+ *   flags      uint8
+ *   value      IEEE 11073-20601 32-bit FLOAT (sint24 mantissa, sint8 exponent)
+ *   timestamp  optional, flags bit 1: year uint16, month, day, h, m, s uint8
+ *   type       optional, flags bit 2: uint8
+ */
+struct TemperatureMeasurement
+{
+    enum Flag : quint8 {
+        Fahrenheit   = 0x01,
+        HasTimestamp = 0x02,
+        HasType      = 0x04
+    };
+
+    // IEEE 11073 special values, reported in status instead of value
+    enum Status : quint8 {
+        Valid = 0,
+        NaN,
+        NRes,
+        PositiveInfinity,
+        NegativeInfinity,
+        Reserved
+    };
+
+    quint8 flags;
+    quint8 status;
+    qint8  exponent;
+    quint8 type;       // 0 when the type field is absent
+    qint32 mantissa;
+    double value;      // mantissa * 10^exponent, 0 unless status is Valid
+
+    quint16 year;      // timestamp fields are 0 when absent
+    quint8  month;
+    quint8  day;
+    quint8  hours;
+    quint8  minutes;
+    quint8  seconds;
+
+    // host clock estimate of when the reading was taken, ms since the epoch;
+    // 0 when unknown. Filled in by ingestion from the timestamp, not by decode()
+    qint64  measuredMs;
+
+    bool isFahrenheit() const { return flags & Fahrenheit; }
+    bool hasTimestamp() const { return flags & HasTimestamp; }
+    bool hasType() const { return flags & HasType; }
+    bool isValid() const { return Valid == status; }
+};
+
+class ThermometerDecoder
+{
+public:
+    // returns false when the buffer is shorter than the fields its flags declare
+    static bool decode(const char *data, int size, TemperatureMeasurement *m);
+
+    // IEEE 11073-20601 32-bit FLOAT from its raw little endian 4 bytes
+    static quint8 decodeFloat(const uchar *p, qint32 *mantissa, qint8 *exponent, double *value);
+
+    static const char *typeName(quint8 type);
+};
+
+#endif // THERMOMETERDECODER_H
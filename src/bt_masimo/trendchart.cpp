@@ -0,0 +1,106 @@
+#include "trendchart.h"
+
+#include <QBluetoothAddress>
+#include <QPaintEvent>
+#include <QPainter>
+
+#include <cmath>
+
+TrendChart::TrendChart(int points, QWidget *parent)
+    : QWidget(parent)
+    , m_points(qMax(2, points))
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setInterval(16);
+    connect(&m_frameTimer, &QTimer::timeout, this, [this]() { update(); });
+}
+
+QSize TrendChart::sizeHint() const
+{
+    return QSize(m_points, qMax(1, m_order.size()) * kStripHeight);
+}
+
+void TrendChart::addPoint(quint64 address, const QString &label, double value)
+{
+    if(!std::isfinite(value))
+        return;
+
+    auto it = m_trends.find(address);
+    if(it == m_trends.end()) {
+        it = m_trends.insert(address, Trend());
+        it->values.resize(m_points);
+        m_order << address;
+        setMinimumHeight(m_order.size() * kStripHeight);
+    }
+    Trend &trend = it.value();
+    trend.label = label;
+    trend.values[trend.head] = float(value);
+    trend.head = (trend.head + 1) % m_points;
+    trend.count = qMin(trend.count + 1, m_points);
+    trend.last = float(value);
+    scheduleRepaint();
+}
+
+void TrendChart::removeDevice(quint64 address)
+{
+    if(0 == m_trends.remove(address))
+        return;
+    m_order.removeOne(address);
+    setMinimumHeight(qMax(1, m_order.size()) * kStripHeight);
+    scheduleRepaint();
+}
+
+void TrendChart::scheduleRepaint()
+{
+    if(!m_frameTimer.isActive())
+        m_frameTimer.start();
+}
+
+void TrendChart::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(event->rect(), palette().base());
+
+    const int first = qMax(0, event->rect().top() / kStripHeight);
+    const int last = qMin(m_order.size() - 1, event->rect().bottom() / kStripHeight);
+    const QColor line = palette().color(QPalette::Highlight);
+    const QColor text = palette().color(QPalette::Text);
+    QVector<QPointF> polyline;
+    polyline.reserve(m_points);
+
+    for(int strip = first; strip <= last; ++strip) {
+        const Trend &trend = m_trends[m_order[strip]];
+        const QRectF area(0, strip * kStripHeight + 2, width(), kStripHeight - 4);
+
+        // scale each strip to its own range, with a little headroom for a flat line
+        float low = trend.last;
+        float high = trend.last;
+        const int start = (trend.head - trend.count + m_points) % m_points;
+        for(int i = 0; i < trend.count; ++i) {
+            const float v = trend.values[(start + i) % m_points];
+            low = qMin(low, v);
+            high = qMax(high, v);
+        }
+        const float span = qMax(high - low, 1.0f);
+        const qreal step = area.width() / (m_points - 1);
+
+        polyline.resize(0);
+        for(int i = 0; i < trend.count; ++i) {
+            const float v = trend.values[(start + i) % m_points];
+            // newest point at the right edge
+            const qreal x = area.right() - (trend.count - 1 - i) * step;
+            polyline << QPointF(x, area.bottom() - (v - low) / span * area.height());
+        }
+
+        painter.setPen(palette().color(QPalette::Mid));
+        painter.drawLine(area.bottomLeft(), area.bottomRight());
+        painter.setPen(line);
+        painter.drawPolyline(polyline.constData(), polyline.size());
+        painter.setPen(text);
+        painter.drawText(area.adjusted(4, 0, -4, 0), Qt::AlignLeft | Qt::AlignTop,
+                         QString("%1 %2").arg(QBluetoothAddress(m_order[strip]).toString(), trend.label));
+        painter.drawText(area.adjusted(4, 0, -4, 0), Qt::AlignRight | Qt::AlignTop,
+                         QString::number(trend.last));
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef TRENDCHART_H
+#define TRENDCHART_H
+
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+
+/**
+ * One sparkline strip per device with its last few hundred values. Points go
+ * into a fixed ring per device and the widget repaints at most once a frame,
+ * however fast they arrive; a repaint draws only the strips in view.
+ */
+class TrendChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrendChart(int points = 300, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+public slots:
+    void addPoint(quint64 address, const QString &label, double value);
+    void removeDevice(quint64 address);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    static const int kStripHeight = 48;
+
+    struct Trend {
+        QString label;
+        QVector<float> values;          // ring of points
+        int head = 0;                   // next write
+        int count = 0;
+        float last = 0.0f;
+    };
+
+    void scheduleRepaint();
+
+    int m_points;
+    QHash<quint64, Trend> m_trends;
+    QVector<quint64> m_order;           // strips top to bottom, in order of first reading
+    QTimer m_frameTimer;
+};
+
+#endif // TRENDCHART_H
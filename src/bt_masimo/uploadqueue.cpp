@@ -0,0 +1,201 @@
+#include "uploadqueue.h"
+#include "latencyrecorder.h"
+#include "structlog.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+
+UploadQueue::UploadQueue(QObject *parent)
+    : QObject(parent)
+    , m_network(this)       // children, so moveToThread takes them along
+    , m_retryTimer(this)
+{
+    m_retryTimer.setSingleShot(true);
+    connect(&m_retryTimer, &QTimer::timeout, this, &UploadQueue::sendPending);
+}
+
+QString UploadQueue::batchPath(const Batch &batch) const
+{
+    // sequence first and zero padded so the directory lists in send order
+    return m_queueDir.filePath(QString("%1-%2.batch").arg(batch.sequence, 16, 10, QLatin1Char('0')).arg(batch.readings));
+}
+
+bool UploadQueue::open(const QUrl &endpoint, const QString &queueDir)
+{
+    if(!endpoint.isValid() || !QDir().mkpath(queueDir)) {
+        LOG_ERROR("upload.open_failed", "endpoint", endpoint.toString(), "queue", queueDir);
+        return false;
+    }
+    m_endpoint = endpoint;
+    m_queueDir = QDir(queueDir);
+
+    const QStringList files = m_queueDir.entryList(QStringList() << "*.batch", QDir::Files, QDir::Name);
+    for(const QString &name : files) {
+        const QString stem = QFileInfo(name).completeBaseName();
+        bool sequenceOk = false, readingsOk = false;
+        Batch batch;
+        batch.sequence = stem.section('-', 0, 0).toULongLong(&sequenceOk);
+        batch.readings = stem.section('-', 1, 1).toInt(&readingsOk);
+        if(!sequenceOk || !readingsOk)
+            continue;
+        batch.bytes = QFileInfo(m_queueDir.filePath(name)).size();
+        m_pending.enqueue(batch);
+        m_pendingBatches.fetch_add(1, std::memory_order_relaxed);
+        m_pendingBytes.fetch_add(batch.bytes, std::memory_order_relaxed);
+        m_nextSequence.store(qMax(m_nextSequence.load(std::memory_order_relaxed), batch.sequence + 1),
+                             std::memory_order_relaxed);
+    }
+    if(!m_pending.isEmpty())
+        LOG_INFO("upload.resume", "batches", m_pending.size(), "bytes", pendingBytes());
+
+    updateBackpressure();
+    sendPending();
+    return true;
+}
+
+quint64 UploadQueue::reserve(qint64 firstEnqueuedAt)
+{
+    const quint64 sequence = m_nextSequence.fetch_add(1, std::memory_order_relaxed);
+    m_pendingBatches.fetch_add(1, std::memory_order_relaxed);
+    QMutexLocker locker(&m_unackedLock);
+    m_unacked.insert(sequence, firstEnqueuedAt);
+    return sequence;
+}
+
+qint64 UploadQueue::oldestUnacked() const
+{
+    // batches go out in sequence order, the lowest is the oldest
+    QMutexLocker locker(&m_unackedLock);
+    return m_unacked.isEmpty() ? 0 : m_unacked.first();
+}
+
+void UploadQueue::write(quint64 sequence, const QJsonArray &readings, const QVector<qint64> &enqueuedAt)
+{
+    QJsonObject payload;
+    payload["instrument"] = QCoreApplication::applicationName();
+    payload["readings"] = readings;
+    // qCompress prefixes the zlib stream with its length, the stream alone is HTTP deflate
+    const QByteArray body = qCompress(QJsonDocument(payload).toJson(QJsonDocument::Compact)).mid(4);
+
+    Batch batch;
+    batch.sequence = sequence;
+    batch.readings = readings.size();
+    batch.enqueuedAt = enqueuedAt;
+
+    // on disk before it is sent, removed only once Pine has it
+    QSaveFile file(batchPath(batch));
+    if(!file.open(QIODevice::WriteOnly) || body.size() != file.write(body) || !file.commit()) {
+        LOG_ERROR("upload.queue_failed", "batch", batch.sequence, "readings", batch.readings,
+                  "error", file.errorString());
+        m_refused.fetch_add(quint64(batch.readings), std::memory_order_relaxed);
+        retire(batch);
+        return;
+    }
+
+    batch.bytes = body.size();
+    m_pendingBytes.fetch_add(batch.bytes, std::memory_order_relaxed);
+    requeue(batch);
+    updateBackpressure();
+    sendPending();
+}
+
+void UploadQueue::requeue(const Batch &batch)
+{
+    // in sequence order: with several in flight, a later batch may have failed first
+    auto at = m_pending.begin();
+    while(m_pending.end() != at && at->sequence < batch.sequence)
+        ++at;
+    m_pending.insert(at, batch);
+}
+
+void UploadQueue::retire(const Batch &batch)
+{
+    m_pendingBatches.fetch_sub(1, std::memory_order_relaxed);
+    m_pendingBytes.fetch_sub(batch.bytes, std::memory_order_relaxed);
+    QMutexLocker locker(&m_unackedLock);
+    m_unacked.remove(batch.sequence);
+}
+
+void UploadQueue::sendPending()
+{
+    // waiting out a failure, the retry timer calls back
+    if(m_retryTimer.isActive())
+        return;
+
+    while(m_inFlight < m_maxInFlight && !m_pending.isEmpty()) {
+        Batch batch = m_pending.dequeue();
+        QFile file(batchPath(batch));
+        if(!file.open(QIODevice::ReadOnly)) {
+            LOG_WARNING("upload.batch_missing", "batch", batch.sequence, "error", file.errorString());
+            retire(batch);
+            continue;
+        }
+
+        QNetworkRequest request(m_endpoint);
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        request.setRawHeader("Content-Encoding", "deflate");
+        // lets the server drop a batch it already has when an acknowledgement was lost
+        request.setRawHeader("X-Batch-Id", QByteArray::number(batch.sequence));
+
+        ++batch.attempts;
+        ++m_inFlight;
+        QNetworkReply *reply = m_network.post(request, file.readAll());
+        connect(reply, &QNetworkReply::finished, this, [this, reply, batch]() { finished(reply, batch); });
+    }
+}
+
+void UploadQueue::finished(QNetworkReply *reply, const Batch &batch)
+{
+    --m_inFlight;
+    reply->deleteLater();
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const bool delivered = QNetworkReply::NoError == reply->error() && 200 <= status && status < 300;
+    // the server will never take this batch, retrying would only hold up the queue
+    const bool rejected = 400 <= status && status < 500 && 408 != status && 429 != status;
+
+    if(delivered || rejected) {
+        if(rejected) {
+            LOG_WARNING("upload.rejected", "batch", batch.sequence, "status", status);
+            QFile::rename(batchPath(batch), batchPath(batch) + ".rejected");
+        } else {
+            QFile::remove(batchPath(batch));
+            m_delivered.fetch_add(quint64(batch.readings), std::memory_order_relaxed);
+            const qint64 now = LatencyRecorder::now();
+            for(qint64 at : batch.enqueuedAt)
+                m_deliveryLatency.recordNanoseconds(now - at);
+            emit batchDelivered(batch.readings);
+        }
+        retire(batch);
+        m_retryDelayMs = 0;
+        updateBackpressure();
+        sendPending();
+        return;
+    }
+
+    m_failures.fetch_add(1, std::memory_order_relaxed);
+    LOG_WARNING("upload.failed", "batch", batch.sequence, "attempt", batch.attempts, "status", status,
+                "error", reply->errorString());
+    requeue(batch);
+    m_retryDelayMs = 0 == m_retryDelayMs ? 1000 : qMin(m_retryDelayMs * 2, 60000);
+    m_retryTimer.start(m_retryDelayMs);
+}
+
+void UploadQueue::updateBackpressure()
+{
+    // engage over the budget, release with some headroom so it does not flap
+    const bool backpressure = isBackpressured();
+    const qint64 bytes = pendingBytes();
+    const bool engaged = backpressure ? bytes > m_queueLimit * 9 / 10 : bytes > m_queueLimit;
+    if(engaged == backpressure)
+        return;
+    m_backpressure.store(engaged, std::memory_order_relaxed);
+    LOG_WARNING("upload.backpressure", "engaged", engaged, "bytes", bytes, "limit", m_queueLimit);
+    emit backpressureChanged(engaged);
+}
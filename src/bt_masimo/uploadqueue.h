@@ -0,0 +1,102 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <QDir>
+#include <QJsonArray>
+#include <QMap>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+
+#include <atomic>
+
+#include "latencyhistogram.h"
+
+QT_FORWARD_DECLARE_CLASS(QNetworkReply)
+
+/**
+ * PineUploader's worker, living on the uploader's own thread. Closed batches
+ * are serialised, deflate-compressed and committed to the queue directory
+ * before anything is sent, then POSTed with a bounded number in flight;
+ * failures back off and retry in sequence order, and a 2xx removes the file.
+ * Sequences are reserved on the event loop when a batch is handed over, so
+ * a batch counts as pending from then on. The counters and the backpressure
+ * flag can be read from any thread.
+ */
+class UploadQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UploadQueue(QObject *parent = nullptr);
+
+    // the rest on the queue's thread; picks up batches left by an earlier run
+    bool open(const QUrl &endpoint, const QString &queueDir);
+    void setMaxInFlight(int requests) { m_maxInFlight = qMax(1, requests); }
+    void setQueueLimit(qint64 bytes) { m_queueLimit = bytes; updateBackpressure(); }
+    // writes and sends a batch reserved by reserve()
+    void write(quint64 sequence, const QJsonArray &readings, const QVector<qint64> &enqueuedAt);
+
+    // any thread, in the order the batches will be written
+    quint64 reserve(qint64 firstEnqueuedAt);
+
+    // any thread
+    bool isBackpressured() const { return m_backpressure.load(std::memory_order_relaxed); }
+    int pendingBatches() const { return m_pendingBatches.load(std::memory_order_relaxed); }
+    qint64 pendingBytes() const { return m_pendingBytes.load(std::memory_order_relaxed); }
+    quint64 delivered() const { return m_delivered.load(std::memory_order_relaxed); }
+    quint64 refused() const { return m_refused.load(std::memory_order_relaxed); }
+    quint64 failures() const { return m_failures.load(std::memory_order_relaxed); }
+    const LatencyHistogram &deliveryLatency() const { return m_deliveryLatency; }
+    // LatencyRecorder::now() of the oldest reading of this run Pine has not acknowledged, 0 for none
+    qint64 oldestUnacked() const;
+
+signals:
+    void backpressureChanged(bool engaged);
+    void batchDelivered(int readings);
+
+private:
+    struct Batch {
+        quint64 sequence = 0;
+        int readings = 0;
+        qint64 bytes = 0;
+        int attempts = 0;
+        QVector<qint64> enqueuedAt;     // LatencyRecorder::now(), empty for batches from disk
+    };
+
+    QString batchPath(const Batch &batch) const;
+    void requeue(const Batch &batch);
+    // a batch that will not be sent again
+    void retire(const Batch &batch);
+    void sendPending();
+    void finished(QNetworkReply *reply, const Batch &batch);
+    void updateBackpressure();
+
+    QNetworkAccessManager m_network;
+    QUrl m_endpoint;
+    QDir m_queueDir;
+
+    QQueue<Batch> m_pending;
+    QTimer m_retryTimer;
+    int m_retryDelayMs = 0;
+    int m_inFlight = 0;
+    int m_maxInFlight = 2;
+    qint64 m_queueLimit = 256LL * 1024 * 1024;
+
+    mutable QMutex m_unackedLock;
+    QMap<quint64, qint64> m_unacked;    // sequence to first enqueuedAt, batches of this run not yet acknowledged
+    std::atomic<quint64> m_nextSequence {1};
+    std::atomic<int> m_pendingBatches {0};
+    std::atomic<qint64> m_pendingBytes {0};
+    std::atomic<bool> m_backpressure {false};
+    std::atomic<quint64> m_delivered {0};
+    std::atomic<quint64> m_refused {0};
+    std::atomic<quint64> m_failures {0};
+    LatencyHistogram m_deliveryLatency;
+};
+
+#endif // UPLOADQUEUE_H
@@ -0,0 +1,7 @@
+# qmake pine_plus.pro && make && make check
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    bt_masimo \
+    bench \
+    tests
@@ -0,0 +1,182 @@
+// AdapterPool over simulated adapters that each take a limited number of
+// links, driven through SessionManager the way the application uses it: the
+// station's device count scales with its radios, links spread evenly, and a
+// radio that powers off has its links carried by the others.
+
+#include "adapterpool.h"
+#include "sessionmanager.h"
+#include "simtransport.h"
+#include "structlog.h"
+
+#include <QElapsedTimer>
+#include <QtTest>
+
+namespace {
+
+const int kLinksPerAdapter = 7;
+
+AdapterPool *simulatedPool(int adapters, int peripherals, QObject *parent)
+{
+    AdapterPool *pool = new AdapterPool([peripherals](QObject *p) -> BLETransport * {
+        SimTransport *transport = new SimTransport(p);
+        for(int i = 0; i < peripherals; ++i) {
+            SimPeripheral peripheral = SimTransport::thermometer(i);
+            peripheral.connectLatencyMs = 5;
+            peripheral.discoveryLatencyMs = 5;
+            peripheral.subscribeLatencyMs = 5;
+            peripheral.rateHz = 10.0;
+            transport->addPeripheral(peripheral);
+        }
+        transport->setMaxLinks(kLinksPerAdapter);
+        return transport;
+    }, parent);
+
+    QList<QBluetoothAddress> addresses;
+    for(int i = 0; i < adapters; ++i)
+        addresses << QBluetoothAddress(Q_UINT64_C(0x00005E000001) + quint64(i));
+    pool->setAdapters(addresses);
+    pool->setLinksPerAdapter(kLinksPerAdapter);
+    return pool;
+}
+
+int subscribed(const SessionManager &manager)
+{
+    int count = 0;
+    for(const BLESession *session : manager.sessions())
+        count += BLESession::Subscribed == session->state();
+    return count;
+}
+
+void connectPeripherals(SessionManager *manager, int peripherals)
+{
+    // refused links retry quickly so the test does not wait on the default backoff
+    QObject::connect(manager, &SessionManager::sessionAdded, [](BLESession *session) {
+        session->setReconnectBackoff(10, 100);
+    });
+    manager->setMaxPendingConnects(8);
+    for(int i = 0; i < peripherals; ++i)
+        manager->addSession(SimTransport::thermometer(i).info);
+    manager->connectAll();
+}
+
+}
+
+class TestAdapterPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void scaling_data();
+    void scaling();
+    void powerOffMovesLinks();
+    void scanGoesToLeastLoaded();
+};
+
+void TestAdapterPool::initTestCase()
+{
+    // quietens the library's log alone, the scaling timings and QtTest's own output still come through
+    Log::setLevel(Log::Error);
+}
+
+void TestAdapterPool::scaling_data()
+{
+    QTest::addColumn<int>("adapters");
+    QTest::addColumn<int>("peripherals");
+    QTest::addColumn<int>("expected");
+
+    // one radio caps the station at its link limit, more radios lift the cap
+    QTest::newRow("1 adapter, 14 devices") << 1 << 14 << kLinksPerAdapter;
+    QTest::newRow("2 adapters, 14 devices") << 2 << 14 << 14;
+    QTest::newRow("4 adapters, 28 devices") << 4 << 28 << 28;
+    QTest::newRow("8 adapters, 56 devices") << 8 << 56 << 56;
+}
+
+void TestAdapterPool::scaling()
+{
+    QFETCH(int, adapters);
+    QFETCH(int, peripherals);
+    QFETCH(int, expected);
+
+    QObject owner;
+    AdapterPool *pool = simulatedPool(adapters, peripherals, &owner);
+    QVERIFY(pool->open(QBluetoothAddress()));
+    QCOMPARE(pool->adapterCount(), adapters);
+
+    SessionManager manager(pool);
+    QElapsedTimer timer;
+    timer.start();
+    connectPeripherals(&manager, peripherals);
+    QTRY_COMPARE_WITH_TIMEOUT(subscribed(manager), expected, 10000);
+    qInfo("%d adapters: %d of %d devices subscribed in %lld ms",
+          adapters, expected, peripherals, timer.elapsed());
+
+    // least loaded first keeps every radio within one link of the others
+    int low = peripherals;
+    int high = 0;
+    for(int i = 0; i < adapters; ++i) {
+        low = qMin(low, pool->load(i));
+        high = qMax(high, pool->load(i));
+        QVERIFY(static_cast<SimTransport *>(pool->adapter(i))->connectedLinks() <= kLinksPerAdapter);
+    }
+    QVERIFY2(high - low <= 1, qPrintable(QString("loads %1..%2").arg(low).arg(high)));
+
+    // nothing beyond the capacity comes up however long it retries
+    QTest::qWait(200);
+    QCOMPARE(subscribed(manager), expected);
+}
+
+void TestAdapterPool::powerOffMovesLinks()
+{
+    const int adapters = 3;
+    const int peripherals = 12;
+
+    QObject owner;
+    AdapterPool *pool = simulatedPool(adapters, peripherals, &owner);
+    QVERIFY(pool->open(QBluetoothAddress()));
+    SessionManager manager(pool);
+    connectPeripherals(&manager, peripherals);
+    QTRY_COMPARE_WITH_TIMEOUT(subscribed(manager), peripherals, 10000);
+    QCOMPARE(pool->load(0), 4);
+
+    SimTransport *lost = static_cast<SimTransport *>(pool->adapter(0));
+    lost->setPowered(false);
+    QCOMPARE(lost->connectedLinks(), 0);
+
+    // the other two take six each, within their limit
+    QTRY_COMPARE_WITH_TIMEOUT(subscribed(manager), peripherals, 10000);
+    QCOMPARE(pool->load(0), 0);
+    QCOMPARE(pool->load(1), 6);
+    QCOMPARE(pool->load(2), 6);
+    QCOMPARE(pool->moves(), quint64(4));
+    QVERIFY(pool->isPowered());
+
+    // a radio coming back takes new links but does not pull live ones over
+    lost->setPowered(true);
+    QTest::qWait(100);
+    QCOMPARE(pool->load(0), 0);
+    QCOMPARE(subscribed(manager), peripherals);
+}
+
+void TestAdapterPool::scanGoesToLeastLoaded()
+{
+    QObject owner;
+    AdapterPool *pool = simulatedPool(2, 3, &owner);
+    QVERIFY(pool->open(QBluetoothAddress()));
+    SessionManager manager(pool);
+    connectPeripherals(&manager, 3);
+    QTRY_COMPARE_WITH_TIMEOUT(subscribed(manager), 3, 10000);
+    const int busy = pool->load(0) > pool->load(1) ? 0 : 1;
+
+    pool->startScan();
+    QVERIFY(pool->isScanning());
+    QVERIFY(pool->adapter(1 - busy)->isScanning());
+    QVERIFY(!pool->adapter(busy)->isScanning());
+    pool->stopScan();
+    QVERIFY(!pool->isScanning());
+}
+
+QTEST_GUILESS_MAIN(TestAdapterPool)
+
+#include "tst_adapterpool.moc"
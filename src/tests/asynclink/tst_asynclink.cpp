@@ -0,0 +1,212 @@
+// AsyncLink over simulated links: the whole subscribe walk as one chain of
+// operations, independent operations in flight together, and every way an
+// operation can end other than success.
+
+#include "asynclink.h"
+#include "simtransport.h"
+#include "../testsupport.h"
+
+#include <QtTest>
+
+namespace {
+
+const QBluetoothUuid kService(QBluetoothUuid::HealthThermometer);
+const QBluetoothUuid kMeasurement(QBluetoothUuid::TemperatureMeasurement);
+const QBluetoothUuid kType(QBluetoothUuid::TemperatureType);
+const QBluetoothUuid kInterval(QBluetoothUuid::MeasurementInterval);
+
+SimPeripheral slowThermometer()
+{
+    SimPeripheral peripheral = SimTransport::thermometer(0);
+    peripheral.connectLatencyMs = 10;
+    peripheral.discoveryLatencyMs = 10;
+    peripheral.serviceWalkMs = 200;
+    peripheral.subscribeLatencyMs = 30;
+    peripheral.valueReadLatencyMs = 30;
+    peripheral.rateHz = 0.0;
+    return peripheral;
+}
+
+}
+
+class TestAsyncLink : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void subscribeChain();
+    void concurrentOperations();
+    void timeout();
+    void cancel();
+    void disconnectFailsPending();
+    void groupFailsFast();
+};
+
+void TestAsyncLink::initTestCase()
+{
+    qInstallMessageHandler(dropMessages);
+}
+
+void TestAsyncLink::subscribeChain()
+{
+    SimTransport transport;
+    transport.addPeripheral(slowThermometer());
+    BLELink *link = transport.createLink(SimTransport::thermometer(0).info, &transport);
+    AsyncLink async(link);
+
+    bool subscribed = false;
+    qint64 discoveredNs = 0;
+    async.connectToDevice()->then([&](GattOperation *op) {
+        QVERIFY(op->succeeded());
+        async.discover(kService)->then([&](GattOperation *op) {
+            QVERIFY(op->succeeded());
+            discoveredNs = op->elapsedNs();
+            async.open(kService, BLELink::SkipValues)->then([&](GattOperation *op) {
+                QVERIFY(op->succeeded());
+                async.subscribe(kService, kMeasurement)->then([&](GattOperation *op) {
+                    subscribed = op->succeeded();
+                });
+            });
+        });
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(subscribed, 2000);
+    QCOMPARE(async.pending(), 0);
+    // the service was taken as soon as it turned up, not after the rest of the walk
+    QVERIFY2(discoveredNs < 150 * 1000000LL, qPrintable(QString::number(discoveredNs)));
+}
+
+void TestAsyncLink::concurrentOperations()
+{
+    SimTransport transport;
+    transport.addPeripheral(slowThermometer());
+    BLELink *link = transport.createLink(SimTransport::thermometer(0).info, &transport);
+    AsyncLink async(link);
+
+    bool opened = false;
+    async.connectToDevice()->then([&](GattOperation *) {
+        async.discover(kService)->then([&](GattOperation *) {
+            async.open(kService, BLELink::SkipValues)->then([&](GattOperation *op) { opened = op->succeeded(); });
+        });
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(opened, 2000);
+
+    // three round trips of 30 ms each, together they take one
+    QByteArray type;
+    QByteArray interval;
+    GattOperation *readType = async.read(kService, kType)->then([&](GattOperation *op) { type = op->value(); });
+    GattOperation *readInterval = async.read(kService, kInterval)->then([&](GattOperation *op) {
+        interval = op->value();
+    });
+    GattOperation *subscribe = async.subscribe(kService, kMeasurement);
+    QCOMPARE(async.pending(), 3);
+
+    qint64 elapsedNs = 0;
+    bool done = false;
+    async.all(QList<GattOperation *>() << readType << readInterval << subscribe)->then([&](GattOperation *op) {
+        QVERIFY(op->succeeded());
+        elapsedNs = op->elapsedNs();
+        done = true;
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(done, 2000);
+    QCOMPARE(type, QByteArray::fromHex("02"));
+    QCOMPARE(interval, QByteArray::fromHex("0100"));
+    QVERIFY2(elapsedNs < 80 * 1000000LL, qPrintable(QString::number(elapsedNs)));
+}
+
+void TestAsyncLink::timeout()
+{
+    SimPeripheral peripheral = slowThermometer();
+    peripheral.connectLatencyMs = 500;
+    SimTransport transport;
+    transport.addPeripheral(peripheral);
+    BLELink *link = transport.createLink(peripheral.info, &transport);
+    AsyncLink async(link);
+
+    GattOperation::Status status = GattOperation::Running;
+    async.connectToDevice(50)->then([&](GattOperation *op) { status = op->status(); });
+    QTRY_COMPARE_WITH_TIMEOUT(status, GattOperation::TimedOut, 1000);
+
+    // the abandoned attempt does not come up later
+    QTest::qWait(600);
+    QVERIFY(!link->isConnected());
+    QCOMPARE(transport.connectedLinks(), 0);
+}
+
+void TestAsyncLink::cancel()
+{
+    SimTransport transport;
+    transport.addPeripheral(slowThermometer());
+    BLELink *link = transport.createLink(SimTransport::thermometer(0).info, &transport);
+    AsyncLink async(link);
+
+    GattOperation::Status status = GattOperation::Running;
+    GattOperation *connect = async.connectToDevice()->then([&](GattOperation *op) { status = op->status(); });
+    connect->cancel();
+    QCOMPARE(status, GattOperation::Cancelled);
+    QCOMPARE(async.pending(), 0);
+
+    // a callback added after the end runs at once
+    bool late = false;
+    connect->then([&](GattOperation *op) { late = GattOperation::Cancelled == op->status(); });
+    QVERIFY(late);
+
+    QTest::qWait(50);
+    QVERIFY(!link->isConnected());
+}
+
+void TestAsyncLink::disconnectFailsPending()
+{
+    SimTransport transport;
+    transport.addPeripheral(slowThermometer());
+    BLELink *link = transport.createLink(SimTransport::thermometer(0).info, &transport);
+    AsyncLink async(link);
+
+    bool opened = false;
+    async.connectToDevice()->then([&](GattOperation *) {
+        async.discover(kService)->then([&](GattOperation *) {
+            async.open(kService, BLELink::SkipValues)->then([&](GattOperation *op) { opened = op->succeeded(); });
+        });
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(opened, 2000);
+
+    int failed = 0;
+    async.read(kService, kType)->then([&](GattOperation *op) { failed += GattOperation::Failed == op->status(); });
+    async.subscribe(kService, kMeasurement)->then([&](GattOperation *op) {
+        failed += GattOperation::Failed == op->status();
+    });
+    transport.setPowered(false);
+    QTRY_COMPARE_WITH_TIMEOUT(failed, 2, 1000);
+    QCOMPARE(async.pending(), 0);
+}
+
+void TestAsyncLink::groupFailsFast()
+{
+    SimTransport transport;
+    transport.addPeripheral(slowThermometer());
+    BLELink *link = transport.createLink(SimTransport::thermometer(0).info, &transport);
+    AsyncLink async(link);
+
+    bool opened = false;
+    async.connectToDevice()->then([&](GattOperation *) {
+        async.discover(kService)->then([&](GattOperation *) {
+            async.open(kService, BLELink::SkipValues)->then([&](GattOperation *op) { opened = op->succeeded(); });
+        });
+    });
+    QTRY_VERIFY_WITH_TIMEOUT(opened, 2000);
+
+    // Temperature Measurement is notify-only, its read fails before the others answer
+    GattOperation *slow = async.read(kService, kType);
+    GattOperation *bad = async.read(kService, kMeasurement);
+    GattOperation::Status group = GattOperation::Running;
+    GattOperation::Status other = GattOperation::Running;
+    slow->then([&](GattOperation *op) { other = op->status(); });
+    async.all(QList<GattOperation *>() << slow << bad)->then([&](GattOperation *op) { group = op->status(); });
+    QCOMPARE(group, GattOperation::Failed);
+    QCOMPARE(other, GattOperation::Cancelled);
+}
+
+QTEST_GUILESS_MAIN(TestAsyncLink)
+
+#include "tst_asynclink.moc"
@@ -0,0 +1,14 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_decode
+
+include(../../bt_masimo/core.pri)
+
+DEFINES += GOLDEN_VECTORS=\\\"$$PWD/../golden/vectors.txt\\\"
+
+SOURCES += \
+    tst_decode.cpp
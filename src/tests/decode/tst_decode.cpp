@@ -0,0 +1,283 @@
+// Decoder correctness against the golden vectors plus QBENCHMARK timings for
+// the notification hot path: decoding, formatting readings for the list and
+// the log, and the BLEInfo helpers. Run with -tickcounter or -perf for
+// steadier numbers than the default wall clock.
+
+#include "bleinfo.h"
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+
+#include <QFile>
+#include <QtTest>
+
+namespace {
+
+struct Vector {
+    quint16 service;
+    quint16 characteristic;
+    QByteArray payload;
+    QString expected;       // empty when the payload must be rejected
+};
+
+QVector<Vector> loadVectors()
+{
+    QVector<Vector> vectors;
+    QFile file(QStringLiteral(GOLDEN_VECTORS));
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return vectors;
+    while(!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if(line.isEmpty() || line.startsWith('#'))
+            continue;
+        const QStringList parts = line.split(' ');
+        if(parts.size() < 4)
+            continue;
+        Vector v;
+        v.service = quint16(parts[0].toUShort(nullptr, 16));
+        v.characteristic = quint16(parts[1].toUShort(nullptr, 16));
+        if(parts[2] != QLatin1String("-"))
+            v.payload = QByteArray::fromHex(parts[2].toLatin1());
+        if(parts[3] != QLatin1String("!"))
+            v.expected = parts.mid(3).join(' ');
+        vectors << v;
+    }
+    return vectors;
+}
+
+QString rowName(const Vector &v)
+{
+    return QString("%1/%2 %3").arg(v.characteristic, 4, 16, QLatin1Char('0'))
+            .arg(v.payload.size()).arg(QString::fromLatin1(v.payload.toHex()));
+}
+
+}
+
+class TestDecode : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void golden_data();
+    void golden();
+    void truncated_data();
+    void truncated();
+    void thermometerAgreement_data();
+    void thermometerAgreement();
+    void sfloatSpecialValues();
+
+    void benchThermometerDecode();
+    void benchGattDecode_data();
+    void benchGattDecode();
+    void benchMeasurementToString();
+    void benchGattToString();
+    void benchUuidToString();
+    void benchValueToString();
+    void benchHandleToString();
+
+private:
+    void vectorData(bool acceptedOnly, quint16 characteristic = 0);
+
+    QVector<Vector> m_vectors;
+};
+
+void TestDecode::initTestCase()
+{
+    m_vectors = loadVectors();
+    QVERIFY2(!m_vectors.isEmpty(), GOLDEN_VECTORS " is missing or empty");
+}
+
+void TestDecode::vectorData(bool acceptedOnly, quint16 characteristic)
+{
+    QTest::addColumn<int>("index");
+    for(int i = 0; i < m_vectors.size(); ++i) {
+        const Vector &v = m_vectors[i];
+        if((acceptedOnly && v.expected.isEmpty())
+           || (0 != characteristic && characteristic != v.characteristic))
+            continue;
+        QTest::newRow(qPrintable(rowName(v))) << i;
+    }
+}
+
+void TestDecode::golden_data()
+{
+    vectorData(false);
+}
+
+void TestDecode::golden()
+{
+    QFETCH(int, index);
+    const Vector &v = m_vectors[index];
+    const GattDecoder::Entry *decoder = GattDecoder::find(v.service, v.characteristic);
+    QVERIFY(nullptr != decoder);
+
+    GattReading r;
+    const bool ok = decoder->decode(v.payload.constData(), v.payload.size(), &r);
+    QCOMPARE(ok, !v.expected.isEmpty());
+    if(ok)
+        QCOMPARE(GattDecoder::toString(*decoder, r), v.expected);
+}
+
+void TestDecode::truncated_data()
+{
+    vectorData(true);
+}
+
+// every field a golden payload declares is there, so any shorter prefix is missing one
+void TestDecode::truncated()
+{
+    QFETCH(int, index);
+    const Vector &v = m_vectors[index];
+    const GattDecoder::Entry *decoder = GattDecoder::find(v.service, v.characteristic);
+    QVERIFY(nullptr != decoder);
+
+    for(int size = 0; size < v.payload.size(); ++size) {
+        // a copy of exactly size bytes so ASan catches a read past the end
+        const QByteArray prefix(v.payload.constData(), size);
+        GattReading r;
+        QVERIFY2(!decoder->decode(prefix.constData(), prefix.size(), &r),
+                 qPrintable(QString("accepted %1 of %2 bytes").arg(size).arg(v.payload.size())));
+    }
+}
+
+void TestDecode::thermometerAgreement_data()
+{
+    vectorData(false, 0x2A1C);
+}
+
+// the hand-written decoder feeding the journal must agree with the registry
+void TestDecode::thermometerAgreement()
+{
+    QFETCH(int, index);
+    const Vector &v = m_vectors[index];
+    GattReading r;
+    TemperatureMeasurement m;
+    const bool generated = GattDecoder::find(v.service, v.characteristic)->decode(v.payload.constData(), v.payload.size(), &r);
+    QCOMPARE(ThermometerDecoder::decode(v.payload.constData(), v.payload.size(), &m), generated);
+    if(!generated)
+        return;
+    QCOMPARE(m.flags, quint8(r.flags));
+    QCOMPARE(m.status, r.status[0]);
+    QCOMPARE(m.value, r.values[0]);
+    QCOMPARE(m.hasType(), r.hasCode(0));
+    if(m.hasType())
+        QCOMPARE(quint32(m.type), r.codes[0]);
+    QCOMPARE(m.year, r.year);
+    QCOMPARE(m.month, r.month);
+    QCOMPARE(m.day, r.day);
+    QCOMPARE(m.hours, r.hours);
+    QCOMPARE(m.minutes, r.minutes);
+    QCOMPARE(m.seconds, r.seconds);
+}
+
+void TestDecode::sfloatSpecialValues()
+{
+    const struct { quint16 raw; quint8 status; double value; } cases[] = {
+        {0x07FF, TemperatureMeasurement::NaN, 0.0},
+        {0x0800, TemperatureMeasurement::NRes, 0.0},
+        {0x07FE, TemperatureMeasurement::PositiveInfinity, 0.0},
+        {0x0802, TemperatureMeasurement::NegativeInfinity, 0.0},
+        {0x0801, TemperatureMeasurement::Reserved, 0.0},
+        {0x0062, TemperatureMeasurement::Valid, 98.0},
+        {0xF3E8, TemperatureMeasurement::Valid, 100.0},
+        {0x0FFF, TemperatureMeasurement::Valid, -1.0},
+        {0x8001, TemperatureMeasurement::Valid, 1e-8},
+    };
+    for(const auto &c : cases) {
+        const uchar bytes[] = {uchar(c.raw & 0xFF), uchar(c.raw >> 8)};
+        double value = -1.0;
+        QCOMPARE(GattLayout::decodeSFloat(bytes, &value), c.status);
+        QCOMPARE(value, c.value);
+    }
+}
+
+void TestDecode::benchThermometerDecode()
+{
+    const QByteArray a = QByteArray::fromHex("07d30300ffe50707080f220001");
+    TemperatureMeasurement m;
+    QBENCHMARK {
+        ThermometerDecoder::decode(a.constData(), a.size(), &m);
+    }
+    QCOMPARE(m.type, quint8(1));
+}
+
+void TestDecode::benchGattDecode_data()
+{
+    vectorData(true);
+}
+
+void TestDecode::benchGattDecode()
+{
+    QFETCH(int, index);
+    const Vector &v = m_vectors[index];
+    const GattDecoder::Entry *decoder = GattDecoder::find(v.service, v.characteristic);
+    GattReading r;
+    bool ok = false;
+    QBENCHMARK {
+        ok = decoder->decode(v.payload.constData(), v.payload.size(), &r);
+    }
+    QVERIFY(ok);
+}
+
+void TestDecode::benchMeasurementToString()
+{
+    const QByteArray a = QByteArray::fromHex("07d30300ffe50707080f220001");
+    TemperatureMeasurement m;
+    QVERIFY(ThermometerDecoder::decode(a.constData(), a.size(), &m));
+    QString s;
+    QBENCHMARK {
+        s = BLEInfo::measurementToString(m);
+    }
+    QCOMPARE(s, QStringLiteral("97.9F (armpit) 2021-07-08 15:34:00"));
+}
+
+void TestDecode::benchGattToString()
+{
+    const QByteArray a = QByteArray::fromHex("1f6100480062004900600047000000030000f300");
+    const GattDecoder::Entry *decoder = GattDecoder::find(0x1822, 0x2A5F);
+    GattReading r;
+    QVERIFY(decoder->decode(a.constData(), a.size(), &r));
+    QString s;
+    QBENCHMARK {
+        s = GattDecoder::toString(*decoder, r);
+    }
+    QVERIFY(s.startsWith(QLatin1String("plx_continuous spo2=97")));
+}
+
+void TestDecode::benchUuidToString()
+{
+    const QBluetoothUuid known(quint16(0x2A1C));
+    const QBluetoothUuid custom(QStringLiteral("{6e400001-b5a3-f393-e0a9-e50e24dcca9e}"));
+    QString a;
+    QString b;
+    QBENCHMARK {
+        a = BLEInfo::uuidToString(known);
+        b = BLEInfo::uuidToString(custom);
+    }
+    QCOMPARE(a, QStringLiteral("0x2a1c"));
+    QCOMPARE(b, QStringLiteral("6e400001-b5a3-f393-e0a9-e50e24dcca9e"));
+}
+
+void TestDecode::benchValueToString()
+{
+    const QByteArray a = QByteArray::fromHex("07d30300ffe50707080f220001");
+    QString s;
+    QBENCHMARK {
+        s = BLEInfo::valueToString(a);
+    }
+    QVERIFY(s.endsWith(QLatin1String("\n07d30300ffe50707080f220001")));
+}
+
+void TestDecode::benchHandleToString()
+{
+    QString s;
+    QBENCHMARK {
+        s = BLEInfo::handleToString(QLowEnergyHandle(0x002A));
+    }
+    QCOMPARE(s, QStringLiteral("0x2a"));
+}
+
+QTEST_GUILESS_MAIN(TestDecode)
+
+#include "tst_decode.moc"
@@ -0,0 +1,25 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = fuzz_decoders
+
+include(../../bt_masimo/core.pri)
+
+# qmake CONFIG+=libfuzzer QMAKE_CXX=clang++ QMAKE_LINK=clang++ builds the real
+# fuzzer; otherwise the same entry point is driven over the files given on
+# the command line, which is how the corpus runs as a regression test.
+libfuzzer {
+    QMAKE_CXXFLAGS += -fsanitize=fuzzer-no-link,address,undefined
+    QMAKE_LFLAGS += -fsanitize=fuzzer,address,undefined
+} else {
+    DEFINES += FUZZ_STANDALONE
+    # make check replays the seed corpus
+    check.commands = $$OUT_PWD/$$TARGET $$PWD/corpus
+    QMAKE_EXTRA_TARGETS += check
+}
+
+SOURCES += \
+    fuzz_decoders.cpp
@@ -0,0 +1,120 @@
+// libFuzzer harness for the measurement decoders. The first input byte picks
+// the decoder: a GattDecoder registry entry by index, or past the end of the
+// registry ThermometerDecoder, which is checked against the registry's own
+// Temperature Measurement layout. The rest is the notification payload.
+//
+//     fuzz_decoders -max_len=64 corpus/
+//
+// Without libFuzzer the files and directories on the command line are replayed
+// once each, e.g. the seed corpus built from tests/golden/vectors.txt.
+
+#include "gattdecoder.h"
+#include "thermometerdecoder.h"
+#include "bleinfo.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef FUZZ_STANDALONE
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#endif
+
+namespace {
+
+void check(bool condition)
+{
+    if(!condition)
+        std::abort();
+}
+
+// a reading may only fill slots its registry entry names, specials read as 0
+void checkReading(const GattDecoder::Entry &entry, const GattReading &r)
+{
+    check(r.service == entry.service && r.characteristic == entry.characteristic);
+    for(int i = 0; i < GattReading::kMaxValues; ++i) {
+        if(r.has(i))
+            check(nullptr != entry.values[i]);
+        if(r.has(i) && !r.isValid(i))
+            check(0.0 == r.values[i]);
+    }
+    for(int i = 0; i < GattReading::kMaxCodes; ++i) {
+        if(r.hasCode(i))
+            check(nullptr != entry.codes[i]);
+    }
+    GattDecoder::toString(entry, r);
+}
+
+void fuzzThermometer(const char *data, int size)
+{
+    TemperatureMeasurement m;
+    GattReading r;
+    const bool ok = ThermometerDecoder::decode(data, size, &m);
+    const bool generated = GattDecoder::find(0x1809, 0x2A1C)->decode(data, size, &r);
+    check(ok == generated);
+    if(!ok)
+        return;
+    check(m.status == r.status[0]);
+    check(m.value == r.values[0]);
+    check(m.year == r.year && m.month == r.month && m.day == r.day);
+    check(m.hasType() == r.hasCode(0));
+    BLEInfo::measurementToString(m);
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *input, size_t length)
+{
+    if(0 == length || length > 1024)
+        return 0;
+
+    // a heap copy of exactly the payload so ASan sees any read past its end
+    const int size = int(length - 1);
+    char *data = static_cast<char *>(std::malloc(size_t(qMax(1, size))));
+    std::memcpy(data, input + 1, size_t(size));
+
+    const int target = input[0] % (GattDecoder::count() + 1);
+    if(target == GattDecoder::count()) {
+        fuzzThermometer(data, size);
+    } else {
+        const GattDecoder::Entry &entry = GattDecoder::entry(target);
+        GattReading r;
+        if(entry.decode(data, size, &r))
+            checkReading(entry, r);
+    }
+
+    std::free(data);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char *argv[])
+{
+    QTextStream err(stderr);
+    int inputs = 0;
+    for(int i = 1; i < argc; ++i) {
+        QStringList files;
+        if(QFileInfo(argv[i]).isDir()) {
+            QDirIterator it(argv[i], QDir::Files, QDirIterator::Subdirectories);
+            while(it.hasNext())
+                files << it.next();
+        } else {
+            files << argv[i];
+        }
+        for(const QString &path : files) {
+            QFile file(path);
+            if(!file.open(QIODevice::ReadOnly)) {
+                err << "cannot read " << path << "\n";
+                return 1;
+            }
+            const QByteArray a = file.readAll();
+            LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(a.constData()), size_t(a.size()));
+            ++inputs;
+        }
+    }
+    err << inputs << " inputs ran clean\n";
+    return 0 == inputs ? 1 : 0;
+}
+#endif
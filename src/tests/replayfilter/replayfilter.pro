@@ -0,0 +1,12 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_replayfilter
+
+include(../../bt_masimo/core.pri)
+
+SOURCES += \
+    tst_replayfilter.cpp
@@ -0,0 +1,198 @@
+// ReplayFilter as the ingest worker runs it: a thermometer re-sending its
+// stored readings after a reconnect has them dropped, the index stays within
+// its fixed tables however many devices pass through, and the device clock
+// estimate settles on the transport delay and follows a clock set back.
+
+#include "replayfilter.h"
+
+#include <QtTest>
+
+#include <cstring>
+
+namespace {
+
+const quint64 kAddress = Q_UINT64_C(0xC026DA13B0DF);
+// 2024-02-29 12:00:00 UTC
+const qint64 kDeviceStart = Q_INT64_C(1709208000000);
+
+// a reading taken index seconds after kDeviceStart
+TemperatureMeasurement stored(int index, qint32 mantissa = 365)
+{
+    TemperatureMeasurement m;
+    std::memset(&m, 0, sizeof(m));
+    m.flags = TemperatureMeasurement::HasTimestamp;
+    m.mantissa = mantissa;
+    m.exponent = -1;
+    m.value = mantissa / 10.0;
+    m.year = 2024;
+    m.month = 2;
+    m.day = 29;
+    m.hours = 12 + index / 3600;
+    m.minutes = index / 60 % 60;
+    m.seconds = index % 60;
+    return m;
+}
+
+}
+
+class TestReplayFilter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void deviceMs();
+    void replaysDropped();
+    void untimestampedPass();
+    void memoryBound();
+    void offsetConverges();
+    void clockStep();
+    void admitBenchmark();
+};
+
+void TestReplayFilter::deviceMs()
+{
+    QCOMPARE(DeviceClock::deviceMs(stored(0)), kDeviceStart);
+    QCOMPARE(DeviceClock::deviceMs(stored(3661)), kDeviceStart + 3661000);
+
+    // what the Date Time characteristic allows but is not a date
+    TemperatureMeasurement m = stored(0);
+    m.year = 2023;
+    QCOMPARE(DeviceClock::deviceMs(m), qint64(0));
+    m = stored(0);
+    m.month = 0;
+    QCOMPARE(DeviceClock::deviceMs(m), qint64(0));
+    m = stored(0);
+    m.flags = 0;
+    QCOMPARE(DeviceClock::deviceMs(m), qint64(0));
+}
+
+void TestReplayFilter::replaysDropped()
+{
+    ReplayFilter filter;
+    const qint64 host = kDeviceStart + 2000;
+    for(int i = 0; i < 200; ++i) {
+        TemperatureMeasurement m = stored(i);
+        QVERIFY(filter.admit(kAddress, host + i * 1000, &m));
+    }
+
+    // reconnected: the device sends its last 100 again, then carries on
+    for(int i = 100; i < 200; ++i) {
+        TemperatureMeasurement m = stored(i);
+        QVERIFY(!filter.admit(kAddress, host + 300000 + i, &m));
+    }
+    TemperatureMeasurement next = stored(200);
+    QVERIFY(filter.admit(kAddress, host + 301000, &next));
+    QCOMPARE(filter.replays(), quint64(100));
+
+    // the same time with another value, or another device, is a new reading
+    TemperatureMeasurement other = stored(150, 370);
+    QVERIFY(filter.admit(kAddress, host + 302000, &other));
+    TemperatureMeasurement same = stored(150);
+    QVERIFY(filter.admit(kAddress + 1, host + 302000, &same));
+}
+
+void TestReplayFilter::untimestampedPass()
+{
+    ReplayFilter filter;
+    TemperatureMeasurement m = stored(0);
+    m.flags = 0;
+    for(int i = 0; i < 10; ++i) {
+        QVERIFY(filter.admit(kAddress, kDeviceStart, &m));
+        QCOMPARE(m.measuredMs, qint64(0));
+    }
+    QCOMPARE(filter.index().deviceCount(), 0);
+}
+
+void TestReplayFilter::memoryBound()
+{
+    ReplayIndex index(256, 64);
+    QCOMPARE(index.readingsPerDevice(), 256);
+    for(int device = 0; device < 64; ++device)
+        QVERIFY(index.insert(kAddress + device, kDeviceStart, stored(0)));
+    const qint64 full = index.memoryBytes();
+    QCOMPARE(full, qint64(64 * 256 * 4));
+
+    // the oldest devices give their tables up, nothing grows
+    for(int device = 64; device < 1000; ++device) {
+        for(int i = 0; i < 300; ++i)
+            index.insert(kAddress + device, kDeviceStart + i * 1000, stored(i));
+    }
+    QCOMPARE(index.deviceCount(), 64);
+    QCOMPARE(index.memoryBytes(), full);
+    QVERIFY(!index.contains(kAddress, kDeviceStart, stored(0)));
+    QVERIFY(index.contains(kAddress + 999, kDeviceStart + 299000, stored(299)));
+}
+
+void TestReplayFilter::offsetConverges()
+{
+    ReplayFilter filter;
+    // the device clock is 90 s behind and delivery takes 20..520 ms
+    const qint64 skew = 90000;
+    for(int i = 0; i < 600; ++i) {
+        TemperatureMeasurement m = stored(i);
+        const qint64 taken = kDeviceStart + i * 1000 + skew;
+        QVERIFY(filter.admit(kAddress, taken + 20 + (i * 37) % 500, &m));
+        if(i > 10)
+            QVERIFY2(qAbs(m.measuredMs - taken) <= 1000, qPrintable(QString::number(m.measuredMs - taken)));
+    }
+
+    // a burst of replays arriving much later must not pull the estimate
+    qint64 before = 0;
+    QVERIFY(filter.clock().offset(kAddress, &before));
+    for(int i = 500; i < 600; ++i) {
+        TemperatureMeasurement m = stored(i);
+        filter.admit(kAddress, kDeviceStart + 3600000, &m);
+    }
+    qint64 after = 0;
+    QVERIFY(filter.clock().offset(kAddress, &after));
+    QCOMPARE(after, before);
+    QCOMPARE(filter.clock().steps(), quint64(0));
+}
+
+void TestReplayFilter::clockStep()
+{
+    ReplayFilter filter;
+    filter.clock().setStepAfterMs(60000);
+    for(int i = 0; i < 60; ++i) {
+        TemperatureMeasurement m = stored(i);
+        filter.admit(kAddress, kDeviceStart + i * 1000 + 100, &m);
+    }
+
+    // the device clock is set back an hour: readings look an hour late until adopted
+    const qint64 back = 3600000;
+    TemperatureMeasurement m;
+    for(int i = 60; i < 200; ++i) {
+        m = stored(i);
+        m.hours = 11;
+        filter.admit(kAddress, kDeviceStart + i * 1000 + 100, &m);
+    }
+    QCOMPARE(filter.clock().steps(), quint64(1));
+    qint64 offset = 0;
+    QVERIFY(filter.clock().offset(kAddress, &offset));
+    QVERIFY(qAbs(offset - (back + 100)) <= 100);
+    QVERIFY(qAbs(m.measuredMs - (kDeviceStart + 199 * 1000)) <= 1000);
+}
+
+void TestReplayFilter::admitBenchmark()
+{
+    // 64 devices each sending a new reading a second, every tenth one sent twice
+    ReplayFilter filter;
+    int second = 0;
+    QBENCHMARK {
+        for(int i = 0; i < 64 * 16; ++i) {
+            const int index = second + i / 64;
+            // stay within the day stored() can express, new values keep the readings distinct
+            TemperatureMeasurement m = stored(index % 40000, 365 + index / 40000);
+            const quint64 address = kAddress + quint64(i % 64);
+            const qint64 host = kDeviceStart + qint64(index) * 1000 + 200;
+            filter.admit(address, host, &m);
+            if(0 == i % 10)
+                filter.admit(address, host + 5, &m);
+        }
+        second += 16;
+    }
+}
+
+QTEST_GUILESS_MAIN(TestReplayFilter)
+
+#include "tst_replayfilter.moc"
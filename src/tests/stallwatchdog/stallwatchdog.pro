@@ -0,0 +1,12 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_stallwatchdog
+
+include(../../bt_masimo/core.pri)
+
+SOURCES += \
+    tst_stallwatchdog.cpp
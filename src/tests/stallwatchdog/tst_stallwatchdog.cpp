@@ -0,0 +1,156 @@
+// StallWatchdog and SlotProfiler on a real event loop: a handler that blocks
+// the loop is caught and named, short ones are not, and the profile comes
+// out as a Chrome trace with the handler runs and the stall.
+
+#include "slotprofiler.h"
+#include "stallwatchdog.h"
+#include "../testsupport.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+const char *const kSlow = "TestStallWatchdog::slowHandler";
+const char *const kQuick = "TestStallWatchdog::quickHandler";
+
+void slowHandler()
+{
+    PROFILE_SLOT(kSlow);
+    QThread::msleep(200);
+}
+
+void quickHandler()
+{
+    PROFILE_SLOT(kQuick);
+    QThread::msleep(5);
+}
+
+}
+
+class TestStallWatchdog : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void namesStalledHandler();
+    void namesStalledHandlerUnprofiled();
+    void ignoresShortHandlers();
+    void disabledRecordsNothing();
+    void chromeTrace();
+};
+
+void TestStallWatchdog::initTestCase()
+{
+    qInstallMessageHandler(dropMessages);
+}
+
+void TestStallWatchdog::init()
+{
+    SlotProfiler::setEnabled(true);
+    SlotProfiler::setTraceCapacity(1000);
+    SlotProfiler::reset();
+}
+
+void TestStallWatchdog::namesStalledHandler()
+{
+    StallWatchdog watchdog(50);
+    QSignalSpy stalled(&watchdog, &StallWatchdog::stalled);
+    watchdog.watch();
+    QTest::qWait(50);
+
+    QTimer::singleShot(0, &slowHandler);
+    QTRY_COMPARE_WITH_TIMEOUT(stalled.count(), 1, 1000);
+    QVERIFY2(stalled.at(0).at(0).toLongLong() >= 120, qPrintable(stalled.at(0).at(0).toString()));
+    QCOMPARE(stalled.at(0).at(1).toString(), QString(kSlow));
+    QCOMPARE(watchdog.stalls(), quint64(1));
+    QCOMPARE(watchdog.stallTime().count(), quint64(1));
+}
+
+void TestStallWatchdog::namesStalledHandlerUnprofiled()
+{
+    // the default run: watching without --profile
+    SlotProfiler::setEnabled(false);
+    StallWatchdog watchdog(50);
+    QSignalSpy stalled(&watchdog, &StallWatchdog::stalled);
+    watchdog.watch();
+    QTest::qWait(50);
+
+    QTimer::singleShot(0, &slowHandler);
+    QTRY_COMPARE_WITH_TIMEOUT(stalled.count(), 1, 1000);
+    QCOMPARE(stalled.at(0).at(1).toString(), QString(kSlow));
+    QCOMPARE(SlotProfiler::site(kSlow)->duration.count(), quint64(0));
+
+    // nothing left on the stack once the handler is done
+    const char *names[SlotProfiler::kMaxDepth];
+    QCOMPARE(SlotProfiler::running(names, SlotProfiler::kMaxDepth), 0);
+}
+
+void TestStallWatchdog::ignoresShortHandlers()
+{
+    StallWatchdog watchdog(50);
+    QSignalSpy stalled(&watchdog, &StallWatchdog::stalled);
+    watchdog.watch();
+    QTest::qWait(50);
+
+    for(int i = 0; i < 20; ++i)
+        QTimer::singleShot(i * 10, &quickHandler);
+    QTest::qWait(300);
+    QCOMPARE(stalled.count(), 0);
+    QCOMPARE(SlotProfiler::site(kQuick)->duration.count(), quint64(20));
+}
+
+void TestStallWatchdog::disabledRecordsNothing()
+{
+    SlotProfiler::setEnabled(false);
+    quickHandler();
+    QCOMPARE(SlotProfiler::site(kQuick)->duration.count(), quint64(0));
+
+    const char *names[SlotProfiler::kMaxDepth];
+    QCOMPARE(SlotProfiler::running(names, SlotProfiler::kMaxDepth), 0);
+}
+
+void TestStallWatchdog::chromeTrace()
+{
+    StallWatchdog watchdog(50);
+    QSignalSpy stalled(&watchdog, &StallWatchdog::stalled);
+    watchdog.watch();
+    QTest::qWait(50);
+    quickHandler();
+    QTimer::singleShot(0, &slowHandler);
+    QTRY_COMPARE_WITH_TIMEOUT(stalled.count(), 1, 1000);
+
+    QTemporaryDir dir;
+    const QString path = dir.filePath("trace.json");
+    QVERIFY(SlotProfiler::writeChromeTrace(path));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+
+    int slowRuns = 0;
+    int stalls = 0;
+    for(const QJsonValue &value : json["traceEvents"].toArray()) {
+        const QJsonObject event = value.toObject();
+        if("X" != event["ph"].toString())
+            continue;
+        QVERIFY(event.contains("ts") && event.contains("dur") && event.contains("tid"));
+        if(kSlow == event["name"].toString()) {
+            ++slowRuns;
+            QVERIFY(event["dur"].toDouble() >= 200000.0);
+        }
+        stalls += "stall" == event["cat"].toString();
+    }
+    QCOMPARE(slowRuns, 1);
+    QCOMPARE(stalls, 1);
+    QCOMPARE(json["slots"].toObject()[kQuick].toObject()["count"].toInt(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestStallWatchdog)
+
+#include "tst_stallwatchdog.moc"
@@ -0,0 +1,11 @@
+# make check runs the decoder tests and replays the fuzzer's seed corpus;
+# ./decode/tst_decode on its own also prints the QBENCHMARK timings
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    adapterpool \
+    asynclink \
+    decode \
+    fuzz \
+    replayfilter \
+    stallwatchdog
@@ -0,0 +1,13 @@
+#ifndef TESTSUPPORT_H
+#define TESTSUPPORT_H
+
+// helpers the tests share, included as "../testsupport.h"
+
+#include <QtGlobal>
+
+// swallows every message, QtTest's included; a test that prints or captures messages raises Log::setLevel instead
+inline void dropMessages(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+#endif // TESTSUPPORT_H